@@ -0,0 +1,494 @@
+#include "bench_harness.h"
+#include "cpu_caps.h"
+#include "timing.h"
+#include "topology.h"
+#include "results_store.h"
+#include <math.h>
+#include <getopt.h>
+
+#define CPUFREQ_PATH "/sys/devices/system/cpu/cpu%d/cpufreq/%s"
+
+static const bench_kernel_t *g_kernels[BENCH_MAX_KERNELS];
+static int g_num_kernels = 0;
+
+static bench_options_t g_opts;
+static FILE *g_json = NULL;
+static FILE *g_csv = NULL;
+static char g_run_id[64];
+static time_t g_run_time;
+static char g_host[64];
+
+// Saved cpufreq limits for restore after a locked-frequency run
+typedef struct {
+    int cpu;
+    int min_khz;
+    int max_khz;
+} freq_saved_t;
+
+static freq_saved_t *g_freq_saved = NULL;
+static int g_num_freq_saved = 0;
+
+// Two-sided 95% Student t critical values for 1..30 degrees of freedom
+static const double t_table_95[] = {
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+    2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+    2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+};
+
+void bench_options_init(bench_options_t *opts, const char *benchmark) {
+    memset(opts, 0, sizeof(*opts));
+    opts->benchmark = benchmark;
+    opts->warmup = BENCH_DEFAULT_WARMUP;
+    opts->repetitions = BENCH_DEFAULT_REPS;
+    opts->outlier_k = BENCH_DEFAULT_OUTLIER;
+    opts->pin_cpu = -1;
+    opts->store = 1;
+}
+
+void bench_print_usage(void) {
+    printf("Harness options:\n");
+    printf("  --warmup N        Unmeasured runs before sampling (default %d)\n", BENCH_DEFAULT_WARMUP);
+    printf("  --reps N          Measured repetitions (default %d)\n", BENCH_DEFAULT_REPS);
+    printf("  --outlier-k K     Reject samples beyond K robust z-scores, 0 disables (default %.1f)\n",
+           BENCH_DEFAULT_OUTLIER);
+    printf("  --pin CPU         Pin the benchmark thread to CPU\n");
+    printf("  --lock-freq KHZ   Lock cpufreq min/max to KHZ during the run\n");
+    printf("  --json FILE       Write JSON lines results (\"-\" for stdout)\n");
+    printf("  --csv FILE        Write CSV results (\"-\" for stdout)\n");
+    printf("  --no-store        Do not append results to the per-host store\n");
+    printf("                    (%s, default %s)\n", RESULTS_DIR_ENV, RESULTS_DEFAULT_DIR);
+    printf("  --kernel NAME     Only run kernels whose name contains NAME\n");
+    printf("  --list            List registered kernels and exit\n");
+    printf("  --verbose         Print statistics for every kernel\n");
+}
+
+// Consume harness options and leave everything else in argv for the caller
+int bench_parse_args(bench_options_t *opts, int *argc, char **argv) {
+    static const struct option long_opts[] = {
+        { "warmup",    required_argument, NULL, 'w' },
+        { "reps",      required_argument, NULL, 'r' },
+        { "outlier-k", required_argument, NULL, 'k' },
+        { "pin",       required_argument, NULL, 'p' },
+        { "lock-freq", required_argument, NULL, 'f' },
+        { "json",      required_argument, NULL, 'j' },
+        { "csv",       required_argument, NULL, 'c' },
+        { "kernel",    required_argument, NULL, 'n' },
+        { "no-store",  no_argument,       NULL, 's' },
+        { "list",      no_argument,       NULL, 'l' },
+        { "verbose",   no_argument,       NULL, 'v' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    int out = 1;
+    for (int i = 1; i < *argc; i++) {
+        const char *arg = argv[i];
+        const struct option *match = NULL;
+
+        if (strncmp(arg, "--", 2) == 0) {
+            for (const struct option *o = long_opts; o->name; o++) {
+                if (strcmp(arg + 2, o->name) == 0) {
+                    match = o;
+                    break;
+                }
+            }
+        }
+
+        if (!match) {
+            argv[out++] = argv[i];
+            continue;
+        }
+
+        const char *value = NULL;
+        if (match->has_arg == required_argument) {
+            if (i + 1 >= *argc) {
+                PRINT_ERROR("Option %s requires a value", arg);
+                return ERROR_INVALID_PARAM;
+            }
+            value = argv[++i];
+        }
+
+        switch (match->val) {
+            case 'w': opts->warmup = atoi(value); break;
+            case 'r': opts->repetitions = atoi(value); break;
+            case 'k': opts->outlier_k = atof(value); break;
+            case 'p': opts->pin_cpu = atoi(value); break;
+            case 'f': opts->lock_freq_khz = atoi(value); break;
+            case 'j': opts->json_path = value; break;
+            case 'c': opts->csv_path = value; break;
+            case 'n': opts->kernel_filter = value; break;
+            case 's': opts->store = 0; break;
+            case 'v': opts->verbose = 1; break;
+            case 'l':
+                bench_list_kernels();
+                exit(EXIT_SUCCESS);
+        }
+    }
+
+    argv[out] = NULL;
+    *argc = out;
+
+    if (opts->repetitions < 1 || opts->repetitions > BENCH_MAX_SAMPLES || opts->warmup < 0) {
+        PRINT_ERROR("Invalid repetition count: --reps must be 1..%d, --warmup >= 0", BENCH_MAX_SAMPLES);
+        return ERROR_INVALID_PARAM;
+    }
+    return SUCCESS;
+}
+
+int bench_register(const bench_kernel_t *kernel) {
+    if (kernel == NULL || kernel->run == NULL || g_num_kernels >= BENCH_MAX_KERNELS) {
+        return ERROR_INVALID_PARAM;
+    }
+    for (int i = 0; i < g_num_kernels; i++) {
+        if (g_kernels[i] == kernel) {
+            return SUCCESS;
+        }
+    }
+    g_kernels[g_num_kernels++] = kernel;
+    return SUCCESS;
+}
+
+const bench_kernel_t *bench_find(const char *name) {
+    for (int i = 0; i < g_num_kernels; i++) {
+        if (strcmp(g_kernels[i]->name, name) == 0) {
+            return g_kernels[i];
+        }
+    }
+    return NULL;
+}
+
+int bench_kernel_selected(const bench_kernel_t *kernel) {
+    return g_opts.kernel_filter == NULL || strstr(kernel->name, g_opts.kernel_filter) != NULL;
+}
+
+void bench_list_kernels(void) {
+    printf("Registered kernels:\n");
+    for (int i = 0; i < g_num_kernels; i++) {
+        printf("  %-24s %-10s %s\n", g_kernels[i]->name, g_kernels[i]->unit,
+               g_kernels[i]->higher_is_better ? "higher is better" : "lower is better");
+    }
+}
+
+static int write_freq(int cpu, const char *file, int khz) {
+    char path[256], value[32];
+    snprintf(path, sizeof(path), CPUFREQ_PATH, cpu, file);
+    snprintf(value, sizeof(value), "%d", khz);
+    return write_file_str(path, value);
+}
+
+// Lower or raise both limits in an order the kernel accepts (min <= max)
+static int set_freq_limits(int cpu, int current_max, int min_khz, int max_khz) {
+    if (min_khz > current_max) {
+        if (write_freq(cpu, "scaling_max_freq", max_khz) != SUCCESS) return ERROR_SYSTEM;
+        return write_freq(cpu, "scaling_min_freq", min_khz);
+    }
+    if (write_freq(cpu, "scaling_min_freq", min_khz) != SUCCESS) return ERROR_SYSTEM;
+    return write_freq(cpu, "scaling_max_freq", max_khz);
+}
+
+static void freq_restore(void) {
+    for (int i = 0; i < g_num_freq_saved; i++) {
+        freq_saved_t *s = &g_freq_saved[i];
+        set_freq_limits(s->cpu, g_opts.lock_freq_khz, s->min_khz, s->max_khz);
+    }
+    free(g_freq_saved);
+    g_freq_saved = NULL;
+    g_num_freq_saved = 0;
+}
+
+static int freq_lock(int khz, int pin_cpu) {
+    const topology_t *topo = topology_get();
+    int max_cpus = topo ? topo->max_cpus : get_cpu_count();
+
+    g_freq_saved = calloc(max_cpus, sizeof(freq_saved_t));
+    if (!g_freq_saved) {
+        return ERROR_SYSTEM;
+    }
+
+    for (int cpu = 0; cpu < max_cpus; cpu++) {
+        if (pin_cpu >= 0 && cpu != pin_cpu) continue;
+        if (topo && !topo->cpus[cpu].online) continue;
+
+        char path[256];
+        freq_saved_t *s = &g_freq_saved[g_num_freq_saved];
+        s->cpu = cpu;
+        snprintf(path, sizeof(path), CPUFREQ_PATH, cpu, "scaling_min_freq");
+        if (read_file_int(path, &s->min_khz) != SUCCESS) goto fail;
+        snprintf(path, sizeof(path), CPUFREQ_PATH, cpu, "scaling_max_freq");
+        if (read_file_int(path, &s->max_khz) != SUCCESS) goto fail;
+        g_num_freq_saved++;
+
+        if (set_freq_limits(cpu, s->max_khz, khz, khz) != SUCCESS) goto fail;
+    }
+
+    PRINT_INFO("Locked %d CPU(s) to %d kHz", g_num_freq_saved, khz);
+    return SUCCESS;
+
+fail:
+    PRINT_ERROR("Failed to lock CPU frequency to %d kHz", khz);
+    freq_restore();
+    return ERROR_SYSTEM;
+}
+
+static FILE *open_output(const char *path) {
+    if (path == NULL) {
+        return NULL;
+    }
+    if (strcmp(path, "-") == 0) {
+        return stdout;
+    }
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        PRINT_ERROR("Failed to open %s: %s", path, strerror(errno));
+    }
+    return fp;
+}
+
+int bench_begin(const bench_options_t *opts) {
+    g_opts = *opts;
+    timing_init();
+
+    g_run_time = time(NULL);
+    snprintf(g_run_id, sizeof(g_run_id), "%ld-%d", (long)g_run_time, (int)getpid());
+    if (gethostname(g_host, sizeof(g_host)) != 0) {
+        strcpy(g_host, "unknown");
+    }
+    g_host[sizeof(g_host) - 1] = '\0';
+
+    if (opts->pin_cpu >= 0 && topo_pin_thread(opts->pin_cpu) != SUCCESS) {
+        return ERROR_SYSTEM;
+    }
+
+    if (opts->lock_freq_khz > 0 && freq_lock(opts->lock_freq_khz, opts->pin_cpu) != SUCCESS) {
+        return ERROR_SYSTEM;
+    }
+
+    g_json = open_output(opts->json_path);
+    g_csv = open_output(opts->csv_path);
+    if ((opts->json_path && !g_json) || (opts->csv_path && !g_csv)) {
+        bench_end();
+        return ERROR_SYSTEM;
+    }
+
+    if (g_csv) {
+        fprintf(g_csv, "run_id,benchmark,kernel,config,unit,n,rejected,mean,stddev,"
+                       "min,max,median,p95,p99,ci95_lo,ci95_hi\n");
+    }
+    return SUCCESS;
+}
+
+void bench_end(void) {
+    if (g_json && g_json != stdout) fclose(g_json);
+    if (g_csv && g_csv != stdout) fclose(g_csv);
+    g_json = g_csv = NULL;
+
+    if (g_num_freq_saved > 0) {
+        freq_restore();
+    }
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Linear interpolation between closest ranks
+double bench_percentile(const double *sorted, int n, double pct) {
+    if (n <= 0) return 0.0;
+    if (n == 1) return sorted[0];
+
+    double rank = pct / 100.0 * (n - 1);
+    int lo = (int)rank;
+    int hi = lo + 1 < n ? lo + 1 : lo;
+    double frac = rank - lo;
+    return sorted[lo] + (sorted[hi] - sorted[lo]) * frac;
+}
+
+void bench_compute_stats(const double *samples, int n, double outlier_k, bench_stats_t *stats) {
+    double sorted[BENCH_MAX_SAMPLES];
+    double deviation[BENCH_MAX_SAMPLES];
+
+    memset(stats, 0, sizeof(*stats));
+    if (n <= 0) return;
+    if (n > BENCH_MAX_SAMPLES) n = BENCH_MAX_SAMPLES;
+
+    memcpy(sorted, samples, n * sizeof(double));
+    qsort(sorted, n, sizeof(double), compare_double);
+
+    // Median absolute deviation based rejection is robust for small n
+    int kept = n;
+    if (outlier_k > 0 && n >= 3) {
+        double median = bench_percentile(sorted, n, 50.0);
+        for (int i = 0; i < n; i++) {
+            deviation[i] = fabs(sorted[i] - median);
+        }
+        qsort(deviation, n, sizeof(double), compare_double);
+        double mad = 1.4826 * bench_percentile(deviation, n, 50.0);
+
+        if (mad > 0) {
+            kept = 0;
+            for (int i = 0; i < n; i++) {
+                if (fabs(sorted[i] - median) <= outlier_k * mad) {
+                    sorted[kept++] = sorted[i];
+                }
+            }
+        }
+    }
+
+    stats->n = kept;
+    stats->rejected = n - kept;
+    memcpy(stats->samples, sorted, kept * sizeof(double));
+
+    double sum = 0.0;
+    for (int i = 0; i < kept; i++) sum += sorted[i];
+    stats->mean = sum / kept;
+
+    double var = 0.0;
+    for (int i = 0; i < kept; i++) var += (sorted[i] - stats->mean) * (sorted[i] - stats->mean);
+    stats->stddev = kept > 1 ? sqrt(var / (kept - 1)) : 0.0;
+
+    stats->min = sorted[0];
+    stats->max = sorted[kept - 1];
+    stats->median = bench_percentile(sorted, kept, 50.0);
+    stats->p95 = bench_percentile(sorted, kept, 95.0);
+    stats->p99 = bench_percentile(sorted, kept, 99.0);
+
+    double t = 1.96;
+    if (kept - 1 >= 1 && kept - 1 <= 30) {
+        t = t_table_95[kept - 2];
+    }
+    double half = kept > 1 ? t * stats->stddev / sqrt((double)kept) : 0.0;
+    stats->ci95_lo = stats->mean - half;
+    stats->ci95_hi = stats->mean + half;
+}
+
+static void json_string(FILE *fp, const char *str) {
+    fputc('"', fp);
+    for (const char *p = str ? str : ""; *p; p++) {
+        if (*p == '"' || *p == '\\') {
+            fputc('\\', fp);
+            fputc(*p, fp);
+        } else if ((unsigned char)*p < 0x20) {
+            fprintf(fp, "\\u%04x", *p);
+        } else {
+            fputc(*p, fp);
+        }
+    }
+    fputc('"', fp);
+}
+
+static void csv_string(FILE *fp, const char *str) {
+    fputc('"', fp);
+    for (const char *p = str ? str : ""; *p; p++) {
+        if (*p == '"') fputc('"', fp);
+        fputc(*p, fp);
+    }
+    fputc('"', fp);
+}
+
+static void write_json_record(FILE *fp, const bench_kernel_t *kernel, const char *config,
+                              const bench_stats_t *s) {
+    const cpu_caps_t *caps = cpu_caps_get();
+
+    fprintf(fp, "{\"run_id\":");
+    json_string(fp, g_run_id);
+    fprintf(fp, ",\"timestamp\":%ld", (long)g_run_time);
+    fprintf(fp, ",\"host\":");
+    json_string(fp, g_host);
+    fprintf(fp, ",\"cpu_vendor\":");
+    json_string(fp, caps->vendor);
+    fprintf(fp, ",\"cpu_model\":");
+    json_string(fp, caps->brand);
+    fprintf(fp, ",\"cpu_signature\":\"%d-%d-%d\"", caps->family, caps->model, caps->stepping);
+    fprintf(fp, ",\"benchmark\":");
+    json_string(fp, g_opts.benchmark);
+    fprintf(fp, ",\"kernel\":");
+    json_string(fp, kernel->name);
+    fprintf(fp, ",\"config\":");
+    json_string(fp, config);
+    fprintf(fp, ",\"unit\":");
+    json_string(fp, kernel->unit);
+    fprintf(fp, ",\"higher_is_better\":%d", kernel->higher_is_better ? 1 : 0);
+    fprintf(fp, ",\"warmup\":%d,\"reps\":%d,\"pin_cpu\":%d,\"lock_freq_khz\":%d",
+            g_opts.warmup, g_opts.repetitions, g_opts.pin_cpu, g_opts.lock_freq_khz);
+    fprintf(fp, ",\"n\":%d,\"rejected\":%d,\"mean\":%.6g,\"stddev\":%.6g,\"min\":%.6g,"
+                    "\"max\":%.6g,\"median\":%.6g,\"p95\":%.6g,\"p99\":%.6g,"
+                    "\"ci95_lo\":%.6g,\"ci95_hi\":%.6g",
+            s->n, s->rejected, s->mean, s->stddev, s->min, s->max, s->median,
+            s->p95, s->p99, s->ci95_lo, s->ci95_hi);
+    fprintf(fp, ",\"samples\":[");
+    for (int i = 0; i < s->n; i++) {
+        fprintf(fp, "%s%.6g", i ? "," : "", s->samples[i]);
+    }
+    fprintf(fp, "]}\n");
+}
+
+// Format the record once so the store receives it with a single append
+static void emit_json(const bench_kernel_t *kernel, const char *config, const bench_stats_t *s) {
+    char *line = NULL;
+    size_t len = 0;
+    FILE *fp = open_memstream(&line, &len);
+    if (!fp) {
+        return;
+    }
+    write_json_record(fp, kernel, config, s);
+    fclose(fp);
+
+    if (g_json) {
+        fwrite(line, 1, len, g_json);
+        fflush(g_json);
+    }
+    if (g_opts.store && results_store_append(line, len) != SUCCESS) {
+        PRINT_INFO("Results store disabled for this run");
+        g_opts.store = 0;
+    }
+    free(line);
+}
+
+static void emit_csv(const bench_kernel_t *kernel, const char *config, const bench_stats_t *s) {
+    fprintf(g_csv, "%s,", g_run_id);
+    csv_string(g_csv, g_opts.benchmark);
+    fputc(',', g_csv);
+    csv_string(g_csv, kernel->name);
+    fputc(',', g_csv);
+    csv_string(g_csv, config);
+    fputc(',', g_csv);
+    csv_string(g_csv, kernel->unit);
+    fprintf(g_csv, ",%d,%d,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g\n",
+            s->n, s->rejected, s->mean, s->stddev, s->min, s->max, s->median,
+            s->p95, s->p99, s->ci95_lo, s->ci95_hi);
+    fflush(g_csv);
+}
+
+void bench_print_stats(const bench_kernel_t *kernel, const char *config, const bench_stats_t *s) {
+    PRINT_INFO("%s [%s]: median %.2f %s, mean %.2f +/- %.2f (95%% CI), p95 %.2f, p99 %.2f, n=%d, rejected=%d",
+               kernel->name, config, s->median, kernel->unit, s->mean,
+               (s->ci95_hi - s->ci95_lo) / 2, s->p95, s->p99, s->n, s->rejected);
+}
+
+int bench_run(const bench_kernel_t *kernel, void *ctx, const char *config, bench_stats_t *stats) {
+    double samples[BENCH_MAX_SAMPLES];
+
+    // Callers that never ran bench_begin() get the default options
+    if (g_opts.repetitions <= 0) {
+        bench_options_init(&g_opts, "bench");
+    }
+
+    bench_register(kernel);
+
+    for (int i = 0; i < g_opts.warmup; i++) {
+        kernel->run(ctx);
+    }
+
+    for (int i = 0; i < g_opts.repetitions; i++) {
+        samples[i] = kernel->run(ctx);
+    }
+
+    bench_compute_stats(samples, g_opts.repetitions, g_opts.outlier_k, stats);
+
+    if (g_json || g_opts.store) emit_json(kernel, config, stats);
+    if (g_csv) emit_csv(kernel, config, stats);
+    if (g_opts.verbose) bench_print_stats(kernel, config, stats);
+
+    return SUCCESS;
+}
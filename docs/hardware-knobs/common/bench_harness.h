@@ -0,0 +1,79 @@
+#ifndef BENCH_HARNESS_H
+#define BENCH_HARNESS_H
+
+#include <stdint.h>
+#include "common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BENCH_MAX_KERNELS     64
+#define BENCH_MAX_SAMPLES     1024
+#define BENCH_DEFAULT_WARMUP  1
+#define BENCH_DEFAULT_REPS    5
+#define BENCH_DEFAULT_OUTLIER 3.5   // Robust z-score (MAD units) cut-off
+
+// A benchmark kernel returns one sample of its metric per call
+typedef double (*bench_kernel_fn)(void *ctx);
+
+typedef struct {
+    const char *name;          // e.g. "seq_read"
+    const char *unit;          // e.g. "MB/s"
+    int higher_is_better;
+    bench_kernel_fn run;
+} bench_kernel_t;
+
+typedef struct {
+    const char *benchmark;     // Program name used as the result key prefix
+    int warmup;
+    int repetitions;
+    double outlier_k;          // 0 disables outlier rejection
+    int pin_cpu;               // -1 leaves affinity alone
+    int lock_freq_khz;         // 0 leaves cpufreq alone
+    const char *json_path;     // JSON lines output, "-" for stdout
+    const char *csv_path;      // CSV output, "-" for stdout
+    const char *kernel_filter; // Run only kernels whose name contains this
+    int store;                 // Append JSON records to the per-host results store
+    int verbose;
+} bench_options_t;
+
+typedef struct {
+    int n;                     // Samples kept after outlier rejection
+    int rejected;
+    double mean;
+    double stddev;
+    double min;
+    double max;
+    double median;
+    double p95;
+    double p99;
+    double ci95_lo;            // 95% confidence interval of the mean
+    double ci95_hi;
+    double samples[BENCH_MAX_SAMPLES];
+} bench_stats_t;
+
+// Harness lifecycle
+void bench_options_init(bench_options_t *opts, const char *benchmark);
+int bench_parse_args(bench_options_t *opts, int *argc, char **argv);
+void bench_print_usage(void);
+int bench_begin(const bench_options_t *opts);
+void bench_end(void);
+
+// Kernel registry
+int bench_register(const bench_kernel_t *kernel);
+const bench_kernel_t *bench_find(const char *name);
+int bench_kernel_selected(const bench_kernel_t *kernel);
+void bench_list_kernels(void);
+
+// Measurement and reporting
+int bench_run(const bench_kernel_t *kernel, void *ctx, const char *config, bench_stats_t *stats);
+void bench_compute_stats(const double *samples, int n, double outlier_k, bench_stats_t *stats);
+void bench_print_stats(const bench_kernel_t *kernel, const char *config, const bench_stats_t *stats);
+double bench_percentile(const double *sorted, int n, double pct);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BENCH_HARNESS_H */
@@ -1,4 +1,5 @@
 #include "common.h"
+#include "cpu_caps.h"
 #include <time.h>
 #include <sys/time.h>
 #include <sys/sysinfo.h>
@@ -131,30 +132,19 @@ int get_cpu_vendor(char *vendor, size_t size) {
 }
 
 int check_cpu_feature(const char *feature) {
-    FILE *fp = fopen("/proc/cpuinfo", "r");
-    if (!fp) {
-        PRINT_ERROR("Failed to open /proc/cpuinfo");
-        return ERROR_SYSTEM;
+    int id = cpu_feature_lookup(feature);
+    if (id < 0) {
+        PRINT_ERROR("Unknown CPU feature '%s'", feature ? feature : "(null)");
+        return ERROR_INVALID_PARAM;
     }
     
-    char line[1024];
-    while (fgets(line, sizeof(line), fp)) {
-        if (strncmp(line, "flags", 5) == 0) {
-            if (strstr(line, feature)) {
-                fclose(fp);
-                return SUCCESS;
-            }
-        }
-    }
-    
-    fclose(fp);
-    return ERROR_NOT_SUPPORTED;
+    return cpu_has_feature((cpu_feature_t)id) ? SUCCESS : ERROR_NOT_SUPPORTED;
 }
 
 uint64_t get_timestamp_us(void) {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
 }
 
 void sleep_ms(int ms) {
@@ -0,0 +1,340 @@
+#include "cpu_caps.h"
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#define CPU_CAPS_HAVE_CPUID 1
+#endif
+
+static cpu_caps_t g_caps;
+static pthread_once_t g_caps_once = PTHREAD_ONCE_INIT;
+
+// Names follow /proc/cpuinfo where the kernel exports the flag
+static const char *feature_names[CPU_FEAT_COUNT] = {
+    [CPU_FEAT_TSC]            = "tsc",
+    [CPU_FEAT_MSR]            = "msr",
+    [CPU_FEAT_CLFLUSH]        = "clflush",
+    [CPU_FEAT_HT]             = "ht",
+    [CPU_FEAT_AVX]            = "avx",
+    [CPU_FEAT_HYPERVISOR]     = "hypervisor",
+    [CPU_FEAT_AVX2]           = "avx2",
+    [CPU_FEAT_AVX512F]        = "avx512f",
+    [CPU_FEAT_CLFLUSHOPT]     = "clflushopt",
+    [CPU_FEAT_CLWB]           = "clwb",
+    [CPU_FEAT_RDT_M]          = "rdt_m",
+    [CPU_FEAT_RDT_A]          = "rdt_a",
+    [CPU_FEAT_HYBRID]         = "hybrid_cpu",
+    [CPU_FEAT_CAT_L3]         = "cat_l3",
+    [CPU_FEAT_CAT_L2]         = "cat_l2",
+    [CPU_FEAT_MBA]            = "mba",
+    [CPU_FEAT_CDP_L3]         = "cdp_l3",
+    [CPU_FEAT_CDP_L2]         = "cdp_l2",
+    [CPU_FEAT_CQM_LLC]        = "cqm_llc",
+    [CPU_FEAT_CQM_OCCUP_LLC]  = "cqm_occup_llc",
+    [CPU_FEAT_CQM_MBM_TOTAL]  = "cqm_mbm_total",
+    [CPU_FEAT_CQM_MBM_LOCAL]  = "cqm_mbm_local",
+    [CPU_FEAT_TURBO]          = "ida",
+    [CPU_FEAT_ARAT]           = "arat",
+    [CPU_FEAT_PLN]            = "pln",
+    [CPU_FEAT_PTS]            = "pts",
+    [CPU_FEAT_HWP]            = "hwp",
+    [CPU_FEAT_HDC]            = "hdc",
+    [CPU_FEAT_APERFMPERF]     = "aperfmperf",
+    [CPU_FEAT_RDTSCP]         = "rdtscp",
+    [CPU_FEAT_INVARIANT_TSC]  = "invariant_tsc",
+};
+
+// Alternative spellings seen in /proc/cpuinfo and older callers
+static const struct {
+    const char *name;
+    cpu_feature_t feature;
+} feature_aliases[] = {
+    { "cqm",          CPU_FEAT_RDT_M },
+    { "constant_tsc", CPU_FEAT_INVARIANT_TSC },
+    { "nonstop_tsc",  CPU_FEAT_INVARIANT_TSC },
+    { "htt",          CPU_FEAT_HT },
+};
+
+#define SET_FEATURE(caps, feat, cond) \
+    do { if (cond) (caps)->features |= (1ULL << (feat)); } while (0)
+
+#ifdef CPU_CAPS_HAVE_CPUID
+static void decode_identity(cpu_caps_t *caps) {
+    uint32_t eax, ebx, ecx, edx;
+
+    __cpuid(0, eax, ebx, ecx, edx);
+    caps->max_leaf = eax;
+    memcpy(caps->vendor, &ebx, 4);
+    memcpy(caps->vendor + 4, &edx, 4);
+    memcpy(caps->vendor + 8, &ecx, 4);
+    caps->vendor[12] = '\0';
+
+    __cpuid(0x80000000, eax, ebx, ecx, edx);
+    caps->max_ext_leaf = eax;
+
+    if (caps->max_ext_leaf >= 0x80000004) {
+        uint32_t brand[12];
+        __cpuid(0x80000002, brand[0], brand[1], brand[2], brand[3]);
+        __cpuid(0x80000003, brand[4], brand[5], brand[6], brand[7]);
+        __cpuid(0x80000004, brand[8], brand[9], brand[10], brand[11]);
+        memcpy(caps->brand, brand, 48);
+        caps->brand[48] = '\0';
+    }
+}
+
+static void decode_leaf1(cpu_caps_t *caps) {
+    uint32_t eax, ebx, ecx, edx;
+
+    __cpuid(1, eax, ebx, ecx, edx);
+    caps->family = ((eax >> 8) & 0xF) + ((eax >> 20) & 0xFF);
+    caps->model = ((eax >> 4) & 0xF) + ((eax >> 12) & 0xF0);
+    caps->stepping = eax & 0xF;
+
+    SET_FEATURE(caps, CPU_FEAT_TSC, edx & (1U << 4));
+    SET_FEATURE(caps, CPU_FEAT_MSR, edx & (1U << 5));
+    SET_FEATURE(caps, CPU_FEAT_CLFLUSH, edx & (1U << 19));
+    SET_FEATURE(caps, CPU_FEAT_HT, edx & (1U << 28));
+    SET_FEATURE(caps, CPU_FEAT_AVX, ecx & (1U << 28));
+    SET_FEATURE(caps, CPU_FEAT_HYPERVISOR, ecx & (1U << 31));
+}
+
+static void decode_leaf7(cpu_caps_t *caps) {
+    uint32_t eax, ebx, ecx, edx;
+
+    if (caps->max_leaf < 7) {
+        return;
+    }
+
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    SET_FEATURE(caps, CPU_FEAT_AVX2, ebx & (1U << 5));
+    SET_FEATURE(caps, CPU_FEAT_RDT_M, ebx & (1U << 12));
+    SET_FEATURE(caps, CPU_FEAT_RDT_A, ebx & (1U << 15));
+    SET_FEATURE(caps, CPU_FEAT_AVX512F, ebx & (1U << 16));
+    SET_FEATURE(caps, CPU_FEAT_CLFLUSHOPT, ebx & (1U << 23));
+    SET_FEATURE(caps, CPU_FEAT_CLWB, ebx & (1U << 24));
+    SET_FEATURE(caps, CPU_FEAT_HYBRID, edx & (1U << 15));
+}
+
+static void decode_cat(int subleaf, cpu_cat_info_t *info, int *cdp) {
+    uint32_t eax, ebx, ecx, edx;
+
+    __cpuid_count(0x10, subleaf, eax, ebx, ecx, edx);
+    info->cbm_len = (int)(eax & 0x1F) + 1;
+    info->shareable_mask = ebx;
+    info->num_clos = (int)(edx & 0xFFFF) + 1;
+    *cdp = (ecx >> 2) & 1;
+}
+
+static void decode_leaf10(cpu_caps_t *caps) {
+    uint32_t eax, ebx, ecx, edx;
+    int cdp;
+
+    if (caps->max_leaf < 0x10 || !(caps->features & (1ULL << CPU_FEAT_RDT_A))) {
+        return;
+    }
+
+    __cpuid_count(0x10, 0, eax, ebx, ecx, edx);
+
+    if (ebx & (1U << 1)) {
+        caps->features |= 1ULL << CPU_FEAT_CAT_L3;
+        decode_cat(1, &caps->l3_cat, &cdp);
+        SET_FEATURE(caps, CPU_FEAT_CDP_L3, cdp);
+    }
+
+    if (ebx & (1U << 2)) {
+        caps->features |= 1ULL << CPU_FEAT_CAT_L2;
+        decode_cat(2, &caps->l2_cat, &cdp);
+        SET_FEATURE(caps, CPU_FEAT_CDP_L2, cdp);
+    }
+
+    if (ebx & (1U << 3)) {
+        caps->features |= 1ULL << CPU_FEAT_MBA;
+        __cpuid_count(0x10, 3, eax, ebx, ecx, edx);
+        caps->mba_max_delay = (int)(eax & 0xFFF) + 1;
+        caps->mba_linear = (ecx >> 2) & 1;
+        caps->mba_num_clos = (int)(edx & 0xFFFF) + 1;
+    }
+}
+
+static void decode_leafF(cpu_caps_t *caps) {
+    uint32_t eax, ebx, ecx, edx;
+
+    if (caps->max_leaf < 0xF || !(caps->features & (1ULL << CPU_FEAT_RDT_M))) {
+        return;
+    }
+
+    __cpuid_count(0xF, 0, eax, ebx, ecx, edx);
+    caps->max_rmid = (int)ebx;
+    if (!(edx & (1U << 1))) {
+        return;
+    }
+
+    caps->features |= 1ULL << CPU_FEAT_CQM_LLC;
+    __cpuid_count(0xF, 1, eax, ebx, ecx, edx);
+    caps->mon_upscale = ebx;
+    caps->l3_max_rmid = (int)ecx;
+    caps->mbm_counter_width = 24 + (int)(eax & 0xFF);
+    SET_FEATURE(caps, CPU_FEAT_CQM_OCCUP_LLC, edx & (1U << 0));
+    SET_FEATURE(caps, CPU_FEAT_CQM_MBM_TOTAL, edx & (1U << 1));
+    SET_FEATURE(caps, CPU_FEAT_CQM_MBM_LOCAL, edx & (1U << 2));
+}
+
+static void decode_leaf6(cpu_caps_t *caps) {
+    uint32_t eax, ebx, ecx, edx;
+
+    if (caps->max_leaf < 6) {
+        return;
+    }
+
+    __cpuid(6, eax, ebx, ecx, edx);
+    SET_FEATURE(caps, CPU_FEAT_TURBO, eax & (1U << 1));
+    SET_FEATURE(caps, CPU_FEAT_ARAT, eax & (1U << 2));
+    SET_FEATURE(caps, CPU_FEAT_PLN, eax & (1U << 4));
+    SET_FEATURE(caps, CPU_FEAT_PTS, eax & (1U << 6));
+    SET_FEATURE(caps, CPU_FEAT_HWP, eax & (1U << 7));
+    SET_FEATURE(caps, CPU_FEAT_HDC, eax & (1U << 13));
+    SET_FEATURE(caps, CPU_FEAT_APERFMPERF, ecx & (1U << 0));
+}
+
+static void decode_leaf1A(cpu_caps_t *caps) {
+    uint32_t eax, ebx, ecx, edx;
+
+    if (caps->max_leaf < 0x1A || !(caps->features & (1ULL << CPU_FEAT_HYBRID))) {
+        return;
+    }
+
+    __cpuid_count(0x1A, 0, eax, ebx, ecx, edx);
+    caps->core_type = (int)(eax >> 24);
+}
+
+static void decode_extended(cpu_caps_t *caps) {
+    uint32_t eax, ebx, ecx, edx;
+
+    if (caps->max_ext_leaf >= 0x80000001) {
+        __cpuid(0x80000001, eax, ebx, ecx, edx);
+        SET_FEATURE(caps, CPU_FEAT_RDTSCP, edx & (1U << 27));
+    }
+
+    if (caps->max_ext_leaf >= 0x80000007) {
+        __cpuid(0x80000007, eax, ebx, ecx, edx);
+        SET_FEATURE(caps, CPU_FEAT_INVARIANT_TSC, edx & (1U << 8));
+    }
+}
+
+// AMD PQoS: L3 allocation enumerates through leaf 0x10 like Intel, but
+// bandwidth enforcement has its own leaves and absolute units
+static void decode_amd_pqos(cpu_caps_t *caps) {
+    uint32_t eax, ebx, ecx, edx;
+
+    if (strcmp(caps->vendor, "AuthenticAMD") != 0 || caps->max_ext_leaf < 0x80000020) {
+        return;
+    }
+
+    __cpuid(0x80000008, eax, ebx, ecx, edx);
+    if (!(ebx & (1U << 6))) {
+        return;
+    }
+
+    __cpuid_count(0x80000020, 1, eax, ebx, ecx, edx);
+    caps->features |= 1ULL << CPU_FEAT_MBA;
+    caps->mba_bw_max = 1 << (eax & 0x1F);
+    caps->mba_num_clos = (int)(edx & 0xFFFF) + 1;
+}
+#endif /* CPU_CAPS_HAVE_CPUID */
+
+static void cpu_caps_init(void) {
+    memset(&g_caps, 0, sizeof(g_caps));
+
+#ifdef CPU_CAPS_HAVE_CPUID
+    decode_identity(&g_caps);
+    decode_leaf1(&g_caps);
+    decode_leaf7(&g_caps);
+    decode_leaf10(&g_caps);
+    decode_leafF(&g_caps);
+    decode_leaf6(&g_caps);
+    decode_leaf1A(&g_caps);
+    decode_extended(&g_caps);
+    decode_amd_pqos(&g_caps);
+#else
+    strcpy(g_caps.vendor, "unknown");
+#endif
+}
+
+const cpu_caps_t *cpu_caps_get(void) {
+    pthread_once(&g_caps_once, cpu_caps_init);
+    return &g_caps;
+}
+
+int cpu_has_feature(cpu_feature_t feature) {
+    if ((int)feature < 0 || feature >= CPU_FEAT_COUNT) {
+        return 0;
+    }
+    return (cpu_caps_get()->features >> feature) & 1;
+}
+
+const char *cpu_feature_name(cpu_feature_t feature) {
+    if ((int)feature < 0 || feature >= CPU_FEAT_COUNT) {
+        return "unknown";
+    }
+    return feature_names[feature];
+}
+
+int cpu_feature_lookup(const char *name) {
+    if (name == NULL) {
+        return ERROR_INVALID_PARAM;
+    }
+
+    for (int i = 0; i < CPU_FEAT_COUNT; i++) {
+        if (strcmp(feature_names[i], name) == 0) {
+            return i;
+        }
+    }
+
+    for (size_t i = 0; i < sizeof(feature_aliases) / sizeof(feature_aliases[0]); i++) {
+        if (strcmp(feature_aliases[i].name, name) == 0) {
+            return feature_aliases[i].feature;
+        }
+    }
+
+    return ERROR_INVALID_PARAM;
+}
+
+int cpu_is_intel(void) {
+    return strcmp(cpu_caps_get()->vendor, "GenuineIntel") == 0;
+}
+
+int cpu_is_amd(void) {
+    return strcmp(cpu_caps_get()->vendor, "AuthenticAMD") == 0;
+}
+
+void cpu_caps_print(void) {
+    const cpu_caps_t *caps = cpu_caps_get();
+
+    PRINT_INFO("CPU: %s (%s) family %d model %d stepping %d",
+               caps->brand[0] ? caps->brand : "unknown", caps->vendor,
+               caps->family, caps->model, caps->stepping);
+
+    if (cpu_has_feature(CPU_FEAT_CAT_L3)) {
+        PRINT_INFO("  L3 CAT: %d-bit CBM, %d CLOS, shareable 0x%x%s",
+                   caps->l3_cat.cbm_len, caps->l3_cat.num_clos,
+                   caps->l3_cat.shareable_mask,
+                   cpu_has_feature(CPU_FEAT_CDP_L3) ? ", CDP" : "");
+    }
+    if (cpu_has_feature(CPU_FEAT_CAT_L2)) {
+        PRINT_INFO("  L2 CAT: %d-bit CBM, %d CLOS%s",
+                   caps->l2_cat.cbm_len, caps->l2_cat.num_clos,
+                   cpu_has_feature(CPU_FEAT_CDP_L2) ? ", CDP" : "");
+    }
+    if (cpu_has_feature(CPU_FEAT_MBA) && caps->mba_bw_max) {
+        PRINT_INFO("  MBA: absolute limits up to %d x 1/8 GB/s (unlimited), %d CLOS",
+                   caps->mba_bw_max, caps->mba_num_clos);
+    } else if (cpu_has_feature(CPU_FEAT_MBA)) {
+        PRINT_INFO("  MBA: max delay %d, %d CLOS, %s",
+                   caps->mba_max_delay, caps->mba_num_clos,
+                   caps->mba_linear ? "linear" : "non-linear");
+    }
+    if (cpu_has_feature(CPU_FEAT_CQM_LLC)) {
+        PRINT_INFO("  Monitoring: max RMID %d, upscale %u bytes, MBM counter %d bits",
+                   caps->l3_max_rmid, caps->mon_upscale, caps->mbm_counter_width);
+    }
+}
@@ -0,0 +1,101 @@
+#ifndef CPU_CAPS_H
+#define CPU_CAPS_H
+
+#include <stdint.h>
+#include "common.h"
+
+// Feature bits, decoded once from CPUID into cpu_caps_t.features
+typedef enum {
+    // Leaf 0x1
+    CPU_FEAT_TSC = 0,
+    CPU_FEAT_MSR,
+    CPU_FEAT_CLFLUSH,
+    CPU_FEAT_HT,
+    CPU_FEAT_AVX,
+    CPU_FEAT_HYPERVISOR,
+    // Leaf 0x7
+    CPU_FEAT_AVX2,
+    CPU_FEAT_AVX512F,
+    CPU_FEAT_CLFLUSHOPT,
+    CPU_FEAT_CLWB,
+    CPU_FEAT_RDT_M,
+    CPU_FEAT_RDT_A,
+    CPU_FEAT_HYBRID,
+    // Leaf 0x10 (allocation)
+    CPU_FEAT_CAT_L3,
+    CPU_FEAT_CAT_L2,
+    CPU_FEAT_MBA,
+    CPU_FEAT_CDP_L3,
+    CPU_FEAT_CDP_L2,
+    // Leaf 0xF (monitoring)
+    CPU_FEAT_CQM_LLC,
+    CPU_FEAT_CQM_OCCUP_LLC,
+    CPU_FEAT_CQM_MBM_TOTAL,
+    CPU_FEAT_CQM_MBM_LOCAL,
+    // Leaf 0x6 (thermal and power)
+    CPU_FEAT_TURBO,
+    CPU_FEAT_ARAT,
+    CPU_FEAT_PLN,
+    CPU_FEAT_PTS,
+    CPU_FEAT_HWP,
+    CPU_FEAT_HDC,
+    CPU_FEAT_APERFMPERF,
+    // Extended leaves
+    CPU_FEAT_RDTSCP,
+    CPU_FEAT_INVARIANT_TSC,
+    CPU_FEAT_COUNT
+} cpu_feature_t;
+
+// Hybrid core types reported by CPUID leaf 0x1A
+#define CPU_CORE_TYPE_NONE  0x00
+#define CPU_CORE_TYPE_ATOM  0x20
+#define CPU_CORE_TYPE_CORE  0x40
+
+// Cache allocation enumeration (CPUID leaf 0x10, sub-leaf 1 for L3, 2 for L2)
+typedef struct {
+    int cbm_len;              // Capacity bitmask length in bits
+    int num_clos;             // Highest COS number + 1
+    uint32_t shareable_mask;  // Ways shared with other agents
+} cpu_cat_info_t;
+
+typedef struct {
+    char vendor[13];
+    char brand[49];
+    int family;
+    int model;
+    int stepping;
+    uint32_t max_leaf;
+    uint32_t max_ext_leaf;
+    uint64_t features;
+
+    cpu_cat_info_t l3_cat;
+    cpu_cat_info_t l2_cat;
+
+    // Memory bandwidth allocation (CPUID leaf 0x10, sub-leaf 3). AMD
+    // enforces absolute limits instead (leaf 0x80000020, sub-leaf 1):
+    // mba_bw_max is the unlimited value in 1/8 GB/s units, 0 on Intel.
+    int mba_max_delay;
+    int mba_num_clos;
+    int mba_linear;
+    int mba_bw_max;
+
+    // Monitoring (CPUID leaf 0xF)
+    int max_rmid;               // Highest RMID of any resource
+    int l3_max_rmid;            // Highest RMID for L3 events
+    uint32_t mon_upscale;       // Bytes per counter unit
+    int mbm_counter_width;      // MBM counter width in bits
+
+    // Hybrid core type of the CPU the caps were decoded on (leaf 0x1A)
+    int core_type;
+} cpu_caps_t;
+
+// Capability queries; CPUID is executed once and cached
+const cpu_caps_t *cpu_caps_get(void);
+int cpu_has_feature(cpu_feature_t feature);
+const char *cpu_feature_name(cpu_feature_t feature);
+int cpu_feature_lookup(const char *name);
+int cpu_is_intel(void);
+int cpu_is_amd(void);
+void cpu_caps_print(void);
+
+#endif /* CPU_CAPS_H */
@@ -0,0 +1,97 @@
+#include "histogram.h"
+
+// Function declarations
+static inline int hist_index(uint64_t value);
+
+static inline int hist_index(uint64_t value) {
+    if (value < HIST_LINEAR) {
+        return (int)value;
+    }
+
+    // Keep the top HIST_SUB_BITS bits: the leading one plus HIST_SUB_BITS - 1
+    // bits of mantissa select the bucket inside the power of two
+    int msb = 63 - __builtin_clzll(value);
+    int shift = msb - (HIST_SUB_BITS - 1);
+    int sub = (int)(value >> shift) - HIST_HALF;
+    return HIST_LINEAR + (shift - 1) * HIST_HALF + sub;
+}
+
+uint64_t hist_bucket_lower(int index) {
+    if (index < HIST_LINEAR) {
+        return (uint64_t)index;
+    }
+    int shift = (index - HIST_LINEAR) / HIST_HALF + 1;
+    uint64_t sub = (uint64_t)((index - HIST_LINEAR) % HIST_HALF + HIST_HALF);
+    return sub << shift;
+}
+
+uint64_t hist_bucket_upper(int index) {
+    if (index < HIST_LINEAR) {
+        return (uint64_t)index;
+    }
+    int shift = (index - HIST_LINEAR) / HIST_HALF + 1;
+    return hist_bucket_lower(index) + ((1ULL << shift) - 1);
+}
+
+void hist_reset(histogram_t *hist) {
+    memset(hist, 0, sizeof(*hist));
+    hist->min = UINT64_MAX;
+}
+
+void hist_record(histogram_t *hist, uint64_t value) {
+    hist->buckets[hist_index(value)]++;
+    hist->count++;
+    hist->sum += (double)value;
+    if (value < hist->min) hist->min = value;
+    if (value > hist->max) hist->max = value;
+}
+
+void hist_merge(histogram_t *dst, const histogram_t *src) {
+    if (src->count == 0) {
+        return;
+    }
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        dst->buckets[i] += src->buckets[i];
+    }
+    dst->count += src->count;
+    dst->sum += src->sum;
+    if (src->min < dst->min) dst->min = src->min;
+    if (src->max > dst->max) dst->max = src->max;
+}
+
+uint64_t hist_percentile(const histogram_t *hist, double pct) {
+    if (hist->count == 0) {
+        return 0;
+    }
+
+    // Rank of the requested sample, 1-based; p100 is the maximum
+    uint64_t rank = (uint64_t)(pct / 100.0 * (double)hist->count + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank >= hist->count) return hist->max;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += hist->buckets[i];
+        if (seen >= rank) {
+            uint64_t upper = hist_bucket_upper(i);
+            return upper < hist->max ? upper : hist->max;
+        }
+    }
+    return hist->max;
+}
+
+double hist_mean(const histogram_t *hist) {
+    return hist->count ? hist->sum / (double)hist->count : 0.0;
+}
+
+void hist_print(const histogram_t *hist, const char *label, const char *unit) {
+    if (hist->count == 0) {
+        printf("%s: no samples\n", label);
+        return;
+    }
+    printf("%s: n=%lu mean=%.1f p50=%lu p90=%lu p99=%lu p99.9=%lu max=%lu %s\n",
+           label, hist->count, hist_mean(hist),
+           hist_percentile(hist, 50.0), hist_percentile(hist, 90.0),
+           hist_percentile(hist, 99.0), hist_percentile(hist, 99.9),
+           hist->max, unit);
+}
@@ -0,0 +1,152 @@
+#include "mem_alloc.h"
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+
+#define MEM_SIZE_2M (2UL * 1024 * 1024)
+#define MEM_SIZE_1G (1024UL * 1024 * 1024)
+
+// Function declarations
+static size_t page_bytes(mem_page_t page);
+static int bind_node(void *addr, size_t len, int node);
+static int node_free_hugepages(int node, mem_page_t page);
+
+int mem_page_parse(const char *name, mem_page_t *page) {
+    if (strcmp(name, "4k") == 0) {
+        *page = MEM_PAGE_4K;
+    } else if (strcmp(name, "thp") == 0) {
+        *page = MEM_PAGE_THP;
+    } else if (strcmp(name, "2m") == 0) {
+        *page = MEM_PAGE_2M;
+    } else if (strcmp(name, "1g") == 0) {
+        *page = MEM_PAGE_1G;
+    } else {
+        return ERROR_INVALID_PARAM;
+    }
+    return SUCCESS;
+}
+
+const char *mem_page_name(mem_page_t page) {
+    switch (page) {
+        case MEM_PAGE_4K:  return "4k";
+        case MEM_PAGE_THP: return "thp";
+        case MEM_PAGE_2M:  return "2m";
+        case MEM_PAGE_1G:  return "1g";
+    }
+    return "unknown";
+}
+
+static size_t page_bytes(mem_page_t page) {
+    switch (page) {
+        case MEM_PAGE_2M:  return MEM_SIZE_2M;
+        case MEM_PAGE_1G:  return MEM_SIZE_1G;
+        case MEM_PAGE_THP: return MEM_SIZE_2M;     // Align so whole huge pages fit
+        default:           return (size_t)sysconf(_SC_PAGESIZE);
+    }
+}
+
+// mbind(2) through syscall(), so the suite does not need libnuma
+static int bind_node(void *addr, size_t len, int node) {
+    unsigned long nodemask[4] = { 0 };
+    unsigned long bits = 8 * sizeof(unsigned long);
+
+    if (node < 0 || (unsigned long)node >= bits * 4) {
+        return ERROR_INVALID_PARAM;
+    }
+    nodemask[node / bits] = 1UL << (node % bits);
+    if (syscall(SYS_mbind, addr, len, MPOL_BIND, nodemask, bits * 4 + 1, 0) != 0) {
+        PRINT_DEBUG("mbind to node %d: %s", node, strerror(errno));
+        return ERROR_SYSTEM;
+    }
+    return SUCCESS;
+}
+
+// Free hugetlb pages of one size on a node, -1 when sysfs does not say
+static int node_free_hugepages(int node, mem_page_t page) {
+    char path[128];
+    int free_pages;
+
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/hugepages/hugepages-%zukB/free_hugepages",
+             node, page_bytes(page) / 1024);
+    if (check_file_exists(path) != SUCCESS || read_file_int(path, &free_pages) != SUCCESS) {
+        return -1;
+    }
+    return free_pages;
+}
+
+int mem_alloc(mem_buffer_t *buf, size_t size, mem_page_t page, int node, int fill) {
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    void *addr = MAP_FAILED;
+
+    memset(buf, 0, sizeof(*buf));
+    buf->node = -1;
+    if (size == 0) {
+        return ERROR_INVALID_PARAM;
+    }
+
+    if (page == MEM_PAGE_2M || page == MEM_PAGE_1G) {
+        size_t len = (size + page_bytes(page) - 1) & ~(page_bytes(page) - 1);
+        int huge = page == MEM_PAGE_2M ? MAP_HUGE_2MB : MAP_HUGE_1GB;
+        // The mmap reservation comes from the global pool; bound to a node
+        // whose own pool is short, the first touch would SIGBUS instead
+        int node_free = node >= 0 ? node_free_hugepages(node, page) : -1;
+        if (node_free >= 0 && (size_t)node_free < len / page_bytes(page)) {
+            PRINT_INFO("Node %d has %d free %s hugetlb pages, %zu needed; using THP",
+                       node, node_free, mem_page_name(page), len / page_bytes(page));
+            page = MEM_PAGE_THP;
+        } else {
+            addr = mmap(NULL, len, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB | huge, -1, 0);
+        }
+        if (addr == MAP_FAILED && page != MEM_PAGE_THP) {
+            PRINT_INFO("No free %s hugetlb pages for %zu bytes (see /proc/sys/vm/nr_hugepages), "
+                       "using THP", mem_page_name(page), size);
+            page = MEM_PAGE_THP;
+        } else if (addr != MAP_FAILED) {
+            buf->mapped = len;
+        }
+    }
+
+    if (addr == MAP_FAILED) {
+        buf->mapped = (size + page_bytes(page) - 1) & ~(page_bytes(page) - 1);
+        addr = mmap(NULL, buf->mapped, PROT_READ | PROT_WRITE, flags, -1, 0);
+        if (addr == MAP_FAILED) {
+            PRINT_ERROR("Failed to map %zu bytes: %s", size, strerror(errno));
+            return ERROR_SYSTEM;
+        }
+        // The system THP mode may be "always"; pin the choice either way
+        if (madvise(addr, buf->mapped, page == MEM_PAGE_THP ? MADV_HUGEPAGE : MADV_NOHUGEPAGE) != 0 &&
+            page == MEM_PAGE_THP) {
+            PRINT_DEBUG("madvise(MADV_HUGEPAGE): %s", strerror(errno));
+        }
+    }
+
+    buf->addr = addr;
+    buf->size = size;
+    buf->page = page;
+    if (node >= 0 && bind_node(addr, buf->mapped, node) == SUCCESS) {
+        buf->node = node;
+    }
+
+    // Fault every page in now, from the thread that will use it; the
+    // rounded-up tail of a huge page is left alone
+    memset(addr, fill, size);
+    return SUCCESS;
+}
+
+void mem_free(mem_buffer_t *buf) {
+    if (buf->addr) {
+        munmap(buf->addr, buf->mapped);
+    }
+    memset(buf, 0, sizeof(*buf));
+    buf->node = -1;
+}
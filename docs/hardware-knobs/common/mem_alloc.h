@@ -0,0 +1,35 @@
+#ifndef MEM_ALLOC_H
+#define MEM_ALLOC_H
+
+#include <stddef.h>
+#include "common.h"
+
+// Benchmark buffers: anonymous mappings on a chosen page size, bound to a
+// NUMA node and first-touched by the caller, so the pages land where the
+// owning thread runs and TLB reach does not skew cache and bandwidth
+// results. Allocate from the thread that will use the buffer.
+typedef enum {
+    MEM_PAGE_4K,                // Base pages, THP disabled for the range
+    MEM_PAGE_THP,               // Transparent hugepages (madvise)
+    MEM_PAGE_2M,                // hugetlbfs 2 MB pages (MAP_HUGETLB)
+    MEM_PAGE_1G                 // hugetlbfs 1 GB pages (MAP_HUGETLB)
+} mem_page_t;
+
+typedef struct {
+    void *addr;
+    size_t size;                // Requested size
+    size_t mapped;              // Mapped length, a multiple of the page size
+    mem_page_t page;            // Page size actually used
+    int node;                   // Bound node, -1 = default policy
+} mem_buffer_t;
+
+int mem_page_parse(const char *name, mem_page_t *page);
+const char *mem_page_name(mem_page_t page);
+
+// Map size bytes on page, falling back to THP when the hugetlb pool is
+// empty. node >= 0 binds the range to that node (MPOL_BIND); every page is
+// then written once with fill.
+int mem_alloc(mem_buffer_t *buf, size_t size, mem_page_t page, int node, int fill);
+void mem_free(mem_buffer_t *buf);
+
+#endif /* MEM_ALLOC_H */
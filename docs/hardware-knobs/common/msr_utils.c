@@ -95,30 +95,12 @@ int msr_check_available(void) {
 }
 
 int msr_check_cpu_feature(const char *feature) {
-    FILE *fp = fopen("/proc/cpuinfo", "r");
-    if (!fp) {
-        PRINT_ERROR("Failed to open /proc/cpuinfo");
-        return ERROR_SYSTEM;
-    }
-    
-    char line[256];
-    int found = 0;
-    
-    while (fgets(line, sizeof(line), fp)) {
-        if (strstr(line, "flags") && strstr(line, feature)) {
-            found = 1;
-            break;
-        }
-    }
-    
-    fclose(fp);
-    
-    if (!found) {
+    int result = check_cpu_feature(feature);
+    if (result == ERROR_NOT_SUPPORTED) {
         PRINT_ERROR("CPU feature '%s' not supported", feature);
-        return ERROR_NOT_SUPPORTED;
     }
     
-    return SUCCESS;
+    return result;
 }
 
 uint64_t msr_get_field(uint64_t value, int start_bit, int num_bits) {
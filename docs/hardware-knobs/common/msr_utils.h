@@ -30,6 +30,10 @@
 #define MSR_IA32_QM_EVTSEL          0xC8D
 #define MSR_IA32_QM_CTR             0xC8E
 #define MSR_IA32_MBA_THRTL_MSR      0xD50
+#define MSR_IA32_L3_QOS_CFG         0xC81   // Bit 0: L3 CDP enable
+#define MSR_IA32_L2_QOS_CFG         0xC82   // Bit 0: L2 CDP enable
+#define MSR_IA32_L2_MASK_0          0xD10
+#define MSR_AMD_MBA_BW_BASE         0xC0000200  // AMD: per-CLOS bandwidth limit, 1/8 GB/s units
 
 // Prefetch control MSRs
 #define MSR_MISC_FEATURE_CONTROL    0x1A4
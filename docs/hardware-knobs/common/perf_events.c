@@ -0,0 +1,153 @@
+#include "perf_events.h"
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+
+// Function declarations
+static long sys_perf_event_open(struct perf_event_attr *attr, pid_t pid, int cpu,
+                                int group_fd, unsigned long flags);
+static uint64_t dtlb_config(uint64_t result);
+
+static long sys_perf_event_open(struct perf_event_attr *attr, pid_t pid, int cpu,
+                                int group_fd, unsigned long flags) {
+    return syscall(SYS_perf_event_open, attr, pid, cpu, group_fd, flags);
+}
+
+int perf_counter_open(perf_counter_t *ctr, uint32_t type, uint64_t config,
+                      pid_t pid, int cpu, int inherit) {
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.inherit = inherit ? 1 : 0;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    ctr->prev = 0;
+    ctr->fd = (int)sys_perf_event_open(&attr, pid, cpu, -1, PERF_FLAG_FD_CLOEXEC);
+    if (ctr->fd < 0) {
+        PRINT_DEBUG("perf_event_open(type %u, config 0x%lx, pid %d, cpu %d): %s",
+                    type, config, (int)pid, cpu, strerror(errno));
+        return errno == EACCES || errno == EPERM ? ERROR_PERMISSION : ERROR_NOT_SUPPORTED;
+    }
+    return SUCCESS;
+}
+
+int perf_counter_read(perf_counter_t *ctr, uint64_t *value) {
+    uint64_t buf[3];    // value, time_enabled, time_running
+
+    if (ctr->fd < 0 || read(ctr->fd, buf, sizeof(buf)) != sizeof(buf)) {
+        return ERROR_SYSTEM;
+    }
+
+    if (buf[2] == 0) {
+        *value = 0;
+    } else if (buf[2] < buf[1]) {
+        *value = (uint64_t)((double)buf[0] * (double)buf[1] / (double)buf[2]);
+    } else {
+        *value = buf[0];
+    }
+    return SUCCESS;
+}
+
+int perf_counter_delta(perf_counter_t *ctr, uint64_t *delta) {
+    uint64_t value;
+
+    if (perf_counter_read(ctr, &value) != SUCCESS) {
+        return ERROR_SYSTEM;
+    }
+    // Scaling can make an estimate step backwards; report no progress then
+    *delta = value > ctr->prev ? value - ctr->prev : 0;
+    ctr->prev = value;
+    return SUCCESS;
+}
+
+void perf_counter_close(perf_counter_t *ctr) {
+    if (ctr->fd >= 0) {
+        close(ctr->fd);
+    }
+    ctr->fd = -1;
+}
+
+int perf_ipc_open(perf_ipc_t *ipc, pid_t pid, int cpu, int inherit) {
+    ipc->instructions.fd = -1;
+
+    int ret = perf_counter_open(&ipc->cycles, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES,
+                                pid, cpu, inherit);
+    if (ret != SUCCESS) {
+        return ret;
+    }
+    ret = perf_counter_open(&ipc->instructions, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS,
+                            pid, cpu, inherit);
+    if (ret != SUCCESS) {
+        perf_counter_close(&ipc->cycles);
+        return ret;
+    }
+
+    // Start the deltas from now
+    uint64_t ignored;
+    perf_counter_delta(&ipc->cycles, &ignored);
+    perf_counter_delta(&ipc->instructions, &ignored);
+    return SUCCESS;
+}
+
+int perf_ipc_read(perf_ipc_t *ipc, uint64_t *cycles, uint64_t *instructions) {
+    if (perf_counter_delta(&ipc->cycles, cycles) != SUCCESS ||
+        perf_counter_delta(&ipc->instructions, instructions) != SUCCESS) {
+        return ERROR_SYSTEM;
+    }
+    return SUCCESS;
+}
+
+void perf_ipc_close(perf_ipc_t *ipc) {
+    perf_counter_close(&ipc->cycles);
+    perf_counter_close(&ipc->instructions);
+}
+
+static uint64_t dtlb_config(uint64_t result) {
+    return PERF_COUNT_HW_CACHE_DTLB | ((uint64_t)PERF_COUNT_HW_CACHE_OP_READ << 8) | (result << 16);
+}
+
+int perf_tlb_open(perf_tlb_t *tlb, pid_t pid, int cpu, int inherit) {
+    int ret = perf_counter_open(&tlb->misses, PERF_TYPE_HW_CACHE,
+                                dtlb_config(PERF_COUNT_HW_CACHE_RESULT_MISS), pid, cpu, inherit);
+    if (ret != SUCCESS) {
+        tlb->loads.fd = -1;
+        return ret;
+    }
+    if (perf_counter_open(&tlb->loads, PERF_TYPE_HW_CACHE,
+                          dtlb_config(PERF_COUNT_HW_CACHE_RESULT_ACCESS), pid, cpu, inherit) != SUCCESS) {
+        PRINT_DEBUG("dTLB load accesses not countable, reporting misses only");
+    }
+
+    uint64_t ignored;
+    perf_tlb_read(tlb, &ignored, &ignored);
+    return SUCCESS;
+}
+
+int perf_tlb_read(perf_tlb_t *tlb, uint64_t *loads, uint64_t *misses) {
+    *loads = 0;
+    if (perf_counter_delta(&tlb->misses, misses) != SUCCESS) {
+        return ERROR_SYSTEM;
+    }
+    if (tlb->loads.fd >= 0 && perf_counter_delta(&tlb->loads, loads) != SUCCESS) {
+        return ERROR_SYSTEM;
+    }
+    return SUCCESS;
+}
+
+void perf_tlb_close(perf_tlb_t *tlb) {
+    perf_counter_close(&tlb->loads);
+    perf_counter_close(&tlb->misses);
+}
+
+int perf_events_available(void) {
+    perf_counter_t ctr;
+
+    if (perf_counter_open(&ctr, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, 0, -1, 0) != SUCCESS) {
+        return 0;
+    }
+    perf_counter_close(&ctr);
+    return 1;
+}
@@ -0,0 +1,51 @@
+#ifndef PERF_EVENTS_H
+#define PERF_EVENTS_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <linux/perf_event.h>
+#include "common.h"
+
+// A hardware or software counter opened with perf_event_open(2). Reads
+// are scaled by time_enabled / time_running when the PMU multiplexes.
+typedef struct {
+    int fd;
+    uint64_t prev;      // Scaled value at the previous perf_counter_delta()
+} perf_counter_t;
+
+// Cycles + instructions of one task or CPU
+typedef struct {
+    perf_counter_t cycles;
+    perf_counter_t instructions;
+} perf_ipc_t;
+
+// dTLB read accesses + misses (generic cache events; on parts without a
+// load-access event only misses are counted)
+typedef struct {
+    perf_counter_t loads;
+    perf_counter_t misses;
+} perf_tlb_t;
+
+// Counters; pid -1 with a cpu counts everything on that CPU, pid 0 is the
+// calling thread. inherit also counts threads created after opening.
+int perf_counter_open(perf_counter_t *ctr, uint32_t type, uint64_t config,
+                      pid_t pid, int cpu, int inherit);
+int perf_counter_read(perf_counter_t *ctr, uint64_t *value);
+int perf_counter_delta(perf_counter_t *ctr, uint64_t *delta);
+void perf_counter_close(perf_counter_t *ctr);
+
+// IPC helpers; deltas are since the previous perf_ipc_read()
+int perf_ipc_open(perf_ipc_t *ipc, pid_t pid, int cpu, int inherit);
+int perf_ipc_read(perf_ipc_t *ipc, uint64_t *cycles, uint64_t *instructions);
+void perf_ipc_close(perf_ipc_t *ipc);
+
+// dTLB helpers; deltas are since the previous perf_tlb_read(), loads is 0
+// when the access event is missing
+int perf_tlb_open(perf_tlb_t *tlb, pid_t pid, int cpu, int inherit);
+int perf_tlb_read(perf_tlb_t *tlb, uint64_t *loads, uint64_t *misses);
+void perf_tlb_close(perf_tlb_t *tlb);
+
+// 1 when hardware counters can be opened for this process
+int perf_events_available(void);
+
+#endif /* PERF_EVENTS_H */
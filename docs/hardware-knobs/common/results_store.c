@@ -0,0 +1,248 @@
+#include "results_store.h"
+#include <sys/file.h>
+
+// Function declarations
+static const char *json_find(const char *line, const char *key);
+static int json_get_string(const char *line, const char *key, char *buf, size_t len);
+static int json_get_number(const char *line, const char *key, double *value);
+static int make_dirs(const char *dir);
+
+int results_store_path(const char *host, char *path, size_t len) {
+    const char *dir = getenv(RESULTS_DIR_ENV);
+    char hostname[64];
+
+    if (dir == NULL || dir[0] == '\0') {
+        dir = RESULTS_DEFAULT_DIR;
+    }
+
+    if (host == NULL) {
+        if (gethostname(hostname, sizeof(hostname)) != 0) {
+            strcpy(hostname, "unknown");
+        }
+        hostname[sizeof(hostname) - 1] = '\0';
+        host = hostname;
+    }
+
+    if ((size_t)snprintf(path, len, "%s/results-%s.jsonl", dir, host) >= len) {
+        return ERROR_INVALID_PARAM;
+    }
+    return SUCCESS;
+}
+
+static int make_dirs(const char *dir) {
+    char tmp[512];
+
+    if ((size_t)snprintf(tmp, sizeof(tmp), "%s", dir) >= sizeof(tmp)) {
+        return ERROR_INVALID_PARAM;
+    }
+
+    for (char *p = tmp + 1; *p; p++) {
+        if (*p == '/') {
+            *p = '\0';
+            if (mkdir(tmp, 0755) != 0 && errno != EEXIST) {
+                return ERROR_SYSTEM;
+            }
+            *p = '/';
+        }
+    }
+    if (mkdir(tmp, 0755) != 0 && errno != EEXIST) {
+        return ERROR_SYSTEM;
+    }
+    return SUCCESS;
+}
+
+// Records are appended whole under an exclusive lock so concurrent
+// benchmark runs on the same host never interleave lines
+int results_store_append(const char *line, size_t len) {
+    char path[512];
+    char dir[512];
+
+    if (results_store_path(NULL, path, sizeof(path)) != SUCCESS) {
+        return ERROR_INVALID_PARAM;
+    }
+
+    snprintf(dir, sizeof(dir), "%s", path);
+    char *slash = strrchr(dir, '/');
+    if (slash) {
+        *slash = '\0';
+        if (make_dirs(dir) != SUCCESS) {
+            PRINT_ERROR("Failed to create results directory %s: %s", dir, strerror(errno));
+            return ERROR_SYSTEM;
+        }
+    }
+
+    int fd = open(path, O_WRONLY | O_APPEND | O_CREAT, 0644);
+    if (fd < 0) {
+        PRINT_ERROR("Failed to open results store %s: %s", path, strerror(errno));
+        return ERROR_SYSTEM;
+    }
+
+    flock(fd, LOCK_EX);
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = write(fd, line + done, len - done);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            PRINT_ERROR("Failed to append to results store %s: %s", path, strerror(errno));
+            flock(fd, LOCK_UN);
+            close(fd);
+            return ERROR_SYSTEM;
+        }
+        done += n;
+    }
+    flock(fd, LOCK_UN);
+    close(fd);
+    return SUCCESS;
+}
+
+// The records are flat objects written by the harness, so a key lookup
+// is enough; escaped quotes inside values never match "key":
+static const char *json_find(const char *line, const char *key) {
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+
+    const char *p = strstr(line, pattern);
+    if (!p) {
+        return NULL;
+    }
+    p += strlen(pattern);
+    while (*p == ' ') p++;
+    return p;
+}
+
+static int json_get_string(const char *line, const char *key, char *buf, size_t len) {
+    const char *p = json_find(line, key);
+    size_t out = 0;
+
+    if (!p || *p != '"' || len == 0) {
+        return ERROR_INVALID_PARAM;
+    }
+
+    for (p++; *p && *p != '"'; p++) {
+        char c = *p;
+        if (c == '\\' && p[1]) {
+            p++;
+            switch (*p) {
+                case 'n': c = '\n'; break;
+                case 't': c = '\t'; break;
+                case 'u':
+                    c = (char)strtol((char[]){ p[1], p[2], p[3], p[4], '\0' }, NULL, 16);
+                    p += 4;
+                    break;
+                default: c = *p; break;
+            }
+        }
+        if (out + 1 < len) {
+            buf[out++] = c;
+        }
+    }
+    buf[out] = '\0';
+    return *p == '"' ? SUCCESS : ERROR_INVALID_PARAM;
+}
+
+static int json_get_number(const char *line, const char *key, double *value) {
+    const char *p = json_find(line, key);
+    char *end;
+
+    if (!p) {
+        return ERROR_INVALID_PARAM;
+    }
+    *value = strtod(p, &end);
+    return end == p ? ERROR_INVALID_PARAM : SUCCESS;
+}
+
+int results_parse_record(const char *line, bench_record_t *rec) {
+    double value;
+
+    memset(rec, 0, sizeof(*rec));
+
+    if (json_get_string(line, "run_id", rec->run_id, sizeof(rec->run_id)) != SUCCESS ||
+        json_get_string(line, "benchmark", rec->benchmark, sizeof(rec->benchmark)) != SUCCESS ||
+        json_get_string(line, "kernel", rec->kernel, sizeof(rec->kernel)) != SUCCESS ||
+        json_get_number(line, "median", &rec->median) != SUCCESS) {
+        return ERROR_INVALID_PARAM;
+    }
+
+    // Optional fields keep their zero defaults when absent
+    json_get_string(line, "host", rec->host, sizeof(rec->host));
+    json_get_string(line, "cpu_vendor", rec->cpu_vendor, sizeof(rec->cpu_vendor));
+    json_get_string(line, "cpu_model", rec->cpu_model, sizeof(rec->cpu_model));
+    json_get_string(line, "cpu_signature", rec->cpu_signature, sizeof(rec->cpu_signature));
+    json_get_string(line, "config", rec->config, sizeof(rec->config));
+    json_get_string(line, "unit", rec->unit, sizeof(rec->unit));
+    json_get_number(line, "mean", &rec->mean);
+    if (json_get_number(line, "timestamp", &value) == SUCCESS) {
+        rec->timestamp = (long)value;
+    }
+    rec->higher_is_better = 1;
+    if (json_get_number(line, "higher_is_better", &value) == SUCCESS) {
+        rec->higher_is_better = value != 0;
+    }
+
+    const char *p = json_find(line, "samples");
+    if (p && *p == '[') {
+        p++;
+        while (*p && *p != ']' && rec->n < BENCH_MAX_SAMPLES) {
+            char *end;
+            double sample = strtod(p, &end);
+            if (end == p) break;
+            rec->samples[rec->n++] = sample;
+            p = end;
+            while (*p == ',' || *p == ' ') p++;
+        }
+    }
+
+    // Records without samples still compare on their median
+    if (rec->n == 0) {
+        rec->samples[0] = rec->median;
+        rec->n = 1;
+    }
+    return SUCCESS;
+}
+
+int results_load(const char *path, bench_record_set_t *set) {
+    FILE *fp = fopen(path, "r");
+    char *line = NULL;
+    size_t cap = 0;
+    int lineno = 0;
+
+    if (!fp) {
+        PRINT_ERROR("Failed to open results file %s: %s", path, strerror(errno));
+        return ERROR_SYSTEM;
+    }
+
+    while (getline(&line, &cap, fp) > 0) {
+        lineno++;
+        if (line[0] != '{') {
+            continue;
+        }
+
+        if (set->count == set->capacity) {
+            int capacity = set->capacity ? set->capacity * 2 : 64;
+            bench_record_t *records = realloc(set->records, capacity * sizeof(bench_record_t));
+            if (!records) {
+                PRINT_ERROR("Out of memory loading %s", path);
+                free(line);
+                fclose(fp);
+                return ERROR_SYSTEM;
+            }
+            set->records = records;
+            set->capacity = capacity;
+        }
+
+        if (results_parse_record(line, &set->records[set->count]) != SUCCESS) {
+            PRINT_ERROR("%s:%d: skipping malformed record", path, lineno);
+            continue;
+        }
+        set->count++;
+    }
+
+    free(line);
+    fclose(fp);
+    return SUCCESS;
+}
+
+void results_free(bench_record_set_t *set) {
+    free(set->records);
+    memset(set, 0, sizeof(*set));
+}
@@ -0,0 +1,47 @@
+#ifndef RESULTS_STORE_H
+#define RESULTS_STORE_H
+
+#include "common.h"
+#include "bench_harness.h"
+
+// Per-host, append-only JSON lines store of harness records
+#define RESULTS_DIR_ENV     "HK_RESULTS_DIR"
+#define RESULTS_DEFAULT_DIR "/var/lib/hardware-knobs"
+
+#define RESULTS_STR_LEN 128
+
+// One harness record as read back from JSON
+typedef struct {
+    char run_id[64];
+    long timestamp;
+    char host[64];
+    char cpu_vendor[16];
+    char cpu_model[RESULTS_STR_LEN];
+    char cpu_signature[32];
+    char benchmark[RESULTS_STR_LEN];
+    char kernel[RESULTS_STR_LEN];
+    char config[RESULTS_STR_LEN];
+    char unit[32];
+    int higher_is_better;
+    double median;
+    double mean;
+    int n;
+    double samples[BENCH_MAX_SAMPLES];
+} bench_record_t;
+
+typedef struct {
+    int count;
+    int capacity;
+    bench_record_t *records;
+} bench_record_set_t;
+
+// Store location and appending
+int results_store_path(const char *host, char *path, size_t len);
+int results_store_append(const char *line, size_t len);
+
+// Reading records back
+int results_parse_record(const char *line, bench_record_t *rec);
+int results_load(const char *path, bench_record_set_t *set);
+void results_free(bench_record_set_t *set);
+
+#endif /* RESULTS_STORE_H */
@@ -0,0 +1,115 @@
+#include "timing.h"
+#include "cpu_caps.h"
+#include <pthread.h>
+
+#define CALIBRATION_ROUNDS 5
+#define CALIBRATION_NS     (20 * 1000000ULL)  // 20 ms per round
+
+int timing_tsc_usable = 0;
+
+static uint64_t g_tsc_hz = 0;
+static double g_ns_per_tick = 1.0;
+static uint64_t g_base_ticks = 0;
+static uint64_t g_base_ns = 0;
+static pthread_once_t g_timing_once = PTHREAD_ONCE_INIT;
+
+#ifdef TIMING_HAVE_TSC
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Measure TSC ticks against CLOCK_MONOTONIC_RAW over short busy-wait
+// windows and keep the median to reject rounds hit by preemption
+static uint64_t calibrate_tsc_hz(void) {
+    uint64_t samples[CALIBRATION_ROUNDS];
+
+    for (int round = 0; round < CALIBRATION_ROUNDS; round++) {
+        uint64_t ns_start = timing_clock_ns();
+        uint64_t tsc_start = __rdtsc();
+        uint64_t ns_end;
+
+        do {
+            ns_end = timing_clock_ns();
+        } while (ns_end - ns_start < CALIBRATION_NS);
+
+        uint64_t tsc_end = __rdtsc();
+        samples[round] = (uint64_t)((double)(tsc_end - tsc_start) * 1e9 /
+                                    (double)(ns_end - ns_start));
+    }
+
+    qsort(samples, CALIBRATION_ROUNDS, sizeof(uint64_t), compare_u64);
+    return samples[CALIBRATION_ROUNDS / 2];
+}
+#endif
+
+static void timing_setup(void) {
+#ifdef TIMING_HAVE_TSC
+    if (cpu_has_feature(CPU_FEAT_INVARIANT_TSC) && cpu_has_feature(CPU_FEAT_RDTSCP)) {
+        g_tsc_hz = calibrate_tsc_hz();
+        if (g_tsc_hz > 0) {
+            g_ns_per_tick = 1e9 / (double)g_tsc_hz;
+            g_base_ns = timing_clock_ns();
+            g_base_ticks = __rdtsc();
+            timing_tsc_usable = 1;
+            return;
+        }
+    }
+#endif
+    g_tsc_hz = 0;
+    g_ns_per_tick = 1.0;
+    timing_tsc_usable = 0;
+}
+
+int timing_init(void) {
+    pthread_once(&g_timing_once, timing_setup);
+    return SUCCESS;
+}
+
+int timing_tsc_invariant(void) {
+    return cpu_has_feature(CPU_FEAT_INVARIANT_TSC);
+}
+
+uint64_t timing_tsc_hz(void) {
+    timing_init();
+    return g_tsc_hz;
+}
+
+const char *timing_source_name(void) {
+    timing_init();
+    return timing_tsc_usable ? "invariant TSC (rdtscp)" : "clock_gettime(CLOCK_MONOTONIC_RAW)";
+}
+
+void timing_print_info(void) {
+    timing_init();
+    if (timing_tsc_usable) {
+        PRINT_INFO("Timer: %s, %.3f MHz", timing_source_name(), g_tsc_hz / 1e6);
+    } else {
+        PRINT_INFO("Timer: %s", timing_source_name());
+    }
+}
+
+double timing_ticks_to_ns(uint64_t ticks) {
+    timing_init();
+    return (double)ticks * g_ns_per_tick;
+}
+
+double timing_ticks_to_sec(uint64_t ticks) {
+    return timing_ticks_to_ns(ticks) / 1e9;
+}
+
+uint64_t timing_ns_to_ticks(uint64_t ns) {
+    timing_init();
+    return (uint64_t)((double)ns / g_ns_per_tick);
+}
+
+uint64_t timing_now_ns(void) {
+    timing_init();
+#ifdef TIMING_HAVE_TSC
+    if (timing_tsc_usable) {
+        return g_base_ns + (uint64_t)((double)(__rdtsc() - g_base_ticks) * g_ns_per_tick);
+    }
+#endif
+    return timing_clock_ns();
+}
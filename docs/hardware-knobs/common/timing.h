@@ -0,0 +1,66 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <stdint.h>
+#include <time.h>
+#include "common.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TIMING_HAVE_TSC 1
+#endif
+
+// Timer ticks are TSC cycles when the TSC is invariant, otherwise
+// CLOCK_MONOTONIC_RAW nanoseconds. Callers only take differences of
+// ticks and convert them with timing_ticks_to_ns().
+extern int timing_tsc_usable;
+
+// Timing setup and queries; timing_init() calibrates the TSC once
+int timing_init(void);
+int timing_tsc_invariant(void);
+uint64_t timing_tsc_hz(void);
+const char *timing_source_name(void);
+void timing_print_info(void);
+
+// Conversions
+double timing_ticks_to_ns(uint64_t ticks);
+double timing_ticks_to_sec(uint64_t ticks);
+uint64_t timing_ns_to_ticks(uint64_t ns);
+
+// Monotonic wall time in nanoseconds
+uint64_t timing_now_ns(void);
+
+static inline uint64_t timing_clock_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Fenced start: earlier instructions retire before the TSC is read
+static inline uint64_t timing_start(void) {
+#ifdef TIMING_HAVE_TSC
+    if (timing_tsc_usable) {
+        _mm_lfence();
+        uint64_t tsc = __rdtsc();
+        _mm_lfence();
+        return tsc;
+    }
+#endif
+    return timing_clock_ns();
+}
+
+// Fenced stop: rdtscp waits for the measured code, lfence keeps later
+// instructions from starting before the read
+static inline uint64_t timing_stop(void) {
+#ifdef TIMING_HAVE_TSC
+    if (timing_tsc_usable) {
+        unsigned int aux;
+        uint64_t tsc = __rdtscp(&aux);
+        _mm_lfence();
+        return tsc;
+    }
+#endif
+    return timing_clock_ns();
+}
+
+#endif /* TIMING_H */
@@ -0,0 +1,519 @@
+#include "topology.h"
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/sysinfo.h>
+
+static topology_t g_topo;
+static int g_topo_loaded = 0;
+static pthread_mutex_t g_topo_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Quiet sysfs readers: missing files are normal for offline CPUs
+static int sysfs_read_str(const char *path, char *buffer, size_t size) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        return ERROR_SYSTEM;
+    }
+
+    if (fgets(buffer, size, fp) == NULL) {
+        fclose(fp);
+        return ERROR_SYSTEM;
+    }
+    fclose(fp);
+
+    size_t len = strlen(buffer);
+    if (len > 0 && buffer[len - 1] == '\n') {
+        buffer[len - 1] = '\0';
+    }
+    return SUCCESS;
+}
+
+static int sysfs_read_int(const char *path, int *value) {
+    char buffer[64];
+    if (sysfs_read_str(path, buffer, sizeof(buffer)) != SUCCESS) {
+        return ERROR_SYSTEM;
+    }
+    *value = atoi(buffer);
+    return SUCCESS;
+}
+
+// Parse sizes such as "32768K" or "30M" from cache/indexN/size
+static size_t parse_cache_size(const char *str) {
+    char *end;
+    size_t size = strtoull(str, &end, 10);
+    if (*end == 'K') {
+        size *= 1024;
+    } else if (*end == 'M') {
+        size *= 1024 * 1024;
+    }
+    return size;
+}
+
+int topo_parse_cpulist(const char *list, cpu_set_t *set) {
+    if (list == NULL || set == NULL) {
+        return ERROR_INVALID_PARAM;
+    }
+
+    CPU_ZERO(set);
+    const char *p = list;
+    int count = 0;
+
+    while (*p) {
+        while (*p == ',' || *p == ' ' || *p == '\n') p++;
+        if (!*p) break;
+
+        char *end;
+        long first = strtol(p, &end, 10);
+        if (end == p || first < 0) {
+            return ERROR_INVALID_PARAM;
+        }
+        long last = first;
+        p = end;
+        if (*p == '-') {
+            p++;
+            last = strtol(p, &end, 10);
+            if (end == p || last < first) {
+                return ERROR_INVALID_PARAM;
+            }
+            p = end;
+        }
+
+        for (long cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++) {
+            CPU_SET(cpu, set);
+            count++;
+        }
+    }
+
+    return count;
+}
+
+static int set_first_cpu(const cpu_set_t *set, int max) {
+    for (int cpu = 0; cpu < max; cpu++) {
+        if (CPU_ISSET(cpu, set)) return cpu;
+    }
+    return -1;
+}
+
+static int detect_max_cpus(void) {
+    char buffer[256];
+    cpu_set_t possible;
+
+    if (sysfs_read_str(TOPO_CPU_PATH "/possible", buffer, sizeof(buffer)) == SUCCESS &&
+        topo_parse_cpulist(buffer, &possible) > 0) {
+        int max = 0;
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &possible)) max = cpu + 1;
+        }
+        return max;
+    }
+
+    int count = get_nprocs_conf();
+    return count < CPU_SETSIZE ? count : CPU_SETSIZE;
+}
+
+// Find the domain matching (package, id) or append a new one
+static int domain_find_or_add(topo_domain_t *domains, int *count, int package_id, int id) {
+    for (int i = 0; i < *count; i++) {
+        if (domains[i].package_id == package_id && domains[i].id == id) {
+            return i;
+        }
+    }
+
+    topo_domain_t *d = &domains[(*count)];
+    memset(d, 0, sizeof(*d));
+    d->id = id;
+    d->package_id = package_id;
+    d->first_cpu = -1;
+    CPU_ZERO(&d->cpus);
+    return (*count)++;
+}
+
+static void domain_add_cpu(topo_domain_t *d, int cpu) {
+    if (!CPU_ISSET(cpu, &d->cpus)) {
+        CPU_SET(cpu, &d->cpus);
+        d->num_cpus++;
+        if (d->first_cpu < 0 || cpu < d->first_cpu) {
+            d->first_cpu = cpu;
+        }
+    }
+}
+
+// Caches are matched by their shared_cpu_list rather than by id, since
+// the id file is missing on older kernels
+static int cache_find_or_add(topo_cache_t *caches, int *count, const cpu_set_t *shared,
+                             int max_cpus, int id) {
+    for (int i = 0; i < *count; i++) {
+        if (CPU_EQUAL(&caches[i].domain.cpus, shared)) {
+            return i;
+        }
+    }
+
+    topo_cache_t *c = &caches[*count];
+    memset(c, 0, sizeof(*c));
+    c->domain.cpus = *shared;
+    c->domain.num_cpus = CPU_COUNT(shared);
+    c->domain.first_cpu = set_first_cpu(shared, max_cpus);
+    c->domain.id = (id >= 0) ? id : *count;
+    return (*count)++;
+}
+
+static void parse_cpu_caches(topology_t *topo, int cpu) {
+    char path[512], buffer[1024];
+
+    for (int index = 0; ; index++) {
+        int level;
+        snprintf(path, sizeof(path), TOPO_CPU_PATH "/cpu%d/cache/index%d/level", cpu, index);
+        if (sysfs_read_int(path, &level) != SUCCESS) {
+            break;
+        }
+        if (level != 2 && level != 3) {
+            continue;
+        }
+
+        snprintf(path, sizeof(path), TOPO_CPU_PATH "/cpu%d/cache/index%d/type", cpu, index);
+        if (sysfs_read_str(path, buffer, sizeof(buffer)) == SUCCESS &&
+            strcmp(buffer, "Instruction") == 0) {
+            continue;
+        }
+
+        cpu_set_t shared;
+        snprintf(path, sizeof(path), TOPO_CPU_PATH "/cpu%d/cache/index%d/shared_cpu_list", cpu, index);
+        if (sysfs_read_str(path, buffer, sizeof(buffer)) != SUCCESS ||
+            topo_parse_cpulist(buffer, &shared) <= 0) {
+            CPU_ZERO(&shared);
+            CPU_SET(cpu, &shared);
+        }
+
+        int id = -1;
+        snprintf(path, sizeof(path), TOPO_CPU_PATH "/cpu%d/cache/index%d/id", cpu, index);
+        sysfs_read_int(path, &id);
+
+        topo_cache_t *caches = (level == 2) ? topo->l2 : topo->l3;
+        int *count = (level == 2) ? &topo->num_l2 : &topo->num_l3;
+        int slot = cache_find_or_add(caches, count, &shared, topo->max_cpus, id);
+        topo_cache_t *c = &caches[slot];
+
+        if (c->level == 0) {
+            c->level = level;
+            c->domain.package_id = topo->cpus[cpu].package_id;
+            snprintf(path, sizeof(path), TOPO_CPU_PATH "/cpu%d/cache/index%d/size", cpu, index);
+            if (sysfs_read_str(path, buffer, sizeof(buffer)) == SUCCESS) {
+                c->size_bytes = parse_cache_size(buffer);
+            }
+            snprintf(path, sizeof(path), TOPO_CPU_PATH "/cpu%d/cache/index%d/ways_of_associativity", cpu, index);
+            sysfs_read_int(path, &c->ways);
+            snprintf(path, sizeof(path), TOPO_CPU_PATH "/cpu%d/cache/index%d/coherency_line_size", cpu, index);
+            sysfs_read_int(path, &c->line_size);
+        }
+
+        if (level == 2) {
+            topo->cpus[cpu].l2 = slot;
+        } else {
+            topo->cpus[cpu].l3 = slot;
+        }
+    }
+}
+
+static void parse_nodes(topology_t *topo) {
+    DIR *dir = opendir(TOPO_NODE_PATH);
+    if (!dir) {
+        return;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strncmp(entry->d_name, "node", 4) != 0 ||
+            entry->d_name[4] < '0' || entry->d_name[4] > '9') {
+            continue;
+        }
+
+        int node_id = atoi(entry->d_name + 4);
+        char path[512], buffer[1024];
+        cpu_set_t cpus;
+
+        snprintf(path, sizeof(path), TOPO_NODE_PATH "/node%d/cpulist", node_id);
+        if (sysfs_read_str(path, buffer, sizeof(buffer)) != SUCCESS) {
+            continue;
+        }
+        if (topo_parse_cpulist(buffer, &cpus) < 0) {
+            CPU_ZERO(&cpus);
+        }
+
+        // Memory-only nodes (CXL, HBM) are kept with an empty CPU set
+        int slot = domain_find_or_add(topo->nodes, &topo->num_nodes, -1, node_id);
+        TOPO_FOR_EACH_CPU(cpu, &cpus, topo->max_cpus) {
+            if (topo->cpus[cpu].online) {
+                domain_add_cpu(&topo->nodes[slot], cpu);
+                topo->cpus[cpu].node = node_id;
+            }
+        }
+    }
+
+    closedir(dir);
+}
+
+static void topology_free(topology_t *topo) {
+    free(topo->cpus);
+    free(topo->dies);
+    free(topo->cores);
+    free(topo->l2);
+    free(topo->l3);
+    free(topo->nodes);
+    memset(topo, 0, sizeof(*topo));
+}
+
+static int topology_parse(topology_t *topo) {
+    memset(topo, 0, sizeof(*topo));
+    topo->max_cpus = detect_max_cpus();
+
+    int n = topo->max_cpus;
+    topo->cpus = calloc(n, sizeof(topo_cpu_t));
+    topo->dies = calloc(n, sizeof(topo_domain_t));
+    topo->cores = calloc(n, sizeof(topo_domain_t));
+    topo->l2 = calloc(n, sizeof(topo_cache_t));
+    topo->l3 = calloc(n, sizeof(topo_cache_t));
+    topo->nodes = calloc(n + 64, sizeof(topo_domain_t));
+    if (!topo->cpus || !topo->dies || !topo->cores || !topo->l2 || !topo->l3 || !topo->nodes) {
+        topology_free(topo);
+        return ERROR_SYSTEM;
+    }
+
+    int max_package = -1;
+    for (int cpu = 0; cpu < n; cpu++) {
+        topo_cpu_t *c = &topo->cpus[cpu];
+        char path[512];
+        int online = 1;
+
+        c->core = c->die = c->l2 = c->l3 = c->node = -1;
+
+        // cpu0 usually has no online file and cannot be offlined
+        snprintf(path, sizeof(path), TOPO_CPU_PATH "/cpu%d/online", cpu);
+        sysfs_read_int(path, &online);
+
+        snprintf(path, sizeof(path), TOPO_CPU_PATH "/cpu%d/topology/physical_package_id", cpu);
+        if (!online || sysfs_read_int(path, &c->package_id) != SUCCESS) {
+            continue;
+        }
+
+        c->online = 1;
+        topo->num_online++;
+
+        snprintf(path, sizeof(path), TOPO_CPU_PATH "/cpu%d/topology/die_id", cpu);
+        if (sysfs_read_int(path, &c->die_id) != SUCCESS || c->die_id < 0) {
+            c->die_id = 0;
+        }
+        snprintf(path, sizeof(path), TOPO_CPU_PATH "/cpu%d/topology/core_id", cpu);
+        if (sysfs_read_int(path, &c->core_id) != SUCCESS) {
+            c->core_id = cpu;
+        }
+
+        if (c->package_id > max_package) {
+            max_package = c->package_id;
+        }
+
+        c->die = domain_find_or_add(topo->dies, &topo->num_dies, c->package_id, c->die_id);
+        domain_add_cpu(&topo->dies[c->die], cpu);
+
+        // core_id is only unique within a package and die
+        c->core = -1;
+        for (int i = 0; i < topo->num_cores; i++) {
+            const topo_cpu_t *first = &topo->cpus[topo->cores[i].first_cpu];
+            if (first->package_id == c->package_id && first->die_id == c->die_id &&
+                first->core_id == c->core_id) {
+                c->core = i;
+                break;
+            }
+        }
+        if (c->core < 0) {
+            c->core = topo->num_cores++;
+            memset(&topo->cores[c->core], 0, sizeof(topo_domain_t));
+            topo->cores[c->core].id = c->core_id;
+            topo->cores[c->core].package_id = c->package_id;
+            topo->cores[c->core].first_cpu = -1;
+        }
+        domain_add_cpu(&topo->cores[c->core], cpu);
+
+        parse_cpu_caches(topo, cpu);
+    }
+
+    topo->num_packages = max_package + 1;
+    parse_nodes(topo);
+
+    return (topo->num_online > 0) ? SUCCESS : ERROR_SYSTEM;
+}
+
+// Caller holds g_topo_lock
+static int topology_load(void) {
+    topology_free(&g_topo);
+    int result = topology_parse(&g_topo);
+    g_topo_loaded = (result == SUCCESS);
+
+    if (result != SUCCESS) {
+        PRINT_ERROR("Failed to parse CPU topology from %s", TOPO_CPU_PATH);
+    }
+    return result;
+}
+
+int topology_refresh(void) {
+    pthread_mutex_lock(&g_topo_lock);
+    int result = topology_load();
+    pthread_mutex_unlock(&g_topo_lock);
+    return result;
+}
+
+const topology_t *topology_get(void) {
+    // Threads racing the first call parse once; the others find it loaded
+    pthread_mutex_lock(&g_topo_lock);
+    int loaded = g_topo_loaded || topology_load() == SUCCESS;
+    pthread_mutex_unlock(&g_topo_lock);
+
+    return loaded ? &g_topo : NULL;
+}
+
+int topo_l3_domain_count(void) {
+    const topology_t *topo = topology_get();
+    return topo ? topo->num_l3 : 0;
+}
+
+int topo_l3_domain_cpu(int domain) {
+    const topology_t *topo = topology_get();
+    if (!topo) {
+        return ERROR_SYSTEM;
+    }
+    // Without L3 information fall back to CPU 0 as the single domain
+    if (topo->num_l3 == 0 && domain == 0) {
+        return 0;
+    }
+    if (domain < 0 || domain >= topo->num_l3) {
+        return ERROR_INVALID_PARAM;
+    }
+    return topo->l3[domain].domain.first_cpu;
+}
+
+int topo_cpu_l3_domain(int cpu) {
+    const topology_t *topo = topology_get();
+    if (!topo || cpu < 0 || cpu >= topo->max_cpus) {
+        return ERROR_INVALID_PARAM;
+    }
+    return topo->cpus[cpu].l3;
+}
+
+int topo_core_count(void) {
+    const topology_t *topo = topology_get();
+    return topo ? topo->num_cores : 0;
+}
+
+int topo_core_first_cpu(int core) {
+    const topology_t *topo = topology_get();
+    if (!topo || core < 0 || core >= topo->num_cores) {
+        return ERROR_INVALID_PARAM;
+    }
+    return topo->cores[core].first_cpu;
+}
+
+int topo_core_siblings(int cpu, int *cpus, int max) {
+    const topology_t *topo = topology_get();
+    if (!topo || cpu < 0 || cpu >= topo->max_cpus || !topo->cpus[cpu].online || cpus == NULL) {
+        return ERROR_INVALID_PARAM;
+    }
+
+    int count = 0;
+    const topo_domain_t *core = &topo->cores[topo->cpus[cpu].core];
+    TOPO_FOR_EACH_CPU(sibling, &core->cpus, topo->max_cpus) {
+        if (count < max) {
+            cpus[count++] = sibling;
+        }
+    }
+    return count;
+}
+
+int topo_node_cpus(int node, int *cpus, int max) {
+    const topology_t *topo = topology_get();
+    if (!topo || cpus == NULL) {
+        return ERROR_INVALID_PARAM;
+    }
+
+    for (int i = 0; i < topo->num_nodes; i++) {
+        if (topo->nodes[i].id != node) {
+            continue;
+        }
+        int count = 0;
+        TOPO_FOR_EACH_CPU(cpu, &topo->nodes[i].cpus, topo->max_cpus) {
+            if (count < max) {
+                cpus[count++] = cpu;
+            }
+        }
+        return count;
+    }
+    return ERROR_INVALID_PARAM;
+}
+
+int topo_cpu_node(int cpu) {
+    const topology_t *topo = topology_get();
+    if (!topo || cpu < 0 || cpu >= topo->max_cpus) {
+        return -1;
+    }
+    return topo->cpus[cpu].node;
+}
+
+const topo_cache_t *topo_llc(void) {
+    const topology_t *topo = topology_get();
+    if (!topo) {
+        return NULL;
+    }
+    if (topo->num_l3 > 0) {
+        return &topo->l3[0];
+    }
+    return (topo->num_l2 > 0) ? &topo->l2[0] : NULL;
+}
+
+int topo_pick_llc_cpus(int *cpus, int count) {
+    const topology_t *topo = topology_get();
+    int found = 0;
+
+    if (topo && topo->num_l3 > 0) {
+        const cpu_set_t *domain = &topo->l3[0].domain.cpus;
+        for (int pass = 0; pass < 2 && found < count; pass++) {
+            TOPO_FOR_EACH_CPU(cpu, domain, topo->max_cpus) {
+                if (found == count) break;
+                int primary = topo_core_first_cpu(topo->cpus[cpu].core) == cpu;
+                if (primary == (pass == 0)) {
+                    cpus[found++] = cpu;
+                }
+            }
+        }
+    }
+    for (int i = found; i < count; i++) {
+        cpus[i] = found ? cpus[i % found] : i % get_cpu_count();
+    }
+    return found;
+}
+
+int topo_pin_thread(int cpu) {
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(cpu, &cpuset);
+
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset) != 0) {
+        PRINT_ERROR("Failed to pin thread to CPU %d", cpu);
+        return ERROR_SYSTEM;
+    }
+    return SUCCESS;
+}
+
+void topology_print(void) {
+    const topology_t *topo = topology_get();
+    if (!topo) {
+        return;
+    }
+
+    PRINT_INFO("Topology: %d online CPUs, %d packages, %d dies, %d cores, %d L3 domains, %d NUMA nodes",
+               topo->num_online, topo->num_packages, topo->num_dies, topo->num_cores,
+               topo->num_l3, topo->num_nodes);
+
+    for (int i = 0; i < topo->num_l3; i++) {
+        const topo_cache_t *l3 = &topo->l3[i];
+        PRINT_INFO("  L3 domain %d: %zu KB, %d ways, %d CPUs, first CPU %d",
+                   l3->domain.id, l3->size_bytes / 1024, l3->ways,
+                   l3->domain.num_cpus, l3->domain.first_cpu);
+    }
+}
@@ -0,0 +1,94 @@
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <sched.h>
+#include <stddef.h>
+#include "common.h"
+
+// Sysfs topology paths
+#define TOPO_CPU_PATH   "/sys/devices/system/cpu"
+#define TOPO_NODE_PATH  "/sys/devices/system/node"
+
+#define TOPO_MAX_CACHE_LEVEL 3
+
+typedef struct {
+    int online;
+    int package_id;
+    int die_id;
+    int core_id;       // Core id as reported by sysfs (package-relative)
+    int core;          // Index into topology_t.cores
+    int die;           // Index into topology_t.dies
+    int l2;            // Index into topology_t.l2, -1 if unknown
+    int l3;            // Index into topology_t.l3, -1 if unknown
+    int node;          // NUMA node id, -1 if unknown
+} topo_cpu_t;
+
+// A set of CPUs sharing one resource (core, die, cache, node)
+typedef struct {
+    int id;            // Hardware id (cache id, node id, core_id, die_id)
+    int package_id;
+    int first_cpu;     // Lowest online CPU in the domain
+    int num_cpus;
+    cpu_set_t cpus;
+} topo_domain_t;
+
+typedef struct {
+    topo_domain_t domain;
+    int level;
+    size_t size_bytes;
+    int ways;
+    int line_size;
+} topo_cache_t;
+
+typedef struct {
+    int max_cpus;      // Length of cpus[] (highest possible CPU id + 1)
+    int num_online;
+    topo_cpu_t *cpus;
+
+    int num_packages;
+    int num_dies;
+    topo_domain_t *dies;
+    int num_cores;
+    topo_domain_t *cores;
+    int num_l2;
+    topo_cache_t *l2;
+    int num_l3;
+    topo_cache_t *l3;
+    int num_nodes;
+    topo_domain_t *nodes;
+} topology_t;
+
+// Iterate over the CPUs in a cpu_set_t
+#define TOPO_FOR_EACH_CPU(cpu, set, max) \
+    for (int cpu = 0; cpu < (max); cpu++) if (CPU_ISSET(cpu, (set)))
+
+// Topology model, parsed from sysfs once and cached. topology_get() is safe
+// from any thread. topology_refresh() re-parses in place, freeing the old
+// model, so it must not run while another thread may still be reading the
+// topology_t it got from topology_get().
+const topology_t *topology_get(void);
+int topology_refresh(void);
+void topology_print(void);
+
+// Domain queries
+int topo_l3_domain_count(void);
+int topo_l3_domain_cpu(int domain);
+int topo_cpu_l3_domain(int cpu);
+int topo_core_count(void);
+int topo_core_first_cpu(int core);
+int topo_core_siblings(int cpu, int *cpus, int max);
+int topo_node_cpus(int node, int *cpus, int max);
+int topo_cpu_node(int cpu);
+const topo_cache_t *topo_llc(void);
+
+// count CPUs of L3 domain 0, one per physical core before any SMT
+// sibling, so co-located threads contend for the LLC rather than a core.
+// Beyond the domain's CPUs the list repeats round-robin. Returns the
+// number of distinct CPUs found.
+int topo_pick_llc_cpus(int *cpus, int count);
+
+// Affinity helpers
+int topo_pin_thread(int cpu);
+int topo_parse_cpulist(const char *list, cpu_set_t *set);
+
+#endif /* TOPOLOGY_H */
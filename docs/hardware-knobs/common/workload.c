@@ -0,0 +1,214 @@
+#include "workload.h"
+#include <math.h>
+
+// Function declarations
+static uint64_t splitmix64(uint64_t *state);
+static size_t stream_length(const wl_config_t *config, size_t num_elems);
+
+static uint64_t splitmix64(uint64_t *state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Seeds go through splitmix64 so consecutive thread ids give unrelated states
+void wl_xorshift_seed(wl_xorshift_t *rng, uint64_t seed) {
+    rng->state = splitmix64(&seed);
+    if (rng->state == 0) {
+        rng->state = 0x9E3779B97F4A7C15ULL;
+    }
+}
+
+void wl_config_default(wl_config_t *config) {
+    memset(config, 0, sizeof(*config));
+    config->dist = WL_DIST_UNIFORM;
+    config->elem_size = 64;
+    config->zipf_theta = WL_DEFAULT_THETA;
+    config->hot_fraction = WL_DEFAULT_HOT_FRACTION;
+    config->hot_prob = WL_DEFAULT_HOT_PROB;
+}
+
+int wl_dist_parse(const char *name, wl_dist_t *dist) {
+    if (strcmp(name, "uniform") == 0) {
+        *dist = WL_DIST_UNIFORM;
+    } else if (strcmp(name, "zipf") == 0) {
+        *dist = WL_DIST_ZIPF;
+    } else if (strcmp(name, "hotcold") == 0) {
+        *dist = WL_DIST_HOTCOLD;
+    } else {
+        return ERROR_INVALID_PARAM;
+    }
+    return SUCCESS;
+}
+
+const char *wl_dist_name(wl_dist_t dist) {
+    switch (dist) {
+        case WL_DIST_UNIFORM: return "uniform";
+        case WL_DIST_ZIPF:    return "zipf";
+        case WL_DIST_HOTCOLD: return "hotcold";
+    }
+    return "unknown";
+}
+
+void wl_config_print(const wl_config_t *config) {
+    if (config->dist == WL_DIST_ZIPF) {
+        PRINT_INFO("Access distribution: zipf (theta %.2f)", config->zipf_theta);
+    } else if (config->dist == WL_DIST_HOTCOLD) {
+        PRINT_INFO("Access distribution: hotcold (%.0f%% of accesses to %.0f%% of the set)",
+                   config->hot_prob * 100.0, config->hot_fraction * 100.0);
+    } else {
+        PRINT_INFO("Access distribution: uniform");
+    }
+}
+
+// Long enough that every element is likely visited, short enough to stay
+// a small fraction of the traffic
+static size_t stream_length(const wl_config_t *config, size_t num_elems) {
+    size_t want = config->stream_len ? config->stream_len : 2 * num_elems;
+    size_t len = WL_STREAM_MIN;
+    while (len < want && len < WL_STREAM_MAX) {
+        len <<= 1;
+    }
+    return len;
+}
+
+void wl_permutation(uint32_t *perm, size_t n, wl_xorshift_t *rng) {
+    for (size_t i = 0; i < n; i++) {
+        perm[i] = (uint32_t)i;
+    }
+    for (size_t i = n - 1; i > 0 && n > 1; i--) {
+        size_t j = wl_bounded(wl_xorshift_next(rng), i + 1);
+        uint32_t tmp = perm[i];
+        perm[i] = perm[j];
+        perm[j] = tmp;
+    }
+}
+
+int wl_stream_build(wl_stream_t *stream, const wl_config_t *config, size_t num_elems,
+                    uint64_t seed) {
+    wl_xorshift_t rng;
+    uint32_t *perm = NULL;
+
+    memset(stream, 0, sizeof(*stream));
+    if (num_elems == 0 || num_elems > UINT32_MAX) {
+        return ERROR_INVALID_PARAM;
+    }
+    if (config->dist == WL_DIST_ZIPF && (config->zipf_theta <= 0.0 || config->zipf_theta >= 1.0)) {
+        PRINT_ERROR("Zipf theta must be in (0, 1), got %.3f", config->zipf_theta);
+        return ERROR_INVALID_PARAM;
+    }
+    if (config->dist == WL_DIST_HOTCOLD &&
+        (config->hot_fraction <= 0.0 || config->hot_fraction > 1.0 ||
+         config->hot_prob < 0.0 || config->hot_prob > 1.0)) {
+        PRINT_ERROR("Hot fraction must be in (0, 1] and hot probability in [0, 1]");
+        return ERROR_INVALID_PARAM;
+    }
+
+    stream->len = stream_length(config, num_elems);
+    stream->mask = stream->len - 1;
+    stream->num_elems = num_elems;
+    stream->index = malloc(stream->len * sizeof(uint32_t));
+    if (config->dist != WL_DIST_UNIFORM) {
+        perm = malloc(num_elems * sizeof(uint32_t));
+    }
+    if (!stream->index || (config->dist != WL_DIST_UNIFORM && !perm)) {
+        free(perm);
+        wl_stream_free(stream);
+        return ERROR_SYSTEM;
+    }
+
+    wl_xorshift_seed(&rng, seed);
+    if (perm) {
+        wl_permutation(perm, num_elems, &rng);
+    }
+
+    if (config->dist == WL_DIST_UNIFORM) {
+        for (size_t i = 0; i < stream->len; i++) {
+            stream->index[i] = (uint32_t)wl_bounded(wl_xorshift_next(&rng), num_elems);
+        }
+    } else if (config->dist == WL_DIST_ZIPF) {
+        // Gray et al., "Quickly generating billion-record synthetic databases"
+        double theta = config->zipf_theta;
+        double n = (double)num_elems;
+        double zetan = 0.0;
+        for (size_t i = 1; i <= num_elems; i++) {
+            zetan += 1.0 / pow((double)i, theta);
+        }
+        double zeta2 = 1.0 + pow(0.5, theta);
+        double alpha = 1.0 / (1.0 - theta);
+        double eta = (1.0 - pow(2.0 / n, 1.0 - theta)) / (1.0 - zeta2 / zetan);
+
+        for (size_t i = 0; i < stream->len; i++) {
+            double u = wl_unit(wl_xorshift_next(&rng));
+            double uz = u * zetan;
+            size_t rank;
+            if (uz < 1.0) {
+                rank = 0;
+            } else if (uz < zeta2) {
+                rank = 1;
+            } else {
+                rank = (size_t)(n * pow(eta * u - eta + 1.0, alpha));
+            }
+            stream->index[i] = perm[rank < num_elems ? rank : num_elems - 1];
+        }
+    } else {
+        size_t hot = (size_t)(config->hot_fraction * (double)num_elems);
+        if (hot == 0) {
+            hot = 1;
+        }
+        for (size_t i = 0; i < stream->len; i++) {
+            uint64_t r = wl_xorshift_next(&rng);
+            size_t rank;
+            if (wl_unit(r) < config->hot_prob || hot == num_elems) {
+                rank = wl_bounded(wl_xorshift_next(&rng), hot);
+            } else {
+                rank = hot + wl_bounded(wl_xorshift_next(&rng), num_elems - hot);
+            }
+            stream->index[i] = perm[rank];
+        }
+    }
+
+    free(perm);
+    return SUCCESS;
+}
+
+void wl_stream_free(wl_stream_t *stream) {
+    free(stream->index);
+    memset(stream, 0, sizeof(*stream));
+}
+
+int wl_chain_init(void *buf, size_t size, size_t stride, uint64_t seed) {
+    size_t num_nodes = stride ? size / stride : 0;
+    char *chain = (char *)buf;
+    wl_xorshift_t rng;
+
+    if (num_nodes < 2 || num_nodes > UINT32_MAX || stride < sizeof(void *)) {
+        return ERROR_INVALID_PARAM;
+    }
+    uint32_t *order = malloc(num_nodes * sizeof(uint32_t));
+    if (!order) {
+        return ERROR_SYSTEM;
+    }
+
+    wl_xorshift_seed(&rng, seed);
+    wl_permutation(order, num_nodes, &rng);
+    for (size_t i = 0; i < num_nodes; i++) {
+        *(void **)(chain + (size_t)order[i] * stride) =
+            chain + (size_t)order[(i + 1) % num_nodes] * stride;
+    }
+
+    free(order);
+    return SUCCESS;
+}
+
+void *wl_chain_alloc(size_t size, size_t stride, uint64_t seed) {
+    size_t bytes = stride ? size / stride * stride : 0;
+    void *chain = bytes ? aligned_alloc(stride, bytes) : NULL;
+
+    if (chain && wl_chain_init(chain, bytes, stride, seed) != SUCCESS) {
+        free(chain);
+        chain = NULL;
+    }
+    return chain;
+}
@@ -0,0 +1,92 @@
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "common.h"
+
+// Building blocks for benchmark kernels: per-thread generators that never
+// take a lock (glibc rand() serializes every caller on one), precomputed
+// access streams over a working set, and random pointer chains.
+
+// xorshift64*: one multiply per draw, for hot loops
+typedef struct {
+    uint64_t state;
+} wl_xorshift_t;
+
+void wl_xorshift_seed(wl_xorshift_t *rng, uint64_t seed);
+
+static inline uint64_t wl_xorshift_next(wl_xorshift_t *rng) {
+    uint64_t x = rng->state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    rng->state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+// Uniform in [0, n) without a division (Lemire's multiply-high)
+static inline uint64_t wl_bounded(uint64_t r, uint64_t n) {
+    return (uint64_t)(((unsigned __int128)r * n) >> 64);
+}
+
+// Uniform in [0, 1)
+static inline double wl_unit(uint64_t r) {
+    return (double)(r >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Access distributions over the elements of a working set. Zipfian and
+// hot/cold ranks are scattered through the set by a random permutation,
+// so the popular elements are not also adjacent.
+typedef enum {
+    WL_DIST_UNIFORM,
+    WL_DIST_ZIPF,               // P(rank k) ~ 1 / k^theta
+    WL_DIST_HOTCOLD             // hot_prob of accesses go to hot_fraction of the set
+} wl_dist_t;
+
+typedef struct {
+    wl_dist_t dist;
+    size_t wss;                 // Working set in bytes, 0 = kernel default
+    size_t elem_size;           // Bytes per element
+    double zipf_theta;
+    double hot_fraction;
+    double hot_prob;
+    size_t stream_len;          // Precomputed accesses, 0 = 2x elements (power of two)
+} wl_config_t;
+
+#define WL_DEFAULT_THETA        0.99
+#define WL_DEFAULT_HOT_FRACTION 0.1
+#define WL_DEFAULT_HOT_PROB     0.9
+#define WL_STREAM_MIN           4096
+#define WL_STREAM_MAX           (1UL << 22)
+
+// Element indices a kernel walks in order; the length is a power of two so
+// wrapping is a mask
+typedef struct {
+    uint32_t *index;
+    size_t len;
+    size_t mask;
+    size_t num_elems;
+} wl_stream_t;
+
+void wl_config_default(wl_config_t *config);
+int wl_dist_parse(const char *name, wl_dist_t *dist);
+const char *wl_dist_name(wl_dist_t dist);
+void wl_config_print(const wl_config_t *config);
+
+// Streams are built outside the timed region; seed per thread
+int wl_stream_build(wl_stream_t *stream, const wl_config_t *config, size_t num_elems,
+                    uint64_t seed);
+void wl_stream_free(wl_stream_t *stream);
+
+// Fisher-Yates shuffle of 0..n-1
+void wl_permutation(uint32_t *perm, size_t n, wl_xorshift_t *rng);
+
+// Random single-cycle chain through buf, one pointer per stride bytes
+int wl_chain_init(void *buf, size_t size, size_t stride, uint64_t seed);
+
+// Allocate a stride-aligned buffer of size bytes (rounded down to whole
+// strides) holding such a chain; stride is a power of two. free() it.
+void *wl_chain_alloc(size_t size, size_t stride, uint64_t seed);
+
+#endif /* WORKLOAD_H */
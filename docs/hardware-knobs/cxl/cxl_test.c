@@ -1,5 +1,6 @@
 #include "../common/common.h"
 #include "../common/msr_utils.h"
+#include "../common/timing.h"
 #include <dirent.h>
 
 // CXL sysfs paths
@@ -53,6 +54,8 @@ int main(int argc, char *argv[]) {
         return EXIT_FAILURE;
     }
     
+    timing_init();
+    
     if (cxl_init() != SUCCESS) {
         PRINT_ERROR("Failed to initialize CXL");
         return EXIT_FAILURE;
@@ -341,7 +344,7 @@ double cxl_measure_memory_bandwidth(void *addr, size_t size) {
     const int iterations = 5;
     
     // Sequential read test
-    uint64_t start_time = get_timestamp_us();
+    uint64_t start_time = timing_start();
     volatile char dummy = 0;
     
     for (int iter = 0; iter < iterations; iter++) {
@@ -350,9 +353,9 @@ double cxl_measure_memory_bandwidth(void *addr, size_t size) {
         }
     }
     
-    uint64_t end_time = get_timestamp_us();
+    uint64_t end_time = timing_stop();
     
-    double time_sec = (end_time - start_time) / 1000000.0;
+    double time_sec = timing_ticks_to_sec(end_time - start_time);
     double bytes_read = (double)size * iterations;
     double bandwidth_bps = bytes_read / time_sec;
     
@@ -1,12 +1,59 @@
 #include "prefetch_common.h"
+#include "../common/timing.h"
+#include "../common/bench_harness.h"
+#include "../common/mem_alloc.h"
+#include "../common/perf_events.h"
+#include "../common/topology.h"
+#include "../common/workload.h"
 #include <signal.h>
+#include <ctype.h>
+#include <sys/wait.h>
 
 // Benchmark parameters
 #define BENCH_ARRAY_SIZE (64 * 1024 * 1024)  // 64MB
 #define BENCH_ITERATIONS 5
 #define CACHE_LINE_SIZE 64
 
+// Auto-tuner: successive halving over the 16 prefetcher combinations. Each
+// round gives the survivors twice the previous round's samples and keeps
+// the better half, so 16 -> 8 -> 4 -> 2 -> 1.
+#define TUNE_MAX_ROUNDS 4
+
+// Software prefetch sweep: distances (0 = no software prefetch) against
+// hardware prefetcher states, per kernel
+#define SWPF_MAX_DISTANCES  16
+#define SWPF_DEFAULT_DISTANCES "0,1,2,4,8,16,32,64,128"
+#define SWPF_OPS            (4 * 1024 * 1024)   // Gathers / probes per sample
+#define SWPF_NODE_SIZE      64
+
+// __builtin_prefetch needs a constant locality; the switch is on a
+// loop-invariant value and predicts perfectly
+#define SWPF_PREFETCH(addr, hint) do {                                  \
+        switch (hint) {                                                 \
+        case SWPF_HINT_T0: __builtin_prefetch((addr), 0, 3); break;     \
+        case SWPF_HINT_T1: __builtin_prefetch((addr), 0, 2); break;     \
+        case SWPF_HINT_T2: __builtin_prefetch((addr), 0, 1); break;     \
+        default:           __builtin_prefetch((addr), 0, 0); break;     \
+        }                                                               \
+    } while (0)
+
+// Coverage map: stride (cache lines, negative walks down) x footprint x
+// concurrent streams, one matrix per prefetcher configuration
+#define COV_MAX_POINTS      24
+#define COV_MAX_STREAM_SETS 8
+#define COV_MAX_STREAMS     64
+#define COV_DEFAULT_STRIDES "1,2,3,4,5,7,8,16,17,32,-1,-2,-3,-8"
+#define COV_DEFAULT_STREAMS "1,4,16"
+#define COV_MIN_FOOTPRINT   (16 * 1024)
+#define COV_DEFAULT_LLC     (32 * 1024 * 1024)  // When sysfs has no cache sizes
+#define COV_ACCESSES        (64 * 1024)         // Dependent loads per sample
+#define COV_MIN_STEPS       8                   // Fewer per stream and pass: cell skipped
+#define COV_COVERED         2.0                 // Speedup over all-off that counts as covered
+
 static volatile int running = 1;
+static mem_page_t g_pages = MEM_PAGE_4K;        // --pages
+static int g_have_perf = 0;
+static int g_tune_higher_is_better = 1;         // Sort direction for tune_compare()
 
 typedef struct {
     const char *name;
@@ -15,6 +62,87 @@ typedef struct {
     uint64_t cache_misses;
 } benchmark_result_t;
 
+// Shared buffer handed to every registered kernel
+typedef struct {
+    void *data;
+    size_t size;
+} kernel_ctx_t;
+
+typedef enum {
+    TUNE_MEDIAN,            // Best typical throughput (or latency)
+    TUNE_P99                // Best tail: p99 of lower-is-better metrics, p1 otherwise
+} tune_objective_t;
+
+// What the tuner measures: a registered kernel on the test buffer, or one
+// run of a shell command timed in seconds
+typedef struct {
+    const bench_kernel_t *kernel;
+    kernel_ctx_t ctx;
+    const char *command;
+    char name[128];
+    const char *unit;
+    int higher_is_better;
+} tune_target_t;
+
+typedef struct {
+    uint64_t mask;
+    int n;
+    double score;
+    double samples[BENCH_MAX_SAMPLES];
+} tune_candidate_t;
+
+typedef enum {
+    SWPF_HINT_T0,           // prefetcht0: all levels
+    SWPF_HINT_T1,           // prefetcht1: L2 and beyond
+    SWPF_HINT_T2,           // prefetcht2: LLC and beyond
+    SWPF_HINT_NTA           // prefetchnta: minimal cache pollution
+} swpf_hint_t;
+
+typedef struct {
+    uint64_t key;           // 0 = empty
+    uint64_t value;
+} swpf_bucket_t;
+
+typedef struct swpf_node {
+    struct swpf_node *next;
+    uint64_t value;
+    char padding[SWPF_NODE_SIZE - sizeof(struct swpf_node *) - sizeof(uint64_t)];
+} swpf_node_t;
+
+// Data of the software prefetch kernels; the big array lives in buf
+typedef struct {
+    mem_buffer_t buf;
+    uint64_t *data;             // gather: 8-byte elements
+    swpf_bucket_t *table;       // hash_probe: open addressing, linear probing
+    int table_bits;
+    swpf_node_t *nodes;         // list_walk
+    uint32_t *index;            // gather indices, or the list's visit order
+    uint64_t *keys;             // hash_probe probe keys, all present
+    size_t count;               // Elements, buckets or nodes in buf
+    size_t ops;                 // Accesses per sample
+    int distance;
+    swpf_hint_t hint;
+} swpf_ctx_t;
+
+// One coverage cell: streams walk disjoint regions of base round-robin
+typedef struct {
+    char *base;
+    size_t region;              // Bytes per stream
+    ptrdiff_t step;             // Stride in bytes
+    size_t span;                // Bytes a stream walks before it wraps
+    int streams;
+    size_t offset[COV_MAX_STREAMS];
+} cov_ctx_t;
+
+typedef struct {
+    const long *strides;
+    int num_strides;
+    const long *footprints;
+    int num_footprints;
+    const long *streams;
+    int num_streams;
+} cov_grid_t;
+
 // Function declarations
 int prefetch_benchmark_init(void);
 void prefetch_benchmark_cleanup(void);
@@ -22,12 +150,224 @@ double benchmark_sequential_read(void *data, size_t size);
 double benchmark_sequential_write(void *data, size_t size);
 double benchmark_random_read(void *data, size_t size);
 double benchmark_stride_read(void *data, size_t size, int stride);
-double benchmark_pointer_chase(void *data, size_t size);
+double benchmark_pointer_chase(void *data, size_t size, double *ns_per_access);
 void benchmark_with_prefetch_config(uint64_t config, const char *config_name);
 void signal_handler(int sig);
 void print_benchmark_header(void);
+static int buffer_node(void);
+static double kernel_seq_read(void *ctx);
+static double kernel_seq_write(void *ctx);
+static double kernel_rand_read(void *ctx);
+static double kernel_stride2(void *ctx);
+static double kernel_stride8(void *ctx);
+static double kernel_ptr_chase(void *ctx);
+static int run_autotune(tune_target_t *target, tune_objective_t objective, const bench_options_t *opts,
+                        const char *profile_path);
+static double tune_sample(tune_target_t *target);
+static double tune_run_command(const char *command);
+static double tune_score(const tune_candidate_t *cand, tune_objective_t objective, int higher_is_better);
+static int tune_compare(const void *a, const void *b);
+static int compare_sample(const void *a, const void *b);
+static void tune_profile_path(const char *name, char *path, size_t len);
+static int apply_profile(const char *path);
+static double kernel_gather(void *ctx);
+static double kernel_hash_probe(void *ctx);
+static double kernel_list_walk(void *ctx);
+static int swpf_setup(const bench_kernel_t *kernel, swpf_ctx_t *ctx);
+static void swpf_teardown(swpf_ctx_t *ctx);
+static int swpf_parse_hint(const char *name, swpf_hint_t *hint);
+static int run_swpf_sweep(const long *distances, int num_distances, swpf_hint_t hint,
+                          const char *heatmap_path);
+static int parse_list(const char *list, long *values, int max, int sizes);
+static double kernel_coverage(void *ctx);
+static int cov_setup(cov_ctx_t *ctx, char *base, long footprint, long stride, int streams);
+static const char *cov_level(long footprint);
+static void cov_print_matrix(const cov_grid_t *grid, const char *title, const double *cells,
+                             const double *baseline);
+static int run_coverage(const cov_grid_t *grid, const char *heatmap_path);
+
+static const bench_kernel_t prefetch_kernels[] = {
+    { "seq_read",  "MB/s",      1, kernel_seq_read },
+    { "seq_write", "MB/s",      1, kernel_seq_write },
+    { "rand_read", "MB/s",      1, kernel_rand_read },
+    { "stride2",   "MB/s",      1, kernel_stride2 },
+    { "stride8",   "MB/s",      1, kernel_stride8 },
+    { "ptr_chase", "ns/access", 0, kernel_ptr_chase },
+};
+
+#define NUM_PREFETCH_KERNELS (sizeof(prefetch_kernels) / sizeof(prefetch_kernels[0]))
+
+// Irregular access patterns the hardware prefetchers cannot follow; they
+// run only in the --swpf-sweep and take a swpf_ctx_t
+static const bench_kernel_t swpf_kernels[] = {
+    { "gather",     "Mops/s", 1, kernel_gather },
+    { "hash_probe", "Mops/s", 1, kernel_hash_probe },
+    { "list_walk",  "Mops/s", 1, kernel_list_walk },
+};
+
+#define NUM_SWPF_KERNELS (sizeof(swpf_kernels) / sizeof(swpf_kernels[0]))
+
+// Hardware states the sweep crosses with the distances
+static const uint64_t swpf_hw_masks[] = {
+    0x0,                                                            // All on
+    PREFETCH_L2_STREAM_HW_DISABLE | PREFETCH_L2_STREAM_ADJ_DISABLE, // L2 prefetchers off
+    PREFETCH_DISABLE_MASK,                                          // All off
+};
+
+#define NUM_SWPF_HW (sizeof(swpf_hw_masks) / sizeof(swpf_hw_masks[0]))
+
+static volatile uint64_t g_swpf_sink;
+
+static const bench_kernel_t coverage_kernel = { "coverage", "cycles/access", 0, kernel_coverage };
+
+// Baseline with everything off first, then each prefetcher on its own,
+// then all on; the baseline must stay first for the speedup glyphs
+static const struct {
+    uint64_t mask;
+    const char *label;
+} cov_configs[] = {
+    { PREFETCH_DISABLE_MASK,                                    "all off" },
+    { PREFETCH_DISABLE_MASK & ~PREFETCH_L2_STREAM_HW_DISABLE,   "L2 streamer only" },
+    { PREFETCH_DISABLE_MASK & ~PREFETCH_L2_STREAM_ADJ_DISABLE,  "L2 adjacent line only" },
+    { PREFETCH_DISABLE_MASK & ~PREFETCH_DCU_STREAM_DISABLE,     "DCU streamer only" },
+    { PREFETCH_DISABLE_MASK & ~PREFETCH_DCU_IP_DISABLE,         "DCU IP-stride only" },
+    { 0x0,                                                      "all on" },
+};
+
+#define NUM_COV_CONFIGS (sizeof(cov_configs) / sizeof(cov_configs[0]))
 
 int main(int argc, char *argv[]) {
+    bench_options_t opts;
+    const char *tune_kernel = NULL;
+    const char *tune_command = NULL;
+    const char *profile_path = NULL;
+    const char *apply_path = NULL;
+    tune_objective_t objective = TUNE_MEDIAN;
+    int swpf_sweep = 0;
+    long distances[SWPF_MAX_DISTANCES];
+    int num_distances = 0;
+    swpf_hint_t hint = SWPF_HINT_T0;
+    const char *heatmap_path = NULL;
+    const char *distance_list = SWPF_DEFAULT_DISTANCES;
+    int coverage = 0;
+    long strides[COV_MAX_POINTS];
+    long footprints[COV_MAX_POINTS];
+    long streams[COV_MAX_STREAM_SETS];
+    const char *stride_list = COV_DEFAULT_STRIDES;
+    const char *footprint_list = NULL;
+    const char *stream_list = COV_DEFAULT_STREAMS;
+    cov_grid_t grid = { strides, 0, footprints, 0, streams, 0 };
+    
+    for (size_t i = 0; i < NUM_PREFETCH_KERNELS; i++) {
+        bench_register(&prefetch_kernels[i]);
+    }
+    
+    bench_options_init(&opts, "prefetch_bench");
+    int bad_args = bench_parse_args(&opts, &argc, argv) != SUCCESS;
+    for (int i = 1; i < argc && !bad_args; i++) {
+        if (strcmp(argv[i], "--pages") == 0 && i + 1 < argc) {
+            bad_args = mem_page_parse(argv[++i], &g_pages) != SUCCESS;
+        } else if (strcmp(argv[i], "--tune") == 0 && i + 1 < argc) {
+            tune_kernel = argv[++i];
+        } else if (strcmp(argv[i], "--tune-cmd") == 0 && i + 1 < argc) {
+            tune_command = argv[++i];
+        } else if (strcmp(argv[i], "--objective") == 0 && i + 1 < argc) {
+            i++;
+            objective = strcmp(argv[i], "p99") == 0 ? TUNE_P99 : TUNE_MEDIAN;
+            bad_args = objective == TUNE_MEDIAN && strcmp(argv[i], "median") != 0;
+        } else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            profile_path = argv[++i];
+        } else if (strcmp(argv[i], "--apply-profile") == 0 && i + 1 < argc) {
+            apply_path = argv[++i];
+        } else if (strcmp(argv[i], "--swpf-sweep") == 0) {
+            swpf_sweep = 1;
+        } else if (strcmp(argv[i], "--distances") == 0 && i + 1 < argc) {
+            distance_list = argv[++i];
+        } else if (strcmp(argv[i], "--hint") == 0 && i + 1 < argc) {
+            bad_args = swpf_parse_hint(argv[++i], &hint) != SUCCESS;
+        } else if (strcmp(argv[i], "--heatmap") == 0 && i + 1 < argc) {
+            heatmap_path = argv[++i];
+        } else if (strcmp(argv[i], "--coverage") == 0) {
+            coverage = 1;
+        } else if (strcmp(argv[i], "--strides") == 0 && i + 1 < argc) {
+            stride_list = argv[++i];
+        } else if (strcmp(argv[i], "--footprints") == 0 && i + 1 < argc) {
+            footprint_list = argv[++i];
+        } else if (strcmp(argv[i], "--streams") == 0 && i + 1 < argc) {
+            stream_list = argv[++i];
+        } else {
+            bad_args = 1;
+        }
+    }
+    if (swpf_sweep && !bad_args) {
+        num_distances = parse_list(distance_list, distances, SWPF_MAX_DISTANCES, 0);
+        for (int d = 0; d < num_distances; d++) {
+            bad_args = bad_args || distances[d] < 0 || distances[d] > 4096;
+        }
+        bad_args = bad_args || num_distances <= 0;
+    }
+    if (coverage && !bad_args) {
+        grid.num_strides = parse_list(stride_list, strides, COV_MAX_POINTS, 0);
+        grid.num_streams = parse_list(stream_list, streams, COV_MAX_STREAM_SETS, 0);
+        if (footprint_list) {
+            grid.num_footprints = parse_list(footprint_list, footprints, COV_MAX_POINTS, 1);
+        } else {
+            // L1-sized up to four times the LLC, doubling
+            const topo_cache_t *llc = topo_llc();
+            long limit = 4 * (llc && llc->size_bytes ? (long)llc->size_bytes : COV_DEFAULT_LLC);
+            for (long fp = COV_MIN_FOOTPRINT; fp <= limit && grid.num_footprints < COV_MAX_POINTS; fp *= 2) {
+                footprints[grid.num_footprints++] = fp;
+            }
+        }
+        bad_args = grid.num_strides <= 0 || grid.num_streams <= 0 || grid.num_footprints <= 0;
+        for (int j = 0; j < grid.num_strides && !bad_args; j++) {
+            bad_args = strides[j] == 0;
+        }
+        for (int j = 0; j < grid.num_streams && !bad_args; j++) {
+            bad_args = streams[j] < 1 || streams[j] > COV_MAX_STREAMS;
+        }
+        for (int j = 0; j < grid.num_footprints && !bad_args; j++) {
+            bad_args = footprints[j] < CACHE_LINE_SIZE;
+        }
+    }
+    if (tune_kernel && !bench_find(tune_kernel)) {
+        PRINT_ERROR("Unknown kernel \"%s\"", tune_kernel);
+        bad_args = 1;
+    }
+    if (bad_args || (tune_kernel && tune_command)) {
+        printf("Usage: %s [--pages 4k|thp|2m|1g] [harness options]\n", argv[0]);
+        printf("       %s --tune KERNEL | --tune-cmd \"CMD\" [--objective median|p99] [--profile FILE]\n",
+               argv[0]);
+        printf("       %s --apply-profile FILE\n", argv[0]);
+        printf("       %s --swpf-sweep [--distances LIST] [--hint t0|t1|t2|nta] [--heatmap FILE]\n",
+               argv[0]);
+        printf("       %s --coverage [--strides LIST] [--footprints LIST] [--streams LIST] [--heatmap FILE]\n",
+               argv[0]);
+        printf("  --pages P          Test buffer on 4k (default), thp, 2m or 1g pages\n");
+        printf("  --tune KERNEL      Search all 16 prefetcher combinations for a registered kernel\n");
+        printf("  --tune-cmd CMD     Same for a shell command, one timed run per sample\n");
+        printf("  --objective O      Rank by median (default) or p99 tail\n");
+        printf("  --profile FILE     Where to write the winning profile (default prefetch_<name>.profile)\n");
+        printf("  --apply-profile F  Set the prefetchers from a profile and leave them set\n");
+        printf("  The first tuning round takes --reps samples per configuration (at most %d)\n",
+               BENCH_MAX_SAMPLES / ((1 << TUNE_MAX_ROUNDS) - 1));
+        printf("  --swpf-sweep       Software prefetch distance x hardware prefetcher state for the\n"
+               "                     gather, hash_probe and list_walk kernels (--kernel filters)\n");
+        printf("  --distances LIST   Prefetch distances in elements, 0 = none (default %s)\n",
+               SWPF_DEFAULT_DISTANCES);
+        printf("  --hint H           Locality hint of the software prefetch (default t0)\n");
+        printf("  --heatmap FILE     Write the sweep or coverage map as CSV\n");
+        printf("  --coverage         Cycles per dependent load over stride x footprint x streams,\n"
+               "                     one matrix per prefetcher (all off, each alone, all on)\n");
+        printf("  --strides LIST     Strides in cache lines, negative walks down (default %s)\n",
+               COV_DEFAULT_STRIDES);
+        printf("  --footprints LIST  Footprints with K/M/G suffixes (default 16K doubling to 4x LLC)\n");
+        printf("  --streams LIST     Concurrent streams, 1-%d (default %s)\n", COV_MAX_STREAMS,
+               COV_DEFAULT_STREAMS);
+        bench_print_usage();
+        return EXIT_FAILURE;
+    }
+    
     PRINT_INFO("Starting Hardware Prefetch Benchmark");
     
     // Check permissions
@@ -41,14 +381,80 @@ int main(int argc, char *argv[]) {
         return EXIT_FAILURE;
     }
     
+    if (apply_path) {
+        int ret = apply_profile(apply_path);
+        prefetch_benchmark_cleanup();
+        return ret == SUCCESS ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    
+    // Calibrate the timer, pin and lock frequency before any measurement
+    if (bench_begin(&opts) != SUCCESS) {
+        PRINT_ERROR("Failed to set up benchmark harness");
+        return EXIT_FAILURE;
+    }
+    timing_print_info();
+    
     // Set up signal handler
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
     
+    if (swpf_sweep || coverage) {
+        int ret = ERROR_SYSTEM;
+        if (prefetch_snapshot_take() == SUCCESS) {
+            if (swpf_sweep) {
+                ret = run_swpf_sweep(distances, num_distances, hint, heatmap_path);
+            } else {
+                ret = run_coverage(&grid, heatmap_path);
+            }
+            prefetch_snapshot_restore();
+        }
+        bench_end();
+        prefetch_benchmark_cleanup();
+        return ret == SUCCESS ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    
+    if (tune_kernel || tune_command) {
+        tune_target_t target = { 0 };
+        mem_buffer_t buf = { 0 };
+        int ret = ERROR_SYSTEM;
+        
+        if (tune_kernel) {
+            target.kernel = bench_find(tune_kernel);
+            target.unit = target.kernel->unit;
+            target.higher_is_better = target.kernel->higher_is_better;
+            snprintf(target.name, sizeof(target.name), "%s", tune_kernel);
+            if (mem_alloc(&buf, BENCH_ARRAY_SIZE, g_pages, buffer_node(), 0x55) != SUCCESS) {
+                PRINT_ERROR("Failed to allocate benchmark data");
+                bench_end();
+                return EXIT_FAILURE;
+            }
+            target.ctx.data = buf.addr;
+            target.ctx.size = BENCH_ARRAY_SIZE;
+        } else {
+            target.command = tune_command;
+            target.unit = "s/run";
+            target.higher_is_better = 0;
+            snprintf(target.name, sizeof(target.name), "%s", tune_command);
+        }
+        
+        // Every core's MSR 0x1A4 comes back on any exit path, signals included
+        if (prefetch_snapshot_take() == SUCCESS) {
+            ret = run_autotune(&target, objective, &opts, profile_path);
+            prefetch_snapshot_restore();
+        }
+        if (tune_kernel) {
+            mem_free(&buf);
+        }
+        bench_end();
+        prefetch_benchmark_cleanup();
+        return ret == SUCCESS ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    
     // Save original prefetch configuration
     uint64_t original_config;
     if (prefetch_read_config(&original_config) != SUCCESS) {
         PRINT_ERROR("Failed to read original prefetch configuration");
+        bench_end();
         return EXIT_FAILURE;
     }
     
@@ -65,6 +471,7 @@ int main(int argc, char *argv[]) {
     // Restore original configuration
     prefetch_write_config(original_config);
     
+    bench_end();
     prefetch_benchmark_cleanup();
     
     PRINT_INFO("Prefetch benchmark completed");
@@ -77,6 +484,9 @@ int prefetch_benchmark_init(void) {
         return ERROR_NOT_SUPPORTED;
     }
     
+    g_have_perf = perf_events_available();
+    PRINT_INFO("Test buffer: %d MB on %s pages", BENCH_ARRAY_SIZE / (1024 * 1024), mem_page_name(g_pages));
+    
     PRINT_INFO("Prefetch benchmark initialized");
     return SUCCESS;
 }
@@ -95,7 +505,7 @@ double benchmark_sequential_read(void *data, size_t size) {
         dummy += ptr[i % size];
     }
     
-    start_time = get_timestamp_us();
+    start_time = timing_start();
     
     for (int iter = 0; iter < BENCH_ITERATIONS; iter++) {
         for (size_t i = 0; i < size; i += CACHE_LINE_SIZE) {
@@ -103,9 +513,9 @@ double benchmark_sequential_read(void *data, size_t size) {
         }
     }
     
-    end_time = get_timestamp_us();
+    end_time = timing_stop();
     
-    double time_sec = (end_time - start_time) / 1000000.0;
+    double time_sec = timing_ticks_to_sec(end_time - start_time);
     double bytes_read = (double)size * BENCH_ITERATIONS;
     
     return (bytes_read / (1024 * 1024)) / time_sec;
@@ -115,7 +525,7 @@ double benchmark_sequential_write(void *data, size_t size) {
     volatile char *ptr = (volatile char *)data;
     uint64_t start_time, end_time;
     
-    start_time = get_timestamp_us();
+    start_time = timing_start();
     
     for (int iter = 0; iter < BENCH_ITERATIONS; iter++) {
         for (size_t i = 0; i < size; i += CACHE_LINE_SIZE) {
@@ -123,9 +533,9 @@ double benchmark_sequential_write(void *data, size_t size) {
         }
     }
     
-    end_time = get_timestamp_us();
+    end_time = timing_stop();
     
-    double time_sec = (end_time - start_time) / 1000000.0;
+    double time_sec = timing_ticks_to_sec(end_time - start_time);
     double bytes_written = (double)size * BENCH_ITERATIONS;
     
     return (bytes_written / (1024 * 1024)) / time_sec;
@@ -147,7 +557,7 @@ double benchmark_random_read(void *data, size_t size) {
         indices[i] = (rand() % (size / CACHE_LINE_SIZE)) * CACHE_LINE_SIZE;
     }
     
-    start_time = get_timestamp_us();
+    start_time = timing_start();
     
     for (int iter = 0; iter < BENCH_ITERATIONS; iter++) {
         for (size_t i = 0; i < num_accesses; i++) {
@@ -155,11 +565,11 @@ double benchmark_random_read(void *data, size_t size) {
         }
     }
     
-    end_time = get_timestamp_us();
+    end_time = timing_stop();
     
     free(indices);
     
-    double time_sec = (end_time - start_time) / 1000000.0;
+    double time_sec = timing_ticks_to_sec(end_time - start_time);
     double bytes_read = (double)num_accesses * CACHE_LINE_SIZE * BENCH_ITERATIONS;
     
     return (bytes_read / (1024 * 1024)) / time_sec;
@@ -172,7 +582,7 @@ double benchmark_stride_read(void *data, size_t size, int stride) {
     
     size_t stride_bytes = stride * CACHE_LINE_SIZE;
     
-    start_time = get_timestamp_us();
+    start_time = timing_start();
     
     for (int iter = 0; iter < BENCH_ITERATIONS; iter++) {
         for (size_t i = 0; i < size; i += stride_bytes) {
@@ -180,15 +590,15 @@ double benchmark_stride_read(void *data, size_t size, int stride) {
         }
     }
     
-    end_time = get_timestamp_us();
+    end_time = timing_stop();
     
-    double time_sec = (end_time - start_time) / 1000000.0;
+    double time_sec = timing_ticks_to_sec(end_time - start_time);
     double bytes_read = (double)(size / stride_bytes) * CACHE_LINE_SIZE * BENCH_ITERATIONS;
     
     return (bytes_read / (1024 * 1024)) / time_sec;
 }
 
-double benchmark_pointer_chase(void *data, size_t size) {
+double benchmark_pointer_chase(void *data, size_t size, double *ns_per_access) {
     struct node {
         struct node *next;
         char padding[CACHE_LINE_SIZE - sizeof(struct node *)];
@@ -212,7 +622,7 @@ double benchmark_pointer_chase(void *data, size_t size) {
         nodes[j].next = temp;
     }
     
-    start_time = get_timestamp_us();
+    start_time = timing_start();
     
     struct node *current = &nodes[0];
     for (int iter = 0; iter < BENCH_ITERATIONS; iter++) {
@@ -221,11 +631,21 @@ double benchmark_pointer_chase(void *data, size_t size) {
         }
     }
     
-    end_time = get_timestamp_us();
+    end_time = timing_stop();
     
-    double time_sec = (end_time - start_time) / 1000000.0;
+    double time_sec = timing_ticks_to_sec(end_time - start_time);
     double bytes_accessed = (double)num_nodes * sizeof(struct node) * BENCH_ITERATIONS;
     
+    // Keep the chain live so the loop is not optimized away
+    if (current == NULL) {
+        PRINT_ERROR("Pointer chase chain broken");
+    }
+    
+    if (ns_per_access) {
+        *ns_per_access = timing_ticks_to_ns(end_time - start_time) /
+                         ((double)num_nodes * BENCH_ITERATIONS);
+    }
+    
     return (bytes_accessed / (1024 * 1024)) / time_sec;
 }
 
@@ -241,39 +661,849 @@ void benchmark_with_prefetch_config(uint64_t config, const char *config_name) {
     // Wait for configuration to take effect
     sleep_ms(100);
     
-    // Allocate test data
-    void *data = malloc(BENCH_ARRAY_SIZE);
-    if (!data) {
+    // Allocate test data, faulted in on this thread's node
+    mem_buffer_t buf;
+    if (mem_alloc(&buf, BENCH_ARRAY_SIZE, g_pages, buffer_node(), 0x55) != SUCCESS) {
         PRINT_ERROR("Failed to allocate benchmark data");
         return;
     }
     
-    // Initialize data
-    memset(data, 0x55, BENCH_ARRAY_SIZE);
+    // Run every selected kernel through the harness and report medians
+    kernel_ctx_t ctx = { buf.addr, BENCH_ARRAY_SIZE };
+    double median[NUM_PREFETCH_KERNELS] = { 0 };
+    perf_tlb_t tlb;
+    uint64_t tlb_loads = 0, tlb_misses = 0;
+    int have_tlb = g_have_perf && perf_tlb_open(&tlb, 0, -1, 0) == SUCCESS;
+    
+    for (size_t i = 0; i < NUM_PREFETCH_KERNELS && running; i++) {
+        bench_stats_t stats;
+        
+        if (!bench_kernel_selected(&prefetch_kernels[i])) {
+            continue;
+        }
+        bench_run(&prefetch_kernels[i], &ctx, config_name, &stats);
+        median[i] = stats.median;
+    }
+    if (have_tlb) {
+        have_tlb = perf_tlb_read(&tlb, &tlb_loads, &tlb_misses) == SUCCESS && tlb_loads > 0;
+        perf_tlb_close(&tlb);
+    }
+    
+    double chase_ns = median[NUM_PREFETCH_KERNELS - 1];
+    double pointer_chase = chase_ns > 0 ?
+        (CACHE_LINE_SIZE / (chase_ns * 1e-9)) / (1024 * 1024) : 0.0;
+    
+    char tlb_rate[16] = "n/a";
+    if (have_tlb) {
+        snprintf(tlb_rate, sizeof(tlb_rate), "%.3f%%", 100.0 * tlb_misses / tlb_loads);
+    }
+    printf("%-16s %8.1f %8.1f %8.1f %8.1f %8.1f %8.1f %8.2f %8s\n",
+           config_name, median[0], median[1], median[2],
+           median[3], median[4], pointer_chase, chase_ns, tlb_rate);
+    
+    mem_free(&buf);
+}
+
+// Node of the CPU the harness pinned us to, -1 on single-node machines
+static int buffer_node(void) {
+    const topology_t *topo = topology_get();
+    if (!topo || topo->num_nodes < 2) {
+        return -1;
+    }
+    return topo_cpu_node(sched_getcpu());
+}
+
+// Successive halving; returns ERROR_SYSTEM if a sample fails or the run is interrupted
+static int run_autotune(tune_target_t *target, tune_objective_t objective, const bench_options_t *opts,
+                        const char *profile_path) {
+    tune_candidate_t *cands = calloc(PREFETCH_NUM_CONFIGS, sizeof(tune_candidate_t));
+    int alive = PREFETCH_NUM_CONFIGS;
+    int samples = opts->repetitions > 0 ? opts->repetitions : BENCH_DEFAULT_REPS;
+    double baseline = 0.0;
+    char name[64];
+    
+    if (!cands) {
+        return ERROR_SYSTEM;
+    }
+    for (int i = 0; i < PREFETCH_NUM_CONFIGS; i++) {
+        cands[i].mask = (uint64_t)i;
+    }
+    g_tune_higher_is_better = target->higher_is_better;
+    if (objective == TUNE_P99) {
+        // A tail needs enough samples to be more than the single worst one
+        samples = samples < 10 ? 10 : samples;
+    }
+    // Each round doubles the samples and keeps the earlier ones, so a
+    // finalist collects samples * (2^rounds - 1) in all
+    int max_samples = BENCH_MAX_SAMPLES / ((1 << TUNE_MAX_ROUNDS) - 1);
+    if (samples > max_samples) {
+        PRINT_INFO("Limiting the first round to %d samples per configuration", max_samples);
+        samples = max_samples;
+    }
+    
+    PRINT_INFO("Auto-tuning prefetchers for %s by %s %s (%s is better)", target->name,
+               objective == TUNE_P99 ? "tail" : "median", target->unit,
+               target->higher_is_better ? "higher" : "lower");
+    
+    for (int round = 0; round < TUNE_MAX_ROUNDS && alive > 1 && running; round++) {
+        int per = samples << round;
+        
+        printf("\nRound %d: %d configurations, %d samples each\n", round + 1, alive, per);
+        for (int c = 0; c < alive && running; c++) {
+            tune_candidate_t *cand = &cands[c];
+            
+            if (prefetch_apply_mask(cand->mask) != SUCCESS) {
+                free(cands);
+                return ERROR_SYSTEM;
+            }
+            for (int w = 0; w < opts->warmup && running; w++) {
+                tune_sample(target);
+            }
+            for (int k = 0; k < per && cand->n < BENCH_MAX_SAMPLES && running; k++) {
+                double value = tune_sample(target);
+                if (value < 0) {
+                    free(cands);
+                    return ERROR_SYSTEM;
+                }
+                cand->samples[cand->n++] = value;
+            }
+            cand->score = tune_score(cand, objective, target->higher_is_better);
+            if (round == 0 && cand->mask == 0) {
+                baseline = cand->score;
+            }
+        }
+        if (!running) {
+            break;
+        }
+        
+        qsort(cands, alive, sizeof(tune_candidate_t), tune_compare);
+        printf("Configuration                        Mask  %12s  Samples\n", target->unit);
+        printf("-----------------------------------  -----  ------------  -------\n");
+        for (int c = 0; c < alive; c++) {
+            printf("%-35s  0x%lX  %12.3f  %7d%s\n",
+                   prefetch_mask_name(cands[c].mask, name, sizeof(name)), cands[c].mask,
+                   cands[c].score, cands[c].n, c < (alive + 1) / 2 ? "" : "  (dropped)");
+        }
+        alive = (alive + 1) / 2;
+    }
+    
+    if (!running) {
+        PRINT_INFO("Tuning interrupted, no profile written");
+        free(cands);
+        return ERROR_SYSTEM;
+    }
+    
+    const tune_candidate_t *best = &cands[0];
+    printf("\n");
+    PRINT_INFO("Best for %s: %s (disable mask 0x%lX), %.3f %s", target->name,
+               prefetch_mask_name(best->mask, name, sizeof(name)), best->mask, best->score, target->unit);
+    if (baseline > 0) {
+        double gain = (best->score - baseline) / baseline * (target->higher_is_better ? 100.0 : -100.0);
+        PRINT_INFO("ALL_ENABLED scored %.3f %s in round 1; best is %+.1f%% better", baseline,
+                   target->unit, gain);
+    }
+    
+    prefetch_profile_t profile = { 0 };
+    char path[256];
+    snprintf(profile.workload, sizeof(profile.workload), "%s", target->name);
+    snprintf(profile.objective, sizeof(profile.objective), "%s", objective == TUNE_P99 ? "p99" : "median");
+    snprintf(profile.unit, sizeof(profile.unit), "%s", target->unit);
+    profile.disable_mask = best->mask;
+    profile.score = best->score;
+    free(cands);
+    
+    if (!profile_path) {
+        tune_profile_path(target->name, path, sizeof(path));
+        profile_path = path;
+    }
+    if (prefetch_profile_save(profile_path, &profile) != SUCCESS) {
+        return ERROR_SYSTEM;
+    }
+    PRINT_INFO("Profile written to %s", profile_path);
+    return SUCCESS;
+}
+
+static double tune_sample(tune_target_t *target) {
+    if (target->kernel) {
+        return target->kernel->run(&target->ctx);
+    }
+    return tune_run_command(target->command);
+}
+
+// Wall time of one run, -1 if it fails; its stdout is discarded. SIGINT
+// reaches the child through the process group, so an interrupt ends both.
+static double tune_run_command(const char *command) {
+    int status;
+    uint64_t start = timing_now_ns();
+    pid_t pid = fork();
+    
+    if (pid < 0) {
+        PRINT_ERROR("fork failed: %s", strerror(errno));
+        return -1.0;
+    }
+    if (pid == 0) {
+        int devnull = open("/dev/null", O_WRONLY);
+        if (devnull >= 0) {
+            dup2(devnull, STDOUT_FILENO);
+            close(devnull);
+        }
+        execl("/bin/sh", "sh", "-c", command, (char *)NULL);
+        _exit(127);
+    }
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            return -1.0;
+        }
+    }
+    uint64_t end = timing_now_ns();
     
-    // Run benchmarks
-    double seq_read = benchmark_sequential_read(data, BENCH_ARRAY_SIZE);
-    double seq_write = benchmark_sequential_write(data, BENCH_ARRAY_SIZE);
-    double rand_read = benchmark_random_read(data, BENCH_ARRAY_SIZE);
-    double stride2_read = benchmark_stride_read(data, BENCH_ARRAY_SIZE, 2);
-    double stride8_read = benchmark_stride_read(data, BENCH_ARRAY_SIZE, 8);
-    double pointer_chase = benchmark_pointer_chase(data, BENCH_ARRAY_SIZE / 2);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        if (running) {
+            PRINT_ERROR("Command failed (status %d): %s", WIFEXITED(status) ? WEXITSTATUS(status) : -1,
+                        command);
+        }
+        return -1.0;
+    }
+    return (double)(end - start) / 1e9;
+}
+
+static double tune_score(const tune_candidate_t *cand, tune_objective_t objective, int higher_is_better) {
+    double sorted[BENCH_MAX_SAMPLES];
+    bench_stats_t stats;
     
-    printf("%-16s %8.1f %8.1f %8.1f %8.1f %8.1f %8.1f\n",
-           config_name, seq_read, seq_write, rand_read, 
-           stride2_read, stride8_read, pointer_chase);
+    if (objective == TUNE_MEDIAN) {
+        bench_compute_stats(cand->samples, cand->n, BENCH_DEFAULT_OUTLIER, &stats);
+        return stats.median;
+    }
+    // The bad tail: slowest runs, or lowest throughput
+    memcpy(sorted, cand->samples, cand->n * sizeof(double));
+    qsort(sorted, cand->n, sizeof(double), compare_sample);
+    return bench_percentile(sorted, cand->n, higher_is_better ? 1.0 : 99.0);
+}
+
+// Best first
+static int tune_compare(const void *a, const void *b) {
+    double sa = ((const tune_candidate_t *)a)->score;
+    double sb = ((const tune_candidate_t *)b)->score;
+    if (sa == sb) {
+        return 0;
+    }
+    return (sa > sb) == g_tune_higher_is_better ? -1 : 1;
+}
+
+static int compare_sample(const void *a, const void *b) {
+    double da = *(const double *)a;
+    double db = *(const double *)b;
+    return (da > db) - (da < db);
+}
+
+// prefetch_<name>.profile with the first word of a command, path stripped
+static void tune_profile_path(const char *name, char *path, size_t len) {
+    char base[64];
+    const char *start = name;
+    size_t n = 0;
     
-    free(data);
+    for (const char *p = name; *p && !isspace((unsigned char)*p); p++) {
+        if (*p == '/') {
+            start = p + 1;
+        }
+    }
+    for (const char *p = start; *p && !isspace((unsigned char)*p) && n < sizeof(base) - 1; p++) {
+        base[n++] = isalnum((unsigned char)*p) || *p == '-' ? *p : '_';
+    }
+    base[n] = '\0';
+    snprintf(path, len, "prefetch_%s.profile", n ? base : "workload");
+}
+
+static int apply_profile(const char *path) {
+    prefetch_profile_t profile;
+    char name[64];
+    
+    if (prefetch_profile_load(path, &profile) != SUCCESS ||
+        prefetch_apply_mask(profile.disable_mask) != SUCCESS) {
+        return ERROR_SYSTEM;
+    }
+    PRINT_INFO("Applied %s for %s: %s (disable mask 0x%lX)", path,
+               profile.workload[0] ? profile.workload : "unnamed workload",
+               prefetch_mask_name(profile.disable_mask, name, sizeof(name)), profile.disable_mask);
+    return SUCCESS;
 }
 
 void print_benchmark_header(void) {
-    PRINT_INFO("Prefetch Configuration Performance Comparison (MB/s):");
-    printf("Configuration    Seq Read Seq Writ Rand Rd  Stride2  Stride8  PtrChase\n");
-    printf("---------------- -------- -------- -------- -------- -------- --------\n");
+    PRINT_INFO("Prefetch Configuration Performance Comparison (median MB/s):");
+    printf("Configuration    Seq Read Seq Writ Rand Rd  Stride2  Stride8  PtrChase Chase ns dTLB mis\n");
+    printf("---------------- -------- -------- -------- -------- -------- -------- -------- --------\n");
 }
 
 void signal_handler(int sig) {
     (void)sig;
     running = 0;
     PRINT_INFO("Received signal, stopping benchmark...");
-}
\ No newline at end of file
+}
+static double kernel_seq_read(void *ctx) {
+    kernel_ctx_t *k = (kernel_ctx_t *)ctx;
+    return benchmark_sequential_read(k->data, k->size);
+}
+
+static double kernel_seq_write(void *ctx) {
+    kernel_ctx_t *k = (kernel_ctx_t *)ctx;
+    return benchmark_sequential_write(k->data, k->size);
+}
+
+static double kernel_rand_read(void *ctx) {
+    kernel_ctx_t *k = (kernel_ctx_t *)ctx;
+    return benchmark_random_read(k->data, k->size);
+}
+
+static double kernel_stride2(void *ctx) {
+    kernel_ctx_t *k = (kernel_ctx_t *)ctx;
+    return benchmark_stride_read(k->data, k->size, 2);
+}
+
+static double kernel_stride8(void *ctx) {
+    kernel_ctx_t *k = (kernel_ctx_t *)ctx;
+    return benchmark_stride_read(k->data, k->size, 8);
+}
+
+static double kernel_ptr_chase(void *ctx) {
+    kernel_ctx_t *k = (kernel_ctx_t *)ctx;
+    double ns_per_access = 0.0;
+    benchmark_pointer_chase(k->data, k->size / 2, &ns_per_access);
+    return ns_per_access;
+}
+
+// data[index[i]]: the index stream is sequential, the gathers are not
+static double kernel_gather(void *ctx) {
+    swpf_ctx_t *k = (swpf_ctx_t *)ctx;
+    const uint64_t *data = k->data;
+    const uint32_t *index = k->index;
+    size_t n = k->ops;
+    size_t d = (size_t)k->distance;
+    uint64_t sum = 0;
+    
+    uint64_t start_time = timing_start();
+    if (d == 0) {
+        for (size_t i = 0; i < n; i++) {
+            sum += data[index[i]];
+        }
+    } else {
+        size_t i = 0;
+        for (; i + d < n; i++) {
+            SWPF_PREFETCH(&data[index[i + d]], k->hint);
+            sum += data[index[i]];
+        }
+        for (; i < n; i++) {
+            sum += data[index[i]];
+        }
+    }
+    uint64_t end_time = timing_stop();
+    
+    g_swpf_sink += sum;
+    return (double)n / timing_ticks_to_sec(end_time - start_time) / 1e6;
+}
+
+static inline size_t swpf_hash(uint64_t key, int bits) {
+    return (size_t)((key * 0x9E3779B97F4A7C15ULL) >> (64 - bits));
+}
+
+// Hash join probe side: hash, then walk the probe sequence to the key
+static double kernel_hash_probe(void *ctx) {
+    swpf_ctx_t *k = (swpf_ctx_t *)ctx;
+    const swpf_bucket_t *table = k->table;
+    const uint64_t *keys = k->keys;
+    size_t mask = k->count - 1;
+    size_t n = k->ops;
+    size_t d = (size_t)k->distance;
+    uint64_t sum = 0;
+    
+    uint64_t start_time = timing_start();
+    for (size_t i = 0; i < n; i++) {
+        if (d && i + d < n) {
+            SWPF_PREFETCH(&table[swpf_hash(keys[i + d], k->table_bits)], k->hint);
+        }
+        size_t b = swpf_hash(keys[i], k->table_bits);
+        while (table[b].key != keys[i] && table[b].key != 0) {
+            b = (b + 1) & mask;
+        }
+        sum += table[b].value;
+    }
+    uint64_t end_time = timing_stop();
+    
+    g_swpf_sink += sum;
+    return (double)n / timing_ticks_to_sec(end_time - start_time) / 1e6;
+}
+
+// Pointer-linked traversal. The next pointer is only known on arrival, so
+// the prefetch address comes from the visit order, as graph code takes it
+// from a CSR neighbour array.
+static double kernel_list_walk(void *ctx) {
+    swpf_ctx_t *k = (swpf_ctx_t *)ctx;
+    const swpf_node_t *nodes = k->nodes;
+    const uint32_t *order = k->index;
+    const swpf_node_t *p = &nodes[order[0]];
+    size_t n = k->count;
+    size_t d = (size_t)k->distance % n;
+    uint64_t sum = 0;
+    
+    uint64_t start_time = timing_start();
+    for (size_t i = 0; i < n; i++) {
+        if (d) {
+            size_t j = i + d < n ? i + d : i + d - n;
+            SWPF_PREFETCH(&nodes[order[j]], k->hint);
+        }
+        sum += p->value;
+        p = p->next;
+    }
+    uint64_t end_time = timing_stop();
+    
+    g_swpf_sink += sum + (uint64_t)(uintptr_t)p;
+    return (double)n / timing_ticks_to_sec(end_time - start_time) / 1e6;
+}
+
+// Build the kernel's data outside the timed region
+static int swpf_setup(const bench_kernel_t *kernel, swpf_ctx_t *ctx) {
+    wl_xorshift_t rng;
+    
+    memset(ctx, 0, sizeof(*ctx));
+    wl_xorshift_seed(&rng, 0x5EED);
+    if (mem_alloc(&ctx->buf, BENCH_ARRAY_SIZE, g_pages, buffer_node(), 0) != SUCCESS) {
+        return ERROR_SYSTEM;
+    }
+    ctx->ops = SWPF_OPS;
+    
+    if (kernel->run == kernel_gather) {
+        ctx->data = (uint64_t *)ctx->buf.addr;
+        ctx->count = BENCH_ARRAY_SIZE / sizeof(uint64_t);
+        ctx->index = malloc(ctx->ops * sizeof(uint32_t));
+        if (!ctx->index) {
+            swpf_teardown(ctx);
+            return ERROR_SYSTEM;
+        }
+        for (size_t i = 0; i < ctx->count; i++) {
+            ctx->data[i] = i;
+        }
+        for (size_t i = 0; i < ctx->ops; i++) {
+            ctx->index[i] = (uint32_t)wl_bounded(wl_xorshift_next(&rng), ctx->count);
+        }
+    } else if (kernel->run == kernel_hash_probe) {
+        // Half full, so probe sequences stay short and the first bucket dominates
+        ctx->table = (swpf_bucket_t *)ctx->buf.addr;
+        ctx->count = BENCH_ARRAY_SIZE / sizeof(swpf_bucket_t);
+        ctx->table_bits = __builtin_ctzll(ctx->count);
+        size_t num_keys = ctx->count / 2;
+        uint64_t *inserted = malloc(num_keys * sizeof(uint64_t));
+        ctx->keys = malloc(ctx->ops * sizeof(uint64_t));
+        if (!inserted || !ctx->keys) {
+            free(inserted);
+            swpf_teardown(ctx);
+            return ERROR_SYSTEM;
+        }
+        for (size_t i = 0; i < num_keys; i++) {
+            uint64_t key = wl_xorshift_next(&rng) | 1;
+            size_t b = swpf_hash(key, ctx->table_bits);
+            while (ctx->table[b].key != 0 && ctx->table[b].key != key) {
+                b = (b + 1) & (ctx->count - 1);
+            }
+            ctx->table[b].key = key;
+            ctx->table[b].value = i;
+            inserted[i] = key;
+        }
+        for (size_t i = 0; i < ctx->ops; i++) {
+            ctx->keys[i] = inserted[wl_bounded(wl_xorshift_next(&rng), num_keys)];
+        }
+        free(inserted);
+    } else {
+        ctx->nodes = (swpf_node_t *)ctx->buf.addr;
+        ctx->count = BENCH_ARRAY_SIZE / sizeof(swpf_node_t);
+        ctx->index = malloc(ctx->count * sizeof(uint32_t));
+        if (!ctx->index) {
+            swpf_teardown(ctx);
+            return ERROR_SYSTEM;
+        }
+        wl_permutation(ctx->index, ctx->count, &rng);
+        for (size_t i = 0; i < ctx->count; i++) {
+            swpf_node_t *node = &ctx->nodes[ctx->index[i]];
+            node->next = &ctx->nodes[ctx->index[(i + 1) % ctx->count]];
+            node->value = i;
+        }
+    }
+    return SUCCESS;
+}
+
+static void swpf_teardown(swpf_ctx_t *ctx) {
+    free(ctx->index);
+    free(ctx->keys);
+    mem_free(&ctx->buf);
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+static int swpf_parse_hint(const char *name, swpf_hint_t *hint) {
+    static const char *names[] = { "t0", "t1", "t2", "nta" };
+    for (int i = 0; i < 4; i++) {
+        if (strcasecmp(name, names[i]) == 0) {
+            *hint = (swpf_hint_t)i;
+            return SUCCESS;
+        }
+    }
+    PRINT_ERROR("Unknown prefetch hint \"%s\" (t0, t1, t2, nta)", name);
+    return ERROR_INVALID_PARAM;
+}
+
+// One table per kernel: a row per distance, a column per hardware state,
+// each cell the median throughput shaded against the kernel's best cell,
+// which is marked with '<'
+static int run_swpf_sweep(const long *distances, int num_distances, swpf_hint_t hint,
+                          const char *heatmap_path) {
+    static const char *hint_names[] = { "t0", "t1", "t2", "nta" };
+    static const char shades[] = " .:-=+*#%@";
+    double cells[SWPF_MAX_DISTANCES][NUM_SWPF_HW];
+    char names[NUM_SWPF_HW][64];
+    FILE *csv = NULL;
+    
+    if (heatmap_path) {
+        csv = fopen(heatmap_path, "w");
+        if (!csv) {
+            PRINT_ERROR("Cannot open %s: %s", heatmap_path, strerror(errno));
+            return ERROR_SYSTEM;
+        }
+        fprintf(csv, "kernel,hint,distance,hw_disable_mask,hw_config,median_mops\n");
+    }
+    for (size_t h = 0; h < NUM_SWPF_HW; h++) {
+        prefetch_mask_name(swpf_hw_masks[h], names[h], sizeof(names[h]));
+    }
+    
+    for (size_t k = 0; k < NUM_SWPF_KERNELS && running; k++) {
+        const bench_kernel_t *kernel = &swpf_kernels[k];
+        swpf_ctx_t ctx;
+        double best = 0.0;
+        int best_d = 0;
+        size_t best_h = 0;
+        
+        if (!bench_kernel_selected(kernel)) {
+            continue;
+        }
+        if (swpf_setup(kernel, &ctx) != SUCCESS) {
+            PRINT_ERROR("Failed to set up %s", kernel->name);
+            if (csv) fclose(csv);
+            return ERROR_SYSTEM;
+        }
+        ctx.hint = hint;
+        
+        // Hardware state outermost: one MSR write per column
+        for (size_t h = 0; h < NUM_SWPF_HW && running; h++) {
+            if (prefetch_apply_mask(swpf_hw_masks[h]) != SUCCESS) {
+                swpf_teardown(&ctx);
+                if (csv) fclose(csv);
+                return ERROR_SYSTEM;
+            }
+            for (int d = 0; d < num_distances && running; d++) {
+                char config[96];
+                bench_stats_t stats;
+                
+                ctx.distance = (int)distances[d];
+                snprintf(config, sizeof(config), "d%ld/%s/%s", distances[d], hint_names[hint], names[h]);
+                bench_run(kernel, &ctx, config, &stats);
+                cells[d][h] = stats.median;
+                if (stats.median > best) {
+                    best = stats.median;
+                    best_d = d;
+                    best_h = h;
+                }
+                if (csv) {
+                    fprintf(csv, "%s,%s,%ld,0x%lx,%s,%.3f\n", kernel->name, hint_names[hint],
+                            distances[d], swpf_hw_masks[h], names[h], stats.median);
+                }
+            }
+        }
+        swpf_teardown(&ctx);
+        if (!running) {
+            break;
+        }
+        
+        printf("\n%s: median %s, software prefetch hint %s\n", kernel->name, kernel->unit,
+               hint_names[hint]);
+        printf("Distance");
+        for (size_t h = 0; h < NUM_SWPF_HW; h++) {
+            printf("  %24s", names[h]);
+        }
+        printf("\n");
+        for (int d = 0; d < num_distances; d++) {
+            if (distances[d] == 0) {
+                printf("%8s", "none");
+            } else {
+                printf("%8ld", distances[d]);
+            }
+            for (size_t h = 0; h < NUM_SWPF_HW; h++) {
+                int level = best > 0 ? (int)(cells[d][h] / best * (sizeof(shades) - 2) + 0.5) : 0;
+                printf("  %21.1f %c%c", cells[d][h], shades[level],
+                       d == best_d && h == best_h ? '<' : ' ');
+            }
+            printf("\n");
+        }
+        
+        // The gain over hardware prefetching alone, at the same hardware state
+        double hw_only = 0.0;
+        for (int d = 0; d < num_distances; d++) {
+            if (distances[d] == 0) {
+                hw_only = cells[d][best_h];
+            }
+        }
+        PRINT_INFO("%s: best distance %ld with %s, %.1f %s%s", kernel->name, distances[best_d],
+                   names[best_h], best, kernel->unit, hw_only > 0 ? "" : " (no distance 0 to compare)");
+        if (hw_only > 0) {
+            PRINT_INFO("%s: software prefetch %+.1f%% over hardware prefetchers alone (%s)",
+                       kernel->name, 100.0 * (best - hw_only) / hw_only, names[best_h]);
+        }
+    }
+    
+    if (csv) {
+        fclose(csv);
+        PRINT_INFO("Heatmap written to %s", heatmap_path);
+    }
+    return running ? SUCCESS : ERROR_SYSTEM;
+}
+
+// Comma-separated integers; with sizes, K/M/G suffixes scale by 1024.
+// Returns the count, or -1 on a malformed or over-long list.
+static int parse_list(const char *list, long *values, int max, int sizes) {
+    int count = 0;
+    const char *p = list;
+    
+    while (*p) {
+        char *end;
+        long value = strtol(p, &end, 10);
+        if (end == p || count == max) {
+            return -1;
+        }
+        if (sizes && (*end == 'K' || *end == 'k')) {
+            value <<= 10;
+            end++;
+        } else if (sizes && (*end == 'M' || *end == 'm')) {
+            value <<= 20;
+            end++;
+        } else if (sizes && (*end == 'G' || *end == 'g')) {
+            value <<= 30;
+            end++;
+        }
+        if (*end && *end != ',') {
+            return -1;
+        }
+        values[count++] = value;
+        p = *end ? end + 1 : end;
+    }
+    return count;
+}
+
+// A chain of dependent loads: the buffer is all zero, and adding each
+// loaded value to the next address serialises the loads, so the time per
+// access is the latency a prefetcher did or did not hide. TSC cycles, or
+// nanoseconds when the TSC is not usable.
+static double kernel_coverage(void *ctx) {
+    cov_ctx_t *c = (cov_ctx_t *)ctx;
+    size_t rounds = COV_ACCESSES / c->streams;
+    uint64_t v = 0;
+    
+    uint64_t start_time = timing_start();
+    for (size_t r = 0; r < rounds; r++) {
+        for (int s = 0; s < c->streams; s++) {
+            v = *(const uint64_t *)(c->base + (size_t)s * c->region + c->offset[s] + v);
+            size_t next = c->offset[s] + (size_t)c->step;
+            if (next >= c->span) {
+                next = c->step > 0 ? next - c->span : next + c->span;
+            }
+            c->offset[s] = next;
+        }
+    }
+    uint64_t end_time = timing_stop();
+    
+    g_swpf_sink += v;
+    double ticks = timing_tsc_usable ? (double)(end_time - start_time) :
+                                       timing_ticks_to_ns(end_time - start_time);
+    return ticks / (double)(rounds * c->streams);
+}
+
+// Lay the streams out for one cell; fails when a stream would make fewer
+// than COV_MIN_STEPS accesses before wrapping
+static int cov_setup(cov_ctx_t *ctx, char *base, long footprint, long stride, int streams) {
+    size_t step = (size_t)labs(stride) * CACHE_LINE_SIZE;
+    
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->base = base;
+    ctx->streams = streams;
+    ctx->region = ((size_t)footprint / streams) & ~(size_t)(CACHE_LINE_SIZE - 1);
+    ctx->step = stride * CACHE_LINE_SIZE;
+    if (ctx->region / step < COV_MIN_STEPS) {
+        return ERROR_INVALID_PARAM;
+    }
+    ctx->span = ctx->region / step * step;
+    for (int s = 0; s < streams; s++) {
+        ctx->offset[s] = stride > 0 ? 0 : ctx->span - step;
+    }
+    return SUCCESS;
+}
+
+// Where a footprint fits, from the topology cache sizes
+static const char *cov_level(long footprint) {
+    const topology_t *topo = topology_get();
+    const topo_cache_t *llc = topo_llc();
+    
+    if (topo && topo->num_l2 > 0 && (size_t)footprint <= topo->l2[0].size_bytes) {
+        return "<=L2";
+    }
+    if (llc && (size_t)footprint <= llc->size_bytes) {
+        return "<=LLC";
+    }
+    return llc ? "DRAM" : "";
+}
+
+// Rows are footprints, columns strides. Against a baseline each cell gets
+// '#' when at least COV_COVERED times faster than with every prefetcher
+// off, '+' when at least 1.25 times; skipped cells print '-'.
+static void cov_print_matrix(const cov_grid_t *grid, const char *title, const double *cells,
+                             const double *baseline) {
+    printf("\n%s: %s per access\n", title, timing_tsc_usable ? "TSC cycles" : "ns");
+    printf("%-15s", "Footprint");
+    for (int j = 0; j < grid->num_strides; j++) {
+        printf(" %6ld ", grid->strides[j]);
+    }
+    printf("\n");
+    
+    for (int f = 0; f < grid->num_footprints; f++) {
+        long fp = grid->footprints[f];
+        char size[24];
+        if (fp >= 1L << 30 && fp % (1L << 30) == 0) {
+            snprintf(size, sizeof(size), "%ldG", fp >> 30);
+        } else if (fp >= 1L << 20 && fp % (1L << 20) == 0) {
+            snprintf(size, sizeof(size), "%ldM", fp >> 20);
+        } else if (fp >= 1L << 10 && fp % (1L << 10) == 0) {
+            snprintf(size, sizeof(size), "%ldK", fp >> 10);
+        } else {
+            snprintf(size, sizeof(size), "%ld", fp);
+        }
+        printf("%6s %-8s", size, cov_level(fp));
+        
+        for (int j = 0; j < grid->num_strides; j++) {
+            double value = cells[f * grid->num_strides + j];
+            if (value <= 0) {
+                printf(" %6s ", "-");
+                continue;
+            }
+            char mark = ' ';
+            if (baseline && baseline[f * grid->num_strides + j] > 0) {
+                double speedup = baseline[f * grid->num_strides + j] / value;
+                mark = speedup >= COV_COVERED ? '#' : speedup >= 1.25 ? '+' : ' ';
+            }
+            printf(" %6.1f%c", value, mark);
+        }
+        printf("\n");
+    }
+    
+    // The largest footprint is the one nothing but a prefetcher can serve
+    if (baseline) {
+        int last = (grid->num_footprints - 1) * grid->num_strides;
+        printf("Strides covered at the largest footprint (>= %.0fx over all off):", COV_COVERED);
+        int any = 0;
+        for (int j = 0; j < grid->num_strides; j++) {
+            if (cells[last + j] > 0 && baseline[last + j] / cells[last + j] >= COV_COVERED) {
+                printf(" %ld", grid->strides[j]);
+                any = 1;
+            }
+        }
+        printf("%s\n", any ? "" : " none");
+    }
+}
+
+// Every prefetcher configuration x stream count x footprint x stride. The
+// prefetcher is outermost so the MSRs change once per configuration.
+static int run_coverage(const cov_grid_t *grid, const char *heatmap_path) {
+    int cells_per_matrix = grid->num_footprints * grid->num_strides;
+    long max_footprint = 0;
+    mem_buffer_t buf;
+    FILE *csv = NULL;
+    int ret = SUCCESS;
+    
+    for (int f = 0; f < grid->num_footprints; f++) {
+        if (grid->footprints[f] > max_footprint) {
+            max_footprint = grid->footprints[f];
+        }
+    }
+    // Zero pages: kernel_coverage relies on every load returning 0
+    if (mem_alloc(&buf, (size_t)max_footprint, g_pages, buffer_node(), 0) != SUCCESS) {
+        PRINT_ERROR("Failed to allocate %ld MB for the coverage map", max_footprint >> 20);
+        return ERROR_SYSTEM;
+    }
+    memset(buf.addr, 0, (size_t)max_footprint);
+    
+    double *cells = calloc((size_t)NUM_COV_CONFIGS * grid->num_streams * cells_per_matrix,
+                           sizeof(double));
+    if (!cells) {
+        mem_free(&buf);
+        return ERROR_SYSTEM;
+    }
+    if (heatmap_path) {
+        csv = fopen(heatmap_path, "w");
+        if (!csv) {
+            PRINT_ERROR("Cannot open %s: %s", heatmap_path, strerror(errno));
+            free(cells);
+            mem_free(&buf);
+            return ERROR_SYSTEM;
+        }
+        fprintf(csv, "config,hw_disable_mask,streams,footprint_bytes,stride_lines,per_access,"
+                "speedup_vs_all_off\n");
+    }
+    if (!timing_tsc_usable) {
+        PRINT_INFO("No invariant TSC: the coverage map is in nanoseconds per access");
+    }
+    PRINT_INFO("Coverage map: %d footprints x %d strides x %d stream counts x %zu configurations",
+               grid->num_footprints, grid->num_strides, grid->num_streams, NUM_COV_CONFIGS);
+    
+    for (size_t c = 0; c < NUM_COV_CONFIGS && running && ret == SUCCESS; c++) {
+        if (prefetch_apply_mask(cov_configs[c].mask) != SUCCESS) {
+            ret = ERROR_SYSTEM;
+            break;
+        }
+        for (int n = 0; n < grid->num_streams && running; n++) {
+            double *matrix = &cells[(c * grid->num_streams + n) * cells_per_matrix];
+            double *baseline = c > 0 ? &cells[n * cells_per_matrix] : NULL;
+            char title[96];
+            
+            for (int f = 0; f < grid->num_footprints && running; f++) {
+                for (int j = 0; j < grid->num_strides && running; j++) {
+                    cov_ctx_t ctx;
+                    bench_stats_t stats;
+                    char config[96];
+                    
+                    if (cov_setup(&ctx, buf.addr, grid->footprints[f], grid->strides[j],
+                                  (int)grid->streams[n]) != SUCCESS) {
+                        continue;
+                    }
+                    snprintf(config, sizeof(config), "s%ld/f%ld/x%ld/0x%lx", grid->strides[j],
+                             grid->footprints[f], grid->streams[n], cov_configs[c].mask);
+                    bench_run(&coverage_kernel, &ctx, config, &stats);
+                    matrix[f * grid->num_strides + j] = stats.median;
+                    if (csv) {
+                        double base = baseline ? baseline[f * grid->num_strides + j] : stats.median;
+                        fprintf(csv, "%s,0x%lx,%ld,%ld,%ld,%.2f,%.3f\n", cov_configs[c].label,
+                                cov_configs[c].mask, grid->streams[n], grid->footprints[f],
+                                grid->strides[j], stats.median, base / stats.median);
+                    }
+                }
+            }
+            if (running) {
+                snprintf(title, sizeof(title), "%s, %ld stream%s", cov_configs[c].label,
+                         grid->streams[n], grid->streams[n] == 1 ? "" : "s");
+                cov_print_matrix(grid, title, matrix, baseline);
+            }
+        }
+    }
+    
+    if (csv) {
+        fclose(csv);
+        if (ret == SUCCESS && running) {
+            PRINT_INFO("Coverage map written to %s", heatmap_path);
+        }
+    }
+    free(cells);
+    mem_free(&buf);
+    return ret == SUCCESS && running ? SUCCESS : ERROR_SYSTEM;
+}
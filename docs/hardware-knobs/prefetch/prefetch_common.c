@@ -1,5 +1,11 @@
 #include "prefetch_common.h"
 
+// Function declarations
+static int prefetch_core_cpu(int core);
+
+static uint64_t *g_snapshot = NULL;     // MSR 0x1A4 per core
+static int g_snapshot_cores = 0;
+
 int prefetch_check_support(void) {
     // Check if we're running on Intel CPU
     char vendor[64];
@@ -46,9 +52,11 @@ int prefetch_read_config(uint64_t *config) {
 }
 
 int prefetch_write_config(uint64_t config) {
-    // Write to all CPUs
-    int cpu_count = get_cpu_count();
-    for (int cpu = 0; cpu < cpu_count; cpu++) {
+    // Prefetch control is per core and shared by SMT siblings; write each core once
+    const topology_t *topo = topology_get();
+    int num_cores = topo ? topo->num_cores : get_cpu_count();
+    for (int core = 0; core < num_cores; core++) {
+        int cpu = topo ? topo->cores[core].first_cpu : core;
         // Try modern MSR first
         if (msr_write_cpu(cpu, MSR_MISC_FEATURES_ENABLES, config) != SUCCESS) {
             // Fall back to older MSR
@@ -60,4 +68,241 @@ int prefetch_write_config(uint64_t config) {
     }
     
     return SUCCESS;
-}
\ No newline at end of file
+}
+
+int prefetch_num_cores(void) {
+    const topology_t *topo = topology_get();
+    return topo ? topo->num_cores : get_cpu_count();
+}
+
+static int prefetch_core_cpu(int core) {
+    const topology_t *topo = topology_get();
+    return topo ? topo->cores[core].first_cpu : core;
+}
+
+// Core index of a CPU; without a topology every CPU counts as its own core
+int prefetch_cpu_core(int cpu) {
+    const topology_t *topo = topology_get();
+    if (!topo) {
+        return cpu < get_cpu_count() ? cpu : -1;
+    }
+    if (cpu < 0 || cpu >= topo->max_cpus || !topo->cpus[cpu].online) {
+        return -1;
+    }
+    return topo->cpus[cpu].core;
+}
+
+int prefetch_core_read(int core, uint64_t *disable_mask) {
+    uint64_t value;
+    if (core < 0 || core >= prefetch_num_cores()) {
+        return ERROR_INVALID_PARAM;
+    }
+    if (msr_read_cpu(prefetch_core_cpu(core), MSR_MISC_FEATURE_CONTROL, &value) != SUCCESS) {
+        return ERROR_SYSTEM;
+    }
+    *disable_mask = value & PREFETCH_DISABLE_MASK;
+    return SUCCESS;
+}
+
+int prefetch_core_apply(int core, uint64_t disable_mask) {
+    uint64_t value;
+    if (core < 0 || core >= prefetch_num_cores() || (disable_mask & ~PREFETCH_DISABLE_MASK)) {
+        return ERROR_INVALID_PARAM;
+    }
+    
+    int cpu = prefetch_core_cpu(core);
+    if (msr_read_cpu(cpu, MSR_MISC_FEATURE_CONTROL, &value) != SUCCESS ||
+        msr_write_cpu(cpu, MSR_MISC_FEATURE_CONTROL,
+                      (value & ~PREFETCH_DISABLE_MASK) | disable_mask) != SUCCESS) {
+        PRINT_ERROR("Failed to set prefetchers on CPU %d", cpu);
+        return ERROR_SYSTEM;
+    }
+    return SUCCESS;
+}
+
+int prefetch_apply_mask(uint64_t disable_mask) {
+    for (int core = 0; core < prefetch_num_cores(); core++) {
+        int ret = prefetch_core_apply(core, disable_mask);
+        if (ret != SUCCESS) {
+            return ret;
+        }
+    }
+    return SUCCESS;
+}
+
+int prefetch_apply_cpu(int cpu, uint64_t disable_mask) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return prefetch_apply_cpuset(&set, disable_mask);
+}
+
+int prefetch_apply_cpuset(const cpu_set_t *cpus, uint64_t disable_mask) {
+    const topology_t *topo = topology_get();
+    int num_cores = prefetch_num_cores();
+    int applied = 0;
+    
+    if (disable_mask & ~PREFETCH_DISABLE_MASK) {
+        return ERROR_INVALID_PARAM;
+    }
+    char *done = calloc(num_cores, 1);
+    if (!done) {
+        return ERROR_SYSTEM;
+    }
+    
+    TOPO_FOR_EACH_CPU(cpu, cpus, CPU_SETSIZE) {
+        int core = prefetch_cpu_core(cpu);
+        if (core < 0) {
+            PRINT_ERROR("CPU %d is not online", cpu);
+            free(done);
+            return ERROR_INVALID_PARAM;
+        }
+        if (done[core]) {
+            continue;
+        }
+        done[core] = 1;
+        
+        // The sibling shares the MSR whether or not it is in the set
+        if (topo) {
+            TOPO_FOR_EACH_CPU(sibling, &topo->cores[core].cpus, topo->max_cpus) {
+                if (!CPU_ISSET(sibling, cpus)) {
+                    PRINT_INFO("CPU %d shares core %d with CPU %d; its prefetchers change too",
+                               sibling, core, cpu);
+                }
+            }
+        }
+        if (prefetch_core_apply(core, disable_mask) != SUCCESS) {
+            free(done);
+            return ERROR_SYSTEM;
+        }
+        applied++;
+    }
+    
+    free(done);
+    return applied ? SUCCESS : ERROR_INVALID_PARAM;
+}
+
+// "ALL_ENABLED", "ALL_DISABLED" or the disabled prefetchers, e.g. "L2_HW+DCU_IP_DISABLED"
+const char *prefetch_mask_name(uint64_t disable_mask, char *buf, size_t len) {
+    static const char *names[] = { "L2_HW", "L2_ADJ", "DCU_STREAM", "DCU_IP" };
+    size_t used = 0;
+    
+    disable_mask &= PREFETCH_DISABLE_MASK;
+    if (disable_mask == 0 || disable_mask == PREFETCH_DISABLE_MASK) {
+        snprintf(buf, len, "%s", disable_mask ? "ALL_DISABLED" : "ALL_ENABLED");
+        return buf;
+    }
+    buf[0] = '\0';
+    for (int bit = 0; bit < 4; bit++) {
+        if ((disable_mask & (1ULL << bit)) && used < len) {
+            used += snprintf(buf + used, len - used, "%s%s", used ? "+" : "", names[bit]);
+        }
+    }
+    if (used < len) {
+        snprintf(buf + used, len - used, "_DISABLED");
+    }
+    return buf;
+}
+
+int prefetch_snapshot_take(void) {
+    int num_cores = prefetch_num_cores();
+    
+    free(g_snapshot);
+    g_snapshot_cores = 0;
+    g_snapshot = calloc(num_cores, sizeof(uint64_t));
+    if (!g_snapshot) {
+        return ERROR_SYSTEM;
+    }
+    for (int core = 0; core < num_cores; core++) {
+        if (msr_read_cpu(prefetch_core_cpu(core), MSR_MISC_FEATURE_CONTROL, &g_snapshot[core]) != SUCCESS) {
+            PRINT_ERROR("Failed to snapshot prefetch control of CPU %d", prefetch_core_cpu(core));
+            free(g_snapshot);
+            g_snapshot = NULL;
+            return ERROR_SYSTEM;
+        }
+    }
+    g_snapshot_cores = num_cores;
+    atexit(prefetch_snapshot_restore);
+    return SUCCESS;
+}
+
+// Disable bits a core had when the snapshot was taken
+int prefetch_snapshot_core(int core, uint64_t *disable_mask) {
+    if (!g_snapshot || core < 0 || core >= g_snapshot_cores) {
+        return ERROR_INVALID_PARAM;
+    }
+    *disable_mask = g_snapshot[core] & PREFETCH_DISABLE_MASK;
+    return SUCCESS;
+}
+
+void prefetch_snapshot_restore(void) {
+    if (!g_snapshot) {
+        return;
+    }
+    for (int core = 0; core < g_snapshot_cores; core++) {
+        if (msr_write_cpu(prefetch_core_cpu(core), MSR_MISC_FEATURE_CONTROL, g_snapshot[core]) != SUCCESS) {
+            PRINT_ERROR("Failed to restore prefetch control of CPU %d", prefetch_core_cpu(core));
+        }
+    }
+    free(g_snapshot);
+    g_snapshot = NULL;
+    g_snapshot_cores = 0;
+}
+
+int prefetch_profile_save(const char *path, const prefetch_profile_t *profile) {
+    char name[64];
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        PRINT_ERROR("Cannot write profile %s: %s", path, strerror(errno));
+        return ERROR_SYSTEM;
+    }
+    fprintf(fp, "# Prefetcher profile: apply disable_mask to bits 3:0 of MSR 0x%X on every core\n",
+            MSR_MISC_FEATURE_CONTROL);
+    fprintf(fp, "workload=%s\n", profile->workload);
+    fprintf(fp, "disable_mask=0x%lx\n", profile->disable_mask);
+    fprintf(fp, "config=%s\n", prefetch_mask_name(profile->disable_mask, name, sizeof(name)));
+    fprintf(fp, "objective=%s\n", profile->objective);
+    fprintf(fp, "score=%.4f\n", profile->score);
+    fprintf(fp, "unit=%s\n", profile->unit);
+    fclose(fp);
+    return SUCCESS;
+}
+
+int prefetch_profile_load(const char *path, prefetch_profile_t *profile) {
+    char line[256];
+    int have_mask = 0;
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        PRINT_ERROR("Cannot read profile %s: %s", path, strerror(errno));
+        return ERROR_SYSTEM;
+    }
+    
+    memset(profile, 0, sizeof(*profile));
+    while (fgets(line, sizeof(line), fp)) {
+        char *value = strchr(line, '=');
+        if (line[0] == '#' || !value) {
+            continue;
+        }
+        *value++ = '\0';
+        value[strcspn(value, "\r\n")] = '\0';
+        if (strcmp(line, "workload") == 0) {
+            snprintf(profile->workload, sizeof(profile->workload), "%s", value);
+        } else if (strcmp(line, "disable_mask") == 0) {
+            profile->disable_mask = strtoull(value, NULL, 0);
+            have_mask = 1;
+        } else if (strcmp(line, "objective") == 0) {
+            snprintf(profile->objective, sizeof(profile->objective), "%s", value);
+        } else if (strcmp(line, "score") == 0) {
+            profile->score = atof(value);
+        } else if (strcmp(line, "unit") == 0) {
+            snprintf(profile->unit, sizeof(profile->unit), "%s", value);
+        }
+    }
+    fclose(fp);
+    
+    if (!have_mask || (profile->disable_mask & ~PREFETCH_DISABLE_MASK)) {
+        PRINT_ERROR("Profile %s has no valid disable_mask", path);
+        return ERROR_INVALID_PARAM;
+    }
+    return SUCCESS;
+}
@@ -3,6 +3,8 @@
 
 #include "../common/common.h"
 #include "../common/msr_utils.h"
+#include "../common/topology.h"
+#include <sched.h>
 
 // Intel prefetch control MSR definitions
 #define MSR_MISC_FEATURES_ENABLES   0x140
@@ -12,10 +14,44 @@
 #define PREFETCH_L2_STREAM_ADJ_DISABLE  (1ULL << 1)
 #define PREFETCH_DCU_STREAM_DISABLE     (1ULL << 2)
 #define PREFETCH_DCU_IP_DISABLE         (1ULL << 3)
+#define PREFETCH_DISABLE_MASK           0xFULL
+#define PREFETCH_NUM_CONFIGS            16      // Every combination of the four bits
+
+// Per-workload profile written by the auto-tuner: key=value lines, '#'
+// comments. A daemon applies disable_mask to MSR 0x1A4 when the workload runs.
+typedef struct {
+    char workload[128];
+    uint64_t disable_mask;
+    char objective[16];
+    double score;
+    char unit[16];
+} prefetch_profile_t;
 
 // Shared function declarations
 int prefetch_check_support(void);
 int prefetch_read_config(uint64_t *config);
 int prefetch_write_config(uint64_t config);
 
+// Read-modify-write of bits 3:0 of MSR 0x1A4 on every core, keeping the rest
+int prefetch_apply_mask(uint64_t disable_mask);
+
+// Per-core control. MSR 0x1A4 is per physical core and shared by its SMT
+// siblings, so a CPU or cpuset is widened to whole cores; siblings outside
+// the set change with it and are reported. core indexes topology cores.
+int prefetch_num_cores(void);
+int prefetch_cpu_core(int cpu);
+int prefetch_core_read(int core, uint64_t *disable_mask);
+int prefetch_core_apply(int core, uint64_t disable_mask);
+int prefetch_apply_cpu(int cpu, uint64_t disable_mask);
+int prefetch_apply_cpuset(const cpu_set_t *cpus, uint64_t disable_mask);
+const char *prefetch_mask_name(uint64_t disable_mask, char *buf, size_t len);
+
+// Per-core copy of MSR 0x1A4; restore is idempotent and also runs at exit
+int prefetch_snapshot_take(void);
+void prefetch_snapshot_restore(void);
+int prefetch_snapshot_core(int core, uint64_t *disable_mask);
+
+int prefetch_profile_save(const char *path, const prefetch_profile_t *profile);
+int prefetch_profile_load(const char *path, prefetch_profile_t *profile);
+
 #endif /* PREFETCH_COMMON_H */
\ No newline at end of file
@@ -0,0 +1,335 @@
+#include "prefetch_common.h"
+#include "../common/timing.h"
+#include <signal.h>
+
+// Per-core prefetcher control. One-shot mode sets the prefetchers of a
+// cpuset; sync mode follows the cpusets of cgroups and keeps every core
+// at the configuration of the workload allowed to run on it, so a
+// streaming job and a pointer-chasing service on one socket each get
+// their own setting. Cores outside every mapping keep the setting they
+// had at start, and all cores are restored on exit.
+
+#define PREFETCH_CTL_MAX_MAPS       32
+#define PREFETCH_CTL_INTERVAL_MS    500
+#define PREFETCH_CGROUP_ROOT        "/sys/fs/cgroup"
+
+// A cpuset (--set) or cgroup (--cgroup) and the disable mask it gets
+typedef struct {
+    char cgroup[320];           // Empty for a fixed cpuset
+    cpu_set_t cpus;
+    uint64_t disable_mask;
+    char source[128];           // Profile path or mask, for the log
+    int missing;                // cgroup unreadable last time, warned once
+} prefetch_map_t;
+
+static volatile int g_running = 1;
+static prefetch_map_t g_maps[PREFETCH_CTL_MAX_MAPS];
+static int g_num_maps = 0;
+
+// Function declarations
+void signal_handler(int sig);
+static void print_usage(const char *prog);
+static int parse_map(const char *spec, int is_cgroup);
+static int parse_config(const char *text, uint64_t *disable_mask);
+static int read_cgroup_cpus(prefetch_map_t *map, cpu_set_t *cpus);
+static int sync_cores(uint64_t *current, int verbose);
+static void show_cores(void);
+
+int main(int argc, char *argv[]) {
+    int interval_ms = PREFETCH_CTL_INTERVAL_MS;
+    int duration = 0;
+    int show = 0;
+    int sync = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--set") == 0 && i + 1 < argc) {
+            if (parse_map(argv[++i], 0) != SUCCESS) {
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--cgroup") == 0 && i + 1 < argc) {
+            if (parse_map(argv[++i], 1) != SUCCESS) {
+                return EXIT_FAILURE;
+            }
+            sync = 1;
+        } else if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc) {
+            interval_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--duration") == 0 && i + 1 < argc) {
+            duration = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--show") == 0) {
+            show = 1;
+        } else {
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if ((g_num_maps == 0 && !show) || interval_ms < 10 || duration < 0) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (check_root_permission() != SUCCESS || prefetch_check_support() != SUCCESS) {
+        return EXIT_FAILURE;
+    }
+
+    // One-shot: every --set is applied in order and left in place
+    if (!sync) {
+        for (int m = 0; m < g_num_maps; m++) {
+            char name[64];
+            if (prefetch_apply_cpuset(&g_maps[m].cpus, g_maps[m].disable_mask) != SUCCESS) {
+                PRINT_ERROR("Failed to apply %s", g_maps[m].source);
+                return EXIT_FAILURE;
+            }
+            PRINT_INFO("%s applied: %s", g_maps[m].source,
+                       prefetch_mask_name(g_maps[m].disable_mask, name, sizeof(name)));
+        }
+        if (show) {
+            show_cores();
+        }
+        return EXIT_SUCCESS;
+    }
+
+    int num_cores = prefetch_num_cores();
+    uint64_t *current = calloc(num_cores, sizeof(uint64_t));
+    if (!current || prefetch_snapshot_take() != SUCCESS) {
+        free(current);
+        return EXIT_FAILURE;
+    }
+    for (int core = 0; core < num_cores; core++) {
+        prefetch_snapshot_core(core, &current[core]);
+    }
+
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+
+    PRINT_INFO("Syncing %d cores with %d mappings every %d ms%s", num_cores, g_num_maps, interval_ms,
+               duration ? "" : " until interrupted");
+    uint64_t start_ns = timing_now_ns();
+    uint64_t next_ns = start_ns;
+    int changes = 0;
+    while (g_running) {
+        int ret = sync_cores(current, show);
+        if (ret < 0) {
+            break;
+        }
+        changes += ret;
+
+        next_ns += (uint64_t)interval_ms * 1000000ULL;
+        if (duration && next_ns - start_ns >= (uint64_t)duration * 1000000000ULL) {
+            break;
+        }
+        uint64_t now_ns = timing_now_ns();
+        if (next_ns > now_ns) {
+            struct timespec ts = { (time_t)((next_ns - now_ns) / 1000000000ULL),
+                                   (long)((next_ns - now_ns) % 1000000000ULL) };
+            nanosleep(&ts, NULL);
+        }
+    }
+
+    PRINT_INFO("%d core reconfigurations; restoring the original settings", changes);
+    prefetch_snapshot_restore();
+    free(current);
+    return EXIT_SUCCESS;
+}
+
+void signal_handler(int sig) {
+    (void)sig;
+    g_running = 0;
+}
+
+static void print_usage(const char *prog) {
+    printf("Usage: %s --set CPULIST:CONFIG [--set ...] [--show]\n", prog);
+    printf("       %s --cgroup PATH:CONFIG [--cgroup ...] [--interval MS] [--duration SEC] [--show]\n",
+           prog);
+    printf("       %s --show\n", prog);
+    printf("  CONFIG is a disable mask for bits 3:0 of MSR 0x%X (0x0 = all prefetchers on)\n",
+           MSR_MISC_FEATURE_CONTROL);
+    printf("  or a profile written by prefetch_bench --tune\n");
+    printf("  --set CPULIST:CONFIG  Set the cores of CPULIST and exit; SMT siblings follow.\n"
+           "                        With --cgroup, a fixed mapping kept in sync alongside\n");
+    printf("  --cgroup PATH:CONFIG  Keep the cores in the cgroup's effective cpuset (relative to %s)\n"
+           "                        at CONFIG; rescanned every interval, restored on exit\n",
+           PREFETCH_CGROUP_ROOT);
+    printf("  --interval MS         Sync period (default %d)\n", PREFETCH_CTL_INTERVAL_MS);
+    printf("  --duration SEC        Stop after SEC seconds (default: until SIGINT/SIGTERM)\n");
+    printf("  --show                Print every core's setting (sync: log each change per core)\n");
+    printf("Cores claimed by mappings with different configs keep a prefetcher enabled if\n"
+           "any of them wants it.\n");
+}
+
+// The last ':' separates the target from the config, so paths may contain one
+static int parse_map(const char *spec, int is_cgroup) {
+    char target[256];
+    const char *sep = strrchr(spec, ':');
+
+    if (g_num_maps == PREFETCH_CTL_MAX_MAPS) {
+        PRINT_ERROR("At most %d mappings", PREFETCH_CTL_MAX_MAPS);
+        return ERROR_INVALID_PARAM;
+    }
+    if (!sep || sep == spec || (size_t)(sep - spec) >= sizeof(target)) {
+        PRINT_ERROR("Invalid mapping \"%s\" (%s:CONFIG)", spec, is_cgroup ? "PATH" : "CPULIST");
+        return ERROR_INVALID_PARAM;
+    }
+    memcpy(target, spec, sep - spec);
+    target[sep - spec] = '\0';
+
+    prefetch_map_t *map = &g_maps[g_num_maps];
+    memset(map, 0, sizeof(*map));
+    if (parse_config(sep + 1, &map->disable_mask) != SUCCESS) {
+        return ERROR_INVALID_PARAM;
+    }
+    if (is_cgroup) {
+        if (target[0] == '/' && strncmp(target, PREFETCH_CGROUP_ROOT, strlen(PREFETCH_CGROUP_ROOT)) == 0) {
+            snprintf(map->cgroup, sizeof(map->cgroup), "%s", target);
+        } else {
+            snprintf(map->cgroup, sizeof(map->cgroup), "%s/%s", PREFETCH_CGROUP_ROOT,
+                     target[0] == '/' ? target + 1 : target);
+        }
+    } else if (topo_parse_cpulist(target, &map->cpus) <= 0) {
+        PRINT_ERROR("Invalid CPU list \"%s\"", target);
+        return ERROR_INVALID_PARAM;
+    }
+    snprintf(map->source, sizeof(map->source), "%s", spec);
+    g_num_maps++;
+    return SUCCESS;
+}
+
+// A number is a disable mask, anything else a profile file
+static int parse_config(const char *text, uint64_t *disable_mask) {
+    char *end;
+    prefetch_profile_t profile;
+
+    errno = 0;
+    unsigned long long value = strtoull(text, &end, 0);
+    if (*text && *end == '\0' && errno == 0) {
+        if (value & ~PREFETCH_DISABLE_MASK) {
+            PRINT_ERROR("Disable mask 0x%llx has bits outside 3:0", value);
+            return ERROR_INVALID_PARAM;
+        }
+        *disable_mask = value;
+        return SUCCESS;
+    }
+    if (prefetch_profile_load(text, &profile) != SUCCESS) {
+        return ERROR_INVALID_PARAM;
+    }
+    *disable_mask = profile.disable_mask;
+    return SUCCESS;
+}
+
+// cgroup v2 cpuset.cpus.effective, or the v1 cpuset controller's file
+static int read_cgroup_cpus(prefetch_map_t *map, cpu_set_t *cpus) {
+    static const char *files[] = { "cpuset.cpus.effective", "cpuset.effective_cpus" };
+    char path[384];
+    char list[4096];
+
+    for (size_t i = 0; i < sizeof(files) / sizeof(files[0]); i++) {
+        snprintf(path, sizeof(path), "%s/%s", map->cgroup, files[i]);
+        if (check_file_exists(path) == SUCCESS && read_file_str(path, list, sizeof(list)) == SUCCESS) {
+            list[strcspn(list, "\n")] = '\0';
+            CPU_ZERO(cpus);
+            if (list[0] && topo_parse_cpulist(list, cpus) < 0) {
+                break;
+            }
+            if (map->missing) {
+                PRINT_INFO("cgroup %s is readable again", map->cgroup);
+                map->missing = 0;
+            }
+            return SUCCESS;
+        }
+    }
+    if (!map->missing) {
+        PRINT_INFO("Cannot read the cpuset of %s; its cores fall back to their original setting",
+                   map->cgroup);
+        map->missing = 1;
+    }
+    return ERROR_SYSTEM;
+}
+
+// One pass: the wanted mask of every core from the current cpusets, then
+// MSR writes for the cores that differ. Returns the number of cores
+// changed, or -1 on a write failure.
+static int sync_cores(uint64_t *current, int verbose) {
+    int num_cores = prefetch_num_cores();
+    uint64_t *want = calloc(num_cores, sizeof(uint64_t));
+    int *want_owner = calloc(num_cores, sizeof(int));
+    int changed = 0;
+
+    if (!want || !want_owner) {
+        free(want);
+        free(want_owner);
+        return -1;
+    }
+    for (int core = 0; core < num_cores; core++) {
+        prefetch_snapshot_core(core, &want[core]);
+        want_owner[core] = -1;
+    }
+
+    for (int m = 0; m < g_num_maps; m++) {
+        cpu_set_t cpus = g_maps[m].cpus;
+        if (g_maps[m].cgroup[0] && read_cgroup_cpus(&g_maps[m], &cpus) != SUCCESS) {
+            continue;
+        }
+        TOPO_FOR_EACH_CPU(cpu, &cpus, CPU_SETSIZE) {
+            int core = prefetch_cpu_core(cpu);
+            if (core < 0) {
+                continue;
+            }
+            if (want_owner[core] < 0) {
+                want[core] = g_maps[m].disable_mask;
+                want_owner[core] = m;
+            } else if (want_owner[core] != m) {
+                // Shared core: a prefetcher stays on if any sharer wants it
+                want[core] &= g_maps[m].disable_mask;
+            }
+        }
+    }
+
+    for (int core = 0; core < num_cores; core++) {
+        char name[64];
+        if (want[core] == current[core]) {
+            continue;
+        }
+        if (prefetch_core_apply(core, want[core]) != SUCCESS) {
+            changed = -1;
+            break;
+        }
+        if (verbose) {
+            PRINT_INFO("Core %d (CPU %d): %s (%s)", core, topo_core_first_cpu(core),
+                       prefetch_mask_name(want[core], name, sizeof(name)),
+                       want_owner[core] >= 0 ? g_maps[want_owner[core]].source : "original setting");
+        }
+        current[core] = want[core];
+        changed++;
+    }
+
+    free(want);
+    free(want_owner);
+    return changed;
+}
+
+static void show_cores(void) {
+    const topology_t *topo = topology_get();
+
+    printf("Core  CPUs              Disabled prefetchers\n");
+    printf("----  ----------------  --------------------\n");
+    for (int core = 0; core < prefetch_num_cores(); core++) {
+        char cpus[64] = "";
+        char name[64];
+        uint64_t mask;
+        size_t len = 0;
+
+        if (topo) {
+            TOPO_FOR_EACH_CPU(cpu, &topo->cores[core].cpus, topo->max_cpus) {
+                if (len < sizeof(cpus)) {
+                    len += snprintf(cpus + len, sizeof(cpus) - len, "%s%d", len ? "," : "", cpu);
+                }
+            }
+        } else {
+            snprintf(cpus, sizeof(cpus), "%d", core);
+        }
+        if (prefetch_core_read(core, &mask) != SUCCESS) {
+            printf("%4d  %-16s  (unreadable)\n", core, cpus);
+            continue;
+        }
+        printf("%4d  %-16s  %s\n", core, cpus, prefetch_mask_name(mask, name, sizeof(name)));
+    }
+}
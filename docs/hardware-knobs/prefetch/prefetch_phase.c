@@ -0,0 +1,623 @@
+#include "prefetch_common.h"
+#include "../common/timing.h"
+#include "../common/perf_events.h"
+#include "../common/mem_alloc.h"
+#include "../common/workload.h"
+#include <math.h>
+#include <pthread.h>
+#include <signal.h>
+
+// Phase-aware prefetcher switching. Every interval the controller reads
+// per-core PMU counts (L2 prefetch requests, prefetched lines evicted
+// unused, L2 references and misses, LLC misses) and turns the L2 streamer
+// and adjacent-line prefetcher off when the useful-prefetch ratio stays
+// below a threshold. While they are off nothing measures their value, so
+// the controller re-enables them for a probe interval periodically, or
+// early when the LLC miss rate moves away from where it was at switch-off
+// (a phase change), and keeps them on only if the probe clears the upper
+// threshold. The gap between the two thresholds is the hysteresis.
+//
+// The built-in workload alternates sequential scans and random lookups
+// over one buffer per worker. Each run compares static all-on, static
+// L2-prefetchers-off and the controller on the same workload.
+
+#define PHASE_INTERVAL_MS       5
+#define PHASE_DURATION          5       // Seconds per mode
+#define PHASE_LEN_MS            200     // Length of each scan or lookup phase
+#define PHASE_WSS_MB            256
+#define PHASE_OFF_BELOW         0.35    // Useful ratio that turns the prefetchers off...
+#define PHASE_ON_ABOVE          0.60    // ...and the ratio a probe needs to keep them on
+#define PHASE_HOLD              3       // Consecutive low intervals before switching off
+#define PHASE_PROBE_EVERY       40      // Intervals off before a periodic probe
+#define PHASE_SHIFT             0.5     // Relative LLC miss rate change that probes early
+#define PHASE_MIN_PF            1000    // Prefetch requests an interval needs to be judged
+#define PHASE_MAX_WORKERS       64
+#define PHASE_MAX_SIBLINGS      8       // Listed CPUs of one core with counters
+
+// The prefetchers the controller switches; the DCU bits stay as found
+#define PHASE_TOGGLE_BITS       (PREFETCH_L2_STREAM_HW_DISABLE | PREFETCH_L2_STREAM_ADJ_DISABLE)
+
+// Raw encodings (umask << 8 | event) for Skylake through Sapphire Rapids
+// cores; other parts pass their own with --pf-event / --useless-event
+#define PHASE_EVT_L2_ALL_PF         0xF824  // L2_RQSTS.ALL_PF
+#define PHASE_EVT_L2_USELESS_HWPF   0x04F2  // L2_LINES_OUT.USELESS_HWPF
+#define PHASE_EVT_L2_REFERENCES     0xFF24  // L2_RQSTS.REFERENCES
+#define PHASE_EVT_L2_MISS           0x3F24  // L2_RQSTS.MISS
+
+typedef enum {
+    PHASE_MODE_STATIC_ON,
+    PHASE_MODE_STATIC_OFF,
+    PHASE_MODE_ADAPTIVE,
+    PHASE_NUM_MODES
+} phase_mode_t;
+
+typedef struct {
+    double off_below;
+    double on_above;
+    int hold;
+    int probe_every;
+    double shift;
+    uint64_t pf_event;
+    uint64_t useless_event;
+} phase_params_t;
+
+// Counter deltas of one core over one interval
+typedef struct {
+    uint64_t pf;
+    uint64_t useless;
+    uint64_t l2_ref;
+    uint64_t l2_miss;
+    uint64_t llc_miss;
+    double dt;
+} phase_sample_t;
+
+// The L2 events count per hardware thread
+typedef struct {
+    int cpu;
+    perf_counter_t pf, useless, l2_ref, l2_miss, llc_miss;
+} phase_counters_t;
+
+typedef struct {
+    int core;
+    int num_cpus;               // Listed CPUs of the core, summed per interval
+    phase_counters_t ctr[PHASE_MAX_SIBLINGS];
+    uint64_t base_mask;         // Snapshot bits outside PHASE_TOGGLE_BITS
+
+    // Controller state
+    int enabled;
+    int low_count;
+    int probing;
+    int since_off;
+    double off_rate;            // LLC misses/s when switched off
+
+    // Totals of the current mode
+    phase_sample_t total;
+    int toggles;
+    int intervals_on;
+    int intervals;
+} phase_core_t;
+
+typedef struct {
+    int cpu;
+    size_t wss;
+    mem_buffer_t buf;
+    volatile int ready;         // 1 once the buffer is in place, -1 on failure
+    volatile uint64_t scan_lines;
+    volatile uint64_t lookup_lines;
+} phase_worker_t;
+
+typedef struct {
+    double scan_mlps;           // Million lines/s summed over workers
+    double lookup_mlps;
+    double llc_gbps;            // LLC miss bandwidth of the controlled cores
+    double l2_hit;
+    double useful;
+    double on_share;
+    int toggles;
+} phase_result_t;
+
+static volatile int g_running = 1;
+static volatile int g_workers_run = 0;
+static int g_phase_ms = PHASE_LEN_MS;
+static phase_core_t g_cores[PHASE_MAX_WORKERS];
+static int g_num_cores = 0;
+static phase_worker_t g_workers[PHASE_MAX_WORKERS];
+static int g_num_workers = 0;
+static FILE *g_log = NULL;
+static volatile uint64_t g_sink;        // Keeps the worker loads live
+
+static const char *mode_names[PHASE_NUM_MODES] = { "static-on", "static-off", "adaptive" };
+
+// Function declarations
+void signal_handler(int sig);
+static void print_usage(const char *prog);
+static void *phase_worker(void *arg);
+static int open_cpu_counters(phase_counters_t *ctr, const phase_params_t *params);
+static int open_core_counters(phase_core_t *c, const phase_params_t *params);
+static void close_cpu_counters(phase_counters_t *ctr);
+static void close_core_counters(phase_core_t *c);
+static int read_core_sample(phase_core_t *c, phase_sample_t *s);
+static int set_core_enabled(phase_core_t *c, int enabled);
+static int phase_decide(phase_core_t *c, const phase_sample_t *s, const phase_params_t *params);
+static int run_mode(phase_mode_t mode, const phase_params_t *params, int duration, int interval_ms,
+                    phase_result_t *result);
+static void print_results(const phase_result_t *results);
+
+int main(int argc, char *argv[]) {
+    phase_params_t params = {
+        PHASE_OFF_BELOW, PHASE_ON_ABOVE, PHASE_HOLD, PHASE_PROBE_EVERY, PHASE_SHIFT,
+        PHASE_EVT_L2_ALL_PF, PHASE_EVT_L2_USELESS_HWPF
+    };
+    int interval_ms = PHASE_INTERVAL_MS;
+    int duration = PHASE_DURATION;
+    size_t wss = (size_t)PHASE_WSS_MB * 1024 * 1024;
+    const char *cpu_list = "0";
+    const char *log_path = NULL;
+    phase_result_t results[PHASE_NUM_MODES];
+    cpu_set_t cpus;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--cpus") == 0 && i + 1 < argc) {
+            cpu_list = argv[++i];
+        } else if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc) {
+            interval_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--duration") == 0 && i + 1 < argc) {
+            duration = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--phase") == 0 && i + 1 < argc) {
+            g_phase_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--wss") == 0 && i + 1 < argc) {
+            wss = (size_t)(atof(argv[++i]) * 1024 * 1024);
+        } else if (strcmp(argv[i], "--thresholds") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%lf:%lf", &params.off_below, &params.on_above) != 2 ||
+                params.off_below < 0 || params.on_above > 1 || params.off_below >= params.on_above) {
+                PRINT_ERROR("--thresholds takes OFF:ON with 0 <= OFF < ON <= 1");
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--hold") == 0 && i + 1 < argc) {
+            params.hold = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--probe") == 0 && i + 1 < argc) {
+            params.probe_every = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--pf-event") == 0 && i + 1 < argc) {
+            params.pf_event = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--useless-event") == 0 && i + 1 < argc) {
+            params.useless_event = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--log") == 0 && i + 1 < argc) {
+            log_path = argv[++i];
+        } else {
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (interval_ms < 1 || duration <= 0 || g_phase_ms < interval_ms || params.hold < 1 ||
+        params.probe_every < 1 || wss < 1024 * 1024 || topo_parse_cpulist(cpu_list, &cpus) <= 0) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (check_root_permission() != SUCCESS || prefetch_check_support() != SUCCESS) {
+        return EXIT_FAILURE;
+    }
+    if (!perf_events_available()) {
+        PRINT_ERROR("The controller needs hardware counters (perf_event_open)");
+        return EXIT_FAILURE;
+    }
+
+    // One worker per CPU; one controlled core per distinct core
+    TOPO_FOR_EACH_CPU(cpu, &cpus, CPU_SETSIZE) {
+        int core = prefetch_cpu_core(cpu);
+        if (core < 0 || g_num_workers == PHASE_MAX_WORKERS) {
+            PRINT_ERROR("CPU %d is offline or past the %d worker limit", cpu, PHASE_MAX_WORKERS);
+            return EXIT_FAILURE;
+        }
+        g_workers[g_num_workers].cpu = cpu;
+        g_workers[g_num_workers].wss = wss;
+        g_num_workers++;
+
+        phase_core_t *owner = NULL;
+        for (int c = 0; c < g_num_cores && !owner; c++) {
+            owner = g_cores[c].core == core ? &g_cores[c] : NULL;
+        }
+        if (!owner) {
+            owner = &g_cores[g_num_cores++];
+            owner->core = core;
+        }
+        if (owner->num_cpus == PHASE_MAX_SIBLINGS) {
+            PRINT_ERROR("More than %d listed CPUs on core %d", PHASE_MAX_SIBLINGS, core);
+            return EXIT_FAILURE;
+        }
+        owner->ctr[owner->num_cpus++].cpu = cpu;
+    }
+
+    if (log_path) {
+        g_log = fopen(log_path, "w");
+        if (!g_log) {
+            PRINT_ERROR("Cannot open %s: %s", log_path, strerror(errno));
+            return EXIT_FAILURE;
+        }
+        fprintf(g_log, "mode,time_s,core,pf_requests,useless,useful_ratio,l2_hit,llc_miss_mbps,enabled\n");
+    }
+
+    if (prefetch_snapshot_take() != SUCCESS) {
+        return EXIT_FAILURE;
+    }
+    for (int c = 0; c < g_num_cores; c++) {
+        prefetch_snapshot_core(g_cores[c].core, &g_cores[c].base_mask);
+        g_cores[c].base_mask &= ~PHASE_TOGGLE_BITS;
+        if (open_core_counters(&g_cores[c], &params) != SUCCESS) {
+            PRINT_ERROR("Cannot open the prefetch counters on core %d (try --pf-event/--useless-event)",
+                        g_cores[c].core);
+            prefetch_snapshot_restore();
+            return EXIT_FAILURE;
+        }
+    }
+
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+
+    PRINT_INFO("%d workers on %d cores, %d ms scan/lookup phases over %zu MB each, %d s per mode",
+               g_num_workers, g_num_cores, g_phase_ms, wss / (1024 * 1024), duration);
+    PRINT_INFO("Controller: %d ms interval, off below %.2f useful for %d intervals, "
+               "probe every %d intervals, keep on above %.2f",
+               interval_ms, params.off_below, params.hold, params.probe_every, params.on_above);
+
+    int ret = SUCCESS;
+    memset(results, 0, sizeof(results));
+    for (int mode = 0; mode < PHASE_NUM_MODES && g_running && ret == SUCCESS; mode++) {
+        ret = run_mode((phase_mode_t)mode, &params, duration, interval_ms, &results[mode]);
+    }
+    if (ret == SUCCESS && g_running) {
+        print_results(results);
+    }
+
+    for (int c = 0; c < g_num_cores; c++) {
+        close_core_counters(&g_cores[c]);
+    }
+    prefetch_snapshot_restore();
+    if (g_log) {
+        fclose(g_log);
+    }
+    return ret == SUCCESS ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+void signal_handler(int sig) {
+    (void)sig;
+    g_running = 0;
+}
+
+static void print_usage(const char *prog) {
+    printf("Usage: %s [--cpus LIST] [--duration SEC] [--interval MS] [--phase MS] [--wss MB]\n", prog);
+    printf("          [--thresholds OFF:ON] [--hold N] [--probe N] [--log FILE]\n");
+    printf("  --cpus LIST          Worker CPUs; their cores are controlled (default 0)\n");
+    printf("  --duration SEC       Run time of each mode (default %d)\n", PHASE_DURATION);
+    printf("  --interval MS        Controller period (default %d)\n", PHASE_INTERVAL_MS);
+    printf("  --phase MS           Length of each scan and lookup phase (default %d)\n", PHASE_LEN_MS);
+    printf("  --wss MB             Buffer per worker (default %d)\n", PHASE_WSS_MB);
+    printf("  --thresholds OFF:ON  Useful-prefetch ratio hysteresis (default %.2f:%.2f)\n",
+           PHASE_OFF_BELOW, PHASE_ON_ABOVE);
+    printf("  --hold N             Low intervals before switching off (default %d)\n", PHASE_HOLD);
+    printf("  --probe N            Intervals off between probes (default %d)\n", PHASE_PROBE_EVERY);
+    printf("  --pf-event RAW       L2 prefetch request event (default 0x%X, L2_RQSTS.ALL_PF)\n",
+           PHASE_EVT_L2_ALL_PF);
+    printf("  --useless-event RAW  Unused prefetched line event (default 0x%X, L2_LINES_OUT.USELESS_HWPF)\n",
+           PHASE_EVT_L2_USELESS_HWPF);
+    printf("  --log FILE           Per-core, per-interval samples as CSV\n");
+}
+
+// Alternate sequential scans and random lookups by wall clock, so every
+// mode sees the same phase pattern
+static void *phase_worker(void *arg) {
+    phase_worker_t *w = (phase_worker_t *)arg;
+    wl_xorshift_t rng;
+    uint64_t sink = 0;
+
+    topo_pin_thread(w->cpu);
+    wl_xorshift_seed(&rng, (uint64_t)w->cpu + 1);
+    const topology_t *topo = topology_get();
+    int node = topo && topo->num_nodes > 1 ? topo_cpu_node(w->cpu) : -1;
+    w->ready = mem_alloc(&w->buf, w->wss, MEM_PAGE_4K, node, 0x5A) == SUCCESS ? 1 : -1;
+    if (w->ready < 0) {
+        return NULL;
+    }
+
+    volatile uint64_t *data = (volatile uint64_t *)w->buf.addr;
+    size_t lines = w->wss / 64;
+    size_t pos = 0;
+    uint64_t phase_ns = (uint64_t)g_phase_ms * 1000000ULL;
+
+    while (!g_workers_run && g_running) {
+        sched_yield();
+    }
+    uint64_t start = timing_now_ns();
+    while (g_workers_run) {
+        int scan = ((timing_now_ns() - start) / phase_ns) % 2 == 0;
+        if (scan) {
+            for (int i = 0; i < 4096; i++) {
+                sink += data[pos * 8];
+                pos = pos + 1 < lines ? pos + 1 : 0;
+            }
+            w->scan_lines += 4096;
+        } else {
+            for (int i = 0; i < 1024; i++) {
+                sink += data[wl_bounded(wl_xorshift_next(&rng), lines) * 8];
+            }
+            w->lookup_lines += 1024;
+        }
+    }
+
+    g_sink = sink;
+    mem_free(&w->buf);
+    return NULL;
+}
+
+static int open_cpu_counters(phase_counters_t *ctr, const phase_params_t *params) {
+    ctr->pf.fd = ctr->useless.fd = ctr->l2_ref.fd = ctr->l2_miss.fd = ctr->llc_miss.fd = -1;
+    if (perf_counter_open(&ctr->pf, PERF_TYPE_RAW, params->pf_event, -1, ctr->cpu, 0) != SUCCESS ||
+        perf_counter_open(&ctr->useless, PERF_TYPE_RAW, params->useless_event, -1, ctr->cpu, 0) != SUCCESS) {
+        perf_counter_close(&ctr->pf);
+        return ERROR_NOT_SUPPORTED;
+    }
+    // Reported when available; the decision only needs the two above
+    perf_counter_open(&ctr->l2_ref, PERF_TYPE_RAW, PHASE_EVT_L2_REFERENCES, -1, ctr->cpu, 0);
+    perf_counter_open(&ctr->l2_miss, PERF_TYPE_RAW, PHASE_EVT_L2_MISS, -1, ctr->cpu, 0);
+    perf_counter_open(&ctr->llc_miss, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, -1, ctr->cpu, 0);
+    return SUCCESS;
+}
+
+// Every listed CPU of the core: SMT siblings share the prefetchers, so the
+// decision needs the traffic of all of them
+static int open_core_counters(phase_core_t *c, const phase_params_t *params) {
+    for (int i = 0; i < c->num_cpus; i++) {
+        if (open_cpu_counters(&c->ctr[i], params) != SUCCESS) {
+            while (--i >= 0) {
+                close_cpu_counters(&c->ctr[i]);
+            }
+            return ERROR_NOT_SUPPORTED;
+        }
+    }
+    return SUCCESS;
+}
+
+static void close_cpu_counters(phase_counters_t *ctr) {
+    perf_counter_close(&ctr->pf);
+    perf_counter_close(&ctr->useless);
+    perf_counter_close(&ctr->l2_ref);
+    perf_counter_close(&ctr->l2_miss);
+    perf_counter_close(&ctr->llc_miss);
+}
+
+static void close_core_counters(phase_core_t *c) {
+    for (int i = 0; i < c->num_cpus; i++) {
+        close_cpu_counters(&c->ctr[i]);
+    }
+}
+
+// Summed over the core's CPUs; optional counters that failed to open read
+// as zero
+static int read_core_sample(phase_core_t *c, phase_sample_t *s) {
+    memset(s, 0, sizeof(*s));
+    for (int i = 0; i < c->num_cpus; i++) {
+        phase_counters_t *ctr = &c->ctr[i];
+        uint64_t pf, useless, value;
+
+        if (perf_counter_delta(&ctr->pf, &pf) != SUCCESS ||
+            perf_counter_delta(&ctr->useless, &useless) != SUCCESS) {
+            return ERROR_SYSTEM;
+        }
+        s->pf += pf;
+        s->useless += useless;
+        if (ctr->l2_ref.fd >= 0 && perf_counter_delta(&ctr->l2_ref, &value) == SUCCESS) {
+            s->l2_ref += value;
+        }
+        if (ctr->l2_miss.fd >= 0 && perf_counter_delta(&ctr->l2_miss, &value) == SUCCESS) {
+            s->l2_miss += value;
+        }
+        if (ctr->llc_miss.fd >= 0 && perf_counter_delta(&ctr->llc_miss, &value) == SUCCESS) {
+            s->llc_miss += value;
+        }
+    }
+    return SUCCESS;
+}
+
+static int set_core_enabled(phase_core_t *c, int enabled) {
+    if (prefetch_core_apply(c->core, c->base_mask | (enabled ? 0 : PHASE_TOGGLE_BITS)) != SUCCESS) {
+        return ERROR_SYSTEM;
+    }
+    c->enabled = enabled;
+    return SUCCESS;
+}
+
+// New state of the L2 prefetchers after one interval
+static int phase_decide(phase_core_t *c, const phase_sample_t *s, const phase_params_t *params) {
+    double rate = s->dt > 0 ? s->llc_miss / s->dt : 0.0;
+
+    if (c->enabled) {
+        int judged = s->pf >= PHASE_MIN_PF;
+        double useful = judged ? 1.0 - (double)(s->useless < s->pf ? s->useless : s->pf) / s->pf : 1.0;
+
+        if (c->probing) {
+            // One interval decides a probe; too few requests means nothing to gain
+            c->probing = 0;
+            if (!judged || useful < params->on_above) {
+                c->since_off = 0;
+                c->off_rate = rate;
+                return 0;
+            }
+            c->low_count = 0;
+            return 1;
+        }
+        c->low_count = judged && useful < params->off_below ? c->low_count + 1 : 0;
+        if (c->low_count >= params->hold) {
+            c->low_count = 0;
+            c->since_off = 0;
+            c->off_rate = rate;
+            return 0;
+        }
+        return 1;
+    }
+
+    c->since_off++;
+    int shifted = c->off_rate > 0 && fabs(rate - c->off_rate) / c->off_rate > params->shift;
+    if (c->since_off >= params->probe_every || shifted) {
+        c->probing = 1;
+        return 1;
+    }
+    return 0;
+}
+
+static int run_mode(phase_mode_t mode, const phase_params_t *params, int duration, int interval_ms,
+                    phase_result_t *result) {
+    pthread_t threads[PHASE_MAX_WORKERS];
+    int started = 0;
+    int ret = SUCCESS;
+
+    for (int c = 0; c < g_num_cores; c++) {
+        phase_core_t *core = &g_cores[c];
+        memset(&core->total, 0, sizeof(core->total));
+        core->toggles = core->intervals = core->intervals_on = 0;
+        core->low_count = core->probing = core->since_off = 0;
+        core->off_rate = 0.0;
+        if (set_core_enabled(core, mode != PHASE_MODE_STATIC_OFF) != SUCCESS) {
+            return ERROR_SYSTEM;
+        }
+    }
+
+    g_workers_run = 0;
+    for (int w = 0; w < g_num_workers; w++) {
+        g_workers[w].ready = 0;
+        g_workers[w].scan_lines = g_workers[w].lookup_lines = 0;
+        if (pthread_create(&threads[w], NULL, phase_worker, &g_workers[w]) != 0) {
+            ret = ERROR_SYSTEM;
+            break;
+        }
+        started++;
+    }
+    for (int w = 0; w < started; w++) {
+        while (g_workers[w].ready == 0 && g_running) {
+            sleep_ms(1);
+        }
+        if (g_workers[w].ready < 0) {
+            PRINT_ERROR("Worker on CPU %d could not allocate its buffer", g_workers[w].cpu);
+            ret = ERROR_SYSTEM;
+        }
+    }
+    if (ret != SUCCESS || !g_running) {
+        g_running = 0;
+        for (int w = 0; w < started; w++) {
+            pthread_join(threads[w], NULL);
+        }
+        return ret;
+    }
+
+    PRINT_INFO("Mode %s", mode_names[mode]);
+    for (int c = 0; c < g_num_cores; c++) {
+        phase_sample_t discard;
+        read_core_sample(&g_cores[c], &discard);
+    }
+    g_workers_run = 1;
+
+    uint64_t start_ns = timing_now_ns();
+    uint64_t prev_ns = start_ns;
+    uint64_t next_ns = start_ns;
+    uint64_t end_ns = start_ns + (uint64_t)duration * 1000000000ULL;
+    while (g_running && next_ns < end_ns && ret == SUCCESS) {
+        next_ns += (uint64_t)interval_ms * 1000000ULL;
+        uint64_t now_ns = timing_now_ns();
+        if (next_ns > now_ns) {
+            struct timespec ts = { (time_t)((next_ns - now_ns) / 1000000000ULL),
+                                   (long)((next_ns - now_ns) % 1000000000ULL) };
+            nanosleep(&ts, NULL);
+        }
+        now_ns = timing_now_ns();
+        double dt = (now_ns - prev_ns) / 1e9;
+        prev_ns = now_ns;
+
+        for (int c = 0; c < g_num_cores && ret == SUCCESS; c++) {
+            phase_core_t *core = &g_cores[c];
+            phase_sample_t s;
+            if (read_core_sample(core, &s) != SUCCESS) {
+                ret = ERROR_SYSTEM;
+                break;
+            }
+            s.dt = dt;
+            core->total.pf += s.pf;
+            core->total.useless += s.useless;
+            core->total.l2_ref += s.l2_ref;
+            core->total.l2_miss += s.l2_miss;
+            core->total.llc_miss += s.llc_miss;
+            core->total.dt += dt;
+            core->intervals++;
+            core->intervals_on += core->enabled;
+
+            if (g_log) {
+                fprintf(g_log, "%s,%.4f,%d,%lu,%lu,%.4f,%.4f,%.1f,%d\n", mode_names[mode],
+                        (now_ns - start_ns) / 1e9, core->core, s.pf, s.useless,
+                        s.pf ? 1.0 - (double)s.useless / s.pf : 0.0,
+                        s.l2_ref ? 1.0 - (double)s.l2_miss / s.l2_ref : 0.0,
+                        s.llc_miss * 64.0 / dt / (1024.0 * 1024.0), core->enabled);
+            }
+            if (mode != PHASE_MODE_ADAPTIVE) {
+                continue;
+            }
+            int enabled = phase_decide(core, &s, params);
+            if (enabled != core->enabled) {
+                if (set_core_enabled(core, enabled) != SUCCESS) {
+                    ret = ERROR_SYSTEM;
+                    break;
+                }
+                core->toggles++;
+            }
+        }
+    }
+    double elapsed = (timing_now_ns() - start_ns) / 1e9;
+    g_workers_run = 0;
+
+    uint64_t scan = 0, lookup = 0;
+    for (int w = 0; w < started; w++) {
+        pthread_join(threads[w], NULL);
+        scan += g_workers[w].scan_lines;
+        lookup += g_workers[w].lookup_lines;
+    }
+
+    phase_sample_t sum = { 0 };
+    int intervals = 0, intervals_on = 0;
+    for (int c = 0; c < g_num_cores; c++) {
+        sum.pf += g_cores[c].total.pf;
+        sum.useless += g_cores[c].total.useless;
+        sum.l2_ref += g_cores[c].total.l2_ref;
+        sum.l2_miss += g_cores[c].total.l2_miss;
+        sum.llc_miss += g_cores[c].total.llc_miss;
+        intervals += g_cores[c].intervals;
+        intervals_on += g_cores[c].intervals_on;
+        result->toggles += g_cores[c].toggles;
+    }
+    result->scan_mlps = scan / elapsed / 1e6;
+    result->lookup_mlps = lookup / elapsed / 1e6;
+    result->llc_gbps = sum.llc_miss * 64.0 / elapsed / 1e9;
+    result->l2_hit = sum.l2_ref ? 1.0 - (double)sum.l2_miss / sum.l2_ref : 0.0;
+    result->useful = sum.pf ? 1.0 - (double)(sum.useless < sum.pf ? sum.useless : sum.pf) / sum.pf : 0.0;
+    result->on_share = intervals ? (double)intervals_on / intervals : 0.0;
+    return ret;
+}
+
+// Bandwidth saved and throughput change of the controller against both static settings
+static void print_results(const phase_result_t *results) {
+    printf("\nMode         Scan Ml/s  Lookup Ml/s  Total Ml/s  LLC miss GB/s  L2 hit  Useful PF  L2 PF on  Toggles\n");
+    printf("-----------  ---------  -----------  ----------  -------------  ------  ---------  --------  -------\n");
+    for (int m = 0; m < PHASE_NUM_MODES; m++) {
+        const phase_result_t *r = &results[m];
+        printf("%-11s  %9.1f  %11.1f  %10.1f  %13.2f  %5.1f%%  %8.1f%%  %7.0f%%  %7d\n", mode_names[m],
+               r->scan_mlps, r->lookup_mlps, r->scan_mlps + r->lookup_mlps, r->llc_gbps,
+               100.0 * r->l2_hit, 100.0 * r->useful, 100.0 * r->on_share, r->toggles);
+    }
+
+    const phase_result_t *adaptive = &results[PHASE_MODE_ADAPTIVE];
+    double adaptive_total = adaptive->scan_mlps + adaptive->lookup_mlps;
+    printf("\n");
+    for (int m = PHASE_MODE_STATIC_ON; m <= PHASE_MODE_STATIC_OFF; m++) {
+        const phase_result_t *r = &results[m];
+        double total = r->scan_mlps + r->lookup_mlps;
+        PRINT_INFO("adaptive vs %s: bandwidth saved %+.1f%%, throughput %+.1f%%", mode_names[m],
+                   r->llc_gbps > 0 ? 100.0 * (r->llc_gbps - adaptive->llc_gbps) / r->llc_gbps : 0.0,
+                   total > 0 ? 100.0 * (adaptive_total - total) / total : 0.0);
+    }
+}
@@ -1,16 +1,47 @@
-#include "../common/common.h"
-#include "../common/msr_utils.h"
+#include "rdt_common.h"
+#include "../common/timing.h"
+#include "../common/bench_harness.h"
+#include "../common/histogram.h"
+#include "../common/workload.h"
+#include "../common/mem_alloc.h"
+#include "../common/perf_events.h"
 #include <signal.h>
 #include <pthread.h>
+#include <sys/mman.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
 // Benchmark parameters
 #define BENCH_ARRAY_SIZE (32 * 1024 * 1024)  // 32MB per thread
 #define BENCH_ITERATIONS 10
+#define BENCH_CACHE_WSS  (BENCH_ARRAY_SIZE / 16)  // Random-access working set
+#define BENCH_MIXED_WSS  (BENCH_ARRAY_SIZE / 32)  // Random phase of the mixed kernel
 #define CACHE_LINE_SIZE 64
 #define MAX_THREADS 16
-#define BENCHMARK_DURATION 30  // seconds
+#define BENCHMARK_DURATION 10  // seconds per harness sample
+#define BENCHMARK_REPS 3
+#define CONFIG_CBM_LEN 16      // Way count the built-in configuration masks are written for
+
+// Colocation parameters
+#define COLOC_LC_CLOS       1
+#define COLOC_BE_CLOS       2
+#define COLOC_LC_WSS        (4 * 1024 * 1024)  // Latency-critical working set
+#define COLOC_REQUEST_HOPS  256                // Dependent loads per request
+
+// Code footprint kernel: generated functions, far more code than L2 holds
+#define CODE_FUNCS          2048
+#define CODE_FUNC_SIZE      4096
+
+// Stream copy chunk between progress updates
+#define STREAM_CHUNK        (1024 * 1024)
+
+// Time series sampling
+#define TS_DEFAULT_INTERVAL_MS  10.0
+#define TS_MIN_INTERVAL_MS      1.0
+
+// CLOS switch latency parameters
+#define SWITCH_SAMPLES      20000
+#define SWITCH_WARMUP       200
 
 // RDT benchmark types
 typedef enum {
@@ -18,22 +49,33 @@ typedef enum {
     BENCH_MEMORY_INTENSIVE,
     BENCH_MIXED_WORKLOAD,
     BENCH_POINTER_CHASE,
-    BENCH_STREAM_COPY
+    BENCH_STREAM_COPY,
+    BENCH_CODE_FOOTPRINT
 } benchmark_type_t;
 
 // Thread data structure
 typedef struct {
     int thread_id;
     int clos_id;
+    int cpu;                // Pinned before joining the CLOS, -1 to leave as is
     benchmark_type_t bench_type;
     void *data;
     size_t data_size;
+    mem_buffer_t buf;       // Backing of data, mapped and first-touched by the worker
+    mem_buffer_t dst;       // Copy target of the stream kernel
+    mem_page_t page;        // Page size and node the buffers got, kept for the report
+    int node;
+    wl_stream_t stream;     // Precomputed cache-line accesses of the random kernels
+    int status;             // Worker setup result, valid once it reaches the start gate
     volatile int *running;
     uint64_t operations;
-    uint64_t start_time;
-    uint64_t end_time;
-    double throughput;
+    uint64_t start_time;    // ns, monotonic
+    uint64_t end_time;      // ns, monotonic
+    double throughput;      // Mops/s or MB/s depending on kernel
     double latency;
+    int have_tlb;
+    uint64_t dtlb_loads;    // Over the timed region; 0 when only misses are countable
+    uint64_t dtlb_misses;
 } thread_data_t;
 
 // RDT configuration structure
@@ -43,12 +85,123 @@ typedef struct {
     uint64_t mb_throttle;
     int num_threads;
     benchmark_type_t bench_type;
+    uint64_t code_mask;     // L3 code mask under CDP (l3_mask is then data), 0 = unified
+    uint64_t l2_mask;       // L2 CBM, 0 = leave L2 alone
 } rdt_config_t;
 
+// LLC occupancy and MBM of the benchmark CLOS, summed over L3 domains and
+// accumulated over the samples of one harness run. Each event counts only
+// the windows whose reads succeeded.
+typedef struct {
+    int llc_samples;
+    int mbm_samples;
+    double llc_kb;
+    double mbm_mbps;
+} rdt_mon_accum_t;
+
+// Latency-critical vs best-effort partitioning. L3 shares are percentages
+// of the CBM: the LC CLOS takes the high ways, the BE CLOS the low ways,
+// and 100 gives a CLOS every way (shared with the other one).
+typedef struct {
+    const char *name;
+    int lc_l3_pct;
+    int be_l3_pct;
+    int be_mba;             // BE MBA throttle (delay %), 0 = unthrottled
+    int be_threads;
+} coloc_config_t;
+
+// Latency-critical thread state
+typedef struct {
+    int cpu;
+    void *chain;
+    size_t chain_size;
+    volatile int *running;
+    histogram_t hist;       // Per-request latency, ns
+} lc_thread_t;
+
+// Per-sample colocation results beside the harness sample (LC p99)
+typedef struct {
+    double p50;
+    double p99;
+    double p999;
+    double be_throughput;
+} coloc_sample_t;
+
+// One point of a cache-way sweep
+typedef struct {
+    int ways;
+    uint64_t mask;
+    bench_stats_t stats;
+    double llc_kb;
+    double mbm_mbps;
+} sweep_point_t;
+
+// Per-thread progress, one cache line each so publishing never bounces a
+// line between workers. work is in the kernel's raw units (operations or
+// bytes) and only grows; the sampler reads it without locks.
+typedef struct {
+    uint64_t work;
+    char pad[CACHE_LINE_SIZE - sizeof(uint64_t)];
+} __attribute__((aligned(CACHE_LINE_SIZE))) progress_slot_t;
+
+// Time series of one benchmark run, written by the sampler thread
+typedef struct {
+    const rdt_config_t *config;
+    int num_threads;
+    int run;                // Harness sample number across the whole invocation
+    int rows;
+    int overruns;           // Intervals skipped because a sample ran late
+} ts_sampler_t;
+
 // Global variables
 static volatile int g_running = 1;
+static volatile int g_interrupted = 0;
+static int g_duration = BENCHMARK_DURATION;
+static rdt_backend_type_t g_backend_type = RDT_BACKEND_AUTO;
+static rdt_mon_accum_t g_mon_accum;
+static benchmark_type_t g_be_type = BENCH_STREAM_COPY;
+static int g_be_threads = 0;            // 0 = per-scenario default
+static wl_config_t g_workload;          // Working set and distribution of the random kernels
+static size_t g_lc_wss = COLOC_LC_WSS;
+static lc_thread_t g_lc_thread;
+static histogram_t g_coloc_hist;        // All LC requests of the current scenario
+static coloc_sample_t g_coloc_samples[BENCH_MAX_SAMPLES];
+static int g_coloc_nsamples = 0;
+static void *volatile g_lc_sink;
 static pthread_t threads[MAX_THREADS];
 static thread_data_t thread_data[MAX_THREADS];
+static progress_slot_t g_progress[MAX_THREADS];
+static __thread progress_slot_t *t_progress;    // This worker's slot, NULL outside workers
+static FILE *g_ts_file = NULL;                  // --timeseries output
+static uint64_t g_ts_interval_ns = (uint64_t)(TS_DEFAULT_INTERVAL_MS * 1e6);
+static int g_ts_runs = 0;
+static int g_ts_suspended = 0;                  // Calibration runs: no time series, no --step
+static double g_step_sec = -1.0;                // --step: change the CLOS 1 mask mid-run
+static uint64_t g_step_mask = 0;
+static int g_mb_min = 0;                        // --mb-min: guaranteed bandwidth of CLOS 1, %
+static double g_mb_peak = 0.0;                  // --mb-peak: GB/s a throttle percent is taken from
+static pthread_once_t g_code_once = PTHREAD_ONCE_INIT;
+static uint8_t *g_code = NULL;          // CODE_FUNCS generated functions
+static mem_page_t g_pages = MEM_PAGE_4K;        // --pages
+static int g_have_perf = 0;
+// Start gate: workers set up their buffers, then wait until the main
+// thread has seen all of them arrive before any measurement starts
+static pthread_mutex_t g_gate_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_gate_cond = PTHREAD_COND_INITIALIZER;
+static int g_gate_arrived = 0;
+static int g_gate_open = 0;
+
+// One CLOS switch latency run: a thread pinned to caller_cpu alternates
+// target_cpu between CLOS 1 and 0
+typedef struct {
+    const char *name;
+    int fast;               // Fast path, else read-modify-write with open/close per access
+    int caller_cpu;
+    int target_cpu;
+    int samples;
+    int failures;
+    histogram_t hist;       // Nanoseconds
+} switch_run_t;
 
 // Function declarations
 void signal_handler(int sig);
@@ -57,14 +210,75 @@ void rdt_bench_cleanup(void);
 void* benchmark_thread(void *arg);
 int setup_rdt_clos(int clos_id, uint64_t l3_mask, uint64_t mb_throttle);
 int assign_thread_to_clos(int clos_id);
-double benchmark_cache_intensive(void *data, size_t size, volatile int *running);
+static inline void publish_progress(uint64_t work);
+static double work_scale(benchmark_type_t type);
+static uint64_t mono_ns(void);
+void *timeseries_thread(void *arg);
+static int prepare_thread_data(thread_data_t *data);
+static int worker_node(const thread_data_t *data);
+static void start_gate_reset(void);
+static void start_gate_arrive(void);
+static int start_gate_wait(thread_data_t *workers, int count);
+static void start_gate_release(void);
+static void release_thread_data(thread_data_t *data);
+double benchmark_cache_intensive(void *data, const wl_stream_t *stream, volatile int *running);
 double benchmark_memory_intensive(void *data, size_t size, volatile int *running);
-double benchmark_mixed_workload(void *data, size_t size, volatile int *running);
-double benchmark_pointer_chase(void *data, size_t size, volatile int *running);
-double benchmark_stream_copy(void *data, size_t size, volatile int *running);
-void run_rdt_benchmark(const rdt_config_t *config);
+double benchmark_mixed_workload(void *data, size_t size, const wl_stream_t *stream,
+                                volatile int *running);
+double benchmark_pointer_chase(void *data, volatile int *running);
+double benchmark_stream_copy(void *data, void *dst, size_t size, volatile int *running);
+static void code_footprint_build(void);
+double benchmark_code_footprint(void *data, size_t size, volatile int *running);
+static uint64_t scale_config_mask(uint64_t mask);
+static void calibrate_mba_reference(const rdt_config_t *config);
+static int apply_rdt_partition(const rdt_config_t *config, int *cdp_toggled);
+static void undo_rdt_partition(const rdt_config_t *config, int cdp_toggled);
+double run_rdt_benchmark(const rdt_config_t *config);
+void run_rdt_config(const rdt_config_t *builtin);
+static double rdt_kernel_run(void *ctx);
 void print_benchmark_results(const rdt_config_t *config, thread_data_t *results, int num_threads);
 void monitor_rdt_metrics(int duration);
+static int read_clos_monitor(int clos, rdt_mon_event_t event, uint64_t *bytes);
+int run_way_sweep(benchmark_type_t bench_type, int num_threads, const char *curve_path);
+static double sweep_traffic_per_work(const sweep_point_t *point);
+static void print_sweep_curve(const bench_kernel_t *kernel, const sweep_point_t *points, int count);
+static int write_sweep_curve(const char *path, const bench_kernel_t *kernel,
+                             const sweep_point_t *points, int count);
+static uint64_t coloc_ways_mask(int pct, int high);
+static int coloc_num_be(const coloc_config_t *config);
+void *lc_request_thread(void *arg);
+static double coloc_kernel_run(void *ctx);
+static int compare_double(const void *a, const void *b);
+static double coloc_sample_median(size_t offset);
+double run_coloc_sample(const coloc_config_t *config);
+int run_coloc_config(const coloc_config_t *config, coloc_sample_t *summary);
+void run_colocation(const coloc_config_t *custom);
+void *switch_latency_thread(void *arg);
+static int switch_pick_cpus(int *target, int *remote);
+void run_switch_latency(int samples);
+
+// Harness kernels, indexed by benchmark_type_t; samples are aggregate throughput
+static const bench_kernel_t rdt_kernels[] = {
+    { "cache_intensive",  "Mops/s", 1, rdt_kernel_run },
+    { "memory_intensive", "MB/s",   1, rdt_kernel_run },
+    { "mixed",            "Mops/s", 1, rdt_kernel_run },
+    { "pointer_chase",    "Mops/s", 1, rdt_kernel_run },
+    { "stream_copy",      "MB/s",   1, rdt_kernel_run },
+    { "code_footprint",   "Mcalls/s", 1, rdt_kernel_run },
+};
+
+// Colocation sample: p99 latency of the latency-critical requests
+static const bench_kernel_t coloc_kernel = { "coloc_lc_p99", "ns", 0, coloc_kernel_run };
+
+// Colocation scenarios, each run with the same LC kernel and BE antagonists
+static const coloc_config_t coloc_configs[] = {
+    { "LC alone",                     100, 100,  0, 0 },
+    { "Colocated - no isolation",     100, 100,  0, 4 },
+    { "Colocated - CAT 50/50",         50,  50,  0, 4 },
+    { "Colocated - CAT 75/25",         75,  25,  0, 4 },
+    { "Colocated - MBA 70",           100, 100, 70, 4 },
+    { "Colocated - CAT 75/25 + MBA 50", 75, 25, 50, 4 },
+};
 
 // Predefined benchmark configurations
 static const rdt_config_t benchmark_configs[] = {
@@ -123,14 +337,247 @@ static const rdt_config_t benchmark_configs[] = {
         .mb_throttle = 75,
         .num_threads = 4,
         .bench_type = BENCH_STREAM_COPY
+    },
+    {
+        .name = "Code Footprint - Shared L3",
+        .l3_mask = 0xFFFF,
+        .mb_throttle = 0,
+        .num_threads = 2,
+        .bench_type = BENCH_CODE_FOOTPRINT
+    },
+    {
+        .name = "Code Footprint - CDP code 0xFFF0 / data 0x000F",
+        .l3_mask = 0x000F,  // Data ways
+        .mb_throttle = 0,
+        .num_threads = 2,
+        .bench_type = BENCH_CODE_FOOTPRINT,
+        .code_mask = 0xFFF0
+    },
+    {
+        .name = "Code Footprint - L2 CAT 0x000F",
+        .l3_mask = 0xFFFF,
+        .mb_throttle = 0,
+        .num_threads = 2,
+        .bench_type = BENCH_CODE_FOOTPRINT,
+        .l2_mask = 0x000F   // Clipped to the L2 CBM
     }
 };
 
 int main(int argc, char *argv[]) {
+    bench_options_t opts;
+    int config_index = -1;
+    const char *sweep_kernel = NULL;
+    const char *curve_path = NULL;
+    int sweep_threads = 0;
+    int coloc = 0;
+    int switch_latency = 0;
+    int switch_samples = SWITCH_SAMPLES;
+    const char *ts_path = NULL;
+    coloc_config_t custom = { "Custom", 100, 100, 0, 4 };
+    int have_custom = 0;
+    
+    for (size_t i = 0; i < sizeof(rdt_kernels) / sizeof(rdt_kernels[0]); i++) {
+        bench_register(&rdt_kernels[i]);
+    }
+    bench_register(&coloc_kernel);
+    
+    // Each sample runs for g_duration seconds, so default to fewer repetitions
+    wl_config_default(&g_workload);
+    g_workload.elem_size = CACHE_LINE_SIZE;
+    
+    bench_options_init(&opts, "rdt_bench");
+    opts.warmup = 0;
+    opts.repetitions = BENCHMARK_REPS;
+    if (bench_parse_args(&opts, &argc, argv) != SUCCESS) {
+        return EXIT_FAILURE;
+    }
+    
+    // Parse command line arguments
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--duration") == 0 && i + 1 < argc) {
+            g_duration = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--backend") == 0 && i + 1 < argc) {
+            if (rdt_backend_parse(argv[++i], &g_backend_type) != SUCCESS) {
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--sweep") == 0 && i + 1 < argc) {
+            sweep_kernel = argv[++i];
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            sweep_threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--curve") == 0 && i + 1 < argc) {
+            curve_path = argv[++i];
+        } else if (strcmp(argv[i], "--dist") == 0 && i + 1 < argc) {
+            if (wl_dist_parse(argv[++i], &g_workload.dist) != SUCCESS) {
+                PRINT_ERROR("Unknown distribution \"%s\" (uniform, zipf, hotcold)", argv[i]);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--wss") == 0 && i + 1 < argc) {
+            g_workload.wss = (size_t)(atof(argv[++i]) * 1024 * 1024);
+        } else if (strcmp(argv[i], "--zipf-theta") == 0 && i + 1 < argc) {
+            g_workload.zipf_theta = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--hot") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%lf:%lf", &g_workload.hot_fraction, &g_workload.hot_prob) != 2) {
+                PRINT_ERROR("--hot takes FRACTION:PROBABILITY, e.g. 0.1:0.9");
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--mb-min") == 0 && i + 1 < argc) {
+            g_mb_min = atoi(argv[++i]);
+            if (g_mb_min < 0 || g_mb_min > 100) {
+                PRINT_ERROR("--mb-min takes a percentage (0-100)");
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--mb-peak") == 0 && i + 1 < argc) {
+            g_mb_peak = atof(argv[++i]);
+            if (g_mb_peak <= 0) {
+                PRINT_ERROR("--mb-peak takes a bandwidth in GB/s");
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--pages") == 0 && i + 1 < argc) {
+            if (mem_page_parse(argv[++i], &g_pages) != SUCCESS) {
+                PRINT_ERROR("Unknown page size \"%s\" (4k, thp, 2m, 1g)", argv[i]);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--timeseries") == 0 && i + 1 < argc) {
+            ts_path = argv[++i];
+        } else if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc) {
+            double ms = atof(argv[++i]);
+            if (ms < TS_MIN_INTERVAL_MS) {
+                PRINT_ERROR("Sampling interval must be at least %.0f ms", TS_MIN_INTERVAL_MS);
+                return EXIT_FAILURE;
+            }
+            g_ts_interval_ns = (uint64_t)(ms * 1e6);
+        } else if (strcmp(argv[i], "--step") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%lf:%lx", &g_step_sec, &g_step_mask) != 2 ||
+                g_step_sec < 0 || g_step_mask == 0) {
+                PRINT_ERROR("--step takes SEC:MASK, e.g. 2:0x000F");
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--switch-latency") == 0) {
+            switch_latency = 1;
+        } else if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc) {
+            switch_samples = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--coloc") == 0) {
+            coloc = 1;
+        } else if (strcmp(argv[i], "--be-kernel") == 0 && i + 1 < argc) {
+            const bench_kernel_t *kernel = bench_find(argv[++i]);
+            if (!kernel || kernel < rdt_kernels ||
+                kernel >= rdt_kernels + sizeof(rdt_kernels) / sizeof(rdt_kernels[0])) {
+                PRINT_ERROR("Unknown best-effort kernel \"%s\"", argv[i]);
+                return EXIT_FAILURE;
+            }
+            g_be_type = (benchmark_type_t)(kernel - rdt_kernels);
+        } else if (strcmp(argv[i], "--be-threads") == 0 && i + 1 < argc) {
+            g_be_threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--lc-wss") == 0 && i + 1 < argc) {
+            g_lc_wss = (size_t)atoi(argv[++i]) * 1024 * 1024;
+        } else if (strcmp(argv[i], "--lc-l3") == 0 && i + 1 < argc) {
+            custom.lc_l3_pct = atoi(argv[++i]);
+            have_custom = 1;
+        } else if (strcmp(argv[i], "--be-l3") == 0 && i + 1 < argc) {
+            custom.be_l3_pct = atoi(argv[++i]);
+            have_custom = 1;
+        } else if (strcmp(argv[i], "--be-mba") == 0 && i + 1 < argc) {
+            custom.be_mba = atoi(argv[++i]);
+            have_custom = 1;
+        } else if (argv[i][0] != '-') {
+            config_index = atoi(argv[i]);
+            if (config_index < 0 || config_index >= (int)(sizeof(benchmark_configs) / sizeof(benchmark_configs[0]))) {
+                PRINT_ERROR("Invalid configuration index: %d", config_index);
+                config_index = -1;
+            }
+        } else {
+            printf("Usage: %s [config_index] [--duration SEC] [--backend auto|msr|resctrl|mpam|sim] "
+                   "[harness options]\n", argv[0]);
+            printf("       %s --sweep KERNEL [--threads N] [--curve FILE] [--duration SEC] ...\n",
+                   argv[0]);
+            printf("  --dist D           Access distribution of cache_intensive/mixed: uniform (default),\n"
+                   "                     zipf or hotcold\n");
+            printf("  --wss MB           Random-access working set (default %d MB, mixed %d MB)\n",
+                   BENCH_CACHE_WSS / (1024 * 1024), BENCH_MIXED_WSS / (1024 * 1024));
+            printf("  --zipf-theta T     Zipf skew in (0, 1) (default %.2f)\n", WL_DEFAULT_THETA);
+            printf("  --hot F:P          hotcold: fraction P of accesses to fraction F of the set\n"
+                   "                     (default %.1f:%.1f)\n", WL_DEFAULT_HOT_FRACTION, WL_DEFAULT_HOT_PROB);
+            printf("  --mb-min PCT       Guaranteed bandwidth of the benchmark CLOS (MPAM MBW_MIN)\n");
+            printf("  --mb-peak GBPS     Bandwidth an MBA throttle is a share of where limits are\n"
+                   "                     absolute (AMD, resctrl mba_MBps); measured when omitted\n");
+            printf("  --pages P          Worker buffers on 4k (default), thp, 2m or 1g pages,\n"
+                   "                     bound to the worker's NUMA node\n");
+            printf("  --timeseries FILE  Throughput, MBM and LLC occupancy every interval as CSV\n");
+            printf("  --interval MS      Time series interval (default %.0f, minimum %.0f)\n",
+                   TS_DEFAULT_INTERVAL_MS, TS_MIN_INTERVAL_MS);
+            printf("  --step SEC:MASK    Switch the benchmark CLOS to L3 MASK SEC seconds into each run\n");
+            printf("  --sweep KERNEL     Run KERNEL with 1..CBM-length contiguous L3 ways\n");
+            printf("  --threads N        Sweep thread count (default: first config using KERNEL)\n");
+            printf("  --curve FILE       Write the sweep curve as CSV\n");
+            printf("       %s --coloc [--be-kernel K] [--be-threads N] [--lc-wss MB]\n"
+                   "                 [--lc-l3 PCT] [--be-l3 PCT] [--be-mba THROTTLE] ...\n", argv[0]);
+            printf("  --coloc            Latency-critical thread vs best-effort antagonists\n");
+            printf("  --be-kernel K      Antagonist kernel (default stream_copy)\n");
+            printf("  --be-threads N     Antagonist threads (default 4)\n");
+            printf("  --lc-wss MB        Latency-critical working set (default %d)\n",
+                   COLOC_LC_WSS / (1024 * 1024));
+            printf("  --lc-l3/--be-l3    L3 share in percent of ways; with --be-mba, run only\n"
+                   "                     this partitioning instead of the built-in scenarios\n");
+            printf("       %s --switch-latency [--samples N] [--backend msr|sim]\n", argv[0]);
+            printf("  --switch-latency   PQR_ASSOC write latency, fast path vs open/close, local vs remote\n");
+            bench_print_usage();
+            return EXIT_FAILURE;
+        }
+    }
+    if (g_duration <= 0) {
+        PRINT_ERROR("Invalid duration: %d", g_duration);
+        return EXIT_FAILURE;
+    }
+    if (ts_path) {
+        g_ts_file = strcmp(ts_path, "-") == 0 ? stdout : fopen(ts_path, "w");
+        if (!g_ts_file) {
+            PRINT_ERROR("Failed to open %s: %s", ts_path, strerror(errno));
+            return EXIT_FAILURE;
+        }
+        fprintf(g_ts_file, "run,config,time_s,throughput,unit,thread_min,thread_max,"
+                           "mbm_mbps,llc_kb,event\n");
+    }
+    if (g_workload.wss > BENCH_ARRAY_SIZE ||
+        (g_workload.wss && g_workload.wss < 2 * CACHE_LINE_SIZE)) {
+        PRINT_ERROR("Working set must be between 128 bytes and %d MB", BENCH_ARRAY_SIZE / (1024 * 1024));
+        return EXIT_FAILURE;
+    }
+    
+    benchmark_type_t sweep_type = BENCH_CACHE_INTENSIVE;
+    if (g_be_threads < 0 || g_be_threads >= MAX_THREADS || g_lc_wss == 0 ||
+        custom.lc_l3_pct <= 0 || custom.lc_l3_pct > 100 ||
+        custom.be_l3_pct <= 0 || custom.be_l3_pct > 100 ||
+        custom.be_mba < 0 || custom.be_mba > 100) {
+        PRINT_ERROR("Invalid colocation parameters");
+        return EXIT_FAILURE;
+    }
+    
+    if (sweep_kernel) {
+        const bench_kernel_t *kernel = bench_find(sweep_kernel);
+        if (!kernel) {
+            PRINT_ERROR("Unknown kernel \"%s\" (see --list)", sweep_kernel);
+            return EXIT_FAILURE;
+        }
+        if (kernel < rdt_kernels ||
+            kernel >= rdt_kernels + sizeof(rdt_kernels) / sizeof(rdt_kernels[0])) {
+            PRINT_ERROR("Kernel \"%s\" cannot be swept", sweep_kernel);
+            return EXIT_FAILURE;
+        }
+        sweep_type = (benchmark_type_t)(kernel - rdt_kernels);
+        if (sweep_threads < 0 || sweep_threads > MAX_THREADS) {
+            PRINT_ERROR("Invalid thread count: %d (1-%d)", sweep_threads, MAX_THREADS);
+            return EXIT_FAILURE;
+        }
+    }
+    if (switch_latency && switch_samples <= 0) {
+        PRINT_ERROR("Invalid sample count: %d", switch_samples);
+        return EXIT_FAILURE;
+    }
+    
     PRINT_INFO("Starting Comprehensive RDT Benchmark Suite");
     
     // Check permissions
-    if (check_root_permission() != SUCCESS) {
+    if (g_backend_type != RDT_BACKEND_SIM && check_root_permission() != SUCCESS) {
         return EXIT_FAILURE;
     }
     
@@ -140,28 +587,38 @@ int main(int argc, char *argv[]) {
         return EXIT_FAILURE;
     }
     
+    // Calibrate the timer, pin and lock frequency before any measurement
+    if (bench_begin(&opts) != SUCCESS) {
+        PRINT_ERROR("Failed to set up benchmark harness");
+        rdt_bench_cleanup();
+        return EXIT_FAILURE;
+    }
+    timing_print_info();
+    wl_config_print(&g_workload);
+    PRINT_INFO("Worker buffers: %s pages, first-touched on the worker's node", mem_page_name(g_pages));
+    
     // Set up signal handler
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
     
-    // Parse command line arguments
-    int config_index = -1;
-    if (argc > 1) {
-        config_index = atoi(argv[1]);
-        if (config_index < 0 || config_index >= (int)(sizeof(benchmark_configs) / sizeof(benchmark_configs[0]))) {
-            PRINT_ERROR("Invalid configuration index: %d", config_index);
-            config_index = -1;
-        }
-    }
-    
-    if (config_index == -1) {
+    if (switch_latency) {
+        run_switch_latency(switch_samples);
+    } else if (sweep_kernel) {
+        run_way_sweep(sweep_type, sweep_threads, curve_path);
+    } else if (coloc) {
+        run_colocation(have_custom ? &custom : NULL);
+    } else if (config_index == -1) {
         // Run all benchmark configurations
         PRINT_INFO("Running all RDT benchmark configurations...");
         for (size_t i = 0; i < sizeof(benchmark_configs) / sizeof(benchmark_configs[0]); i++) {
             if (!g_running) break;
             
+            if (!bench_kernel_selected(&rdt_kernels[benchmark_configs[i].bench_type])) {
+                continue;
+            }
+            
             PRINT_INFO("=== Configuration %zu: %s ===", i, benchmark_configs[i].name);
-            run_rdt_benchmark(&benchmark_configs[i]);
+            run_rdt_config(&benchmark_configs[i]);
             
             // Wait between configurations
             if (i < sizeof(benchmark_configs) / sizeof(benchmark_configs[0]) - 1) {
@@ -172,14 +629,21 @@ int main(int argc, char *argv[]) {
     } else {
         // Run specific configuration
         PRINT_INFO("Running configuration %d: %s", config_index, benchmark_configs[config_index].name);
-        run_rdt_benchmark(&benchmark_configs[config_index]);
+        run_rdt_config(&benchmark_configs[config_index]);
     }
     
     // Start RDT monitoring in background
-    PRINT_INFO("Starting RDT monitoring for comprehensive analysis...");
-    monitor_rdt_metrics(10);
+    if (!sweep_kernel && !coloc && !switch_latency && g_running) {
+        PRINT_INFO("Starting RDT monitoring for comprehensive analysis...");
+        monitor_rdt_metrics(10);
+    }
     
+    bench_end();
     rdt_bench_cleanup();
+    if (g_ts_file && g_ts_file != stdout) {
+        fclose(g_ts_file);
+        PRINT_INFO("Time series written to %s", ts_path);
+    }
     
     PRINT_INFO("RDT benchmark suite completed");
     return EXIT_SUCCESS;
@@ -187,57 +651,61 @@ int main(int argc, char *argv[]) {
 
 int rdt_bench_init(void) {
     // Check RDT support
-    if (check_cpu_feature("rdt_a") != SUCCESS) {
+    // MPAM has no CPUID bits; a mounted resctrl is its enumeration
+    if (g_backend_type != RDT_BACKEND_SIM && !cpu_has_feature(CPU_FEAT_RDT_A) &&
+        !rdt_resctrl_mounted()) {
         PRINT_ERROR("RDT not supported on this CPU");
         return ERROR_NOT_SUPPORTED;
     }
     
-    // Check MSR availability
-    if (msr_check_available() != SUCCESS) {
-        PRINT_ERROR("MSR access not available");
+    // resctrl when mounted, raw MSRs otherwise
+    if (rdt_backend_init(g_backend_type) != SUCCESS) {
         return ERROR_NOT_SUPPORTED;
     }
     
     // Initialize default CLOS configurations
     // CLOS 0: Default (all resources)
-    setup_rdt_clos(0, 0xFFFF, 0);
+    setup_rdt_clos(0, rdt_l3_full_mask(), 0);
+    
+    PRINT_INFO("L3 CAT: %d-bit CBM, %d CLOS, CDP %s; L2 CAT: %s; MBA: %s",
+               rdt_l3_cbm_len(), rdt_num_clos(),
+               rdt_has_cdp() ? (rdt_cdp_enabled() ? "on" : "off") : "n/a",
+               rdt_has_l2_cat() ? "yes" : "no",
+               rdt_has_mba() ? (rdt_mba_absolute() ? "absolute" :
+                                rdt_has_mba_min() ? "max+min" : "max") : "no");
+    if (rdt_mba_absolute() && g_mb_peak > 0) {
+        rdt_mba_set_reference(g_mb_peak);
+    }
+    if (rdt_l3_cbm_len() != CONFIG_CBM_LEN) {
+        PRINT_INFO("Configuration masks are scaled from %d ways to the %d-bit CBM",
+                   CONFIG_CBM_LEN, rdt_l3_cbm_len());
+    }
+    
+    // dTLB counters per worker; results show n/a without them
+    g_have_perf = perf_events_available();
     
     PRINT_INFO("RDT benchmark initialized");
     return SUCCESS;
 }
 
 void rdt_bench_cleanup(void) {
-    // Reset all threads to default CLOS
-    int cpu_count = get_cpu_count();
-    for (int cpu = 0; cpu < cpu_count; cpu++) {
-        uint64_t value;
-        if (msr_read_cpu(cpu, MSR_IA32_PQR_ASSOC, &value) == SUCCESS) {
-            value = value & 0x00000000FFFFFFFFULL;  // Clear CLOS bits
-            msr_write_cpu(cpu, MSR_IA32_PQR_ASSOC, value);
-        }
-    }
-    
-    // Reset CLOS configurations to default
-    for (int clos = 0; clos < 16; clos++) {
-        msr_write_cpu(0, MSR_IA32_L3_MASK_0 + clos, 0xFFFF);
-        if (check_cpu_feature("mba") == SUCCESS) {
-            msr_write_cpu(0, MSR_IA32_MBA_THRTL_MSR + clos, 0);
-        }
-    }
+    // Restores default allocations, returns threads/CPUs to CLOS 0 and
+    // removes any resctrl groups we created
+    rdt_backend_cleanup();
     
     PRINT_INFO("RDT benchmark cleanup completed");
 }
 
 int setup_rdt_clos(int clos_id, uint64_t l3_mask, uint64_t mb_throttle) {
-    // Set L3 cache allocation mask
-    if (msr_write_cpu(0, MSR_IA32_L3_MASK_0 + clos_id, l3_mask) != SUCCESS) {
+    // Set L3 cache allocation mask in every L3 domain
+    if (rdt_alloc_l3(clos_id, RDT_ALL_DOMAINS, l3_mask) != SUCCESS) {
         PRINT_ERROR("Failed to set L3 mask for CLOS %d", clos_id);
         return ERROR_SYSTEM;
     }
     
-    // Set memory bandwidth throttling (if supported)
-    if (check_cpu_feature("mba") == SUCCESS && mb_throttle > 0) {
-        if (msr_write_cpu(0, MSR_IA32_MBA_THRTL_MSR + clos_id, mb_throttle) != SUCCESS) {
+    // Set memory bandwidth throttling (if supported); 0 clears a previous limit
+    if (rdt_has_mba()) {
+        if (rdt_alloc_mba(clos_id, RDT_ALL_DOMAINS, (int)mb_throttle) != SUCCESS) {
             PRINT_INFO("Memory bandwidth throttling not supported or failed for CLOS %d", clos_id);
         }
     }
@@ -246,61 +714,215 @@ int setup_rdt_clos(int clos_id, uint64_t l3_mask, uint64_t mb_throttle) {
 }
 
 int assign_thread_to_clos(int clos_id) {
-    int cpu = sched_getcpu();
-    if (cpu < 0) {
-        return ERROR_SYSTEM;
+    return rdt_assign_task(clos_id, 0);
+}
+
+static double rdt_kernel_run(void *ctx) {
+    return run_rdt_benchmark((const rdt_config_t *)ctx);
+}
+
+// Sample one configuration through the harness, then show the last sample per thread
+void run_rdt_config(const rdt_config_t *builtin) {
+    const bench_kernel_t *kernel = &rdt_kernels[builtin->bench_type];
+    bench_stats_t stats;
+    int cdp_toggled = 0;
+    
+    // The same share of ways on whatever CBM (or MPAM portion bitmap) we have
+    rdt_config_t scaled = *builtin;
+    scaled.l3_mask = scale_config_mask(builtin->l3_mask);
+    scaled.code_mask = scale_config_mask(builtin->code_mask);
+    const rdt_config_t *config = &scaled;
+    
+    // A throttle percent needs the unthrottled bandwidth where limits are absolute
+    if (config->mb_throttle > 0 && rdt_mba_absolute() && rdt_mba_reference() <= 0) {
+        calibrate_mba_reference(config);
     }
     
-    uint64_t value;
-    if (msr_read_cpu(cpu, MSR_IA32_PQR_ASSOC, &value) != SUCCESS) {
-        return ERROR_SYSTEM;
+    // Setup RDT configuration
+    if (apply_rdt_partition(config, &cdp_toggled) != SUCCESS) {
+        PRINT_ERROR("Failed to setup RDT configuration");
+        undo_rdt_partition(config, cdp_toggled);
+        return;
     }
     
-    // Set CLOS ID in bits 63:32
-    value = (value & 0x00000000FFFFFFFFULL) | ((uint64_t)clos_id << 32);
+    memset(&g_mon_accum, 0, sizeof(g_mon_accum));
+    bench_run(kernel, (void *)config, config->name, &stats);
+    print_benchmark_results(config, thread_data, config->num_threads);
+    bench_print_stats(kernel, config->name, &stats);
+    PRINT_INFO("%s [%s]: median %.2f %s per thread (%d threads)", kernel->name, config->name,
+               stats.median / config->num_threads, kernel->unit, config->num_threads);
     
-    return msr_write_cpu(cpu, MSR_IA32_PQR_ASSOC, value);
+    undo_rdt_partition(config, cdp_toggled);
 }
 
-void run_rdt_benchmark(const rdt_config_t *config) {
-    // Setup RDT configuration
-    if (setup_rdt_clos(1, config->l3_mask, config->mb_throttle) != SUCCESS) {
-        PRINT_ERROR("Failed to setup RDT configuration");
+// One unthrottled second of the configuration. MBM gives the bandwidth on
+// every kernel; without it the memory kernels report their own MB/s.
+static void calibrate_mba_reference(const rdt_config_t *config) {
+    const bench_kernel_t *kernel = &rdt_kernels[config->bench_type];
+    int saved_duration = g_duration;
+    double gbps = 0.0;
+    
+    if (setup_rdt_clos(1, config->l3_mask, 0) != SUCCESS) {
+        return;
+    }
+    memset(&g_mon_accum, 0, sizeof(g_mon_accum));
+    g_duration = 1;
+    g_ts_suspended = 1;
+    double throughput = run_rdt_benchmark(config);
+    g_ts_suspended = 0;
+    g_duration = saved_duration;
+    
+    if (g_mon_accum.mbm_samples > 0 && g_mon_accum.mbm_mbps > 0) {
+        gbps = g_mon_accum.mbm_mbps / g_mon_accum.mbm_samples * (1024.0 * 1024.0) / 1e9;
+    } else if (config->bench_type == BENCH_MEMORY_INTENSIVE || config->bench_type == BENCH_STREAM_COPY) {
+        gbps = throughput * (1024.0 * 1024.0) / 1e9;
+    }
+    if (gbps <= 0) {
+        PRINT_ERROR("Could not measure the %s bandwidth; pass --mb-peak to apply MBA throttles",
+                    kernel->name);
         return;
     }
+    rdt_mba_set_reference(gbps);
+    PRINT_INFO("MBA reference: %.2f GB/s unthrottled (%s); throttles are shares of it",
+               gbps, kernel->name);
+}
+
+// Map a contiguous mask over CONFIG_CBM_LEN ways onto the real CBM, rounding
+// both edges to the nearest way so adjacent masks stay disjoint
+static uint64_t scale_config_mask(uint64_t mask) {
+    int cbm_len = rdt_l3_cbm_len();
+    if (!mask || cbm_len == CONFIG_CBM_LEN || cbm_len <= 0 || cbm_len > 63) {
+        return mask;
+    }
+    
+    int lo = __builtin_ctzll(mask);
+    int hi = 64 - __builtin_clzll(mask);        // One past the highest way
+    int new_lo = (lo * cbm_len + CONFIG_CBM_LEN / 2) / CONFIG_CBM_LEN;
+    int new_hi = (hi * cbm_len + CONFIG_CBM_LEN / 2) / CONFIG_CBM_LEN;
+    if (new_lo >= cbm_len) {
+        new_lo = cbm_len - 1;
+    }
+    if (new_hi <= new_lo) {
+        new_hi = new_lo + 1;
+    }
+    return ((1ULL << (new_hi - new_lo)) - 1) << new_lo;
+}
+
+// CLOS 1 masks of a configuration: L3 (split into code and data under
+// CDP), MBA and L2. Enabling CDP resets every mask, so it comes first.
+static int apply_rdt_partition(const rdt_config_t *config, int *cdp_toggled) {
+    *cdp_toggled = 0;
+    if (config->code_mask && !rdt_cdp_enabled()) {
+        if (rdt_cdp_enable(1) != SUCCESS) {
+            PRINT_INFO("L3 CDP not available, skipping %s", config->name);
+            return ERROR_NOT_SUPPORTED;
+        }
+        *cdp_toggled = 1;
+    }
+    
+    if (setup_rdt_clos(1, config->l3_mask, config->mb_throttle) != SUCCESS) {
+        return ERROR_SYSTEM;
+    }
+    if (config->code_mask &&
+        rdt_alloc_l3_cdp(1, RDT_ALL_DOMAINS, config->code_mask, config->l3_mask) != SUCCESS) {
+        PRINT_ERROR("Failed to set L3 code/data masks for CLOS 1");
+        return ERROR_SYSTEM;
+    }
+    if (config->l2_mask && rdt_alloc_l2(1, RDT_ALL_DOMAINS, config->l2_mask) != SUCCESS) {
+        PRINT_INFO("L2 CAT not available, skipping %s", config->name);
+        return ERROR_NOT_SUPPORTED;
+    }
+    if (g_mb_min > 0 && rdt_alloc_mba_min(1, RDT_ALL_DOMAINS, g_mb_min) != SUCCESS) {
+        PRINT_INFO("No minimum-bandwidth control on the %s backend, ignoring --mb-min",
+                   rdt_backend_name());
+        g_mb_min = 0;
+    }
+    return SUCCESS;
+}
+
+// Later configurations run unified, with the whole L2 and an unrestricted
+// CLOS 1; also called after a partial apply_rdt_partition()
+static void undo_rdt_partition(const rdt_config_t *config, int cdp_toggled) {
+    if (config->l2_mask) {
+        rdt_alloc_l2(1, RDT_ALL_DOMAINS, rdt_l2_full_mask());
+    }
+    if (cdp_toggled) {
+        rdt_cdp_enable(0);
+        setup_rdt_clos(0, rdt_l3_full_mask(), 0);
+    }
+    setup_rdt_clos(1, rdt_l3_full_mask(), 0);
+}
+
+// One sample: run all threads for g_duration seconds, return the summed throughput
+double run_rdt_benchmark(const rdt_config_t *config) {
+    double total_throughput = 0.0;
+    int cpus[MAX_THREADS];
+    int started = 0;
+    
+    if (g_interrupted) {
+        return 0.0;
+    }
+    
+    // One CPU per worker across the L3 domain, so each carries CLOS 1 itself
+    topo_pick_llc_cpus(cpus, config->num_threads);
     
     // Initialize thread data
     for (int i = 0; i < config->num_threads; i++) {
         thread_data[i].thread_id = i;
         thread_data[i].clos_id = 1;  // Use CLOS 1 for benchmark
+        thread_data[i].cpu = cpus[i];
         thread_data[i].bench_type = config->bench_type;
-        thread_data[i].data_size = BENCH_ARRAY_SIZE;
         thread_data[i].running = &g_running;
         thread_data[i].operations = 0;
         thread_data[i].throughput = 0.0;
         thread_data[i].latency = 0.0;
-        
-        // Allocate data for each thread
-        thread_data[i].data = malloc(thread_data[i].data_size);
-        if (!thread_data[i].data) {
-            PRINT_ERROR("Failed to allocate data for thread %d", i);
-            return;
-        }
-        
-        // Initialize data
-        memset(thread_data[i].data, 0x55, thread_data[i].data_size);
     }
     
-    // Create and start threads
+    // Workers build their own data on their own node, then wait at the gate
+    start_gate_reset();
     for (int i = 0; i < config->num_threads; i++) {
         if (pthread_create(&threads[i], NULL, benchmark_thread, &thread_data[i]) != 0) {
             PRINT_ERROR("Failed to create thread %d", i);
-            return;
+            break;
+        }
+        started++;
+    }
+    if (start_gate_wait(thread_data, started) != SUCCESS || started < config->num_threads) {
+        g_running = 0;
+        start_gate_release();
+        for (int i = 0; i < started; i++) {
+            pthread_join(threads[i], NULL);
+            release_thread_data(&thread_data[i]);
         }
+        g_running = !g_interrupted;
+        return 0.0;
     }
+    start_gate_release();
+    
+    ts_sampler_t sampler = { config, config->num_threads, g_ts_suspended ? 0 : ++g_ts_runs, 0, 0 };
+    pthread_t sampler_tid;
+    int sampling = !g_ts_suspended && (g_ts_file || g_step_sec >= 0) &&
+                   pthread_create(&sampler_tid, NULL, timeseries_thread, &sampler) == 0;
     
-    // Let benchmark run for specified duration
-    sleep(BENCHMARK_DURATION);
+    // Let benchmark run for specified duration, sampling MBM across the window
+    uint64_t mbm_start = 0, mbm_end = 0, llc_occupancy = 0;
+    int have_mbm = read_clos_monitor(1, RDT_MON_MBM_TOTAL, &mbm_start) == SUCCESS;
+    uint64_t mon_start = timing_now_ns();
+    
+    sleep(g_duration);
+    
+    // Occupancy is read while the threads still own their lines
+    have_mbm = have_mbm && read_clos_monitor(1, RDT_MON_MBM_TOTAL, &mbm_end) == SUCCESS;
+    uint64_t mon_end = timing_now_ns();
+    if (read_clos_monitor(1, RDT_MON_LLC_OCCUPANCY, &llc_occupancy) == SUCCESS) {
+        g_mon_accum.llc_kb += llc_occupancy / 1024.0;
+        g_mon_accum.llc_samples++;
+    }
+    if (have_mbm && mbm_end >= mbm_start && mon_end > mon_start) {
+        g_mon_accum.mbm_mbps += (double)(mbm_end - mbm_start) / (1024.0 * 1024.0) * 1e9 /
+                                (double)(mon_end - mon_start);
+        g_mon_accum.mbm_samples++;
+    }
     
     // Stop benchmark
     g_running = 0;
@@ -309,69 +931,211 @@ void run_rdt_benchmark(const rdt_config_t *config) {
     for (int i = 0; i < config->num_threads; i++) {
         pthread_join(threads[i], NULL);
     }
-    
-    // Print results
-    print_benchmark_results(config, thread_data, config->num_threads);
+    if (sampling) {
+        pthread_join(sampler_tid, NULL);
+        if (g_ts_file) {
+            PRINT_DEBUG("Run %d: %d time series rows, %d overruns", sampler.run, sampler.rows,
+                        sampler.overruns);
+        }
+    }
     
     // Cleanup thread data
     for (int i = 0; i < config->num_threads; i++) {
-        free(thread_data[i].data);
+        total_throughput += thread_data[i].throughput;
+        release_thread_data(&thread_data[i]);
     }
     
-    // Reset running flag
-    g_running = 1;
+    // Reset running flag unless the run was interrupted
+    g_running = !g_interrupted;
+    return total_throughput;
 }
 
 void* benchmark_thread(void *arg) {
     thread_data_t *data = (thread_data_t *)arg;
+    perf_tlb_t tlb;
     
-    // Assign thread to CLOS
-    if (assign_thread_to_clos(data->clos_id) != SUCCESS) {
+    // Every path reaches the gate, or the main thread would wait forever
+    data->status = SUCCESS;
+    data->have_tlb = 0;
+    if (data->cpu >= 0 && topo_pin_thread(data->cpu) != SUCCESS) {
+        PRINT_ERROR("Failed to pin thread %d to CPU %d", data->thread_id, data->cpu);
+        data->status = ERROR_SYSTEM;
+    } else if (assign_thread_to_clos(data->clos_id) != SUCCESS) {
         PRINT_ERROR("Failed to assign thread %d to CLOS %d", data->thread_id, data->clos_id);
+        data->status = ERROR_SYSTEM;
+    } else if (prepare_thread_data(data) != SUCCESS) {
+        // Data, access streams and chains are built outside the timed region
+        PRINT_ERROR("Failed to allocate data for thread %d", data->thread_id);
+        data->status = ERROR_SYSTEM;
+    }
+    start_gate_arrive();
+    if (data->status != SUCCESS) {
         return NULL;
     }
     
+    t_progress = &g_progress[data->thread_id];
+    data->have_tlb = g_have_perf && perf_tlb_open(&tlb, 0, -1, 0) == SUCCESS;
+    
     // Run benchmark based on type
-    data->start_time = get_timestamp_us();
+    double work = 0.0;
+    data->start_time = timing_now_ns();
     
     switch (data->bench_type) {
         case BENCH_CACHE_INTENSIVE:
-            data->throughput = benchmark_cache_intensive(data->data, data->data_size, data->running);
+            work = benchmark_cache_intensive(data->data, &data->stream, data->running);
             break;
         case BENCH_MEMORY_INTENSIVE:
-            data->throughput = benchmark_memory_intensive(data->data, data->data_size, data->running);
+            work = benchmark_memory_intensive(data->data, data->data_size, data->running);
             break;
         case BENCH_MIXED_WORKLOAD:
-            data->throughput = benchmark_mixed_workload(data->data, data->data_size, data->running);
+            work = benchmark_mixed_workload(data->data, data->data_size, &data->stream,
+                                            data->running);
             break;
         case BENCH_POINTER_CHASE:
-            data->throughput = benchmark_pointer_chase(data->data, data->data_size, data->running);
+            work = benchmark_pointer_chase(data->data, data->running);
             break;
         case BENCH_STREAM_COPY:
-            data->throughput = benchmark_stream_copy(data->data, data->data_size, data->running);
+            work = benchmark_stream_copy(data->data, data->dst.addr, data->data_size, data->running);
             break;
+        case BENCH_CODE_FOOTPRINT:
+            work = benchmark_code_footprint(data->data, data->data_size, data->running);
+            break;
+    }
+    
+    data->end_time = timing_now_ns();
+    data->latency = (data->end_time - data->start_time) / 1000000.0; // Convert to ms
+    if (data->have_tlb) {
+        data->have_tlb = perf_tlb_read(&tlb, &data->dtlb_loads, &data->dtlb_misses) == SUCCESS;
+        perf_tlb_close(&tlb);
     }
     
-    data->end_time = get_timestamp_us();
-    data->latency = (data->end_time - data->start_time) / 1000.0; // Convert to ms
+    // Kernels return total work (Mops or MB); normalize to a rate
+    double elapsed_sec = (data->end_time - data->start_time) / 1e9;
+    data->throughput = (elapsed_sec > 0) ? work / elapsed_sec : 0.0;
     
     return NULL;
 }
 
-double benchmark_cache_intensive(void *data, size_t size, volatile int *running) {
-    volatile int *array = (volatile int *)data;
-    size_t num_ints = size / sizeof(int);
-    uint64_t operations = 0;
+// Buffers and access patterns of one benchmark thread, built by the worker
+// itself after pinning so every page is faulted in on its node. Streams
+// are seeded by thread id, so every sample replays the same accesses.
+static int prepare_thread_data(thread_data_t *data) {
+    wl_config_t workload = g_workload;
+    uint64_t seed = (uint64_t)data->thread_id + 1;
+    int node = worker_node(data);
+    
+    memset(&data->stream, 0, sizeof(data->stream));
+    __atomic_store_n(&g_progress[data->thread_id].work, 0, __ATOMIC_RELAXED);
+    data->data_size = BENCH_ARRAY_SIZE;
+    if (mem_alloc(&data->buf, data->data_size, g_pages, node, 0x55) != SUCCESS) {
+        return ERROR_SYSTEM;
+    }
+    data->data = data->buf.addr;
+    data->page = data->buf.page;
+    data->node = data->buf.node;
     
-    // Cache-intensive workload: frequent random access to small data set
-    size_t working_set = num_ints / 16;  // Use 1/16 of array for high cache locality
+    switch (data->bench_type) {
+        case BENCH_CACHE_INTENSIVE:
+        case BENCH_MIXED_WORKLOAD:
+            if (!workload.wss) {
+                workload.wss = data->bench_type == BENCH_CACHE_INTENSIVE ? BENCH_CACHE_WSS : BENCH_MIXED_WSS;
+            }
+            if (wl_stream_build(&data->stream, &workload, workload.wss / CACHE_LINE_SIZE, seed) != SUCCESS) {
+                release_thread_data(data);
+                return ERROR_SYSTEM;
+            }
+            break;
+        case BENCH_POINTER_CHASE:
+            if (wl_chain_init(data->data, data->data_size, CACHE_LINE_SIZE, seed) != SUCCESS) {
+                release_thread_data(data);
+                return ERROR_SYSTEM;
+            }
+            break;
+        case BENCH_STREAM_COPY:
+            if (mem_alloc(&data->dst, data->data_size, g_pages, node, 0) != SUCCESS) {
+                release_thread_data(data);
+                return ERROR_SYSTEM;
+            }
+            break;
+        default:
+            break;
+    }
+    return SUCCESS;
+}
+
+static void release_thread_data(thread_data_t *data) {
+    mem_free(&data->buf);
+    mem_free(&data->dst);
+    data->data = NULL;
+    wl_stream_free(&data->stream);
+}
+
+// NUMA node of the worker's CPU (the current one when unpinned), -1 on
+// single-node machines where binding would only cost a syscall
+static int worker_node(const thread_data_t *data) {
+    const topology_t *topo = topology_get();
+    if (!topo || topo->num_nodes < 2) {
+        return -1;
+    }
+    return topo_cpu_node(data->cpu >= 0 ? data->cpu : sched_getcpu());
+}
+
+static void start_gate_reset(void) {
+    pthread_mutex_lock(&g_gate_lock);
+    g_gate_arrived = 0;
+    g_gate_open = 0;
+    pthread_mutex_unlock(&g_gate_lock);
+}
+
+// Worker side: report setup done, then block until the gate opens
+static void start_gate_arrive(void) {
+    pthread_mutex_lock(&g_gate_lock);
+    g_gate_arrived++;
+    pthread_cond_broadcast(&g_gate_cond);
+    while (!g_gate_open) {
+        pthread_cond_wait(&g_gate_cond, &g_gate_lock);
+    }
+    pthread_mutex_unlock(&g_gate_lock);
+}
+
+// Main side: wait for count workers, fail if any could not set up
+static int start_gate_wait(thread_data_t *workers, int count) {
+    pthread_mutex_lock(&g_gate_lock);
+    while (g_gate_arrived < count) {
+        pthread_cond_wait(&g_gate_cond, &g_gate_lock);
+    }
+    pthread_mutex_unlock(&g_gate_lock);
     
+    for (int i = 0; i < count; i++) {
+        if (workers[i].status != SUCCESS) {
+            return ERROR_SYSTEM;
+        }
+    }
+    return SUCCESS;
+}
+
+static void start_gate_release(void) {
+    pthread_mutex_lock(&g_gate_lock);
+    g_gate_open = 1;
+    pthread_cond_broadcast(&g_gate_cond);
+    pthread_mutex_unlock(&g_gate_lock);
+}
+
+double benchmark_cache_intensive(void *data, const wl_stream_t *stream, volatile int *running) {
+    char *array = (char *)data;
+    uint64_t operations = 0;
+    size_t pos = 0;
+    
+    // Cache-intensive workload: read-modify-write of lines drawn from the
+    // working set in the configured distribution
     while (*running) {
-        for (size_t i = 0; i < working_set && *running; i++) {
-            size_t index = (rand() % working_set);
-            array[index] += array[(index + 1) % working_set];
-            operations++;
+        for (int i = 0; i < 4096; i++) {
+            volatile int *line = (volatile int *)(array + (size_t)stream->index[pos] * CACHE_LINE_SIZE);
+            line[0] += line[1];
+            pos = (pos + 1) & stream->mask;
         }
+        operations += 4096;
+        publish_progress(operations);
     }
     
     return (double)operations / 1000000.0;  // Return millions of operations per second
@@ -387,23 +1151,29 @@ double benchmark_memory_intensive(void *data, size_t size, volatile int *running
             // Read and write to cause memory traffic
             array[i] = array[i] + 1;
             bytes_processed += CACHE_LINE_SIZE;
+            if ((bytes_processed & ((256 * 1024) - 1)) == 0) {
+                publish_progress(bytes_processed);
+            }
         }
     }
     
     return (double)bytes_processed / (1024 * 1024);  // Return MB/s
 }
 
-double benchmark_mixed_workload(void *data, size_t size, volatile int *running) {
+double benchmark_mixed_workload(void *data, size_t size, const wl_stream_t *stream,
+                                volatile int *running) {
     volatile int *array = (volatile int *)data;
     size_t num_ints = size / sizeof(int);
     uint64_t operations = 0;
+    size_t pos = 0;
     
     // Mixed workload: combination of cache-intensive and memory-intensive operations
     while (*running) {
         // Cache-intensive phase
         for (int i = 0; i < 1000 && *running; i++) {
-            size_t index = rand() % (num_ints / 32);
-            array[index] += array[(index + 1) % (num_ints / 32)];
+            volatile int *line = array + (size_t)stream->index[pos] * (CACHE_LINE_SIZE / sizeof(int));
+            line[0] += line[1];
+            pos = (pos + 1) & stream->mask;
             operations++;
         }
         
@@ -412,59 +1182,45 @@ double benchmark_mixed_workload(void *data, size_t size, volatile int *running)
             array[i] = array[i] + 1;
             operations++;
         }
+        publish_progress(operations);
     }
     
     return (double)operations / 1000000.0;
 }
 
-double benchmark_pointer_chase(void *data, size_t size, volatile int *running) {
-    typedef struct node {
-        struct node *next;
-        char padding[CACHE_LINE_SIZE - sizeof(struct node *)];
-    } node_t;
-    
-    node_t *nodes = (node_t *)data;
-    size_t num_nodes = size / sizeof(node_t);
+// The random cycle through every line is built by prepare_thread_data()
+double benchmark_pointer_chase(void *data, volatile int *running) {
+    void **current = (void **)data;
     uint64_t operations = 0;
     
-    // Create a random pointer chain
-    for (size_t i = 0; i < num_nodes - 1; i++) {
-        nodes[i].next = &nodes[i + 1];
-    }
-    nodes[num_nodes - 1].next = &nodes[0];
-    
-    // Shuffle the chain
-    for (size_t i = 0; i < num_nodes; i++) {
-        size_t j = rand() % num_nodes;
-        node_t *temp = nodes[i].next;
-        nodes[i].next = nodes[j].next;
-        nodes[j].next = temp;
-    }
-    
-    // Perform pointer chase
-    node_t *current = &nodes[0];
     while (*running) {
-        for (size_t i = 0; i < num_nodes && *running; i++) {
-            current = current->next;
-            operations++;
+        for (int i = 0; i < 4096; i++) {
+            current = (void **)*current;
         }
+        operations += 4096;
+        publish_progress(operations);
     }
     
+    // Keep the chase live
+    __asm__ volatile("" : : "r"(current));
     return (double)operations / 1000000.0;
 }
 
-double benchmark_stream_copy(void *data, size_t size, volatile int *running) {
+// dst is the worker's second buffer, faulted in by prepare_thread_data()
+double benchmark_stream_copy(void *data, void *dst_data, size_t size, volatile int *running) {
     char *src = (char *)data;
-    char *dst = (char *)malloc(size);
-    if (!dst) return 0.0;
-    
-    char *original_dst = dst;  // Keep track of original malloc'd pointer
+    char *dst = (char *)dst_data;
     uint64_t bytes_copied = 0;
     
-    // Stream copy workload: bandwidth-intensive
+    // Stream copy workload: bandwidth-intensive, copied in chunks so
+    // progress is visible at millisecond intervals
     while (*running) {
-        memcpy(dst, src, size);
-        bytes_copied += size;
+        for (size_t off = 0; off < size; off += STREAM_CHUNK) {
+            size_t len = size - off < STREAM_CHUNK ? size - off : STREAM_CHUNK;
+            memcpy(dst + off, src + off, len);
+            bytes_copied += len;
+            publish_progress(bytes_copied);
+        }
         
         // Swap src and dst to keep working
         char *temp = src;
@@ -472,82 +1228,181 @@ double benchmark_stream_copy(void *data, size_t size, volatile int *running) {
         dst = temp;
     }
     
-    // Free the originally allocated memory
-    if (original_dst == src) {
-        free(src);
-    } else {
-        free(original_dst);
+    return (double)bytes_copied / (1024 * 1024);  // Return MB/s
+}
+
+// Generate CODE_FUNCS x86-64 functions of CODE_FUNC_SIZE bytes each:
+// xor eax,eax; add eax,imm32 repeated; ret. Calling them in random order
+// streams instruction fetches through the whole block, the pattern of JIT
+// code and large binaries that CDP protects from data traffic.
+static void code_footprint_build(void) {
+#if defined(__x86_64__)
+    size_t size = (size_t)CODE_FUNCS * CODE_FUNC_SIZE;
+    uint8_t *code = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code == MAP_FAILED) {
+        PRINT_ERROR("Failed to map %zu bytes for generated code", size);
+        return;
     }
     
-    return (double)bytes_copied / (1024 * 1024);  // Return MB/s
+    for (int f = 0; f < CODE_FUNCS; f++) {
+        uint8_t *p = code + (size_t)f * CODE_FUNC_SIZE;
+        uint8_t *end = p + CODE_FUNC_SIZE - 1;
+        *p++ = 0x31;            // xor eax, eax
+        *p++ = 0xC0;
+        for (uint32_t imm = (uint32_t)f; p + 5 <= end; imm++) {
+            *p++ = 0x05;        // add eax, imm32
+            memcpy(p, &imm, sizeof(imm));
+            p += sizeof(imm);
+        }
+        *p = 0xC3;              // ret
+    }
+    
+    if (mprotect(code, size, PROT_READ | PROT_EXEC) != 0) {
+        PRINT_ERROR("Failed to make generated code executable");
+        munmap(code, size);
+        return;
+    }
+    g_code = code;
+#endif
+}
+
+double benchmark_code_footprint(void *data, size_t size, volatile int *running) {
+    volatile char *array = (volatile char *)data;
+    size_t num_lines = size / CACHE_LINE_SIZE;
+    uint64_t calls = 0;
+    uint32_t sink = 0;
+    wl_xorshift_t rng;
+    
+    wl_xorshift_seed(&rng, (uint64_t)(uintptr_t)&calls);   // Per-thread seed
+    
+    pthread_once(&g_code_once, code_footprint_build);
+    if (!g_code) {
+        return 0.0;
+    }
+    
+    // Random function order defeats the prefetchers; a data line per call
+    // keeps data traffic competing with code for the LLC
+    while (*running) {
+        for (int i = 0; i < 1024; i++) {
+            uint64_t r = wl_xorshift_next(&rng);
+            uint32_t (*fn)(void) =
+                (uint32_t (*)(void))(void *)(g_code + wl_bounded(r, CODE_FUNCS) * CODE_FUNC_SIZE);
+            sink += fn();
+            array[wl_bounded(r << 16 | r >> 48, num_lines) * CACHE_LINE_SIZE] += (char)sink;
+            calls++;
+        }
+        publish_progress(calls);
+    }
+    
+    return (double)calls / 1000000.0;
 }
 
 void print_benchmark_results(const rdt_config_t *config, thread_data_t *results, int num_threads) {
     printf("\n=== Benchmark Results: %s ===\n", config->name);
-    printf("L3 Cache Mask: 0x%04lX\n", config->l3_mask);
+    if (config->code_mask) {
+        printf("L3 Code Mask: 0x%04lX  Data Mask: 0x%04lX\n", config->code_mask, config->l3_mask);
+    } else {
+        printf("L3 Cache Mask: 0x%04lX\n", config->l3_mask);
+    }
+    if (config->l2_mask) {
+        printf("L2 Cache Mask: 0x%04lX\n", config->l2_mask & rdt_l2_full_mask());
+    }
     printf("Memory Bandwidth Throttle: %lu%%\n", config->mb_throttle);
+    if (config->mb_throttle > 0 && rdt_mba_absolute() && rdt_mba_reference() > 0) {
+        double limit = rdt_mba_reference() * (100 - config->mb_throttle) / 100.0;
+        printf("Memory Bandwidth Limit: %.2f GB/s (of %.2f GB/s reference)\n",
+               limit < 0.125 ? 0.125 : limit, rdt_mba_reference());
+    }
+    if (g_mb_min > 0) {
+        printf("Memory Bandwidth Minimum: %d%%\n", g_mb_min);
+    }
     printf("Number of Threads: %d\n", num_threads);
     printf("Benchmark Type: %s\n", 
            (config->bench_type == BENCH_CACHE_INTENSIVE) ? "Cache Intensive" :
            (config->bench_type == BENCH_MEMORY_INTENSIVE) ? "Memory Intensive" :
            (config->bench_type == BENCH_MIXED_WORKLOAD) ? "Mixed Workload" :
            (config->bench_type == BENCH_POINTER_CHASE) ? "Pointer Chase" :
-           (config->bench_type == BENCH_STREAM_COPY) ? "Stream Copy" : "Unknown");
+           (config->bench_type == BENCH_STREAM_COPY) ? "Stream Copy" :
+           (config->bench_type == BENCH_CODE_FOOTPRINT) ? "Code Footprint" : "Unknown");
+    
+    printf("Pages: %s (requested %s)\n", mem_page_name(results[0].page), mem_page_name(g_pages));
     
     printf("\nPer-Thread Results:\n");
-    printf("Thread  Throughput    Latency(ms)  Duration(s)\n");
-    printf("------  ----------    -----------  -----------\n");
+    printf("Thread  Throughput    Latency(ms)  Duration(s)  Node  dTLB miss\n");
+    printf("------  ----------    -----------  -----------  ----  ---------\n");
     
     double total_throughput = 0.0;
     double avg_latency = 0.0;
+    uint64_t tlb_loads = 0, tlb_misses = 0;
+    double work = 0.0;
+    int have_tlb = num_threads > 0;
     
     for (int i = 0; i < num_threads; i++) {
-        double duration = (results[i].end_time - results[i].start_time) / 1000000.0;
-        printf("%6d  %10.2f    %11.2f  %11.2f\n", 
-               i, results[i].throughput, results[i].latency, duration);
+        double duration = (results[i].end_time - results[i].start_time) / 1e9;
+        char tlb[16] = "n/a";
+        if (results[i].have_tlb && results[i].dtlb_loads) {
+            snprintf(tlb, sizeof(tlb), "%.3f%%", 100.0 * results[i].dtlb_misses / results[i].dtlb_loads);
+        }
+        printf("%6d  %10.2f    %11.2f  %11.2f  %4d  %9s\n", 
+               i, results[i].throughput, results[i].latency, duration, results[i].node, tlb);
         total_throughput += results[i].throughput;
         avg_latency += results[i].latency;
+        work += results[i].throughput * duration;
+        have_tlb = have_tlb && results[i].have_tlb;
+        tlb_loads += results[i].dtlb_loads;
+        tlb_misses += results[i].dtlb_misses;
     }
     
-    printf("------  ----------    -----------  -----------\n");
+    printf("------  ----------    -----------  -----------  ----  ---------\n");
     printf("Total   %10.2f    %11.2f\n", total_throughput, avg_latency / num_threads);
+    printf("Per thread %7.2f %s\n", total_throughput / num_threads, rdt_kernels[config->bench_type].unit);
+    
+    // Vendor-neutral view of what the partition allowed
+    if (g_mon_accum.mbm_samples > 0 && g_mon_accum.mbm_mbps > 0) {
+        printf("Monitored: %.2f GB/s memory bandwidth (mean of %d samples)\n",
+               g_mon_accum.mbm_mbps / g_mon_accum.mbm_samples * (1024.0 * 1024.0) / 1e9,
+               g_mon_accum.mbm_samples);
+    }
+    if (g_mon_accum.llc_samples > 0 && g_mon_accum.llc_kb > 0) {
+        printf("Monitored: %.0f KB LLC occupancy (mean of %d samples)\n",
+               g_mon_accum.llc_kb / g_mon_accum.llc_samples, g_mon_accum.llc_samples);
+    }
+    
+    // Misses per unit of work compare page sizes even without a load count
+    if (have_tlb && work > 0) {
+        printf("dTLB misses: %.0f per %s", (double)tlb_misses / work,
+               (config->bench_type == BENCH_MEMORY_INTENSIVE ||
+                config->bench_type == BENCH_STREAM_COPY) ? "MB" : "Mop");
+        if (tlb_loads) {
+            printf(", %.3f%% of loads", 100.0 * tlb_misses / tlb_loads);
+        }
+        printf("\n");
+    } else {
+        printf("dTLB misses: n/a (perf events unavailable)\n");
+    }
     printf("\n");
 }
 
 void monitor_rdt_metrics(int duration) {
     PRINT_INFO("Monitoring RDT metrics for %d seconds...", duration);
     
-    uint64_t start_time = get_timestamp_us();
-    uint64_t end_time = start_time + (uint64_t)duration * 1000000;
+    uint64_t start_time = timing_now_ns();
+    uint64_t end_time = start_time + (uint64_t)duration * 1000000000ULL;
     
     printf("Time(s)  LLC Occupancy(KB)  MBM Total(MB/s)  MBM Local(MB/s)\n");
     printf("-------  -----------------  ---------------  ---------------\n");
     
     uint64_t prev_mbm_total = 0, prev_mbm_local = 0;
-    uint64_t prev_timestamp = start_time;
+    uint64_t prev_timestamp = 0;    // No rate until two samples exist
     
-    while (get_timestamp_us() < end_time) {
+    while (timing_now_ns() < end_time) {
         uint64_t llc_occupancy = 0, mbm_total = 0, mbm_local = 0;
-        uint64_t curr_timestamp = get_timestamp_us();
+        uint64_t curr_timestamp = timing_now_ns();
         
-        // Try to read RDT monitoring data
-        // Note: This may show simulated data if hardware monitoring is not available
-        uint64_t evtsel = 0 | (1ULL << 32);  // LLC occupancy
-        if (msr_write_cpu(0, MSR_IA32_QM_EVTSEL, evtsel) == SUCCESS) {
-            if (msr_read_cpu(0, MSR_IA32_QM_CTR, &llc_occupancy) == SUCCESS) {
-                llc_occupancy *= 64;  // Convert to bytes
-            }
-        }
-        
-        evtsel = 0 | (2ULL << 32);  // MBM total
-        if (msr_write_cpu(0, MSR_IA32_QM_EVTSEL, evtsel) == SUCCESS) {
-            msr_read_cpu(0, MSR_IA32_QM_CTR, &mbm_total);
-        }
-        
-        evtsel = 0 | (3ULL << 32);  // MBM local
-        if (msr_write_cpu(0, MSR_IA32_QM_EVTSEL, evtsel) == SUCCESS) {
-            msr_read_cpu(0, MSR_IA32_QM_CTR, &mbm_local);
-        }
+        // Default group (CLOS 0 / RMID 0) in the first L3 domain
+        rdt_mon_read(0, 0, RDT_MON_LLC_OCCUPANCY, &llc_occupancy);
+        rdt_mon_read(0, 0, RDT_MON_MBM_TOTAL, &mbm_total);
+        rdt_mon_read(0, 0, RDT_MON_MBM_LOCAL, &mbm_local);
         
         // Calculate rates
         if (prev_timestamp > 0) {
@@ -555,12 +1410,12 @@ void monitor_rdt_metrics(int duration) {
             uint64_t mbm_total_rate = 0, mbm_local_rate = 0;
             
             if (time_diff > 0) {
-                mbm_total_rate = (mbm_total - prev_mbm_total) * 1000000 / time_diff;
-                mbm_local_rate = (mbm_local - prev_mbm_local) * 1000000 / time_diff;
+                mbm_total_rate = (uint64_t)((double)(mbm_total - prev_mbm_total) * 1e9 / time_diff);
+                mbm_local_rate = (uint64_t)((double)(mbm_local - prev_mbm_local) * 1e9 / time_diff);
             }
             
             printf("%7.1f  %17lu  %15lu  %15lu\n",
-                   (curr_timestamp - start_time) / 1000000.0,
+                   (curr_timestamp - start_time) / 1e9,
                    llc_occupancy / 1024,
                    mbm_total_rate / (1024 * 1024),
                    mbm_local_rate / (1024 * 1024));
@@ -576,8 +1431,606 @@ void monitor_rdt_metrics(int duration) {
     printf("\nRDT monitoring completed.\n");
 }
 
+// Workers publish their running work count for the time series sampler
+static inline void publish_progress(uint64_t work) {
+    if (t_progress) {
+        __atomic_store_n(&t_progress->work, work, __ATOMIC_RELAXED);
+    }
+}
+
+// Progress units to the kernel's reported unit (Mops or MB)
+static double work_scale(benchmark_type_t type) {
+    if (type == BENCH_MEMORY_INTENSIVE || type == BENCH_STREAM_COPY) {
+        return 1.0 / (1024.0 * 1024.0);
+    }
+    return 1e-6;
+}
+
+static uint64_t mono_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Snapshot every worker's progress slot, MBM and LLC occupancy of the
+// benchmark CLOS at each interval; with --step, also switch the CLOS mask
+// partway through so the transient shows up in the series
+void *timeseries_thread(void *arg) {
+    ts_sampler_t *sampler = (ts_sampler_t *)arg;
+    const rdt_config_t *config = sampler->config;
+    const char *unit = rdt_kernels[config->bench_type].unit;
+    double scale = work_scale(config->bench_type);
+    uint64_t prev_work[MAX_THREADS] = { 0 };
+    uint64_t mbm_prev = 0;
+    int have_mbm = read_clos_monitor(1, RDT_MON_MBM_TOTAL, &mbm_prev) == SUCCESS;
+    uint64_t start = mono_ns();
+    uint64_t prev = start;
+    uint64_t next = start;
+    int stepped = 0;
+    
+    // Workers started before the sampler; rates count from here
+    for (int i = 0; i < sampler->num_threads; i++) {
+        prev_work[i] = __atomic_load_n(&g_progress[i].work, __ATOMIC_RELAXED);
+    }
+    
+    while (g_running) {
+        next += g_ts_interval_ns;
+        struct timespec ts = { (time_t)(next / 1000000000ULL), (long)(next % 1000000000ULL) };
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+        if (!g_running) {
+            break;
+        }
+        
+        uint64_t now = mono_ns();
+        double dt = (double)(now - prev) / 1e9;
+        double total = 0.0, thread_min = 0.0, thread_max = 0.0;
+        for (int i = 0; i < sampler->num_threads; i++) {
+            uint64_t work = __atomic_load_n(&g_progress[i].work, __ATOMIC_RELAXED);
+            double rate = (double)(work - prev_work[i]) * scale / dt;
+            prev_work[i] = work;
+            total += rate;
+            thread_min = (i == 0 || rate < thread_min) ? rate : thread_min;
+            thread_max = (i == 0 || rate > thread_max) ? rate : thread_max;
+        }
+        
+        double mbm_mbps = -1.0, llc_kb = -1.0;
+        uint64_t value;
+        if (have_mbm && read_clos_monitor(1, RDT_MON_MBM_TOTAL, &value) == SUCCESS) {
+            mbm_mbps = value >= mbm_prev ? (double)(value - mbm_prev) / (1024.0 * 1024.0) / dt : 0.0;
+            mbm_prev = value;
+        }
+        if (read_clos_monitor(1, RDT_MON_LLC_OCCUPANCY, &value) == SUCCESS) {
+            llc_kb = value / 1024.0;
+        }
+        
+        char event[48] = "";
+        if (!stepped && g_step_sec >= 0 && (double)(now - start) / 1e9 >= g_step_sec) {
+            if (rdt_alloc_l3(1, RDT_ALL_DOMAINS, g_step_mask) == SUCCESS) {
+                snprintf(event, sizeof(event), "l3_mask=0x%lx", g_step_mask);
+            }
+            stepped = 1;
+        }
+        
+        if (g_ts_file) {
+            fprintf(g_ts_file, "%d,\"%s\",%.4f,%.3f,%s,%.3f,%.3f,%.1f,%.0f,%s\n",
+                    sampler->run, config->name, (double)(now - start) / 1e9, total, unit,
+                    thread_min, thread_max, mbm_mbps, llc_kb, event);
+            sampler->rows++;
+        }
+        
+        // Fell behind: drop the missed deadlines rather than bunching samples
+        prev = now;
+        if (now > next + g_ts_interval_ns) {
+            uint64_t missed = (now - next) / g_ts_interval_ns;
+            sampler->overruns += (int)missed;
+            next += missed * g_ts_interval_ns;
+        }
+    }
+    
+    // Later samples of this configuration start from its own masks
+    if (stepped) {
+        if (config->code_mask) {
+            rdt_alloc_l3_cdp(1, RDT_ALL_DOMAINS, config->code_mask, config->l3_mask);
+        } else {
+            rdt_alloc_l3(1, RDT_ALL_DOMAINS, config->l3_mask);
+        }
+    }
+    if (g_ts_file) {
+        fflush(g_ts_file);
+    }
+    return NULL;
+}
+
+// Sum a monitoring event for one CLOS over every L3 domain
+static int read_clos_monitor(int clos, rdt_mon_event_t event, uint64_t *bytes) {
+    uint64_t total = 0;
+    
+    for (int d = 0; d < rdt_num_domains(); d++) {
+        uint64_t value;
+        if (rdt_mon_read(clos, d, event, &value) != SUCCESS) {
+            return ERROR_NOT_SUPPORTED;
+        }
+        total += value;
+    }
+    *bytes = total;
+    return SUCCESS;
+}
+
+// Run one kernel with 1, 2, ... cbm_len contiguous low L3 ways and record
+// throughput, LLC occupancy and MBM bandwidth at each step
+int run_way_sweep(benchmark_type_t bench_type, int num_threads, const char *curve_path) {
+    const bench_kernel_t *kernel = &rdt_kernels[bench_type];
+    int cbm_len = rdt_l3_cbm_len();
+    sweep_point_t *points;
+    int count = 0;
+    
+    if (cbm_len <= 0 || cbm_len > 63) {
+        PRINT_ERROR("L3 CAT capacity bitmask length unknown (CPUID leaf 0x10 or resctrl cbm_mask)");
+        return ERROR_NOT_SUPPORTED;
+    }
+    
+    if (num_threads == 0) {
+        num_threads = 1;
+        for (size_t i = 0; i < sizeof(benchmark_configs) / sizeof(benchmark_configs[0]); i++) {
+            if (benchmark_configs[i].bench_type == bench_type) {
+                num_threads = benchmark_configs[i].num_threads;
+                break;
+            }
+        }
+    }
+    
+    points = calloc(cbm_len, sizeof(sweep_point_t));
+    if (!points) {
+        PRINT_ERROR("Failed to allocate sweep results");
+        return ERROR_SYSTEM;
+    }
+    
+    PRINT_INFO("Sweeping %s over 1-%d L3 ways with %d thread(s), %d s per sample",
+               kernel->name, cbm_len, num_threads, g_duration);
+    
+    for (int ways = 1; ways <= cbm_len && g_running; ways++) {
+        char name[64];
+        sweep_point_t *point = &points[count];
+        rdt_config_t config = {
+            .name = name,
+            .l3_mask = (1ULL << ways) - 1,
+            .mb_throttle = 0,
+            .num_threads = num_threads,
+            .bench_type = bench_type
+        };
+        
+        snprintf(name, sizeof(name), "ways=%d,threads=%d", ways, num_threads);
+        
+        // Some parts need more than one way per CBM; skip masks the backend rejects
+        if (setup_rdt_clos(1, config.l3_mask, 0) != SUCCESS) {
+            PRINT_INFO("Skipping %d way(s): mask 0x%lx rejected", ways, config.l3_mask);
+            continue;
+        }
+        
+        memset(&g_mon_accum, 0, sizeof(g_mon_accum));
+        if (bench_run(kernel, &config, name, &point->stats) != SUCCESS || g_interrupted) {
+            break;
+        }
+        
+        point->ways = ways;
+        point->mask = config.l3_mask;
+        if (g_mon_accum.llc_samples > 0) {
+            point->llc_kb = g_mon_accum.llc_kb / g_mon_accum.llc_samples;
+        }
+        if (g_mon_accum.mbm_samples > 0) {
+            point->mbm_mbps = g_mon_accum.mbm_mbps / g_mon_accum.mbm_samples;
+        }
+        PRINT_INFO("%2d way(s) mask 0x%05lx: %.2f %s, LLC %.0f KB, MBM %.1f MB/s",
+                   ways, point->mask, point->stats.median, kernel->unit,
+                   point->llc_kb, point->mbm_mbps);
+        count++;
+    }
+    
+    // Leave CLOS 1 with the full cache again
+    setup_rdt_clos(1, rdt_l3_full_mask(), 0);
+    
+    if (count > 0) {
+        print_sweep_curve(kernel, points, count);
+        if (curve_path) {
+            write_sweep_curve(curve_path, kernel, points, count);
+        }
+    }
+    
+    free(points);
+    return count > 0 ? SUCCESS : ERROR_SYSTEM;
+}
+
+// Memory traffic per unit of work stands in for the miss ratio: a kernel
+// that stops missing in its ways stops generating MBM traffic
+static double sweep_traffic_per_work(const sweep_point_t *point) {
+    return point->stats.median > 0 ? point->mbm_mbps / point->stats.median : 0.0;
+}
+
+static void print_sweep_curve(const bench_kernel_t *kernel, const sweep_point_t *points, int count) {
+    double full = points[count - 1].stats.median;
+    
+    printf("\n=== Cache-Way Sweep: %s ===\n", kernel->name);
+    printf("Ways  L3 Mask   %12s  CI95 (+/-)  Rel Full  LLC Occ(KB)  MBM(MB/s)  MB/work\n",
+           kernel->unit);
+    printf("----  --------  ------------  ----------  --------  -----------  ---------  -------\n");
+    
+    for (int i = 0; i < count; i++) {
+        const sweep_point_t *p = &points[i];
+        printf("%4d  0x%06lx  %12.2f  %10.2f  %7.1f%%  %11.0f  %9.1f  %7.4f\n",
+               p->ways, p->mask, p->stats.median,
+               (p->stats.ci95_hi - p->stats.ci95_lo) / 2,
+               full > 0 ? p->stats.median / full * 100.0 : 0.0,
+               p->llc_kb, p->mbm_mbps, sweep_traffic_per_work(p));
+    }
+    printf("\n");
+}
+
+static int write_sweep_curve(const char *path, const bench_kernel_t *kernel,
+                             const sweep_point_t *points, int count) {
+    FILE *fp = strcmp(path, "-") == 0 ? stdout : fopen(path, "w");
+    if (!fp) {
+        PRINT_ERROR("Failed to open %s: %s", path, strerror(errno));
+        return ERROR_SYSTEM;
+    }
+    
+    fprintf(fp, "kernel,unit,ways,mask,median,ci95_lo,ci95_hi,llc_occupancy_kb,mbm_mbps,mbm_per_work\n");
+    for (int i = 0; i < count; i++) {
+        const sweep_point_t *p = &points[i];
+        fprintf(fp, "%s,%s,%d,0x%lx,%.6g,%.6g,%.6g,%.1f,%.3f,%.6g\n",
+                kernel->name, kernel->unit, p->ways, p->mask, p->stats.median,
+                p->stats.ci95_lo, p->stats.ci95_hi, p->llc_kb, p->mbm_mbps,
+                sweep_traffic_per_work(p));
+    }
+    
+    if (fp != stdout) {
+        fclose(fp);
+        PRINT_SUCCESS("Sweep curve written to %s", path);
+    }
+    return SUCCESS;
+}
+
+// Contiguous mask covering pct% of the CBM, at the high or low end
+static uint64_t coloc_ways_mask(int pct, int high) {
+    int cbm_len = rdt_l3_cbm_len();
+    if (cbm_len <= 0 || cbm_len > 63 || pct >= 100) {
+        return rdt_l3_full_mask();
+    }
+    
+    int ways = (cbm_len * pct + 50) / 100;
+    if (ways < 1) ways = 1;
+    uint64_t mask = (1ULL << ways) - 1;
+    return high ? mask << (cbm_len - ways) : mask;
+}
+
+// --be-threads overrides the scenarios that have antagonists at all
+static int coloc_num_be(const coloc_config_t *config) {
+    if (config->be_threads == 0) {
+        return 0;
+    }
+    return g_be_threads > 0 ? g_be_threads : config->be_threads;
+}
+
+// Closed-loop request/response service: each request walks
+// COLOC_REQUEST_HOPS dependent lines of the working set
+void *lc_request_thread(void *arg) {
+    lc_thread_t *lc = (lc_thread_t *)arg;
+    void **p = (void **)lc->chain;
+    
+    if (topo_pin_thread(lc->cpu) != SUCCESS ||
+        assign_thread_to_clos(COLOC_LC_CLOS) != SUCCESS) {
+        PRINT_ERROR("Failed to place latency-critical thread on CPU %d", lc->cpu);
+        return NULL;
+    }
+    
+    while (*lc->running) {
+        uint64_t start = timing_start();
+        for (int hop = 0; hop < COLOC_REQUEST_HOPS; hop++) {
+            p = (void **)*p;
+        }
+        uint64_t end = timing_stop();
+        hist_record(&lc->hist, (uint64_t)timing_ticks_to_ns(end - start));
+    }
+    
+    // Keep the chase from being optimized away
+    g_lc_sink = p;
+    return NULL;
+}
+
+static double coloc_kernel_run(void *ctx) {
+    return run_coloc_sample((const coloc_config_t *)ctx);
+}
+
+// One sample: LC thread plus BE antagonists for g_duration seconds
+double run_coloc_sample(const coloc_config_t *config) {
+    int num_be = coloc_num_be(config);
+    int cpus[MAX_THREADS];
+    pthread_t lc_tid;
+    int started = 0;
+    
+    if (g_interrupted) {
+        return 0.0;
+    }
+    
+    topo_pick_llc_cpus(cpus, num_be + 1);
+    
+    hist_reset(&g_lc_thread.hist);
+    g_lc_thread.cpu = cpus[0];
+    g_lc_thread.running = &g_running;
+    g_lc_thread.chain_size = g_lc_wss;
+    g_lc_thread.chain = wl_chain_alloc(g_lc_wss, CACHE_LINE_SIZE, timing_now_ns());
+    if (!g_lc_thread.chain) {
+        PRINT_ERROR("Failed to allocate latency-critical working set");
+        return 0.0;
+    }
+    
+    // Antagonists first, so the LC thread only ever runs under contention
+    start_gate_reset();
+    for (int i = 0; i < num_be; i++) {
+        thread_data[i].thread_id = i;
+        thread_data[i].clos_id = COLOC_BE_CLOS;
+        thread_data[i].cpu = cpus[i + 1];
+        thread_data[i].bench_type = g_be_type;
+        thread_data[i].running = &g_running;
+        thread_data[i].throughput = 0.0;
+        if (pthread_create(&threads[i], NULL, benchmark_thread, &thread_data[i]) != 0) {
+            PRINT_ERROR("Failed to create thread %d", i);
+            break;
+        }
+        started++;
+    }
+    int be_ready = start_gate_wait(thread_data, started) == SUCCESS;
+    if (!be_ready) {
+        g_running = 0;
+    }
+    start_gate_release();
+    
+    int lc_started = be_ready && started == num_be &&
+                     pthread_create(&lc_tid, NULL, lc_request_thread, &g_lc_thread) == 0;
+    if (lc_started) {
+        sleep(g_duration);
+    }
+    
+    g_running = 0;
+    if (lc_started) {
+        pthread_join(lc_tid, NULL);
+    }
+    
+    double be_throughput = 0.0;
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+        be_throughput += thread_data[i].throughput;
+        release_thread_data(&thread_data[i]);
+    }
+    free(g_lc_thread.chain);
+    g_lc_thread.chain = NULL;
+    g_running = !g_interrupted;
+    
+    if (!lc_started || g_lc_thread.hist.count == 0) {
+        return 0.0;
+    }
+    
+    hist_merge(&g_coloc_hist, &g_lc_thread.hist);
+    if (g_coloc_nsamples < BENCH_MAX_SAMPLES) {
+        coloc_sample_t *sample = &g_coloc_samples[g_coloc_nsamples++];
+        sample->p50 = hist_percentile(&g_lc_thread.hist, 50.0);
+        sample->p99 = hist_percentile(&g_lc_thread.hist, 99.0);
+        sample->p999 = hist_percentile(&g_lc_thread.hist, 99.9);
+        sample->be_throughput = be_throughput;
+    }
+    return hist_percentile(&g_lc_thread.hist, 99.0);
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Median of one coloc_sample_t field over the samples of a scenario
+static double coloc_sample_median(size_t offset) {
+    double values[BENCH_MAX_SAMPLES];
+    
+    if (g_coloc_nsamples == 0) {
+        return 0.0;
+    }
+    for (int i = 0; i < g_coloc_nsamples; i++) {
+        values[i] = *(const double *)((const char *)&g_coloc_samples[i] + offset);
+    }
+    qsort(values, g_coloc_nsamples, sizeof(double), compare_double);
+    return bench_percentile(values, g_coloc_nsamples, 50.0);
+}
+
+int run_coloc_config(const coloc_config_t *config, coloc_sample_t *summary) {
+    int num_be = coloc_num_be(config);
+    uint64_t lc_mask = coloc_ways_mask(config->lc_l3_pct, 1);
+    uint64_t be_mask = coloc_ways_mask(config->be_l3_pct, 0);
+    char name[160];
+    bench_stats_t stats;
+    
+    if (setup_rdt_clos(COLOC_LC_CLOS, lc_mask, 0) != SUCCESS ||
+        setup_rdt_clos(COLOC_BE_CLOS, be_mask, config->be_mba) != SUCCESS) {
+        PRINT_ERROR("Failed to set up partitioning for \"%s\"", config->name);
+        return ERROR_SYSTEM;
+    }
+    
+    snprintf(name, sizeof(name), "lc_l3=%d,be_l3=%d,be_mba=%d,be=%s,be_threads=%d,lc_wss_mb=%zu",
+             config->lc_l3_pct, config->be_l3_pct, config->be_mba,
+             rdt_kernels[g_be_type].name, num_be, g_lc_wss / (1024 * 1024));
+    
+    PRINT_INFO("LC mask 0x%lx (CLOS %d), BE mask 0x%lx MBA %d%% (CLOS %d), %d BE thread(s)",
+               lc_mask, COLOC_LC_CLOS, be_mask, config->be_mba, COLOC_BE_CLOS, num_be);
+    
+    hist_reset(&g_coloc_hist);
+    g_coloc_nsamples = 0;
+    if (bench_run(&coloc_kernel, (void *)config, name, &stats) != SUCCESS || g_interrupted) {
+        return ERROR_SYSTEM;
+    }
+    
+    summary->p50 = coloc_sample_median(offsetof(coloc_sample_t, p50));
+    summary->p99 = coloc_sample_median(offsetof(coloc_sample_t, p99));
+    summary->p999 = coloc_sample_median(offsetof(coloc_sample_t, p999));
+    summary->be_throughput = coloc_sample_median(offsetof(coloc_sample_t, be_throughput));
+    
+    hist_print(&g_coloc_hist, "LC request latency (all samples)", "ns");
+    bench_print_stats(&coloc_kernel, name, &stats);
+    return SUCCESS;
+}
+
+// Run the built-in partitionings, or a single custom one, and compare them
+void run_colocation(const coloc_config_t *custom) {
+    const coloc_config_t *configs = custom ? custom : coloc_configs;
+    int count = custom ? 1 : (int)(sizeof(coloc_configs) / sizeof(coloc_configs[0]));
+    coloc_sample_t results[sizeof(coloc_configs) / sizeof(coloc_configs[0])];
+    int done[sizeof(coloc_configs) / sizeof(coloc_configs[0])] = { 0 };
+    
+    PRINT_INFO("Colocation: LC working set %zu MB, %d hops/request, BE kernel %s",
+               g_lc_wss / (1024 * 1024), COLOC_REQUEST_HOPS, rdt_kernels[g_be_type].name);
+    
+    for (int i = 0; i < count && g_running; i++) {
+        PRINT_INFO("=== Colocation %d: %s ===", i, configs[i].name);
+        done[i] = run_coloc_config(&configs[i], &results[i]) == SUCCESS;
+    }
+    
+    printf("\n=== Colocation Summary (medians over samples) ===\n");
+    printf("%-32s  LC L3  BE L3  BE MBA  %9s  %9s  %9s  BE %-8s\n",
+           "Scenario", "p50(ns)", "p99(ns)", "p99.9(ns)", rdt_kernels[g_be_type].unit);
+    printf("--------------------------------  -----  -----  ------  ---------  ---------  ---------  -----------\n");
+    for (int i = 0; i < count; i++) {
+        if (!done[i]) continue;
+        printf("%-32s  %4d%%  %4d%%  %5d%%  %9.0f  %9.0f  %9.0f  %11.1f\n",
+               configs[i].name, configs[i].lc_l3_pct, configs[i].be_l3_pct, configs[i].be_mba,
+               results[i].p50, results[i].p99, results[i].p999, results[i].be_throughput);
+    }
+    printf("\n");
+}
+
+// The kernel msr driver runs a WRMSR for another CPU through an IPI and
+// waits for it; from a thread on the target CPU it runs inline. The fast
+// path also drops the open/close and the read half of read-modify-write.
+void *switch_latency_thread(void *arg) {
+    switch_run_t *run = (switch_run_t *)arg;
+    uint64_t pqr;
+
+    hist_reset(&run->hist);
+    if (topo_pin_thread(run->caller_cpu) != SUCCESS) {
+        run->failures = run->samples;
+        return NULL;
+    }
+
+    for (int i = 0; i < SWITCH_WARMUP + run->samples && g_running; i++) {
+        int clos = (i & 1) ? 0 : 1;
+        int result;
+
+        uint64_t start = timing_start();
+        if (run->fast) {
+            result = rdt_clos_fast_switch(run->target_cpu, clos);
+        } else {
+            result = rdt_msr_read(run->target_cpu, MSR_IA32_PQR_ASSOC, &pqr);
+            if (result == SUCCESS) {
+                pqr = (pqr & ~(0xFFFFFFFFULL << RDT_PQR_CLOS_SHIFT)) | ((uint64_t)clos << RDT_PQR_CLOS_SHIFT);
+                result = rdt_msr_write(run->target_cpu, MSR_IA32_PQR_ASSOC, pqr);
+            }
+        }
+        uint64_t end = timing_stop();
+
+        if (result != SUCCESS) {
+            run->failures++;
+        } else if (i >= SWITCH_WARMUP) {
+            hist_record(&run->hist, (uint64_t)(timing_ticks_to_ns(end - start) + 0.5));
+        }
+    }
+    return NULL;
+}
+
+// Target: first CPU of the first core. Remote caller: a CPU in another L3
+// domain when there is one, else the first CPU of the last core.
+static int switch_pick_cpus(int *target, int *remote) {
+    *target = topo_core_first_cpu(0);
+    if (*target < 0) {
+        *target = 0;
+    }
+    *remote = -1;
+    for (int d = 0; d < rdt_num_domains(); d++) {
+        int cpu = topo_l3_domain_cpu(d);
+        if (cpu >= 0 && topo_cpu_l3_domain(cpu) != topo_cpu_l3_domain(*target)) {
+            *remote = cpu;
+            return SUCCESS;
+        }
+    }
+    if (topo_core_count() > 1) {
+        *remote = topo_core_first_cpu(topo_core_count() - 1);
+    }
+    return *remote >= 0 && *remote != *target ? SUCCESS : ERROR_NOT_SUPPORTED;
+}
+
+void run_switch_latency(int samples) {
+    int target, remote;
+    uint64_t saved;
+
+    if (strcmp(rdt_backend_name(), "resctrl") == 0) {
+        PRINT_ERROR("Under resctrl the kernel switches PQR_ASSOC itself; use --backend msr or sim");
+        return;
+    }
+    if (switch_pick_cpus(&target, &remote) != SUCCESS) {
+        PRINT_INFO("Only one core available; measuring local switches only");
+    }
+    if (rdt_msr_read(target, MSR_IA32_PQR_ASSOC, &saved) != SUCCESS ||
+        rdt_clos_fast_open(target) != SUCCESS) {
+        PRINT_ERROR("Cannot access PQR_ASSOC of CPU %d", target);
+        return;
+    }
+
+    switch_run_t runs[] = {
+        { "open/close RMW, local",  0, target, target, samples, 0, { 0 } },
+        { "open/close RMW, remote", 0, remote, target, samples, 0, { 0 } },
+        { "fast path, local",       1, target, target, samples, 0, { 0 } },
+        { "fast path, remote",      1, remote, target, samples, 0, { 0 } },
+    };
+    int num_runs = sizeof(runs) / sizeof(runs[0]);
+
+    PRINT_INFO("CLOS switch latency on CPU %d, %d samples per path (%s backend, %s timer)",
+               target, samples, rdt_backend_name(), timing_source_name());
+
+    for (int i = 0; i < num_runs && g_running; i++) {
+        pthread_t thread;
+        if (runs[i].caller_cpu < 0) {
+            continue;
+        }
+        if (pthread_create(&thread, NULL, switch_latency_thread, &runs[i]) != 0) {
+            PRINT_ERROR("Failed to start switch thread");
+            break;
+        }
+        pthread_join(thread, NULL);
+    }
+
+    rdt_msr_write(target, MSR_IA32_PQR_ASSOC, saved);
+    rdt_clos_fast_close(target);
+
+    printf("\n=== CLOS Switch Latency (ns) ===\n");
+    printf("%-24s  %6s  %6s  %8s  %8s  %8s  %8s  %8s\n",
+           "Path", "Caller", "Target", "Mean", "p50", "p99", "p99.9", "Max");
+    for (int i = 0; i < num_runs; i++) {
+        const switch_run_t *run = &runs[i];
+        if (run->caller_cpu < 0 || run->hist.count == 0) {
+            printf("%-24s  %6s  %6d  %8s\n", run->name, "-", run->target_cpu, "skipped");
+            continue;
+        }
+        printf("%-24s  %6d  %6d  %8.0f  %8lu  %8lu  %8lu  %8lu\n",
+               run->name, run->caller_cpu, run->target_cpu, hist_mean(&run->hist),
+               (unsigned long)hist_percentile(&run->hist, 50.0),
+               (unsigned long)hist_percentile(&run->hist, 99.0),
+               (unsigned long)hist_percentile(&run->hist, 99.9),
+               (unsigned long)run->hist.max);
+        if (run->failures) {
+            PRINT_ERROR("%s: %d failed writes", run->name, run->failures);
+        }
+    }
+    printf("\n");
+}
+
 void signal_handler(int sig) {
     (void)sig;
+    g_interrupted = 1;
     g_running = 0;
     PRINT_INFO("Received signal, stopping benchmark...");
 }
\ No newline at end of file
@@ -0,0 +1,1610 @@
+#include "rdt_common.h"
+#include "rdt_sim.h"
+#include <dirent.h>
+#include <math.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+static const rdt_backend_t *g_backend = NULL;
+static uint32_t g_touched_l2 = 0;      // CLOS whose L2 mask we changed
+
+// resctrl enumeration from info/, the only source on MPAM systems
+static uint64_t g_resctrl_l3_cbm = 0;  // Cache portion bitmap width as a mask
+static uint64_t g_resctrl_l2_cbm = 0;
+static int g_resctrl_has_mb = 0;
+static int g_resctrl_mb_gran = 1;      // bandwidth_gran, percent
+static const char *g_resctrl_mb_min = NULL;    // Minimum-bandwidth resource, if any
+static double g_resctrl_mb_unit = 0.0;  // GB/s per MB schemata unit, 0 = percent
+static uint64_t g_resctrl_mb_max = 100;        // MB value meaning unlimited
+
+// Bandwidth a percent throttle is relative to where limits are absolute
+static double g_mba_ref_gbps = 0.0;
+
+// Register access of the MSR backend; the sim backend swaps in the simulator
+static int (*g_msr_read)(int cpu, uint32_t msr, uint64_t *value) = msr_read_cpu;
+static int (*g_msr_write)(int cpu, uint32_t msr, uint64_t value) = msr_write_cpu;
+
+// Fast path state per CPU, allocated on first use
+typedef struct {
+    int open;
+    int fd;                     // -1 on the sim backend
+    uint64_t pqr;               // Last value written to PQR_ASSOC
+} rdt_fast_cpu_t;
+
+static rdt_fast_cpu_t *g_fast = NULL;
+static int g_fast_cpus = 0;
+
+// L3 CDP mode of the MSR backend, and the mode to restore on cleanup
+static int g_msr_cdp = 0;
+static int g_msr_cdp_initial = 0;
+
+// Allocation MSRs as found at init, restored on cleanup. A count of 0
+// means that resource could not be read and is left alone.
+typedef struct {
+    uint64_t l3_mask[RDT_MAX_CLOS];
+    uint64_t mba[RDT_MAX_CLOS];
+} msr_snapshot_t;
+
+static msr_snapshot_t *g_snap = NULL;                   // Per L3 domain
+static uint64_t (*g_snap_l2)[RDT_MAX_CLOS] = NULL;      // Per L2 domain
+static int g_snap_l3_count = 0;
+static int g_snap_mba_count = 0;
+static int g_snap_l2_count = 0;
+
+// Function declarations
+static int msr_backend_init(void);
+static void msr_read_cdp_mode(void);
+static int msr_num_regs(int enumerated);
+static void msr_snapshot_take(void);
+static void msr_restore_reg(int cpu, uint32_t msr, uint64_t value);
+static void msr_snapshot_restore(void);
+static void msr_backend_cleanup(void);
+static int msr_set_l3_mask(int clos, int domain, uint64_t mask);
+static int msr_set_l3_cdp(int clos, int domain, uint64_t code_mask, uint64_t data_mask);
+static int msr_set_l2_mask(int clos, int l2_domain, uint64_t mask);
+static int msr_set_cdp(int enable);
+static int msr_set_mba_throttle(int clos, int domain, int throttle);
+static int msr_set_mba_bw(int clos, int domain, double gbps);
+static int msr_mba_amd(void);
+static uint32_t msr_mba_base(void);
+static int mba_throttle_gbps(int throttle, double *gbps);
+static int msr_assign_task(int clos, pid_t tid);
+static int msr_assign_cpu(int clos, int cpu);
+static int msr_read_monitor(int clos, int domain, rdt_mon_event_t event, uint64_t *bytes);
+static int sim_backend_init(void);
+static void sim_backend_cleanup(void);
+static int resctrl_backend_init(void);
+static void resctrl_backend_cleanup(void);
+static int resctrl_set_l3_mask(int clos, int domain, uint64_t mask);
+static int resctrl_set_l3_cdp(int clos, int domain, uint64_t code_mask, uint64_t data_mask);
+static int resctrl_set_l2_mask(int clos, int l2_domain, uint64_t mask);
+static int resctrl_set_cdp(int enable);
+static int resctrl_set_mba_throttle(int clos, int domain, int throttle);
+static int resctrl_set_mba_min(int clos, int domain, int percent);
+static int resctrl_set_mba_bw(int clos, int domain, double gbps);
+static int resctrl_mount_has(const char *option);
+static int resctrl_assign_task(int clos, pid_t tid);
+static int resctrl_assign_cpu(int clos, int cpu);
+static int resctrl_read_monitor(int clos, int domain, rdt_mon_event_t event, uint64_t *bytes);
+static int resctrl_read_mon_data(const char *group_path, int domain, rdt_mon_event_t event,
+                                 uint64_t *bytes);
+static int resctrl_read_schemata(const char *path, char *buf, size_t size);
+static int resctrl_tasks_has(const char *dir, pid_t tid);
+static int resctrl_task_ctrl_group(pid_t tid, char *path, size_t len);
+static int mon_group_open(rdt_mon_group_t *group, const char *ctrl_path);
+static uint64_t resctrl_read_cbm(const char *resource);
+static int mpam_backend_init(void);
+static int backend_is_resctrl(void);
+
+static const rdt_backend_t msr_backend = {
+    .name = "msr",
+    .init = msr_backend_init,
+    .cleanup = msr_backend_cleanup,
+    .set_l3_mask = msr_set_l3_mask,
+    .set_l3_cdp = msr_set_l3_cdp,
+    .set_l2_mask = msr_set_l2_mask,
+    .set_cdp = msr_set_cdp,
+    .set_mba_throttle = msr_set_mba_throttle,
+    .set_mba_min = NULL,
+    .set_mba_bw = msr_set_mba_bw,
+    .assign_task = msr_assign_task,
+    .assign_cpu = msr_assign_cpu,
+    .read_monitor = msr_read_monitor,
+};
+
+static const rdt_backend_t sim_backend = {
+    .name = "sim",
+    .init = sim_backend_init,
+    .cleanup = sim_backend_cleanup,
+    .set_l3_mask = msr_set_l3_mask,
+    .set_l3_cdp = msr_set_l3_cdp,
+    .set_l2_mask = msr_set_l2_mask,
+    .set_cdp = msr_set_cdp,
+    .set_mba_throttle = msr_set_mba_throttle,
+    .set_mba_min = NULL,
+    .set_mba_bw = NULL,
+    .assign_task = msr_assign_task,
+    .assign_cpu = msr_assign_cpu,
+    .read_monitor = msr_read_monitor,
+};
+
+static const rdt_backend_t resctrl_backend = {
+    .name = "resctrl",
+    .init = resctrl_backend_init,
+    .cleanup = resctrl_backend_cleanup,
+    .set_l3_mask = resctrl_set_l3_mask,
+    .set_l3_cdp = resctrl_set_l3_cdp,
+    .set_l2_mask = resctrl_set_l2_mask,
+    .set_cdp = resctrl_set_cdp,
+    .set_mba_throttle = resctrl_set_mba_throttle,
+    .set_mba_min = resctrl_set_mba_min,
+    .set_mba_bw = resctrl_set_mba_bw,
+    .assign_task = resctrl_assign_task,
+    .assign_cpu = resctrl_assign_cpu,
+    .read_monitor = resctrl_read_monitor,
+};
+
+// Same resctrl interface; only discovery differs, since MPAM parts have
+// no CPUID and report everything through info/
+static const rdt_backend_t mpam_backend = {
+    .name = "mpam",
+    .init = mpam_backend_init,
+    .cleanup = resctrl_backend_cleanup,
+    .set_l3_mask = resctrl_set_l3_mask,
+    .set_l3_cdp = resctrl_set_l3_cdp,
+    .set_l2_mask = resctrl_set_l2_mask,
+    .set_cdp = resctrl_set_cdp,
+    .set_mba_throttle = resctrl_set_mba_throttle,
+    .set_mba_min = resctrl_set_mba_min,
+    .set_mba_bw = resctrl_set_mba_bw,
+    .assign_task = resctrl_assign_task,
+    .assign_cpu = resctrl_assign_cpu,
+    .read_monitor = resctrl_read_monitor,
+};
+
+// ---------------------------------------------------------------------------
+// Domain helpers
+// ---------------------------------------------------------------------------
+
+int rdt_num_domains(void) {
+    int n = topo_l3_domain_count();
+    return n > 0 ? n : 1;
+}
+
+// Hardware cache id of an L3 domain, as used in resctrl schemata
+int rdt_domain_id(int domain) {
+    const topology_t *topo = topology_get();
+    if (topo && domain >= 0 && domain < topo->num_l3) {
+        return topo->l3[domain].domain.id;
+    }
+    return domain;
+}
+
+uint64_t rdt_l3_full_mask(void) {
+    if (backend_is_resctrl() && g_resctrl_l3_cbm) {
+        return g_resctrl_l3_cbm;
+    }
+    int cbm_len = cpu_caps_get()->l3_cat.cbm_len;
+    if (cbm_len <= 0 || cbm_len > 63) {
+        return 0xFFFF;
+    }
+    return (1ULL << cbm_len) - 1;
+}
+
+int rdt_num_l2_domains(void) {
+    const topology_t *topo = topology_get();
+    return topo ? topo->num_l2 : 0;
+}
+
+int rdt_l2_domain_id(int l2_domain) {
+    const topology_t *topo = topology_get();
+    if (topo && l2_domain >= 0 && l2_domain < topo->num_l2) {
+        return topo->l2[l2_domain].domain.id;
+    }
+    return l2_domain;
+}
+
+static int rdt_l2_domain_cpu(int l2_domain) {
+    const topology_t *topo = topology_get();
+    if (topo && l2_domain >= 0 && l2_domain < topo->num_l2) {
+        return topo->l2[l2_domain].domain.first_cpu;
+    }
+    return -1;
+}
+
+int rdt_l3_cbm_len(void) {
+    return __builtin_popcountll(rdt_l3_full_mask());
+}
+
+uint64_t rdt_l2_full_mask(void) {
+    if (backend_is_resctrl() && g_resctrl_l2_cbm) {
+        return g_resctrl_l2_cbm;
+    }
+    int cbm_len = cpu_caps_get()->l2_cat.cbm_len;
+    if (cbm_len <= 0 || cbm_len > 63) {
+        return 0xFF;
+    }
+    return (1ULL << cbm_len) - 1;
+}
+
+uint32_t rdt_mon_upscale(void) {
+    uint32_t upscale = cpu_caps_get()->mon_upscale;
+    if (upscale) {
+        return upscale;
+    }
+    return g_backend == &sim_backend ? RDT_SIM_UPSCALE : 1;
+}
+
+int rdt_mbm_counter_width(void) {
+    int width = cpu_caps_get()->mbm_counter_width;
+    return (width >= 24 && width <= 62) ? width : 24;
+}
+
+int rdt_mba_max_delay(void) {
+    int max_delay = cpu_caps_get()->mba_max_delay;
+    return max_delay > 0 ? max_delay : 90;
+}
+
+static int check_clos(int clos) {
+    if (clos < 0 || clos >= rdt_num_clos()) {
+        PRINT_ERROR("Invalid CLOS %d", clos);
+        return ERROR_INVALID_PARAM;
+    }
+    return SUCCESS;
+}
+
+static int check_domain(int domain) {
+    if (domain != RDT_ALL_DOMAINS && (domain < 0 || domain >= rdt_num_domains())) {
+        PRINT_ERROR("Invalid L3 domain %d", domain);
+        return ERROR_INVALID_PARAM;
+    }
+    return SUCCESS;
+}
+
+// ---------------------------------------------------------------------------
+// Raw MSR backend
+// ---------------------------------------------------------------------------
+
+static int msr_backend_init(void) {
+    if (msr_check_available() != SUCCESS) {
+        PRINT_ERROR("MSR access not available");
+        return ERROR_NOT_SUPPORTED;
+    }
+    if (rdt_resctrl_mounted()) {
+        PRINT_INFO("resctrl is mounted; raw MSR writes will conflict with kernel RDT state");
+    }
+    msr_read_cdp_mode();
+    msr_snapshot_take();
+    return SUCCESS;
+}
+
+static void msr_read_cdp_mode(void) {
+    uint64_t cfg = 0;
+    int cpu = topo_l3_domain_cpu(0);
+
+    g_msr_cdp = 0;
+    if ((cpu_has_feature(CPU_FEAT_CDP_L3) || g_msr_read != msr_read_cpu) && cpu >= 0 &&
+        g_msr_read(cpu, MSR_IA32_L3_QOS_CFG, &cfg) == SUCCESS) {
+        g_msr_cdp = (cfg & RDT_QOS_CFG_CDP) != 0;
+    }
+    g_msr_cdp_initial = g_msr_cdp;
+}
+
+// Mask/delay MSRs per domain: CPUID's count, or RDT_MAX_CLOS where the
+// CPU (or the simulator's host) does not enumerate one
+static int msr_num_regs(int enumerated) {
+    return (enumerated > 0 && enumerated <= RDT_MAX_CLOS) ? enumerated : RDT_MAX_CLOS;
+}
+
+static void msr_snapshot_take(void) {
+    const cpu_caps_t *caps = cpu_caps_get();
+    int sim = g_msr_read != msr_read_cpu;
+    int num_l2 = rdt_num_l2_domains();
+
+    free(g_snap);
+    free(g_snap_l2);
+    g_snap = calloc(rdt_num_domains(), sizeof(*g_snap));
+    g_snap_l2 = num_l2 > 0 ? calloc(num_l2, sizeof(*g_snap_l2)) : NULL;
+    g_snap_l3_count = g_snap ? msr_num_regs(caps->l3_cat.num_clos) : 0;
+    g_snap_mba_count = g_snap && (cpu_has_feature(CPU_FEAT_MBA) || sim) ?
+                       msr_num_regs(caps->mba_num_clos) : 0;
+    uint32_t mba_base = msr_mba_base();
+    g_snap_l2_count = g_snap_l2 && (cpu_has_feature(CPU_FEAT_CAT_L2) || sim) ?
+                      msr_num_regs(caps->l2_cat.num_clos) : 0;
+
+    for (int d = 0; d < rdt_num_domains() && g_snap; d++) {
+        int cpu = topo_l3_domain_cpu(d);
+        for (int i = 0; i < g_snap_l3_count; i++) {
+            if (g_msr_read(cpu, MSR_IA32_L3_MASK_0 + i, &g_snap[d].l3_mask[i]) != SUCCESS) {
+                PRINT_DEBUG("L3 mask MSRs not readable; they will not be restored");
+                g_snap_l3_count = 0;
+            }
+        }
+        for (int i = 0; i < g_snap_mba_count; i++) {
+            if (g_msr_read(cpu, mba_base + i, &g_snap[d].mba[i]) != SUCCESS) {
+                PRINT_DEBUG("MBA MSRs not readable; they will not be restored");
+                g_snap_mba_count = 0;
+            }
+        }
+    }
+    for (int d = 0; d < num_l2 && g_snap_l2_count; d++) {
+        int cpu = rdt_l2_domain_cpu(d);
+        for (int i = 0; i < g_snap_l2_count; i++) {
+            if (cpu < 0 || g_msr_read(cpu, MSR_IA32_L2_MASK_0 + i, &g_snap_l2[d][i]) != SUCCESS) {
+                PRINT_DEBUG("L2 mask MSRs not readable; they will not be restored");
+                g_snap_l2_count = 0;
+            }
+        }
+    }
+}
+
+// Rewrite only registers that differ, so untouched CLOS see no writes
+static void msr_restore_reg(int cpu, uint32_t msr, uint64_t value) {
+    uint64_t current;
+    if (g_msr_read(cpu, msr, &current) != SUCCESS || current != value) {
+        if (g_msr_write(cpu, msr, value) != SUCCESS) {
+            PRINT_ERROR("Failed to restore MSR 0x%x on CPU %d", msr, cpu);
+        }
+    }
+}
+
+static void msr_snapshot_restore(void) {
+    for (int d = 0; d < rdt_num_domains() && g_snap; d++) {
+        int cpu = topo_l3_domain_cpu(d);
+        for (int i = 0; i < g_snap_l3_count; i++) {
+            msr_restore_reg(cpu, MSR_IA32_L3_MASK_0 + i, g_snap[d].l3_mask[i]);
+        }
+        for (int i = 0; i < g_snap_mba_count; i++) {
+            msr_restore_reg(cpu, msr_mba_base() + i, g_snap[d].mba[i]);
+        }
+    }
+    for (int d = 0; d < rdt_num_l2_domains() && g_snap_l2_count; d++) {
+        int cpu = rdt_l2_domain_cpu(d);
+        for (int i = 0; i < g_snap_l2_count; i++) {
+            msr_restore_reg(cpu, MSR_IA32_L2_MASK_0 + i, g_snap_l2[d][i]);
+        }
+    }
+
+    free(g_snap);
+    free(g_snap_l2);
+    g_snap = NULL;
+    g_snap_l2 = NULL;
+    g_snap_l3_count = g_snap_mba_count = g_snap_l2_count = 0;
+}
+
+static void msr_backend_cleanup(void) {
+    // The CDP switch resets the masks, so it goes before the snapshot
+    if (g_msr_cdp != g_msr_cdp_initial) {
+        msr_set_cdp(g_msr_cdp_initial);
+    }
+    msr_snapshot_restore();
+
+    for (int cpu = 0; cpu < g_fast_cpus; cpu++) {
+        rdt_clos_fast_close(cpu);
+    }
+    free(g_fast);
+    g_fast = NULL;
+    g_fast_cpus = 0;
+
+    // Return every CPU to CLOS 0 / RMID 0
+    int cpu_count = get_cpu_count();
+    for (int cpu = 0; cpu < cpu_count; cpu++) {
+        uint64_t value;
+        if (g_msr_read(cpu, MSR_IA32_PQR_ASSOC, &value) == SUCCESS) {
+            value &= ~(RDT_PQR_RMID_MASK | (0xFFFFFFFFULL << RDT_PQR_CLOS_SHIFT));
+            g_msr_write(cpu, MSR_IA32_PQR_ASSOC, value);
+        }
+    }
+}
+
+static int msr_set_l3_mask(int clos, int domain, uint64_t mask) {
+    if (g_msr_cdp) {
+        return msr_set_l3_cdp(clos, domain, mask, mask);
+    }
+    for (int d = 0; d < rdt_num_domains(); d++) {
+        if (domain != RDT_ALL_DOMAINS && d != domain) continue;
+
+        int cpu = topo_l3_domain_cpu(d);
+        if (cpu < 0 || g_msr_write(cpu, MSR_IA32_L3_MASK_0 + clos, mask) != SUCCESS) {
+            PRINT_ERROR("Failed to set L3 mask for CLOS %d on L3 domain %d", clos, d);
+            return ERROR_SYSTEM;
+        }
+    }
+    return SUCCESS;
+}
+
+static int msr_set_l3_cdp(int clos, int domain, uint64_t code_mask, uint64_t data_mask) {
+    if (!g_msr_cdp) {
+        PRINT_ERROR("L3 CDP is not enabled");
+        return ERROR_NOT_SUPPORTED;
+    }
+    for (int d = 0; d < rdt_num_domains(); d++) {
+        if (domain != RDT_ALL_DOMAINS && d != domain) continue;
+
+        int cpu = topo_l3_domain_cpu(d);
+        if (cpu < 0 ||
+            g_msr_write(cpu, MSR_IA32_L3_MASK_0 + 2 * clos, data_mask) != SUCCESS ||
+            g_msr_write(cpu, MSR_IA32_L3_MASK_0 + 2 * clos + 1, code_mask) != SUCCESS) {
+            PRINT_ERROR("Failed to set L3 code/data masks for CLOS %d on L3 domain %d", clos, d);
+            return ERROR_SYSTEM;
+        }
+    }
+    return SUCCESS;
+}
+
+static int msr_set_l2_mask(int clos, int l2_domain, uint64_t mask) {
+    for (int d = 0; d < rdt_num_l2_domains(); d++) {
+        if (l2_domain != RDT_ALL_DOMAINS && d != l2_domain) continue;
+
+        int cpu = rdt_l2_domain_cpu(d);
+        if (cpu < 0 || g_msr_write(cpu, MSR_IA32_L2_MASK_0 + clos, mask) != SUCCESS) {
+            PRINT_ERROR("Failed to set L2 mask for CLOS %d on L2 domain %d", clos, d);
+            return ERROR_SYSTEM;
+        }
+    }
+    return SUCCESS;
+}
+
+// The mask MSRs change meaning with the mode, so start every CLOS from
+// the full CBM in both modes
+static int msr_set_cdp(int enable) {
+    int num_masks = msr_num_regs(cpu_caps_get()->l3_cat.num_clos);
+
+    for (int d = 0; d < rdt_num_domains(); d++) {
+        uint64_t cfg;
+        int cpu = topo_l3_domain_cpu(d);
+
+        if (cpu < 0 || g_msr_read(cpu, MSR_IA32_L3_QOS_CFG, &cfg) != SUCCESS) {
+            return ERROR_SYSTEM;
+        }
+        cfg = enable ? (cfg | RDT_QOS_CFG_CDP) : (cfg & ~RDT_QOS_CFG_CDP);
+        if (g_msr_write(cpu, MSR_IA32_L3_QOS_CFG, cfg) != SUCCESS) {
+            PRINT_ERROR("Failed to %s L3 CDP on L3 domain %d", enable ? "enable" : "disable", d);
+            return ERROR_SYSTEM;
+        }
+        for (int i = 0; i < num_masks; i++) {
+            g_msr_write(cpu, MSR_IA32_L3_MASK_0 + i, rdt_l3_full_mask());
+        }
+    }
+    g_msr_cdp = enable;
+    return SUCCESS;
+}
+
+static int msr_set_mba_throttle(int clos, int domain, int throttle) {
+    if (msr_mba_amd()) {
+        double gbps;
+        if (mba_throttle_gbps(throttle, &gbps) != SUCCESS) {
+            return ERROR_NOT_SUPPORTED;
+        }
+        return msr_set_mba_bw(clos, domain, gbps);
+    }
+
+    // Delays past the enumerated maximum are rejected by the hardware
+    if (throttle > rdt_mba_max_delay()) {
+        throttle = rdt_mba_max_delay();
+    }
+    for (int d = 0; d < rdt_num_domains(); d++) {
+        if (domain != RDT_ALL_DOMAINS && d != domain) continue;
+
+        int cpu = topo_l3_domain_cpu(d);
+        if (cpu < 0 || g_msr_write(cpu, MSR_IA32_MBA_THRTL_MSR + clos, (uint64_t)throttle) != SUCCESS) {
+            PRINT_ERROR("Failed to set MBA throttle for CLOS %d on L3 domain %d", clos, d);
+            return ERROR_SYSTEM;
+        }
+    }
+    return SUCCESS;
+}
+
+// AMD: one limit register per CLOS in each CCX, written on a CPU of that CCX
+static int msr_set_mba_bw(int clos, int domain, double gbps) {
+    int max = cpu_caps_get()->mba_bw_max;
+    
+    if (!msr_mba_amd()) {
+        return ERROR_NOT_SUPPORTED;
+    }
+    long units = gbps > 0 ? lround(gbps * 8.0) : max;
+    if (units < 1) units = 1;
+    if (units > max) units = max;
+    
+    for (int d = 0; d < rdt_num_domains(); d++) {
+        if (domain != RDT_ALL_DOMAINS && d != domain) continue;
+
+        int cpu = topo_l3_domain_cpu(d);
+        if (cpu < 0 || g_msr_write(cpu, MSR_AMD_MBA_BW_BASE + clos, (uint64_t)units) != SUCCESS) {
+            PRINT_ERROR("Failed to set bandwidth limit for CLOS %d on L3 domain %d", clos, d);
+            return ERROR_SYSTEM;
+        }
+    }
+    return SUCCESS;
+}
+
+// The simulator models Intel's delay registers whatever the host is
+static int msr_mba_amd(void) {
+    return cpu_caps_get()->mba_bw_max > 0 && g_msr_read == msr_read_cpu;
+}
+
+static uint32_t msr_mba_base(void) {
+    return msr_mba_amd() ? MSR_AMD_MBA_BW_BASE : MSR_IA32_MBA_THRTL_MSR;
+}
+
+// Percent throttle as an absolute limit (0 = unlimited), never below one
+// 1/8 GB/s step so a 100% throttle does not wrap around to unlimited
+static int mba_throttle_gbps(int throttle, double *gbps) {
+    *gbps = 0.0;
+    if (throttle == 0) {
+        return SUCCESS;
+    }
+    if (g_mba_ref_gbps <= 0) {
+        PRINT_ERROR("Bandwidth limits are absolute here; set a reference bandwidth for a %d%% throttle",
+                    throttle);
+        return ERROR_NOT_SUPPORTED;
+    }
+    *gbps = g_mba_ref_gbps * (100 - throttle) / 100.0;
+    if (*gbps < 0.125) {
+        *gbps = 0.125;
+    }
+    return SUCCESS;
+}
+
+// PQR_ASSOC is per CPU, so a thread is pinned to the CPU whose CLOS it takes
+static int msr_assign_task(int clos, pid_t tid) {
+    if (tid != 0 && tid != (pid_t)syscall(SYS_gettid)) {
+        PRINT_ERROR("MSR backend can only associate the calling thread");
+        return ERROR_NOT_SUPPORTED;
+    }
+
+    int cpu = sched_getcpu();
+    if (cpu < 0 || topo_pin_thread(cpu) != SUCCESS) {
+        return ERROR_SYSTEM;
+    }
+    return msr_assign_cpu(clos, cpu);
+}
+
+// Each CLOS also gets RMID == CLOS so it can be monitored separately
+static int msr_assign_cpu(int clos, int cpu) {
+    uint64_t value;
+    if (g_msr_read(cpu, MSR_IA32_PQR_ASSOC, &value) != SUCCESS) {
+        return ERROR_SYSTEM;
+    }
+
+    value &= ~(RDT_PQR_RMID_MASK | (0xFFFFFFFFULL << RDT_PQR_CLOS_SHIFT));
+    value |= ((uint64_t)clos << RDT_PQR_CLOS_SHIFT) | ((uint64_t)clos & RDT_PQR_RMID_MASK);
+
+    return g_msr_write(cpu, MSR_IA32_PQR_ASSOC, value);
+}
+
+static int msr_read_monitor(int clos, int domain, rdt_mon_event_t event, uint64_t *bytes) {
+    static const uint32_t event_ids[] = {
+        [RDT_MON_LLC_OCCUPANCY] = RDT_EVT_LLC_OCCUPANCY,
+        [RDT_MON_MBM_TOTAL] = RDT_EVT_MBM_TOTAL,
+        [RDT_MON_MBM_LOCAL] = RDT_EVT_MBM_LOCAL,
+    };
+    uint64_t ctr;
+
+    int cpu = topo_l3_domain_cpu(domain);
+    if (cpu < 0) {
+        return ERROR_INVALID_PARAM;
+    }
+
+    uint64_t evtsel = event_ids[event] | ((uint64_t)clos << 32);
+    if (g_msr_write(cpu, MSR_IA32_QM_EVTSEL, evtsel) != SUCCESS ||
+        g_msr_read(cpu, MSR_IA32_QM_CTR, &ctr) != SUCCESS) {
+        return ERROR_SYSTEM;
+    }
+    if (ctr & (RDT_QM_CTR_ERROR | RDT_QM_CTR_UNAVAILABLE)) {
+        return ERROR_NOT_SUPPORTED;
+    }
+
+    *bytes = ctr * rdt_mon_upscale();
+    return SUCCESS;
+}
+
+static int check_raw_backend(void) {
+    if (g_backend != &msr_backend && g_backend != &sim_backend) {
+        PRINT_ERROR("Raw RDT register access needs the msr or sim backend");
+        return ERROR_NOT_SUPPORTED;
+    }
+    return SUCCESS;
+}
+
+int rdt_msr_read(int cpu, uint32_t msr, uint64_t *value) {
+    if (check_raw_backend() != SUCCESS) {
+        return ERROR_NOT_SUPPORTED;
+    }
+    return g_msr_read(cpu, msr, value);
+}
+
+int rdt_msr_write(int cpu, uint32_t msr, uint64_t value) {
+    if (check_raw_backend() != SUCCESS) {
+        return ERROR_NOT_SUPPORTED;
+    }
+    return g_msr_write(cpu, msr, value);
+}
+
+int rdt_mon_read_batch(int domain, rdt_mon_req_t *reqs, int count) {
+    int cpu = topo_l3_domain_cpu(domain);
+    int result = SUCCESS;
+
+    if (check_raw_backend() != SUCCESS) {
+        return ERROR_NOT_SUPPORTED;
+    }
+    if (cpu < 0 || (reqs == NULL && count > 0)) {
+        return ERROR_INVALID_PARAM;
+    }
+
+    if (g_msr_read != msr_read_cpu) {
+        for (int i = 0; i < count; i++) {
+            uint64_t evtsel = reqs[i].event | ((uint64_t)reqs[i].rmid << 32);
+            if (g_msr_write(cpu, MSR_IA32_QM_EVTSEL, evtsel) != SUCCESS ||
+                g_msr_read(cpu, MSR_IA32_QM_CTR, &reqs[i].ctr) != SUCCESS) {
+                return ERROR_SYSTEM;
+            }
+        }
+        return SUCCESS;
+    }
+
+    // One open for the batch and one pwrite/pread per pair, instead of
+    // open/seek/close around every access as msr_read_cpu() does
+    int fd = msr_open(cpu);
+    if (fd < 0) {
+        return ERROR_SYSTEM;
+    }
+    for (int i = 0; i < count; i++) {
+        uint64_t evtsel = reqs[i].event | ((uint64_t)reqs[i].rmid << 32);
+        if (pwrite(fd, &evtsel, sizeof(evtsel), MSR_IA32_QM_EVTSEL) != sizeof(evtsel) ||
+            pread(fd, &reqs[i].ctr, sizeof(reqs[i].ctr), MSR_IA32_QM_CTR) != sizeof(reqs[i].ctr)) {
+            result = ERROR_SYSTEM;
+            break;
+        }
+    }
+    msr_close(fd);
+    return result;
+}
+
+int rdt_clos_fast_open(int cpu) {
+    if (check_raw_backend() != SUCCESS) {
+        return ERROR_NOT_SUPPORTED;
+    }
+    if (!g_fast) {
+        g_fast_cpus = get_cpu_count();
+        g_fast = calloc(g_fast_cpus, sizeof(rdt_fast_cpu_t));
+        if (!g_fast) {
+            return ERROR_SYSTEM;
+        }
+    }
+    if (cpu < 0 || cpu >= g_fast_cpus) {
+        return ERROR_INVALID_PARAM;
+    }
+
+    rdt_fast_cpu_t *fast = &g_fast[cpu];
+    if (fast->open) {
+        return SUCCESS;
+    }
+    if (g_msr_read(cpu, MSR_IA32_PQR_ASSOC, &fast->pqr) != SUCCESS) {
+        return ERROR_SYSTEM;
+    }
+    fast->fd = -1;
+    if (g_msr_write == msr_write_cpu && (fast->fd = msr_open(cpu)) < 0) {
+        return ERROR_SYSTEM;
+    }
+    fast->open = 1;
+    return SUCCESS;
+}
+
+// The cached PQR_ASSOC supplies the RMID, so a concurrent RMID change on
+// this CPU by someone else is overwritten
+int rdt_clos_fast_switch(int cpu, int clos) {
+    if (cpu < 0 || cpu >= g_fast_cpus || !g_fast[cpu].open || clos < 0 || clos >= RDT_MAX_CLOS) {
+        return ERROR_INVALID_PARAM;
+    }
+
+    rdt_fast_cpu_t *fast = &g_fast[cpu];
+    uint64_t value = (fast->pqr & ~(0xFFFFFFFFULL << RDT_PQR_CLOS_SHIFT)) |
+                     ((uint64_t)clos << RDT_PQR_CLOS_SHIFT);
+
+    if (fast->fd >= 0) {
+        if (pwrite(fast->fd, &value, sizeof(value), MSR_IA32_PQR_ASSOC) != sizeof(value)) {
+            return ERROR_SYSTEM;
+        }
+    } else if (g_msr_write(cpu, MSR_IA32_PQR_ASSOC, value) != SUCCESS) {
+        return ERROR_SYSTEM;
+    }
+    fast->pqr = value;
+    return SUCCESS;
+}
+
+void rdt_clos_fast_close(int cpu) {
+    if (cpu < 0 || cpu >= g_fast_cpus || !g_fast[cpu].open) {
+        return;
+    }
+    msr_close(g_fast[cpu].fd);
+    g_fast[cpu].fd = -1;
+    g_fast[cpu].open = 0;
+}
+
+// Bytes between two raw MBM readings; one wrap of the counter is absorbed,
+// so readings must be closer together than the wrap period
+uint64_t rdt_mbm_delta_bytes(uint64_t prev, uint64_t cur) {
+    uint64_t width_mask = (1ULL << rdt_mbm_counter_width()) - 1;
+    return ((cur - prev) & width_mask) * rdt_mon_upscale();
+}
+
+// ---------------------------------------------------------------------------
+// Simulated backend: the MSR backend on rdt_sim's register file
+// ---------------------------------------------------------------------------
+
+static int sim_backend_init(void) {
+    if (rdt_sim_init() != SUCCESS) {
+        PRINT_ERROR("Failed to set up the simulated RDT register file");
+        return ERROR_SYSTEM;
+    }
+    g_msr_read = rdt_sim_msr_read;
+    g_msr_write = rdt_sim_msr_write;
+    msr_read_cdp_mode();
+    msr_snapshot_take();
+    return SUCCESS;
+}
+
+static void sim_backend_cleanup(void) {
+    msr_backend_cleanup();
+    rdt_sim_cleanup();
+    g_msr_read = msr_read_cpu;
+    g_msr_write = msr_write_cpu;
+}
+
+// ---------------------------------------------------------------------------
+// resctrl backend
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    char path[256];
+    int created;        // Group directory was created by us
+    int schemata_fd;    // Kept open so repeated updates skip path lookups
+    int tasks_fd;
+    char saved[1024];   // Schemata of a group we did not create, restored on cleanup
+} resctrl_group_t;
+
+static resctrl_group_t g_groups[RDT_MAX_CLOS];
+static int g_resctrl_cdp = 0;          // L3 split into L3CODE/L3DATA
+static int g_resctrl_l2_cdp = 0;       // L2 split into L2CODE/L2DATA
+static int g_resctrl_mba_min = 10;
+static int g_resctrl_num_closids = 0;
+
+// Names kernels have used for the MPAM MBW_MIN control
+static const char *const mb_min_resources[] = { "MB_MIN", "MBW_MIN" };
+
+int rdt_resctrl_mounted(void) {
+    return check_file_exists(RDT_RESCTRL_PATH "/info") == SUCCESS;
+}
+
+static void resctrl_print_status(void) {
+    char status[256];
+    FILE *fp = fopen(RDT_RESCTRL_PATH "/info/last_cmd_status", "r");
+    if (fp) {
+        if (fgets(status, sizeof(status), fp)) {
+            status[strcspn(status, "\n")] = '\0';
+            PRINT_ERROR("resctrl: %s", status);
+        }
+        fclose(fp);
+    }
+}
+
+static int resctrl_group_open(int clos) {
+    resctrl_group_t *group = &g_groups[clos];
+    char path[300];
+
+    if (group->schemata_fd >= 0 && group->tasks_fd >= 0) {
+        return SUCCESS;
+    }
+
+    if (clos == 0) {
+        snprintf(group->path, sizeof(group->path), "%s", RDT_RESCTRL_PATH);
+    } else {
+        snprintf(group->path, sizeof(group->path), "%s/%s%d", RDT_RESCTRL_PATH, RDT_GROUP_PREFIX, clos);
+        if (mkdir(group->path, 0755) == 0) {
+            group->created = 1;
+        } else if (errno != EEXIST) {
+            PRINT_ERROR("Failed to create resctrl group %s: %s", group->path, strerror(errno));
+            resctrl_print_status();
+            return ERROR_SYSTEM;
+        }
+    }
+
+    snprintf(path, sizeof(path), "%s/schemata", group->path);
+    group->saved[0] = '\0';
+    if (!group->created && resctrl_read_schemata(path, group->saved, sizeof(group->saved)) != SUCCESS) {
+        PRINT_DEBUG("Could not save schemata of %s; it will not be restored", group->path);
+    }
+    group->schemata_fd = open(path, O_WRONLY);
+    snprintf(path, sizeof(path), "%s/tasks", group->path);
+    group->tasks_fd = open(path, O_WRONLY);
+
+    if (group->schemata_fd < 0 || group->tasks_fd < 0) {
+        PRINT_ERROR("Failed to open resctrl group %s: %s", group->path, strerror(errno));
+        return ERROR_SYSTEM;
+    }
+    return SUCCESS;
+}
+
+// The whole multi-line schemata, which resctrl accepts back in one write
+static int resctrl_read_schemata(const char *path, char *buf, size_t size) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        return ERROR_SYSTEM;
+    }
+    size_t len = fread(buf, 1, size - 1, fp);
+    int full = !feof(fp);
+    fclose(fp);
+
+    buf[full ? 0 : len] = '\0';
+    return (len > 0 && !full) ? SUCCESS : ERROR_SYSTEM;
+}
+
+// resctrl parses each write() as a whole; reuse the fd at offset 0
+static int resctrl_write_fd(int fd, const char *buf) {
+    if (pwrite(fd, buf, strlen(buf), 0) < 0) {
+        resctrl_print_status();
+        return ERROR_SYSTEM;
+    }
+    return SUCCESS;
+}
+
+static int resctrl_write_schemata(int clos, const char *resource, int domain, const char *fmt,
+                                  uint64_t value) {
+    char line[1024];
+    char entry[64];
+    size_t len;
+
+    if (resctrl_group_open(clos) != SUCCESS) {
+        return ERROR_SYSTEM;
+    }
+
+    // L2 resources are keyed by L2 cache id, everything else by L3
+    int l2 = strncmp(resource, "L2", 2) == 0;
+    int num_domains = l2 ? rdt_num_l2_domains() : rdt_num_domains();
+
+    len = snprintf(line, sizeof(line), "%s:", resource);
+    for (int d = 0; d < num_domains; d++) {
+        if (domain != RDT_ALL_DOMAINS && d != domain) continue;
+        snprintf(entry, sizeof(entry), fmt, l2 ? rdt_l2_domain_id(d) : rdt_domain_id(d), value);
+        len += snprintf(line + len, sizeof(line) - len, "%s%s", line[len - 1] == ':' ? "" : ";", entry);
+        if (len >= sizeof(line)) {
+            return ERROR_INVALID_PARAM;
+        }
+    }
+    snprintf(line + len, sizeof(line) - len, "\n");
+
+    if (resctrl_write_fd(g_groups[clos].schemata_fd, line) != SUCCESS) {
+        PRINT_ERROR("Failed to write schemata \"%.*s\" for CLOS %d", (int)len, line, clos);
+        return ERROR_SYSTEM;
+    }
+    return SUCCESS;
+}
+
+static int resctrl_backend_init(void) {
+    if (!rdt_resctrl_mounted()) {
+        PRINT_ERROR("resctrl is not mounted at %s (mount -t resctrl resctrl %s)",
+                    RDT_RESCTRL_PATH, RDT_RESCTRL_PATH);
+        return ERROR_NOT_SUPPORTED;
+    }
+
+    for (int i = 0; i < RDT_MAX_CLOS; i++) {
+        g_groups[i].schemata_fd = -1;
+        g_groups[i].tasks_fd = -1;
+        g_groups[i].created = 0;
+        g_groups[i].saved[0] = '\0';
+    }
+
+    g_resctrl_cdp = check_file_exists(RDT_RESCTRL_PATH "/info/L3CODE") == SUCCESS;
+    g_resctrl_l2_cdp = check_file_exists(RDT_RESCTRL_PATH "/info/L2CODE") == SUCCESS;
+
+    // Under CDP the kernel already reports the halved count
+    int closids = 0;
+    if (read_file_int(g_resctrl_cdp ? RDT_RESCTRL_PATH "/info/L3CODE/num_closids" :
+                                      RDT_RESCTRL_PATH "/info/L3/num_closids", &closids) == SUCCESS) {
+        g_resctrl_num_closids = closids;
+    }
+
+    int min_bw;
+    char path[] = RDT_RESCTRL_PATH "/info/MB/min_bandwidth";
+    if (check_file_exists(path) == SUCCESS && read_file_int(path, &min_bw) == SUCCESS) {
+        g_resctrl_mba_min = min_bw;
+    }
+
+    int gran;
+    g_resctrl_has_mb = check_file_exists(RDT_RESCTRL_PATH "/info/MB") == SUCCESS;
+    g_resctrl_mb_gran = 1;
+    if (read_file_int(RDT_RESCTRL_PATH "/info/MB/bandwidth_gran", &gran) == SUCCESS && gran > 0) {
+        g_resctrl_mb_gran = gran;
+    }
+    // AMD MB values are 1/8 GB/s; mba_MBps switches Intel to MiB/s
+    g_resctrl_mb_unit = 0.0;
+    g_resctrl_mb_max = 100;
+    if (g_resctrl_has_mb && cpu_is_amd()) {
+        g_resctrl_mb_unit = 0.125;
+        g_resctrl_mb_max = cpu_caps_get()->mba_bw_max > 0 ? (uint64_t)cpu_caps_get()->mba_bw_max : 2048;
+    } else if (g_resctrl_has_mb && resctrl_mount_has("mba_MBps")) {
+        g_resctrl_mb_unit = 1048576.0 / 1e9;
+        g_resctrl_mb_max = UINT32_MAX;
+    }
+    g_resctrl_l3_cbm = resctrl_read_cbm(g_resctrl_cdp ? "L3CODE" : "L3");
+    g_resctrl_l2_cbm = resctrl_read_cbm(g_resctrl_l2_cdp ? "L2CODE" : "L2");
+
+    g_resctrl_mb_min = NULL;
+    for (size_t i = 0; i < sizeof(mb_min_resources) / sizeof(mb_min_resources[0]); i++) {
+        snprintf(path, sizeof(path), RDT_RESCTRL_PATH "/info/%s", mb_min_resources[i]);
+        if (check_file_exists(path) == SUCCESS) {
+            g_resctrl_mb_min = mb_min_resources[i];
+            break;
+        }
+    }
+    return SUCCESS;
+}
+
+// Option of the resctrl mount in /proc/mounts
+static int resctrl_mount_has(const char *option) {
+    char line[512];
+    int found = 0;
+    FILE *fp = fopen("/proc/mounts", "r");
+    if (!fp) {
+        return 0;
+    }
+    while (!found && fgets(line, sizeof(line), fp)) {
+        found = strstr(line, " " RDT_RESCTRL_PATH " resctrl ") && strstr(line, option);
+    }
+    fclose(fp);
+    return found;
+}
+
+// info/<resource>/cbm_mask, 0 when the resource is not mounted
+static uint64_t resctrl_read_cbm(const char *resource) {
+    char path[128];
+    char value[32];
+
+    snprintf(path, sizeof(path), RDT_RESCTRL_PATH "/info/%s/cbm_mask", resource);
+    if (read_file_str(path, value, sizeof(value)) != SUCCESS) {
+        return 0;
+    }
+    return strtoull(value, NULL, 16);
+}
+
+static int mpam_backend_init(void) {
+    if (resctrl_backend_init() != SUCCESS) {
+        return ERROR_NOT_SUPPORTED;
+    }
+    if (!g_resctrl_l3_cbm && !g_resctrl_l2_cbm && !g_resctrl_has_mb) {
+        PRINT_ERROR("resctrl exposes no MPAM cache portion or bandwidth controls");
+        return ERROR_NOT_SUPPORTED;
+    }
+
+    PRINT_INFO("MPAM: %d PARTIDs, L3 CPBM %d bits, L2 CPBM %d bits, MB max %s (step %d%%), MB min %s",
+               g_resctrl_num_closids, __builtin_popcountll(g_resctrl_l3_cbm),
+               __builtin_popcountll(g_resctrl_l2_cbm), g_resctrl_has_mb ? "yes" : "no",
+               g_resctrl_mb_gran, g_resctrl_mb_min ? g_resctrl_mb_min : "no");
+    return SUCCESS;
+}
+
+static void resctrl_backend_cleanup(void) {
+    for (int clos = 0; clos < RDT_MAX_CLOS; clos++) {
+        resctrl_group_t *group = &g_groups[clos];
+
+        if (group->schemata_fd >= 0 && group->saved[0] &&
+            resctrl_write_fd(group->schemata_fd, group->saved) != SUCCESS) {
+            PRINT_ERROR("Failed to restore schemata of %s", group->path);
+        }
+        group->saved[0] = '\0';
+
+        if (group->schemata_fd >= 0) close(group->schemata_fd);
+        if (group->tasks_fd >= 0) close(group->tasks_fd);
+        group->schemata_fd = group->tasks_fd = -1;
+
+        // Removing a group moves its tasks and CPUs back to the root group
+        if (group->created && rmdir(group->path) != 0) {
+            PRINT_ERROR("Failed to remove resctrl group %s: %s", group->path, strerror(errno));
+        }
+        group->created = 0;
+    }
+}
+
+static int resctrl_set_l3_mask(int clos, int domain, uint64_t mask) {
+    if (g_resctrl_cdp) {
+        if (resctrl_write_schemata(clos, "L3DATA", domain, "%d=%lx", mask) != SUCCESS) {
+            return ERROR_SYSTEM;
+        }
+        return resctrl_write_schemata(clos, "L3CODE", domain, "%d=%lx", mask);
+    }
+    return resctrl_write_schemata(clos, "L3", domain, "%d=%lx", mask);
+}
+
+static int resctrl_set_l3_cdp(int clos, int domain, uint64_t code_mask, uint64_t data_mask) {
+    if (!g_resctrl_cdp) {
+        PRINT_ERROR("L3 CDP is not enabled (mount resctrl with -o cdp)");
+        return ERROR_NOT_SUPPORTED;
+    }
+    if (resctrl_write_schemata(clos, "L3DATA", domain, "%d=%lx", data_mask) != SUCCESS) {
+        return ERROR_SYSTEM;
+    }
+    return resctrl_write_schemata(clos, "L3CODE", domain, "%d=%lx", code_mask);
+}
+
+static int resctrl_set_l2_mask(int clos, int l2_domain, uint64_t mask) {
+    if (g_resctrl_l2_cdp) {
+        if (resctrl_write_schemata(clos, "L2DATA", l2_domain, "%d=%lx", mask) != SUCCESS) {
+            return ERROR_SYSTEM;
+        }
+        return resctrl_write_schemata(clos, "L2CODE", l2_domain, "%d=%lx", mask);
+    }
+    return resctrl_write_schemata(clos, "L2", l2_domain, "%d=%lx", mask);
+}
+
+// CDP is a mount option; the mode cannot change under running groups
+static int resctrl_set_cdp(int enable) {
+    if (!enable == !g_resctrl_cdp) {
+        return SUCCESS;
+    }
+    PRINT_ERROR("resctrl L3 CDP is set at mount time: umount %s && mount -t resctrl%s resctrl %s",
+                RDT_RESCTRL_PATH, enable ? " -o cdp" : "", RDT_RESCTRL_PATH);
+    return ERROR_NOT_SUPPORTED;
+}
+
+// resctrl takes the bandwidth percentage allowed rather than the delay,
+// in steps of bandwidth_gran (MPAM MBW_MAX fractions are coarse)
+static int resctrl_set_mba_throttle(int clos, int domain, int throttle) {
+    if (g_resctrl_mb_unit > 0) {
+        double gbps;
+        if (mba_throttle_gbps(throttle, &gbps) != SUCCESS) {
+            return ERROR_NOT_SUPPORTED;
+        }
+        return resctrl_set_mba_bw(clos, domain, gbps);
+    }
+
+    int percent = 100 - throttle;
+    percent = (percent + g_resctrl_mb_gran - 1) / g_resctrl_mb_gran * g_resctrl_mb_gran;
+    if (percent < g_resctrl_mba_min) {
+        percent = g_resctrl_mba_min;
+    }
+    if (percent > 100) {
+        percent = 100;
+    }
+    return resctrl_write_schemata(clos, "MB", domain, "%d=%lu", (uint64_t)percent);
+}
+
+static int resctrl_set_mba_bw(int clos, int domain, double gbps) {
+    if (g_resctrl_mb_unit <= 0) {
+        return ERROR_NOT_SUPPORTED;
+    }
+    uint64_t value = g_resctrl_mb_max;
+    if (gbps > 0) {
+        value = (uint64_t)llround(gbps / g_resctrl_mb_unit);
+        value = value < 1 ? 1 : (value > g_resctrl_mb_max ? g_resctrl_mb_max : value);
+    }
+    return resctrl_write_schemata(clos, "MB", domain, "%d=%lu", value);
+}
+
+static int resctrl_set_mba_min(int clos, int domain, int percent) {
+    if (!g_resctrl_mb_min) {
+        return ERROR_NOT_SUPPORTED;
+    }
+    return resctrl_write_schemata(clos, g_resctrl_mb_min, domain, "%d=%lu", (uint64_t)percent);
+}
+
+static int resctrl_assign_task(int clos, pid_t tid) {
+    char buf[32];
+
+    if (resctrl_group_open(clos) != SUCCESS) {
+        return ERROR_SYSTEM;
+    }
+    if (tid == 0) {
+        tid = (pid_t)syscall(SYS_gettid);
+    }
+
+    snprintf(buf, sizeof(buf), "%d\n", (int)tid);
+    if (resctrl_write_fd(g_groups[clos].tasks_fd, buf) != SUCCESS) {
+        PRINT_ERROR("Failed to move task %d to CLOS %d", (int)tid, clos);
+        return ERROR_SYSTEM;
+    }
+    return SUCCESS;
+}
+
+// cpus_list replaces the group's CPU set, so read it back and add one CPU
+static int resctrl_assign_cpu(int clos, int cpu) {
+    char path[300];
+    char list[4096];
+    cpu_set_t set;
+
+    if (resctrl_group_open(clos) != SUCCESS) {
+        return ERROR_SYSTEM;
+    }
+
+    snprintf(path, sizeof(path), "%s/cpus_list", g_groups[clos].path);
+    if (read_file_str(path, list, sizeof(list)) != SUCCESS ||
+        topo_parse_cpulist(list, &set) < 0) {
+        CPU_ZERO(&set);
+    }
+    CPU_SET(cpu, &set);
+
+    size_t len = 0;
+    list[0] = '\0';
+    TOPO_FOR_EACH_CPU(c, &set, CPU_SETSIZE) {
+        len += snprintf(list + len, sizeof(list) - len, "%s%d", len ? "," : "", c);
+        if (len >= sizeof(list)) {
+            return ERROR_INVALID_PARAM;
+        }
+    }
+
+    if (write_file_str(path, list) != SUCCESS) {
+        resctrl_print_status();
+        return ERROR_SYSTEM;
+    }
+    return SUCCESS;
+}
+
+static int resctrl_read_monitor(int clos, int domain, rdt_mon_event_t event, uint64_t *bytes) {
+    if (resctrl_group_open(clos) != SUCCESS) {
+        return ERROR_SYSTEM;
+    }
+    return resctrl_read_mon_data(g_groups[clos].path, domain, event, bytes);
+}
+
+// mon_data of a control or monitoring group directory
+static int resctrl_read_mon_data(const char *group_path, int domain, rdt_mon_event_t event,
+                                 uint64_t *bytes) {
+    static const char *event_files[] = {
+        [RDT_MON_LLC_OCCUPANCY] = "llc_occupancy",
+        [RDT_MON_MBM_TOTAL] = "mbm_total_bytes",
+        [RDT_MON_MBM_LOCAL] = "mbm_local_bytes",
+    };
+    char path[384];
+    char value[64];
+
+    snprintf(path, sizeof(path), "%s/mon_data/mon_L3_%02d/%s",
+             group_path, rdt_domain_id(domain), event_files[event]);
+
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        return ERROR_NOT_SUPPORTED;
+    }
+    if (fgets(value, sizeof(value), fp) == NULL) {
+        fclose(fp);
+        return ERROR_SYSTEM;
+    }
+    fclose(fp);
+
+    // The kernel reports "Unavailable" when the RMID is not yet counted
+    char *end;
+    *bytes = strtoull(value, &end, 10);
+    return end == value ? ERROR_NOT_SUPPORTED : SUCCESS;
+}
+
+// ---------------------------------------------------------------------------
+// resctrl monitoring groups
+// ---------------------------------------------------------------------------
+
+// Whether the tasks file of a resctrl group lists tid
+static int resctrl_tasks_has(const char *dir, pid_t tid) {
+    char path[384];
+    char line[32];
+    int found = 0;
+
+    snprintf(path, sizeof(path), "%s/tasks", dir);
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        return 0;
+    }
+    while (!found && fgets(line, sizeof(line), fp)) {
+        found = (pid_t)atoi(line) == tid;
+    }
+    fclose(fp);
+    return found;
+}
+
+// Control group of a task. A control group's tasks file lists every task
+// with its CLOS, including those in its monitoring groups; the root lists
+// the tasks of CLOS 0, so it is checked last.
+static int resctrl_task_ctrl_group(pid_t tid, char *path, size_t len) {
+    struct dirent *entry;
+    int found = 0;
+
+    DIR *dir = opendir(RDT_RESCTRL_PATH);
+    if (!dir) {
+        return ERROR_SYSTEM;
+    }
+    while (!found && (entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.' || entry->d_type != DT_DIR ||
+            strcmp(entry->d_name, "info") == 0 || strcmp(entry->d_name, "mon_groups") == 0 ||
+            strcmp(entry->d_name, "mon_data") == 0) {
+            continue;
+        }
+        snprintf(path, len, "%s/%s", RDT_RESCTRL_PATH, entry->d_name);
+        found = resctrl_tasks_has(path, tid);
+    }
+    closedir(dir);
+
+    if (!found) {
+        snprintf(path, len, "%s", RDT_RESCTRL_PATH);
+        found = resctrl_tasks_has(path, tid);
+    }
+    return found ? SUCCESS : ERROR_SYSTEM;
+}
+
+// Make the monitoring group directory under ctrl_path and open its tasks file
+static int mon_group_open(rdt_mon_group_t *group, const char *ctrl_path) {
+    char path[600];
+
+    snprintf(group->ctrl_path, sizeof(group->ctrl_path), "%s", ctrl_path);
+    snprintf(group->path, sizeof(group->path), "%s/mon_groups/%s%s",
+             group->ctrl_path, RDT_MON_GROUP_PREFIX, group->name);
+    if (mkdir(group->path, 0755) == 0) {
+        group->created = 1;
+    } else if (errno != EEXIST) {
+        // ENOSPC: every RMID is in use
+        PRINT_ERROR("Failed to create monitoring group %s: %s", group->path, strerror(errno));
+        resctrl_print_status();
+        return ERROR_SYSTEM;
+    }
+
+    snprintf(path, sizeof(path), "%s/tasks", group->path);
+    group->tasks_fd = open(path, O_WRONLY);
+    if (group->tasks_fd < 0) {
+        PRINT_ERROR("Failed to open %s: %s", path, strerror(errno));
+        rdt_mon_group_destroy(group);
+        return ERROR_SYSTEM;
+    }
+    if (strcmp(group->ctrl_path, RDT_RESCTRL_PATH) != 0) {
+        PRINT_INFO("Monitoring group %s is under control group %s", group->name, group->ctrl_path);
+    }
+    return SUCCESS;
+}
+
+// Checks resctrl only; the directory is made when the first task is added
+int rdt_mon_group_create(rdt_mon_group_t *group, const char *name) {
+    memset(group, 0, sizeof(*group));
+    group->tasks_fd = -1;
+    snprintf(group->name, sizeof(group->name), "%s", name);
+
+    if (!rdt_resctrl_mounted()) {
+        PRINT_ERROR("resctrl is not mounted at %s (mount -t resctrl resctrl %s)",
+                    RDT_RESCTRL_PATH, RDT_RESCTRL_PATH);
+        return ERROR_NOT_SUPPORTED;
+    }
+    return SUCCESS;
+}
+
+// Writing a TID into a monitoring group also sets its CLOS to the parent's,
+// so a task is only added to a group under its own control group
+int rdt_mon_group_add_task(rdt_mon_group_t *group, pid_t tid) {
+    char ctrl_path[320];
+    char buf[32];
+
+    if (resctrl_task_ctrl_group(tid, ctrl_path, sizeof(ctrl_path)) != SUCCESS) {
+        // The task may have exited since it was listed
+        return ERROR_SYSTEM;
+    }
+    if (group->tasks_fd < 0) {
+        if (mon_group_open(group, ctrl_path) != SUCCESS) {
+            return ERROR_SYSTEM;
+        }
+    } else if (strcmp(ctrl_path, group->ctrl_path) != 0) {
+        PRINT_ERROR("Task %d is in control group %s, monitoring group %s is under %s; "
+                    "moving it would change its allocation", (int)tid, ctrl_path, group->name,
+                    group->ctrl_path);
+        return ERROR_INVALID_PARAM;
+    }
+
+    snprintf(buf, sizeof(buf), "%d\n", (int)tid);
+    if (resctrl_write_fd(group->tasks_fd, buf) != SUCCESS) {
+        // The task may have exited since it was listed
+        return ERROR_SYSTEM;
+    }
+    return SUCCESS;
+}
+
+// resctrl moves single threads; move every thread of the process. Threads
+// created later inherit the group from their parent.
+int rdt_mon_group_add_pid(rdt_mon_group_t *group, pid_t pid) {
+    char path[64];
+    struct dirent *entry;
+    int added = 0;
+
+    snprintf(path, sizeof(path), "/proc/%d/task", (int)pid);
+    DIR *dir = opendir(path);
+    if (!dir) {
+        return rdt_mon_group_add_task(group, pid);
+    }
+    while ((entry = readdir(dir)) != NULL) {
+        pid_t tid = (pid_t)atoi(entry->d_name);
+        if (tid > 0 && rdt_mon_group_add_task(group, tid) == SUCCESS) {
+            added++;
+        }
+    }
+    closedir(dir);
+    return added > 0 ? SUCCESS : ERROR_SYSTEM;
+}
+
+int rdt_mon_group_read(const rdt_mon_group_t *group, int domain, rdt_mon_event_t event,
+                       uint64_t *bytes) {
+    if (group->path[0] == '\0') {
+        return ERROR_NOT_SUPPORTED;
+    }
+    return resctrl_read_mon_data(group->path, domain, event, bytes);
+}
+
+// Removing the group returns its tasks to the parent group's RMID
+void rdt_mon_group_destroy(rdt_mon_group_t *group) {
+    if (group->tasks_fd >= 0) {
+        close(group->tasks_fd);
+        group->tasks_fd = -1;
+    }
+    if (group->created && rmdir(group->path) != 0) {
+        PRINT_ERROR("Failed to remove monitoring group %s: %s", group->path, strerror(errno));
+    }
+    group->created = 0;
+    group->path[0] = '\0';
+}
+
+// ---------------------------------------------------------------------------
+// Backend selection and dispatch
+// ---------------------------------------------------------------------------
+
+int rdt_backend_parse(const char *name, rdt_backend_type_t *type) {
+    if (strcmp(name, "auto") == 0) {
+        *type = RDT_BACKEND_AUTO;
+    } else if (strcmp(name, "msr") == 0) {
+        *type = RDT_BACKEND_MSR;
+    } else if (strcmp(name, "resctrl") == 0) {
+        *type = RDT_BACKEND_RESCTRL;
+    } else if (strcmp(name, "sim") == 0) {
+        *type = RDT_BACKEND_SIM;
+    } else if (strcmp(name, "mpam") == 0) {
+        *type = RDT_BACKEND_MPAM;
+    } else {
+        PRINT_ERROR("Unknown RDT backend \"%s\" (auto, msr, resctrl, mpam, sim)", name);
+        return ERROR_INVALID_PARAM;
+    }
+    return SUCCESS;
+}
+
+// Prefer resctrl whenever it is mounted so we never fight the kernel
+int rdt_backend_init(rdt_backend_type_t type) {
+#ifdef RDT_ARCH_MPAM
+    if (type == RDT_BACKEND_AUTO || type == RDT_BACKEND_RESCTRL) {
+        type = RDT_BACKEND_MPAM;
+    } else if (type == RDT_BACKEND_MSR) {
+        PRINT_ERROR("The msr backend is x86 only; mount resctrl to use MPAM");
+        return ERROR_NOT_SUPPORTED;
+    }
+#endif
+    if (type == RDT_BACKEND_AUTO) {
+        type = rdt_resctrl_mounted() ? RDT_BACKEND_RESCTRL : RDT_BACKEND_MSR;
+    }
+
+    const rdt_backend_t *backend = &msr_backend;
+    if (type == RDT_BACKEND_RESCTRL) {
+        backend = &resctrl_backend;
+    } else if (type == RDT_BACKEND_MPAM) {
+        backend = &mpam_backend;
+    } else if (type == RDT_BACKEND_SIM) {
+        backend = &sim_backend;
+    }
+    if (backend->init() != SUCCESS) {
+        return ERROR_NOT_SUPPORTED;
+    }
+
+    g_backend = backend;
+    g_touched_l2 = 0;
+    PRINT_INFO("RDT backend: %s", backend->name);
+    return SUCCESS;
+}
+
+void rdt_backend_cleanup(void) {
+    if (!g_backend) {
+        return;
+    }
+
+    // Each backend puts back the allocation state it found at init
+    g_backend->cleanup();
+    g_backend = NULL;
+}
+
+const rdt_backend_t *rdt_backend_get(void) {
+    return g_backend;
+}
+
+const char *rdt_backend_name(void) {
+    return g_backend ? g_backend->name : "none";
+}
+
+static int backend_is_resctrl(void) {
+    return g_backend == &resctrl_backend || g_backend == &mpam_backend;
+}
+
+// The simulator models every resource, resctrl reports what it mounted,
+// the MSR backend goes by CPUID
+int rdt_has_mba(void) {
+    if (backend_is_resctrl()) {
+        return g_resctrl_has_mb;
+    }
+    return g_backend == &sim_backend || cpu_has_feature(CPU_FEAT_MBA);
+}
+
+int rdt_mba_absolute(void) {
+    if (backend_is_resctrl()) {
+        return g_resctrl_mb_unit > 0;
+    }
+    return g_backend == &msr_backend && msr_mba_amd();
+}
+
+void rdt_mba_set_reference(double gbps) {
+    g_mba_ref_gbps = gbps > 0 ? gbps : 0.0;
+}
+
+double rdt_mba_reference(void) {
+    return g_mba_ref_gbps;
+}
+
+int rdt_has_mba_min(void) {
+    return backend_is_resctrl() && g_resctrl_mb_min != NULL;
+}
+
+int rdt_has_l2_cat(void) {
+    if (backend_is_resctrl()) {
+        return g_resctrl_l2_cbm != 0;
+    }
+    return g_backend == &sim_backend || cpu_has_feature(CPU_FEAT_CAT_L2);
+}
+
+int rdt_has_cdp(void) {
+    if (backend_is_resctrl()) {
+        return g_resctrl_cdp || cpu_has_feature(CPU_FEAT_CDP_L3);
+    }
+    return g_backend == &sim_backend || cpu_has_feature(CPU_FEAT_CDP_L3);
+}
+
+int rdt_alloc_l3(int clos, int domain, uint64_t mask) {
+    if (!g_backend || check_clos(clos) != SUCCESS || check_domain(domain) != SUCCESS) {
+        return ERROR_INVALID_PARAM;
+    }
+
+    // Masks wider than the CBM would be rejected by hardware and kernel alike
+    uint64_t full = rdt_l3_full_mask();
+    if ((mask & ~full) && (mask & full)) {
+        PRINT_DEBUG("L3 mask 0x%lx clipped to CBM 0x%lx", mask, mask & full);
+        mask &= full;
+    }
+
+    return g_backend->set_l3_mask(clos, domain, mask);
+}
+
+int rdt_cdp_enable(int enable) {
+    if (!g_backend) {
+        return ERROR_INVALID_PARAM;
+    }
+    if (!rdt_has_cdp()) {
+        PRINT_ERROR("L3 CDP not supported on this CPU");
+        return ERROR_NOT_SUPPORTED;
+    }
+    return g_backend->set_cdp(enable != 0);
+}
+
+int rdt_num_clos(void) {
+    int num_clos = cpu_caps_get()->l3_cat.num_clos;
+
+    if (backend_is_resctrl() && g_resctrl_num_closids > 0) {
+        num_clos = g_resctrl_num_closids;
+    } else {
+        // Under CDP each CLOS takes two mask MSRs
+        num_clos = msr_num_regs(num_clos);
+        if (g_msr_cdp) {
+            num_clos /= 2;
+        }
+    }
+    return num_clos < RDT_MAX_CLOS ? num_clos : RDT_MAX_CLOS;
+}
+
+int rdt_cdp_enabled(void) {
+    if (backend_is_resctrl()) {
+        return g_resctrl_cdp;
+    }
+    return g_backend ? g_msr_cdp : 0;
+}
+
+int rdt_alloc_l3_cdp(int clos, int domain, uint64_t code_mask, uint64_t data_mask) {
+    if (!g_backend || check_clos(clos) != SUCCESS || check_domain(domain) != SUCCESS) {
+        return ERROR_INVALID_PARAM;
+    }
+
+    uint64_t full = rdt_l3_full_mask();
+    if ((code_mask & full) && (data_mask & full)) {
+        code_mask &= full;
+        data_mask &= full;
+    }
+
+    return g_backend->set_l3_cdp(clos, domain, code_mask, data_mask);
+}
+
+int rdt_alloc_l2(int clos, int l2_domain, uint64_t mask) {
+    if (!g_backend || check_clos(clos) != SUCCESS ||
+        (l2_domain != RDT_ALL_DOMAINS && (l2_domain < 0 || l2_domain >= rdt_num_l2_domains()))) {
+        return ERROR_INVALID_PARAM;
+    }
+    if (!rdt_has_l2_cat() || rdt_num_l2_domains() == 0) {
+        return ERROR_NOT_SUPPORTED;
+    }
+
+    uint64_t full = rdt_l2_full_mask();
+    if ((mask & ~full) && (mask & full)) {
+        PRINT_DEBUG("L2 mask 0x%lx clipped to CBM 0x%lx", mask, mask & full);
+        mask &= full;
+    }
+
+    g_touched_l2 |= 1U << clos;
+    return g_backend->set_l2_mask(clos, l2_domain, mask);
+}
+
+int rdt_alloc_mba(int clos, int domain, int throttle) {
+    if (!g_backend || check_clos(clos) != SUCCESS || check_domain(domain) != SUCCESS ||
+        throttle < 0 || throttle > 100) {
+        return ERROR_INVALID_PARAM;
+    }
+    if (!rdt_has_mba()) {
+        return ERROR_NOT_SUPPORTED;
+    }
+
+    return g_backend->set_mba_throttle(clos, domain, throttle);
+}
+
+int rdt_alloc_mba_bw(int clos, int domain, double gbps) {
+    if (!g_backend || check_clos(clos) != SUCCESS || check_domain(domain) != SUCCESS || gbps < 0) {
+        return ERROR_INVALID_PARAM;
+    }
+    if (!rdt_mba_absolute() || !g_backend->set_mba_bw) {
+        return ERROR_NOT_SUPPORTED;
+    }
+    return g_backend->set_mba_bw(clos, domain, gbps);
+}
+
+int rdt_alloc_mba_min(int clos, int domain, int percent) {
+    if (!g_backend || check_clos(clos) != SUCCESS || check_domain(domain) != SUCCESS ||
+        percent < 0 || percent > 100) {
+        return ERROR_INVALID_PARAM;
+    }
+    if (!g_backend->set_mba_min) {
+        return ERROR_NOT_SUPPORTED;
+    }
+    return g_backend->set_mba_min(clos, domain, percent);
+}
+
+int rdt_alloc_reset(int clos) {
+    int ret = rdt_alloc_l3(clos, RDT_ALL_DOMAINS, rdt_l3_full_mask());
+    if (rdt_has_mba()) {
+        rdt_alloc_mba(clos, RDT_ALL_DOMAINS, 0);
+    }
+    if (g_touched_l2 & (1U << clos)) {
+        rdt_alloc_l2(clos, RDT_ALL_DOMAINS, rdt_l2_full_mask());
+        g_touched_l2 &= ~(1U << clos);
+    }
+    return ret;
+}
+
+int rdt_assign_task(int clos, pid_t tid) {
+    if (!g_backend || check_clos(clos) != SUCCESS) {
+        return ERROR_INVALID_PARAM;
+    }
+    return g_backend->assign_task(clos, tid);
+}
+
+int rdt_assign_cpu(int clos, int cpu) {
+    if (!g_backend || check_clos(clos) != SUCCESS || cpu < 0) {
+        return ERROR_INVALID_PARAM;
+    }
+    return g_backend->assign_cpu(clos, cpu);
+}
+
+int rdt_mon_read(int clos, int domain, rdt_mon_event_t event, uint64_t *bytes) {
+    if (!g_backend || check_clos(clos) != SUCCESS || domain < 0 || domain >= rdt_num_domains() ||
+        bytes == NULL) {
+        return ERROR_INVALID_PARAM;
+    }
+    return g_backend->read_monitor(clos, domain, event, bytes);
+}
@@ -0,0 +1,191 @@
+#ifndef RDT_COMMON_H
+#define RDT_COMMON_H
+
+#include <sys/types.h>
+#include "../common/common.h"
+#include "../common/msr_utils.h"
+#include "../common/cpu_caps.h"
+#include "../common/topology.h"
+
+// resctrl filesystem
+#define RDT_RESCTRL_PATH    "/sys/fs/resctrl"
+#define RDT_GROUP_PREFIX    "hk_clos"
+#define RDT_MON_GROUP_PREFIX "hk_mon_"
+
+#define RDT_MAX_CLOS        16
+
+// Arm MPAM has no MSR interface from user space; partitioning goes
+// through resctrl, which the MPAM driver backs with PARTIDs
+#if defined(__aarch64__)
+#define RDT_ARCH_MPAM       1
+#endif
+#define RDT_ALL_DOMAINS     -1
+
+// PQR_ASSOC layout: RMID in bits 9:0, CLOS in bits 63:32
+#define RDT_PQR_RMID_MASK   0x3FFULL
+#define RDT_PQR_CLOS_SHIFT  32
+
+// QM_EVTSEL event ids
+#define RDT_EVT_LLC_OCCUPANCY  1
+#define RDT_EVT_MBM_TOTAL      2
+#define RDT_EVT_MBM_LOCAL      3
+
+// IA32_L3_QOS_CFG / IA32_L2_QOS_CFG: with CDP enabled, CLOS n uses mask
+// MSR 2n for data and 2n+1 for code, halving the usable CLOS
+#define RDT_QOS_CFG_CDP        (1ULL << 0)
+
+// QM_CTR status bits
+#define RDT_QM_CTR_ERROR       (1ULL << 63)
+#define RDT_QM_CTR_UNAVAILABLE (1ULL << 62)
+
+typedef enum {
+    RDT_BACKEND_AUTO,
+    RDT_BACKEND_MSR,
+    RDT_BACKEND_RESCTRL,
+    RDT_BACKEND_SIM,            // MSR backend on the simulated register file
+    RDT_BACKEND_MPAM            // resctrl on Arm MPAM, enumerated from resctrl info/
+} rdt_backend_type_t;
+
+typedef enum {
+    RDT_MON_LLC_OCCUPANCY,
+    RDT_MON_MBM_TOTAL,
+    RDT_MON_MBM_LOCAL
+} rdt_mon_event_t;
+
+// Allocation and monitoring operations of one backend. A CLOS is a
+// resctrl control group on the resctrl backend (CLOS 0 is the root group);
+// domain is an index into the topology L3 domains or RDT_ALL_DOMAINS.
+typedef struct {
+    const char *name;
+    int (*init)(void);
+    void (*cleanup)(void);
+    int (*set_l3_mask)(int clos, int domain, uint64_t mask);
+    int (*set_l3_cdp)(int clos, int domain, uint64_t code_mask, uint64_t data_mask);
+    int (*set_l2_mask)(int clos, int l2_domain, uint64_t mask);
+    int (*set_cdp)(int enable);
+    int (*set_mba_throttle)(int clos, int domain, int throttle);
+    int (*set_mba_min)(int clos, int domain, int percent);     // NULL without a minimum control
+    int (*set_mba_bw)(int clos, int domain, double gbps);      // Absolute limit, 0 = unlimited
+    int (*assign_task)(int clos, pid_t tid);
+    int (*assign_cpu)(int clos, int cpu);
+    int (*read_monitor)(int clos, int domain, rdt_mon_event_t event, uint64_t *bytes);
+} rdt_backend_t;
+
+// Backend selection. Init snapshots the allocation state (L3/L2 masks and
+// MBA delays of every domain, or the schemata of pre-existing resctrl
+// groups) and cleanup restores it, so runs leave the machine as found.
+int rdt_backend_init(rdt_backend_type_t type);
+void rdt_backend_cleanup(void);
+const rdt_backend_t *rdt_backend_get(void);
+const char *rdt_backend_name(void);
+int rdt_backend_parse(const char *name, rdt_backend_type_t *type);
+int rdt_resctrl_mounted(void);
+
+// Allocation; throttle is the MBA delay in percent (0 = unthrottled),
+// which resctrl and MPAM take as a maximum of 100 - throttle percent.
+// With CDP enabled rdt_alloc_l3() sets the code and data masks alike.
+int rdt_alloc_l3(int clos, int domain, uint64_t mask);
+int rdt_alloc_mba(int clos, int domain, int throttle);
+// Guaranteed bandwidth in percent (MPAM MBW_MIN); resctrl only exposes it
+// on kernels that publish a minimum-bandwidth schemata resource
+int rdt_alloc_mba_min(int clos, int domain, int percent);
+
+// AMD enforces bandwidth as an absolute limit (1/8 GB/s units) per L3
+// domain, i.e. per CCX; so does resctrl mounted with mba_MBps. There
+// rdt_alloc_mba_bw() sets the limit in GB/s (0 = unlimited), and a percent
+// throttle is taken from the reference bandwidth, normally the workload's
+// unthrottled demand, so N% means the same share on every vendor.
+int rdt_mba_absolute(void);
+int rdt_alloc_mba_bw(int clos, int domain, double gbps);
+void rdt_mba_set_reference(double gbps);
+double rdt_mba_reference(void);
+
+int rdt_alloc_reset(int clos);
+
+// Code/Data Prioritization on L3. Enabling or disabling it remaps the mask
+// MSRs, so every L3 mask is reset to the full CBM; resctrl fixes the mode
+// at mount time (-o cdp) and only reports it.
+int rdt_cdp_enable(int enable);
+int rdt_cdp_enabled(void);
+int rdt_alloc_l3_cdp(int clos, int domain, uint64_t code_mask, uint64_t data_mask);
+
+// L2 CAT; l2_domain indexes the topology L2 caches or is RDT_ALL_DOMAINS
+int rdt_alloc_l2(int clos, int l2_domain, uint64_t mask);
+
+// Association; tid 0 is the calling thread
+int rdt_assign_task(int clos, pid_t tid);
+int rdt_assign_cpu(int clos, int cpu);
+
+// Monitoring; occupancy in bytes, MBM as a running byte count
+int rdt_mon_read(int clos, int domain, rdt_mon_event_t event, uint64_t *bytes);
+
+// Raw access on the msr and sim backends, for tools that manage RMIDs and
+// counters themselves. A batch runs its QM_EVTSEL/QM_CTR pairs back to
+// back on one CPU of the domain; ctr is the raw QM_CTR value with the
+// status bits, so callers handle wrap with rdt_mbm_delta_bytes().
+typedef struct {
+    int rmid;
+    uint32_t event;             // RDT_EVT_*
+    uint64_t ctr;
+} rdt_mon_req_t;
+
+int rdt_msr_read(int cpu, uint32_t msr, uint64_t *value);
+int rdt_msr_write(int cpu, uint32_t msr, uint64_t value);
+int rdt_mon_read_batch(int domain, rdt_mon_req_t *reqs, int count);
+uint64_t rdt_mbm_delta_bytes(uint64_t prev, uint64_t cur);
+
+// CLOS switch fast path on the msr and sim backends. Opening a CPU keeps its
+// MSR device open and caches PQR_ASSOC, so a switch is a single write that
+// keeps the RMID. Switch from a thread pinned to that CPU: the msr driver
+// then executes the WRMSR locally instead of sending an IPI.
+int rdt_clos_fast_open(int cpu);
+int rdt_clos_fast_switch(int cpu, int clos);
+void rdt_clos_fast_close(int cpu);
+
+// resctrl monitoring group. The kernel gives it an RMID and switches
+// PQR_ASSOC on context switch, so its tasks are counted wherever they run;
+// counters are in bytes and never wrap. A monitoring group lives under one
+// control group and moving a task into it keeps the task's CLOS only if it
+// is that control group, so the directory is made under the control group
+// of the first task added, and tasks of other control groups are refused.
+typedef struct {
+    char name[64];
+    char ctrl_path[320];        // Control group the tasks belong to
+    char path[512];             // Empty until the first task is added
+    int created;
+    int tasks_fd;
+} rdt_mon_group_t;
+
+int rdt_mon_group_create(rdt_mon_group_t *group, const char *name);
+int rdt_mon_group_add_task(rdt_mon_group_t *group, pid_t tid);
+int rdt_mon_group_add_pid(rdt_mon_group_t *group, pid_t pid);
+int rdt_mon_group_read(const rdt_mon_group_t *group, int domain, rdt_mon_event_t event,
+                       uint64_t *bytes);
+void rdt_mon_group_destroy(rdt_mon_group_t *group);
+
+// Domain helpers; rdt_num_clos() is the usable CLOS count (CPUID or
+// resctrl num_closids, halved under CDP, at most RDT_MAX_CLOS). Full masks
+// come from resctrl cbm_mask on the resctrl backends (the MPAM cache
+// portion bitmap), from CPUID otherwise.
+int rdt_num_clos(void);
+int rdt_num_domains(void);
+int rdt_domain_id(int domain);
+uint64_t rdt_l3_full_mask(void);
+int rdt_l3_cbm_len(void);
+int rdt_num_l2_domains(void);
+int rdt_l2_domain_id(int l2_domain);
+uint64_t rdt_l2_full_mask(void);
+
+// Resources the active backend can control
+int rdt_has_mba(void);
+int rdt_has_mba_min(void);
+int rdt_has_l2_cat(void);
+int rdt_has_cdp(void);
+
+// Enumeration with fallbacks for parts (or the simulator) that do not
+// report them: bytes per MBM counter unit, MBM counter width, MBA delay
+uint32_t rdt_mon_upscale(void);
+int rdt_mbm_counter_width(void);
+int rdt_mba_max_delay(void);
+
+#endif /* RDT_COMMON_H */
@@ -0,0 +1,1203 @@
+#include "rdt_common.h"
+#include "../common/timing.h"
+#include "../common/histogram.h"
+#include "../common/perf_events.h"
+#include "../common/workload.h"
+#include <dirent.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/syscall.h>
+
+// Closed-loop dynamic L3 allocation (after dCat, EuroSys '18). Every
+// period the daemon samples IPC, LLC occupancy and MBM of each managed
+// resctrl group and grows or shrinks the contiguous CBM of the
+// performance-targeted groups. Best-effort groups and the root group
+// share whatever ways are left at the low end of the CBM.
+
+#define DCAT_MAX_GROUPS         8
+#define DCAT_MAX_TASKS          256
+#define DCAT_DEFAULT_PERIOD_MS  50
+#define DCAT_DEFAULT_HYSTERESIS 0.05   // Dead band around the IPC target
+#define DCAT_DEFAULT_STABLE     3      // Intervals a verdict must persist
+#define DCAT_DEFAULT_COOLDOWN   500    // ms between changes of one group
+#define DCAT_DEFAULT_WRITE_GAP  100    // ms between any two CBM changes
+#define DCAT_OCCUPANCY_FULL     0.80   // Occupancy/allocation ratio of a cache-bound group
+#define DCAT_EWMA_ALPHA         0.3
+
+#define CACHE_LINE_SIZE         64
+
+// Built-in probe test
+#define PROBE_REQUEST_HOPS      256
+#define PROBE_STREAM_SIZE       (64 * 1024 * 1024)
+#define PROBE_SETTLE_MS         1000
+#define PROBE_DEFAULT_DURATION  10
+#define PROBE_DEFAULT_TARGET    0.90   // Fraction of the probe's solo IPC
+#define PROBE_DEFAULT_NEIGHBORS 4
+
+typedef enum {
+    DCAT_HOLD,
+    DCAT_GROW,
+    DCAT_SHRINK,
+    DCAT_BLOCKED
+} dcat_action_t;
+
+// Controller parameters, fixed for a run and recorded in the log
+typedef struct {
+    int period_ms;
+    double hysteresis;
+    int stable;
+    int cooldown_ms;
+    int write_gap_ms;
+    int cbm_len;
+    int min_cbm_bits;
+    double way_bytes;           // L3 bytes per way in one domain
+} dcat_params_t;
+
+// Metrics of one group over one interval
+typedef struct {
+    int valid;
+    double ipc;
+    double llc_bytes;           // Largest occupancy over the L3 domains
+    double mbm_bps;             // Total over the L3 domains
+} dcat_sample_t;
+
+// Controller view of a group; everything here is derived from the
+// parameters and the sample stream so a log can be replayed exactly
+typedef struct {
+    char name[32];
+    double target_ipc;          // 0 = best effort
+    int min_ways;
+    int ways;                   // Current allocation of a targeted group
+    int have_metrics;
+    double ipc;                 // Smoothed metrics
+    double llc_bytes;
+    double mbm_bps;
+    int want;                   // Pending verdict: +1 grow, -1 shrink
+    int streak;
+    int64_t last_change_ms;
+} dcat_group_t;
+
+typedef struct {
+    dcat_params_t params;
+    int num_groups;
+    dcat_group_t groups[DCAT_MAX_GROUPS];
+    int64_t last_write_ms;
+    uint64_t epoch_ns;          // Time zero of the log, live runs only
+} dcat_ctl_t;
+
+typedef struct {
+    int group;
+    dcat_action_t action;
+    int from_ways;
+    int to_ways;
+    char reason[128];
+} dcat_decision_t;
+
+// Live state of a group: its CLOS, tasks and counters
+typedef struct {
+    int clos;
+    int num_tasks;
+    pid_t tasks[DCAT_MAX_TASKS];
+    perf_ipc_t perf[DCAT_MAX_TASKS];
+    uint64_t prev_mbm;
+    int have_mbm;
+    uint64_t mask;
+} dcat_live_t;
+
+// Probe test threads
+typedef struct {
+    int cpu;
+    pid_t tid;
+    void *buf;
+    size_t size;
+} probe_thread_t;
+
+static volatile int g_running = 1;
+static FILE *g_log = NULL;
+static int g_manage_root = 1;
+static dcat_live_t g_live[DCAT_MAX_GROUPS];
+static uint64_t g_be_mask = 0;
+
+// Probe test state
+static volatile int g_probe_stop = 0;
+static volatile int g_probe_phase = -1;     // Histogram index, -1 = not recording
+static volatile int g_neighbors_run = 0;
+static histogram_t g_probe_hist[3];
+static void *volatile g_probe_sink;
+
+// Function declarations
+void signal_handler(int sig);
+static void print_usage(const char *prog);
+static int parse_group(const char *spec, dcat_ctl_t *ctl, dcat_live_t *live);
+static int read_min_cbm_bits(void);
+static void dcat_init_params(dcat_params_t *params, int period_ms);
+static int dcat_ctl_setup(dcat_ctl_t *ctl);
+static double dcat_ratio(const dcat_group_t *group);
+static int dcat_step(dcat_ctl_t *ctl, const dcat_sample_t *samples, int64_t now_ms,
+                     dcat_decision_t *decision);
+static void dcat_reset_state(dcat_ctl_t *ctl);
+static void dcat_ctl_start(dcat_ctl_t *ctl);
+static void dcat_layout(const dcat_ctl_t *ctl, uint64_t *masks, uint64_t *be_mask);
+static int dcat_apply_layout(const dcat_ctl_t *ctl, dcat_live_t *live, int force);
+static int dcat_attach_pid(dcat_live_t *live, pid_t pid);
+static int dcat_attach_tid(dcat_live_t *live, pid_t tid);
+static void dcat_detach(dcat_live_t *live);
+static void dcat_sample(dcat_live_t *live, double dt_sec, dcat_sample_t *sample);
+static int dcat_run(dcat_ctl_t *ctl, dcat_live_t *live, int duration_ms, int control,
+                    double *ipc_sum, int *ipc_count);
+static const char *dcat_action_name(dcat_action_t action);
+static void log_params(const dcat_ctl_t *ctl);
+static void log_sample(int64_t t_ms, int group, const dcat_sample_t *sample);
+static void log_decision(int64_t t_ms, const dcat_ctl_t *ctl, const dcat_decision_t *decision);
+static const char *log_find(const char *line, const char *key);
+static double log_number(const char *line, const char *key, double fallback);
+static int log_string(const char *line, const char *key, char *buf, size_t len);
+static int dcat_replay(const char *path);
+static void *probe_request_thread(void *arg);
+static void *probe_stream_thread(void *arg);
+static int run_probe_test(dcat_ctl_t *ctl, int neighbors, int duration, double target_frac,
+                          int initial_ways);
+
+int main(int argc, char *argv[]) {
+    dcat_ctl_t ctl;
+    int period_ms = DCAT_DEFAULT_PERIOD_MS;
+    int duration = 0;
+    int initial_ways = 0;
+    const char *log_path = NULL;
+    const char *replay_path = NULL;
+    const char *group_specs[DCAT_MAX_GROUPS];
+    int num_specs = 0;
+    int probe_test = 0;
+    int probe_neighbors = PROBE_DEFAULT_NEIGHBORS;
+    int probe_duration = PROBE_DEFAULT_DURATION;
+    double probe_target = PROBE_DEFAULT_TARGET;
+
+    memset(&ctl, 0, sizeof(ctl));
+    dcat_init_params(&ctl.params, period_ms);
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--group") == 0 && i + 1 < argc) {
+            if (num_specs == DCAT_MAX_GROUPS) {
+                PRINT_ERROR("At most %d groups", DCAT_MAX_GROUPS);
+                return EXIT_FAILURE;
+            }
+            group_specs[num_specs++] = argv[++i];
+        } else if (strcmp(argv[i], "--period") == 0 && i + 1 < argc) {
+            period_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--hysteresis") == 0 && i + 1 < argc) {
+            ctl.params.hysteresis = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--stable") == 0 && i + 1 < argc) {
+            ctl.params.stable = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--cooldown") == 0 && i + 1 < argc) {
+            ctl.params.cooldown_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--write-gap") == 0 && i + 1 < argc) {
+            ctl.params.write_gap_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--initial-ways") == 0 && i + 1 < argc) {
+            initial_ways = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--duration") == 0 && i + 1 < argc) {
+            duration = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--log") == 0 && i + 1 < argc) {
+            log_path = argv[++i];
+        } else if (strcmp(argv[i], "--no-root") == 0) {
+            g_manage_root = 0;
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replay_path = argv[++i];
+        } else if (strcmp(argv[i], "--probe-test") == 0) {
+            probe_test = 1;
+        } else if (strcmp(argv[i], "--probe-neighbors") == 0 && i + 1 < argc) {
+            probe_neighbors = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--probe-duration") == 0 && i + 1 < argc) {
+            probe_duration = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--probe-target") == 0 && i + 1 < argc) {
+            probe_target = atof(argv[++i]);
+        } else {
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (replay_path) {
+        return dcat_replay(replay_path) == SUCCESS ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (period_ms < 10 || period_ms > 100) {
+        PRINT_ERROR("Sampling period must be 10-100 ms");
+        return EXIT_FAILURE;
+    }
+    ctl.params.period_ms = period_ms;
+    if (ctl.params.hysteresis < 0 || ctl.params.stable < 1 || ctl.params.cooldown_ms < 0 ||
+        ctl.params.write_gap_ms < 0 || duration < 0 || initial_ways < 0 ||
+        probe_neighbors < 1 || probe_neighbors > 64 || probe_duration < 1 ||
+        probe_target <= 0 || probe_target > 1.5) {
+        PRINT_ERROR("Invalid controller parameters");
+        return EXIT_FAILURE;
+    }
+    if (!probe_test && num_specs == 0) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (check_root_permission() != SUCCESS) {
+        return EXIT_FAILURE;
+    }
+    if (!cpu_has_feature(CPU_FEAT_CAT_L3) || !cpu_has_feature(CPU_FEAT_CQM_OCCUP_LLC)) {
+        PRINT_ERROR("L3 CAT and LLC occupancy monitoring are required");
+        return EXIT_FAILURE;
+    }
+    if (!perf_events_available()) {
+        PRINT_ERROR("Hardware perf counters unavailable; IPC cannot be sampled");
+        return EXIT_FAILURE;
+    }
+
+    // Monitoring groups only exist in resctrl
+    if (rdt_backend_init(RDT_BACKEND_RESCTRL) != SUCCESS) {
+        return EXIT_FAILURE;
+    }
+    if (timing_init() != SUCCESS || dcat_ctl_setup(&ctl) != SUCCESS) {
+        rdt_backend_cleanup();
+        return EXIT_FAILURE;
+    }
+
+    if (log_path) {
+        g_log = fopen(log_path, "w");
+        if (!g_log) {
+            PRINT_ERROR("Failed to open %s: %s", log_path, strerror(errno));
+            rdt_backend_cleanup();
+            return EXIT_FAILURE;
+        }
+        setvbuf(g_log, NULL, _IOLBF, 0);
+    }
+
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+
+    int ret = SUCCESS;
+    if (probe_test) {
+        ret = run_probe_test(&ctl, probe_neighbors, probe_duration, probe_target, initial_ways);
+    } else {
+        for (int i = 0; i < num_specs && ret == SUCCESS; i++) {
+            ret = parse_group(group_specs[i], &ctl, &g_live[ctl.num_groups]);
+        }
+
+        // Targeted groups start from an equal share of at most half the cache
+        int num_lc = 0;
+        for (int i = 0; i < ctl.num_groups; i++) {
+            num_lc += ctl.groups[i].target_ipc > 0;
+        }
+        for (int i = 0; i < ctl.num_groups && ret == SUCCESS; i++) {
+            dcat_group_t *group = &ctl.groups[i];
+            if (group->target_ipc > 0) {
+                int ways = initial_ways ? initial_ways : ctl.params.cbm_len / (2 * num_lc);
+                group->ways = ways > group->min_ways ? ways : group->min_ways;
+            }
+        }
+
+        int lc_ways = 0;
+        for (int i = 0; i < ctl.num_groups; i++) {
+            lc_ways += ctl.groups[i].target_ipc > 0 ? ctl.groups[i].ways : 0;
+        }
+        if (ret == SUCCESS && ctl.params.cbm_len - lc_ways < ctl.params.min_cbm_bits) {
+            PRINT_ERROR("Targeted groups need %d of %d ways; nothing left for best effort",
+                        lc_ways, ctl.params.cbm_len);
+            ret = ERROR_INVALID_PARAM;
+        }
+
+        if (ret == SUCCESS) {
+            ret = dcat_apply_layout(&ctl, g_live, 1);
+        }
+        if (ret == SUCCESS) {
+            PRINT_INFO("Managing %d group(s), period %d ms; Ctrl+C to stop",
+                       ctl.num_groups, ctl.params.period_ms);
+            dcat_ctl_start(&ctl);
+            ret = dcat_run(&ctl, g_live, duration * 1000, 1, NULL, NULL);
+        }
+        for (int i = 0; i < ctl.num_groups; i++) {
+            dcat_detach(&g_live[i]);
+        }
+    }
+
+    if (g_log) {
+        fclose(g_log);
+    }
+    // Restores full masks and removes the groups we created
+    rdt_backend_cleanup();
+    return ret == SUCCESS ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static void print_usage(const char *prog) {
+    printf("Usage: %s --group NAME:PID[,PID...][:ipc=TARGET][:min=WAYS] ... [options]\n", prog);
+    printf("       %s --probe-test [--probe-neighbors N] [--probe-duration SEC] [--probe-target FRAC]\n", prog);
+    printf("       %s --replay LOG\n", prog);
+    printf("Groups with an IPC target get their own contiguous ways at the high end\n");
+    printf("of the CBM; the others (and the root group) share the rest.\n");
+    printf("Options:\n");
+    printf("  --period MS         Sampling period, 10-100 (default %d)\n", DCAT_DEFAULT_PERIOD_MS);
+    printf("  --hysteresis FRAC   Dead band around the IPC target (default %.2f)\n", DCAT_DEFAULT_HYSTERESIS);
+    printf("  --stable N          Intervals a verdict must persist (default %d)\n", DCAT_DEFAULT_STABLE);
+    printf("  --cooldown MS       Minimum time between changes of a group (default %d)\n", DCAT_DEFAULT_COOLDOWN);
+    printf("  --write-gap MS      Minimum time between any CBM changes (default %d)\n", DCAT_DEFAULT_WRITE_GAP);
+    printf("  --initial-ways N    Starting ways of each targeted group\n");
+    printf("  --duration SEC      Stop after SEC seconds (default: until signalled)\n");
+    printf("  --log FILE          Write the JSON-lines sample/decision log\n");
+    printf("  --no-root           Leave the root group's mask alone\n");
+    printf("  --replay LOG        Re-run the controller over a log and check its decisions\n");
+}
+
+void signal_handler(int sig) {
+    (void)sig;
+    g_running = 0;
+}
+
+static int read_min_cbm_bits(void) {
+    int bits;
+    if (read_file_int(RDT_RESCTRL_PATH "/info/L3/min_cbm_bits", &bits) == SUCCESS && bits > 0) {
+        return bits;
+    }
+    return 1;
+}
+
+static void dcat_init_params(dcat_params_t *params, int period_ms) {
+    params->period_ms = period_ms;
+    params->hysteresis = DCAT_DEFAULT_HYSTERESIS;
+    params->stable = DCAT_DEFAULT_STABLE;
+    params->cooldown_ms = DCAT_DEFAULT_COOLDOWN;
+    params->write_gap_ms = DCAT_DEFAULT_WRITE_GAP;
+    params->cbm_len = 0;
+    params->min_cbm_bits = 1;
+    params->way_bytes = 0;
+}
+
+static int dcat_ctl_setup(dcat_ctl_t *ctl) {
+    const topo_cache_t *llc = topo_llc();
+
+    ctl->params.cbm_len = cpu_caps_get()->l3_cat.cbm_len;
+    if (ctl->params.cbm_len < 2 || ctl->params.cbm_len > 63) {
+        PRINT_ERROR("Unusable L3 CBM length %d", ctl->params.cbm_len);
+        return ERROR_NOT_SUPPORTED;
+    }
+    ctl->params.min_cbm_bits = read_min_cbm_bits();
+    ctl->params.way_bytes = llc ? (double)llc->size_bytes / ctl->params.cbm_len : 0;
+    ctl->last_write_ms = INT64_MIN / 2;
+    return SUCCESS;
+}
+
+// NAME:PID[,PID...][:ipc=TARGET][:min=WAYS]
+static int parse_group(const char *spec, dcat_ctl_t *ctl, dcat_live_t *live) {
+    char buf[512];
+    char *save = NULL;
+    dcat_group_t *group = &ctl->groups[ctl->num_groups];
+
+    snprintf(buf, sizeof(buf), "%s", spec);
+    char *name = strtok_r(buf, ":", &save);
+    char *pids = strtok_r(NULL, ":", &save);
+    if (!name || !pids) {
+        PRINT_ERROR("Invalid group \"%s\" (NAME:PID[,PID...][:ipc=X][:min=N])", spec);
+        return ERROR_INVALID_PARAM;
+    }
+
+    memset(group, 0, sizeof(*group));
+    memset(live, 0, sizeof(*live));
+    snprintf(group->name, sizeof(group->name), "%s", name);
+    group->min_ways = ctl->params.min_cbm_bits;
+    group->last_change_ms = INT64_MIN / 2;
+    live->clos = ctl->num_groups + 1;
+    if (live->clos >= rdt_num_clos()) {
+        PRINT_ERROR("Group %s needs CLOS %d; only %d CLOS available", name, live->clos, rdt_num_clos());
+        return ERROR_INVALID_PARAM;
+    }
+
+    for (char *opt = strtok_r(NULL, ":", &save); opt; opt = strtok_r(NULL, ":", &save)) {
+        if (strncmp(opt, "ipc=", 4) == 0) {
+            group->target_ipc = atof(opt + 4);
+        } else if (strncmp(opt, "min=", 4) == 0) {
+            int min = atoi(opt + 4);
+            group->min_ways = min > group->min_ways ? min : group->min_ways;
+        } else {
+            PRINT_ERROR("Unknown group option \"%s\"", opt);
+            return ERROR_INVALID_PARAM;
+        }
+    }
+
+    char *pid_save = NULL;
+    for (char *pid = strtok_r(pids, ",", &pid_save); pid; pid = strtok_r(NULL, ",", &pid_save)) {
+        if (dcat_attach_pid(live, (pid_t)atoi(pid)) != SUCCESS) {
+            return ERROR_SYSTEM;
+        }
+    }
+
+    ctl->num_groups++;
+    PRINT_INFO("Group %s: CLOS %d, %d task(s), %s", group->name, live->clos, live->num_tasks,
+               group->target_ipc > 0 ? "IPC-targeted" : "best effort");
+    return SUCCESS;
+}
+
+// Every thread of a process joins the group and gets its own counters;
+// inherit covers threads the process creates later
+static int dcat_attach_pid(dcat_live_t *live, pid_t pid) {
+    char path[64];
+    struct dirent *entry;
+
+    snprintf(path, sizeof(path), "/proc/%d/task", (int)pid);
+    DIR *dir = opendir(path);
+    if (!dir) {
+        PRINT_ERROR("No such process %d", (int)pid);
+        return ERROR_INVALID_PARAM;
+    }
+
+    int ret = SUCCESS;
+    while ((entry = readdir(dir)) != NULL && ret == SUCCESS) {
+        if (entry->d_name[0] == '.') continue;
+        ret = dcat_attach_tid(live, (pid_t)atoi(entry->d_name));
+    }
+    closedir(dir);
+    return ret;
+}
+
+static int dcat_attach_tid(dcat_live_t *live, pid_t tid) {
+    if (live->num_tasks == DCAT_MAX_TASKS) {
+        PRINT_ERROR("Too many tasks in CLOS %d", live->clos);
+        return ERROR_INVALID_PARAM;
+    }
+    if (rdt_assign_task(live->clos, tid) != SUCCESS) {
+        return ERROR_SYSTEM;
+    }
+    if (perf_ipc_open(&live->perf[live->num_tasks], tid, -1, 1) != SUCCESS) {
+        PRINT_ERROR("Failed to open cycle/instruction counters for task %d", (int)tid);
+        return ERROR_SYSTEM;
+    }
+    live->tasks[live->num_tasks++] = tid;
+    return SUCCESS;
+}
+
+static void dcat_detach(dcat_live_t *live) {
+    for (int i = 0; i < live->num_tasks; i++) {
+        perf_ipc_close(&live->perf[i]);
+    }
+    live->num_tasks = 0;
+}
+
+// ---------------------------------------------------------------------------
+// Controller
+// ---------------------------------------------------------------------------
+
+static double dcat_ratio(const dcat_group_t *group) {
+    return group->target_ipc > 0 ? group->ipc / group->target_ipc : 1.0;
+}
+
+// Forget smoothed metrics, streaks and change times; the replay starts
+// every group from exactly this state when it reads the group records
+static void dcat_reset_state(dcat_ctl_t *ctl) {
+    for (int i = 0; i < ctl->num_groups; i++) {
+        dcat_group_t *group = &ctl->groups[i];
+        group->have_metrics = 0;
+        group->ipc = group->llc_bytes = group->mbm_bps = 0;
+        group->want = 0;
+        group->streak = 0;
+        group->last_change_ms = INT64_MIN / 2;
+    }
+    ctl->last_write_ms = INT64_MIN / 2;
+}
+
+// Start a controlled run: fresh state, new time zero, params in the log
+static void dcat_ctl_start(dcat_ctl_t *ctl) {
+    dcat_reset_state(ctl);
+    ctl->epoch_ns = timing_now_ns();
+    log_params(ctl);
+}
+
+// Targeted groups take contiguous ways from the top of the CBM in group
+// order; everything below them is the shared best-effort region
+static void dcat_layout(const dcat_ctl_t *ctl, uint64_t *masks, uint64_t *be_mask) {
+    int top = ctl->params.cbm_len;
+
+    for (int i = 0; i < ctl->num_groups; i++) {
+        const dcat_group_t *group = &ctl->groups[i];
+        if (group->target_ipc > 0) {
+            top -= group->ways;
+            masks[i] = ((1ULL << group->ways) - 1) << top;
+        }
+    }
+    *be_mask = (1ULL << top) - 1;
+    for (int i = 0; i < ctl->num_groups; i++) {
+        if (ctl->groups[i].target_ipc <= 0) {
+            masks[i] = *be_mask;
+        }
+    }
+}
+
+// One controller step. Updates the smoothed metrics and verdict streaks,
+// then makes at most one allocation change. Returns 1 when *decision was
+// filled in (a change or a blocked grow), 0 otherwise.
+static int dcat_step(dcat_ctl_t *ctl, const dcat_sample_t *samples, int64_t now_ms,
+                     dcat_decision_t *decision) {
+    const dcat_params_t *p = &ctl->params;
+    int lc_ways = 0;
+    int best = -1;
+
+    for (int i = 0; i < ctl->num_groups; i++) {
+        dcat_group_t *group = &ctl->groups[i];
+        const dcat_sample_t *s = &samples[i];
+
+        if (group->target_ipc > 0) {
+            lc_ways += group->ways;
+        }
+        if (!s->valid) {
+            continue;
+        }
+
+        if (!group->have_metrics) {
+            group->ipc = s->ipc;
+            group->llc_bytes = s->llc_bytes;
+            group->mbm_bps = s->mbm_bps;
+            group->have_metrics = 1;
+        } else {
+            group->ipc += DCAT_EWMA_ALPHA * (s->ipc - group->ipc);
+            group->llc_bytes += DCAT_EWMA_ALPHA * (s->llc_bytes - group->llc_bytes);
+            group->mbm_bps += DCAT_EWMA_ALPHA * (s->mbm_bps - group->mbm_bps);
+        }
+
+        if (group->target_ipc <= 0) {
+            continue;
+        }
+
+        // Below target and filling its ways: more cache should help.
+        // Below target with spare occupancy is not a cache problem.
+        double ratio = dcat_ratio(group);
+        double alloc = group->ways * p->way_bytes;
+        int verdict = 0;
+        if (ratio < 1.0 - p->hysteresis) {
+            verdict = (alloc <= 0 || group->llc_bytes >= DCAT_OCCUPANCY_FULL * alloc) ? 1 : 0;
+        } else if (ratio > 1.0 + p->hysteresis && group->ways > group->min_ways) {
+            verdict = -1;
+        }
+
+        if (verdict != 0 && verdict == group->want) {
+            group->streak++;
+        } else {
+            group->want = verdict;
+            group->streak = verdict != 0;
+        }
+    }
+
+    if (now_ms - ctl->last_write_ms < p->write_gap_ms) {
+        return 0;
+    }
+
+    // Serve the group furthest below target first, then give back ways
+    // from the group furthest above it
+    for (int pass = 0; pass < 2 && best < 0; pass++) {
+        int want = pass == 0 ? 1 : -1;
+        for (int i = 0; i < ctl->num_groups; i++) {
+            const dcat_group_t *group = &ctl->groups[i];
+            if (group->target_ipc <= 0 || group->want != want || group->streak < p->stable ||
+                now_ms - group->last_change_ms < p->cooldown_ms) {
+                continue;
+            }
+            if (best < 0 || (want > 0 ? dcat_ratio(group) < dcat_ratio(&ctl->groups[best])
+                                      : dcat_ratio(group) > dcat_ratio(&ctl->groups[best]))) {
+                best = i;
+            }
+        }
+    }
+    if (best < 0) {
+        return 0;
+    }
+
+    dcat_group_t *group = &ctl->groups[best];
+    double alloc = group->ways * p->way_bytes;
+    decision->group = best;
+    decision->from_ways = group->ways;
+    group->streak = 0;
+
+    if (group->want > 0) {
+        // The best-effort region keeps at least min_cbm_bits ways
+        if (p->cbm_len - lc_ways - 1 < p->min_cbm_bits) {
+            decision->action = DCAT_BLOCKED;
+            decision->to_ways = group->ways;
+            snprintf(decision->reason, sizeof(decision->reason),
+                     "ipc %.3f < target %.3f but no free ways", group->ipc, group->target_ipc);
+            return 1;
+        }
+        decision->action = DCAT_GROW;
+        group->ways++;
+        snprintf(decision->reason, sizeof(decision->reason),
+                 "ipc %.3f < target %.3f, occupancy %.0f%% of allocation",
+                 group->ipc, group->target_ipc, alloc > 0 ? group->llc_bytes / alloc * 100 : 0.0);
+    } else {
+        decision->action = DCAT_SHRINK;
+        group->ways--;
+        snprintf(decision->reason, sizeof(decision->reason),
+                 "ipc %.3f > target %.3f", group->ipc, group->target_ipc);
+    }
+
+    decision->to_ways = group->ways;
+    group->last_change_ms = now_ms;
+    ctl->last_write_ms = now_ms;
+    return 1;
+}
+
+// Write the masks that changed; the root group follows the BE region
+static int dcat_apply_layout(const dcat_ctl_t *ctl, dcat_live_t *live, int force) {
+    uint64_t masks[DCAT_MAX_GROUPS];
+    uint64_t be_mask;
+
+    dcat_layout(ctl, masks, &be_mask);
+
+    // Shrink the shared region before growing a targeted group into it
+    if (g_manage_root && (force || be_mask != g_be_mask)) {
+        if (rdt_alloc_l3(0, RDT_ALL_DOMAINS, be_mask) != SUCCESS) {
+            return ERROR_SYSTEM;
+        }
+        g_be_mask = be_mask;
+    }
+    for (int i = 0; i < ctl->num_groups; i++) {
+        if (!force && masks[i] == live[i].mask) continue;
+        if (rdt_alloc_l3(live[i].clos, RDT_ALL_DOMAINS, masks[i]) != SUCCESS) {
+            return ERROR_SYSTEM;
+        }
+        live[i].mask = masks[i];
+    }
+    return SUCCESS;
+}
+
+static void dcat_sample(dcat_live_t *live, double dt_sec, dcat_sample_t *sample) {
+    uint64_t cycles = 0, instructions = 0;
+    uint64_t mbm = 0, llc_max = 0;
+    int have_mbm = 1;
+
+    memset(sample, 0, sizeof(*sample));
+
+    for (int i = 0; i < live->num_tasks; i++) {
+        uint64_t c, n;
+        if (perf_ipc_read(&live->perf[i], &c, &n) == SUCCESS) {
+            cycles += c;
+            instructions += n;
+        }
+    }
+
+    for (int d = 0; d < rdt_num_domains(); d++) {
+        uint64_t value;
+        if (rdt_mon_read(live->clos, d, RDT_MON_LLC_OCCUPANCY, &value) == SUCCESS && value > llc_max) {
+            llc_max = value;
+        }
+        if (rdt_mon_read(live->clos, d, RDT_MON_MBM_TOTAL, &value) == SUCCESS) {
+            mbm += value;
+        } else {
+            have_mbm = 0;
+        }
+    }
+
+    // A group whose tasks did not run has nothing to say this interval
+    sample->valid = cycles > 0;
+    sample->ipc = cycles ? (double)instructions / (double)cycles : 0.0;
+    sample->llc_bytes = (double)llc_max;
+    if (have_mbm && live->have_mbm && mbm >= live->prev_mbm && dt_sec > 0) {
+        sample->mbm_bps = (double)(mbm - live->prev_mbm) / dt_sec;
+    }
+    live->prev_mbm = mbm;
+    live->have_mbm = have_mbm;
+}
+
+// Sample every period for duration_ms (0 = until signalled). With control
+// off the allocation stays fixed and nothing is logged, so the log holds
+// exactly the intervals the controller saw.
+static int dcat_run(dcat_ctl_t *ctl, dcat_live_t *live, int duration_ms, int control,
+                    double *ipc_sum, int *ipc_count) {
+    dcat_sample_t samples[DCAT_MAX_GROUPS];
+    uint64_t start_ns = timing_now_ns();
+    uint64_t next_ns = start_ns;
+    uint64_t prev_ns = start_ns;
+
+    if (ctl->epoch_ns == 0) {
+        ctl->epoch_ns = start_ns;
+    }
+
+    // Prime the counter and MBM deltas
+    for (int i = 0; i < ctl->num_groups; i++) {
+        dcat_sample(&live[i], 0, &samples[i]);
+    }
+
+    while (g_running) {
+        next_ns += (uint64_t)ctl->params.period_ms * 1000000ULL;
+        uint64_t now_ns = timing_now_ns();
+        if (next_ns > now_ns) {
+            struct timespec ts = { 0, (long)(next_ns - now_ns) };
+            nanosleep(&ts, NULL);
+        }
+
+        now_ns = timing_now_ns();
+        int64_t t_ms = (int64_t)((now_ns - ctl->epoch_ns) / 1000000ULL);
+        double dt_sec = (now_ns - prev_ns) / 1e9;
+        prev_ns = now_ns;
+
+        for (int i = 0; i < ctl->num_groups; i++) {
+            dcat_sample(&live[i], dt_sec, &samples[i]);
+            if (control) {
+                log_sample(t_ms, i, &samples[i]);
+            }
+            if (ipc_sum && i == 0 && samples[i].valid) {
+                *ipc_sum += samples[i].ipc;
+                (*ipc_count)++;
+            }
+        }
+
+        dcat_decision_t decision;
+        if (control && dcat_step(ctl, samples, t_ms, &decision)) {
+            log_decision(t_ms, ctl, &decision);
+            if (decision.action != DCAT_BLOCKED) {
+                PRINT_INFO("%6.1fs %s: %s %d -> %d ways (%s)", t_ms / 1000.0,
+                           ctl->groups[decision.group].name, dcat_action_name(decision.action),
+                           decision.from_ways, decision.to_ways, decision.reason);
+                if (dcat_apply_layout(ctl, live, 0) != SUCCESS) {
+                    return ERROR_SYSTEM;
+                }
+            }
+        }
+
+        if (duration_ms > 0 && now_ns - start_ns >= (uint64_t)duration_ms * 1000000ULL) {
+            break;
+        }
+    }
+    return SUCCESS;
+}
+
+// ---------------------------------------------------------------------------
+// Decision log and replay
+// ---------------------------------------------------------------------------
+
+static const char *dcat_action_name(dcat_action_t action) {
+    switch (action) {
+        case DCAT_GROW: return "grow";
+        case DCAT_SHRINK: return "shrink";
+        case DCAT_BLOCKED: return "blocked";
+        default: return "hold";
+    }
+}
+
+// Doubles are logged with full precision so a replay sees identical input
+static void log_params(const dcat_ctl_t *ctl) {
+    const dcat_params_t *p = &ctl->params;
+
+    if (!g_log) return;
+    fprintf(g_log, "{\"type\":\"params\",\"period_ms\":%d,\"hysteresis\":%.17g,\"stable\":%d,"
+            "\"cooldown_ms\":%d,\"write_gap_ms\":%d,\"cbm_len\":%d,\"min_cbm_bits\":%d,"
+            "\"way_bytes\":%.17g}\n",
+            p->period_ms, p->hysteresis, p->stable, p->cooldown_ms, p->write_gap_ms,
+            p->cbm_len, p->min_cbm_bits, p->way_bytes);
+    for (int i = 0; i < ctl->num_groups; i++) {
+        const dcat_group_t *g = &ctl->groups[i];
+        fprintf(g_log, "{\"type\":\"group\",\"group\":%d,\"name\":\"%s\",\"target_ipc\":%.17g,"
+                "\"min_ways\":%d,\"ways\":%d}\n", i, g->name, g->target_ipc, g->min_ways, g->ways);
+    }
+}
+
+static void log_sample(int64_t t_ms, int group, const dcat_sample_t *sample) {
+    if (!g_log) return;
+    fprintf(g_log, "{\"type\":\"sample\",\"t_ms\":%ld,\"group\":%d,\"valid\":%d,\"ipc\":%.17g,"
+            "\"llc_bytes\":%.17g,\"mbm_bps\":%.17g}\n",
+            (long)t_ms, group, sample->valid, sample->ipc, sample->llc_bytes, sample->mbm_bps);
+}
+
+static void log_decision(int64_t t_ms, const dcat_ctl_t *ctl, const dcat_decision_t *decision) {
+    uint64_t masks[DCAT_MAX_GROUPS];
+    uint64_t be_mask;
+
+    if (!g_log) return;
+    dcat_layout(ctl, masks, &be_mask);
+    fprintf(g_log, "{\"type\":\"decision\",\"t_ms\":%ld,\"group\":%d,\"action\":\"%s\","
+            "\"from_ways\":%d,\"to_ways\":%d,\"mask\":\"0x%lx\",\"be_mask\":\"0x%lx\","
+            "\"reason\":\"%s\"}\n",
+            (long)t_ms, decision->group, dcat_action_name(decision->action),
+            decision->from_ways, decision->to_ways, masks[decision->group], be_mask,
+            decision->reason);
+}
+
+static const char *log_find(const char *line, const char *key) {
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+    const char *p = strstr(line, pattern);
+    return p ? p + strlen(pattern) : NULL;
+}
+
+static double log_number(const char *line, const char *key, double fallback) {
+    const char *p = log_find(line, key);
+    return p ? strtod(p, NULL) : fallback;
+}
+
+static int log_string(const char *line, const char *key, char *buf, size_t len) {
+    const char *p = log_find(line, key);
+    if (!p || *p != '"') {
+        return ERROR_INVALID_PARAM;
+    }
+    const char *end = strchr(p + 1, '"');
+    if (!end) {
+        return ERROR_INVALID_PARAM;
+    }
+    snprintf(buf, len, "%.*s", (int)(end - p - 1), p + 1);
+    return SUCCESS;
+}
+
+// Feed the logged samples through a fresh controller and check that it
+// makes the logged decisions at the same times
+static int dcat_replay(const char *path) {
+    FILE *fp = fopen(path, "r");
+    dcat_ctl_t ctl;
+    dcat_sample_t samples[DCAT_MAX_GROUPS];
+    int64_t cur_t = -1;
+    int pending = 0;
+    int have_params = 0;
+    dcat_decision_t replayed;
+    int have_replayed = 0;
+    int decisions = 0, mismatches = 0;
+    char *line = NULL;
+    size_t cap = 0;
+
+    if (!fp) {
+        PRINT_ERROR("Failed to open %s: %s", path, strerror(errno));
+        return ERROR_SYSTEM;
+    }
+
+    memset(&ctl, 0, sizeof(ctl));
+    memset(samples, 0, sizeof(samples));
+    ctl.last_write_ms = INT64_MIN / 2;
+
+    printf("%8s  %-16s  %-8s  %5s  %5s  %s\n", "t(ms)", "group", "action", "from", "to", "check");
+
+    for (;;) {
+        ssize_t n = getline(&line, &cap, fp);
+        char type[16] = "";
+
+        if (n > 0) {
+            log_string(line, "type", type, sizeof(type));
+        }
+        int64_t t = n > 0 ? (int64_t)log_number(line, "t_ms", -1) : -1;
+
+        // A new interval (or the end) closes the pending one
+        if (pending && (n <= 0 || strcmp(type, "sample") != 0 || t != cur_t)) {
+            have_replayed = dcat_step(&ctl, samples, cur_t, &replayed);
+            pending = 0;
+            if (have_replayed && (n <= 0 || strcmp(type, "decision") != 0 || t != cur_t)) {
+                printf("%8ld  %-16s  %-8s  %5d  %5d  EXTRA (not in log)\n", (long)cur_t,
+                       ctl.groups[replayed.group].name, dcat_action_name(replayed.action),
+                       replayed.from_ways, replayed.to_ways);
+                mismatches++;
+                have_replayed = 0;
+            }
+        }
+        if (n <= 0) {
+            break;
+        }
+
+        if (strcmp(type, "params") == 0) {
+            dcat_params_t *p = &ctl.params;
+            p->period_ms = (int)log_number(line, "period_ms", DCAT_DEFAULT_PERIOD_MS);
+            p->hysteresis = log_number(line, "hysteresis", DCAT_DEFAULT_HYSTERESIS);
+            p->stable = (int)log_number(line, "stable", DCAT_DEFAULT_STABLE);
+            p->cooldown_ms = (int)log_number(line, "cooldown_ms", DCAT_DEFAULT_COOLDOWN);
+            p->write_gap_ms = (int)log_number(line, "write_gap_ms", DCAT_DEFAULT_WRITE_GAP);
+            p->cbm_len = (int)log_number(line, "cbm_len", 0);
+            p->min_cbm_bits = (int)log_number(line, "min_cbm_bits", 1);
+            p->way_bytes = log_number(line, "way_bytes", 0);
+            ctl.last_write_ms = INT64_MIN / 2;
+            have_params = 1;
+        } else if (strcmp(type, "group") == 0) {
+            int index = (int)log_number(line, "group", -1);
+            if (index < 0 || index >= DCAT_MAX_GROUPS) continue;
+            dcat_group_t *g = &ctl.groups[index];
+            memset(g, 0, sizeof(*g));
+            log_string(line, "name", g->name, sizeof(g->name));
+            g->target_ipc = log_number(line, "target_ipc", 0);
+            g->min_ways = (int)log_number(line, "min_ways", 1);
+            g->ways = (int)log_number(line, "ways", 0);
+            g->last_change_ms = INT64_MIN / 2;
+            if (index >= ctl.num_groups) ctl.num_groups = index + 1;
+        } else if (strcmp(type, "sample") == 0) {
+            int index = (int)log_number(line, "group", -1);
+            if (index < 0 || index >= ctl.num_groups) continue;
+            if (!pending) {
+                memset(samples, 0, sizeof(samples));
+            }
+            samples[index].valid = (int)log_number(line, "valid", 0);
+            samples[index].ipc = log_number(line, "ipc", 0);
+            samples[index].llc_bytes = log_number(line, "llc_bytes", 0);
+            samples[index].mbm_bps = log_number(line, "mbm_bps", 0);
+            cur_t = t;
+            pending = 1;
+        } else if (strcmp(type, "decision") == 0) {
+            char action[16] = "";
+            int group = (int)log_number(line, "group", -1);
+            int to = (int)log_number(line, "to_ways", -1);
+            log_string(line, "action", action, sizeof(action));
+            decisions++;
+
+            int match = have_replayed && replayed.group == group && replayed.to_ways == to &&
+                        strcmp(dcat_action_name(replayed.action), action) == 0;
+            printf("%8ld  %-16s  %-8s  %5d  %5d  %s\n", (long)t,
+                   group >= 0 && group < ctl.num_groups ? ctl.groups[group].name : "?",
+                   action, (int)log_number(line, "from_ways", -1), to,
+                   match ? "ok" : "MISMATCH");
+            mismatches += !match;
+            have_replayed = 0;
+        }
+    }
+
+    free(line);
+    fclose(fp);
+
+    if (!have_params) {
+        PRINT_ERROR("%s has no params record", path);
+        return ERROR_INVALID_PARAM;
+    }
+    printf("\n%d logged decision(s), %d mismatch(es)\n", decisions, mismatches);
+    return mismatches == 0 ? SUCCESS : ERROR_SYSTEM;
+}
+
+// ---------------------------------------------------------------------------
+// Built-in latency probe vs streaming neighbors test
+// ---------------------------------------------------------------------------
+
+// Request loop: PROBE_REQUEST_HOPS dependent loads over a working set
+// sized to need a good part of the LLC
+static void *probe_request_thread(void *arg) {
+    probe_thread_t *t = (probe_thread_t *)arg;
+    void **p = (void **)t->buf;
+
+    topo_pin_thread(t->cpu);
+    t->tid = (pid_t)syscall(SYS_gettid);
+
+    while (!g_probe_stop) {
+        uint64_t start = timing_start();
+        for (int hop = 0; hop < PROBE_REQUEST_HOPS; hop++) {
+            p = (void **)*p;
+        }
+        uint64_t end = timing_stop();
+
+        int phase = g_probe_phase;
+        if (phase >= 0) {
+            hist_record(&g_probe_hist[phase], (uint64_t)timing_ticks_to_ns(end - start));
+        }
+    }
+    g_probe_sink = p;
+    return NULL;
+}
+
+static void *probe_stream_thread(void *arg) {
+    probe_thread_t *t = (probe_thread_t *)arg;
+    char *src = t->buf;
+    char *dst = src + t->size / 2;
+
+    topo_pin_thread(t->cpu);
+    t->tid = (pid_t)syscall(SYS_gettid);
+
+    while (!g_probe_stop) {
+        if (!g_neighbors_run) {
+            sleep_ms(1);
+            continue;
+        }
+        memcpy(dst, src, t->size / 2);
+        char *tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+    return NULL;
+}
+
+// Shared cache, a static split and the controller, each measured on the
+// same probe and neighbors after a short settle period
+static int run_probe_test(dcat_ctl_t *ctl, int neighbors, int duration, double target_frac,
+                          int initial_ways) {
+    static const char *phase_names[] = { "shared (no CAT)", "static split", "dynamic (dcat)" };
+    const topo_cache_t *llc = topo_llc();
+    probe_thread_t probe;
+    probe_thread_t *streams = calloc(neighbors, sizeof(probe_thread_t));
+    pthread_t *tids = calloc(neighbors + 1, sizeof(pthread_t));
+    int cpus[65];
+    int started = 0;
+    int probe_started = 0;
+    double phase_ipc[3] = { 0 };
+    int phase_ways[3] = { 0 };
+    int ret = SUCCESS;
+
+    if (!streams || !tids) {
+        free(streams);
+        free(tids);
+        return ERROR_SYSTEM;
+    }
+    if (rdt_num_clos() < 3) {
+        PRINT_ERROR("The probe test needs CLOS 1 and 2; only %d CLOS available", rdt_num_clos());
+        free(streams);
+        free(tids);
+        return ERROR_NOT_SUPPORTED;
+    }
+
+    topo_pick_llc_cpus(cpus, neighbors + 1);
+
+    // Half the LLC: more than the static share, less than the whole cache
+    memset(&probe, 0, sizeof(probe));
+    probe.cpu = cpus[0];
+    probe.size = llc && llc->size_bytes ? llc->size_bytes / 2 : 8 * 1024 * 1024;
+    probe.buf = wl_chain_alloc(probe.size, CACHE_LINE_SIZE, timing_now_ns());
+    if (!probe.buf) {
+        PRINT_ERROR("Failed to allocate probe working set");
+        free(streams);
+        free(tids);
+        return ERROR_SYSTEM;
+    }
+
+    for (int i = 0; i < 3; i++) {
+        hist_reset(&g_probe_hist[i]);
+    }
+
+    if (pthread_create(&tids[0], NULL, probe_request_thread, &probe) != 0) {
+        ret = ERROR_SYSTEM;
+    } else {
+        probe_started = 1;
+    }
+    for (int i = 0; i < neighbors && ret == SUCCESS; i++) {
+        streams[i].cpu = cpus[i + 1];
+        streams[i].size = PROBE_STREAM_SIZE;
+        streams[i].buf = malloc(PROBE_STREAM_SIZE);
+        if (!streams[i].buf || pthread_create(&tids[i + 1], NULL, probe_stream_thread, &streams[i]) != 0) {
+            free(streams[i].buf);
+            ret = ERROR_SYSTEM;
+            break;
+        }
+        memset(streams[i].buf, 0x5a, PROBE_STREAM_SIZE);
+        started++;
+    }
+
+    // Wait for the threads to publish their tids
+    for (int spin = 0; ret == SUCCESS && spin < 1000; spin++) {
+        int ready = probe.tid != 0;
+        for (int i = 0; i < started; i++) ready &= streams[i].tid != 0;
+        if (ready) break;
+        sleep_ms(1);
+    }
+    if (ret == SUCCESS) {
+        int ready = probe.tid != 0;
+        for (int i = 0; i < started; i++) ready &= streams[i].tid != 0;
+        if (!ready) {
+            PRINT_ERROR("Probe threads did not start");
+            ret = ERROR_SYSTEM;
+        }
+    }
+
+    // Group 0: the probe, IPC-targeted. Group 1: the neighbors, best effort.
+    ctl->num_groups = 2;
+    memset(ctl->groups, 0, sizeof(ctl->groups));
+    memset(g_live, 0, sizeof(dcat_live_t) * 2);
+    snprintf(ctl->groups[0].name, sizeof(ctl->groups[0].name), "probe");
+    snprintf(ctl->groups[1].name, sizeof(ctl->groups[1].name), "stream");
+    for (int i = 0; i < 2; i++) {
+        ctl->groups[i].min_ways = ctl->params.min_cbm_bits;
+        ctl->groups[i].last_change_ms = INT64_MIN / 2;
+        g_live[i].clos = i + 1;
+    }
+    if (ret == SUCCESS) {
+        ret = dcat_attach_tid(&g_live[0], probe.tid);
+    }
+    for (int i = 0; i < started && ret == SUCCESS; i++) {
+        ret = dcat_attach_tid(&g_live[1], streams[i].tid);
+    }
+
+    // Calibrate the IPC target on the probe running alone with the whole cache
+    int full_ways = ctl->params.cbm_len - ctl->params.min_cbm_bits;
+    double solo_ipc = 0;
+    int solo_count = 0;
+    if (ret == SUCCESS) {
+        ctl->groups[0].target_ipc = 1;     // Give the probe its own ways for now
+        ctl->groups[0].ways = full_ways;
+        ret = dcat_apply_layout(ctl, g_live, 1);
+    }
+    if (ret == SUCCESS) {
+        PRINT_INFO("Calibrating probe IPC alone (%zu KB working set)...", probe.size / 1024);
+        dcat_run(ctl, g_live, PROBE_SETTLE_MS, 0, &solo_ipc, &solo_count);
+        if (solo_count == 0 || solo_ipc <= 0) {
+            PRINT_ERROR("Probe IPC could not be measured");
+            ret = ERROR_SYSTEM;
+        }
+    }
+
+    int static_ways = initial_ways ? initial_ways : ctl->params.cbm_len / 4;
+    if (static_ways < ctl->params.min_cbm_bits) static_ways = ctl->params.min_cbm_bits;
+    if (static_ways > full_ways) static_ways = full_ways;
+
+    if (ret == SUCCESS) {
+        ctl->groups[0].target_ipc = target_frac * solo_ipc / solo_count;
+        PRINT_INFO("Probe solo IPC %.3f, target %.3f; static split gives it %d of %d ways",
+                   solo_ipc / solo_count, ctl->groups[0].target_ipc, static_ways, ctl->params.cbm_len);
+        g_neighbors_run = 1;
+    }
+
+    for (int phase = 0; phase < 3 && ret == SUCCESS && g_running; phase++) {
+        double ipc_sum = 0;
+        int ipc_count = 0;
+
+        if (phase == 0) {
+            // Everyone gets every way
+            rdt_alloc_l3(g_live[0].clos, RDT_ALL_DOMAINS, rdt_l3_full_mask());
+            rdt_alloc_l3(g_live[1].clos, RDT_ALL_DOMAINS, rdt_l3_full_mask());
+            if (g_manage_root) rdt_alloc_l3(0, RDT_ALL_DOMAINS, rdt_l3_full_mask());
+            g_live[0].mask = g_live[1].mask = g_be_mask = rdt_l3_full_mask();
+        } else {
+            ctl->groups[0].ways = static_ways;
+            ret = dcat_apply_layout(ctl, g_live, 1);
+        }
+        if (phase == 2) {
+            // The controller starts from the static split
+            dcat_ctl_start(ctl);
+        }
+
+        PRINT_INFO("=== Phase %d: %s ===", phase, phase_names[phase]);
+        int control = phase == 2;
+        g_probe_phase = -1;
+        dcat_run(ctl, g_live, PROBE_SETTLE_MS, control, NULL, NULL);
+        g_probe_phase = phase;
+        dcat_run(ctl, g_live, duration * 1000, control, &ipc_sum, &ipc_count);
+        g_probe_phase = -1;
+
+        phase_ipc[phase] = ipc_count ? ipc_sum / ipc_count : 0;
+        phase_ways[phase] = phase == 0 ? ctl->params.cbm_len : ctl->groups[0].ways;
+        hist_print(&g_probe_hist[phase], phase_names[phase], "ns");
+    }
+
+    g_probe_stop = 1;
+    if (probe_started) {
+        pthread_join(tids[0], NULL);
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(tids[i + 1], NULL);
+    }
+    for (int i = 0; i < 2; i++) {
+        dcat_detach(&g_live[i]);
+    }
+
+    if (ret == SUCCESS && g_running) {
+        printf("\n=== Latency Probe vs %d Streaming Neighbor(s) ===\n", neighbors);
+        printf("%-18s  %9s  %9s  %9s  %9s  %10s\n",
+               "Phase", "p50(ns)", "p99(ns)", "p99.9(ns)", "Probe IPC", "Probe ways");
+        for (int phase = 0; phase < 3; phase++) {
+            printf("%-18s  %9lu  %9lu  %9lu  %9.3f  %10d\n", phase_names[phase],
+                   hist_percentile(&g_probe_hist[phase], 50.0),
+                   hist_percentile(&g_probe_hist[phase], 99.0),
+                   hist_percentile(&g_probe_hist[phase], 99.9),
+                   phase_ipc[phase], phase_ways[phase]);
+        }
+
+        double p99_static = (double)hist_percentile(&g_probe_hist[1], 99.0);
+        double p99_dcat = (double)hist_percentile(&g_probe_hist[2], 99.0);
+        if (p99_static > 0) {
+            printf("\np99 vs static split: %+.1f%% (%s)\n",
+                   (p99_dcat - p99_static) / p99_static * 100.0,
+                   p99_dcat < p99_static ? "improved" : "not improved");
+        }
+    }
+
+    free(probe.buf);
+    for (int i = 0; i < started; i++) {
+        free(streams[i].buf);
+    }
+    free(streams);
+    free(tids);
+    return ret;
+}
@@ -0,0 +1,455 @@
+#include "rdt_common.h"
+#include "rdt_sim.h"
+#include "../common/timing.h"
+#include <math.h>
+#include <signal.h>
+
+// Software MBA controller: holds each CLOS at a bandwidth target in MB/s
+// by adjusting its MBA delay every interval from MBM deltas. The delay to
+// bandwidth mapping is nonlinear and platform specific, so the controller
+// steps along a secant through its last two operating points and falls
+// back to a damped proportional step when it has only one.
+
+#define MBA_CTL_MAX_TARGETS     RDT_MAX_CLOS
+#define MBA_CTL_MAX_DOMAINS     64
+#define MBA_CTL_INTERVAL_MS     100
+#define MBA_CTL_DURATION        20
+#define MBA_CTL_TOLERANCE       5.0     // Percent of target counted as converged
+#define MBA_CTL_GAIN            0.6     // Damping of the proportional step
+#define MBA_CTL_MAX_STEP        30.0    // Largest change of allowed bandwidth, percent
+#define MBA_CTL_SIM_DEMAND      12000.0 // Default simulated demand, MB/s
+
+typedef enum {
+    MBA_METRIC_TOTAL,
+    MBA_METRIC_LOCAL
+} mba_metric_t;
+
+typedef struct {
+    int clos;
+    double target_mbps;
+    double sim_demand_mbps;
+
+    // Controller state; "allowed" is 100 - delay, kept continuous
+    double allowed;
+    int delay;
+    int have_prev;
+    double prev_allowed;
+    double prev_mbps;
+    int demand_limited;
+
+    // Last MBM reading per L3 domain
+    uint64_t last_total[MBA_CTL_MAX_DOMAINS];
+    uint64_t last_local[MBA_CTL_MAX_DOMAINS];
+
+    // Time series for the report
+    int count;
+    double *total_mbps;
+    double *local_mbps;
+    double *error_pct;
+    int *delays;
+} mba_target_t;
+
+static volatile int g_running = 1;
+static mba_target_t g_targets[MBA_CTL_MAX_TARGETS];
+static int g_num_targets = 0;
+
+// Function declarations
+void signal_handler(int sig);
+static void print_usage(const char *prog);
+static int parse_pair(const char *arg, int *clos, double *value);
+static mba_target_t *find_target(int clos);
+static uint64_t mbm_delta(uint64_t prev, uint64_t cur);
+static int read_clos_mbm(mba_target_t *t, uint64_t *total, uint64_t *local);
+static int mba_step_size(void);
+static int quantize_delay(double allowed);
+static void mba_control(mba_target_t *t, double mbps, double tolerance);
+static void report(int interval_ms, double tolerance);
+
+int main(int argc, char *argv[]) {
+    rdt_backend_type_t backend = RDT_BACKEND_AUTO;
+    mba_metric_t metric = MBA_METRIC_TOTAL;
+    int interval_ms = MBA_CTL_INTERVAL_MS;
+    int duration = MBA_CTL_DURATION;
+    double tolerance = MBA_CTL_TOLERANCE;
+    double sim_cap = RDT_SIM_DEFAULT_CAP_MBPS;
+    int cpus[MBA_CTL_MAX_TARGETS * 4][2];
+    int num_cpus = 0;
+
+    for (int i = 1; i < argc; i++) {
+        int clos;
+        double value;
+
+        if (strcmp(argv[i], "--target") == 0 && i + 1 < argc) {
+            if (parse_pair(argv[++i], &clos, &value) != SUCCESS || value <= 0 ||
+                g_num_targets == MBA_CTL_MAX_TARGETS || find_target(clos)) {
+                PRINT_ERROR("Invalid target \"%s\" (CLOS:MBPS, one per CLOS)", argv[i]);
+                return EXIT_FAILURE;
+            }
+            g_targets[g_num_targets].clos = clos;
+            g_targets[g_num_targets].target_mbps = value;
+            g_targets[g_num_targets].sim_demand_mbps = MBA_CTL_SIM_DEMAND;
+            g_num_targets++;
+        } else if (strcmp(argv[i], "--cpu") == 0 && i + 1 < argc) {
+            if (parse_pair(argv[++i], &clos, &value) != SUCCESS ||
+                num_cpus == (int)(sizeof(cpus) / sizeof(cpus[0]))) {
+                PRINT_ERROR("Invalid CPU assignment \"%s\" (CLOS:CPU)", argv[i]);
+                return EXIT_FAILURE;
+            }
+            cpus[num_cpus][0] = clos;
+            cpus[num_cpus][1] = (int)value;
+            num_cpus++;
+        } else if (strcmp(argv[i], "--metric") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "total") == 0) {
+                metric = MBA_METRIC_TOTAL;
+            } else if (strcmp(argv[i], "local") == 0) {
+                metric = MBA_METRIC_LOCAL;
+            } else {
+                PRINT_ERROR("Unknown metric \"%s\" (total, local)", argv[i]);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc) {
+            interval_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--duration") == 0 && i + 1 < argc) {
+            duration = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+            tolerance = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--backend") == 0 && i + 1 < argc) {
+            if (rdt_backend_parse(argv[++i], &backend) != SUCCESS) {
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--sim-demand") == 0 && i + 1 < argc) {
+            mba_target_t *t;
+            if (parse_pair(argv[++i], &clos, &value) != SUCCESS || !(t = find_target(clos))) {
+                PRINT_ERROR("Invalid demand \"%s\" (CLOS:MBPS of a --target CLOS)", argv[i]);
+                return EXIT_FAILURE;
+            }
+            t->sim_demand_mbps = value;
+        } else if (strcmp(argv[i], "--sim-cap") == 0 && i + 1 < argc) {
+            sim_cap = atof(argv[++i]);
+        } else {
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (g_num_targets == 0 || interval_ms < 10 || duration <= 0 || tolerance <= 0) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (backend != RDT_BACKEND_SIM) {
+        if (check_root_permission() != SUCCESS) {
+            return EXIT_FAILURE;
+        }
+        if (!cpu_has_feature(CPU_FEAT_MBA) ||
+            !cpu_has_feature(metric == MBA_METRIC_TOTAL ? CPU_FEAT_CQM_MBM_TOTAL : CPU_FEAT_CQM_MBM_LOCAL)) {
+            PRINT_ERROR("MBA and MBM %s are required (try --backend sim)",
+                        metric == MBA_METRIC_TOTAL ? "total" : "local");
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (rdt_backend_init(backend) != SUCCESS) {
+        return EXIT_FAILURE;
+    }
+    if (rdt_num_domains() > MBA_CTL_MAX_DOMAINS) {
+        PRINT_ERROR("%d L3 domains exceed the supported %d", rdt_num_domains(), MBA_CTL_MAX_DOMAINS);
+        rdt_backend_cleanup();
+        return EXIT_FAILURE;
+    }
+
+    int max_samples = duration * 1000 / interval_ms + 1;
+    for (int i = 0; i < g_num_targets; i++) {
+        mba_target_t *t = &g_targets[i];
+        t->total_mbps = calloc(max_samples, sizeof(double));
+        t->local_mbps = calloc(max_samples, sizeof(double));
+        t->error_pct = calloc(max_samples, sizeof(double));
+        t->delays = calloc(max_samples, sizeof(int));
+        if (!t->total_mbps || !t->local_mbps || !t->error_pct || !t->delays) {
+            PRINT_ERROR("Out of memory");
+            rdt_backend_cleanup();
+            return EXIT_FAILURE;
+        }
+
+        // Start unthrottled and let the loop find the delay
+        t->allowed = 100.0;
+        t->delay = 0;
+        rdt_alloc_mba(t->clos, RDT_ALL_DOMAINS, 0);
+        if (strcmp(rdt_backend_name(), "sim") == 0) {
+            rdt_sim_set_demand(t->clos, 0, t->sim_demand_mbps);
+        }
+    }
+    if (strcmp(rdt_backend_name(), "sim") == 0) {
+        rdt_sim_set_bandwidth_cap(sim_cap);
+    }
+    for (int i = 0; i < num_cpus; i++) {
+        if (rdt_assign_cpu(cpus[i][0], cpus[i][1]) != SUCCESS) {
+            PRINT_ERROR("Failed to move CPU %d to CLOS %d", cpus[i][1], cpus[i][0]);
+        }
+    }
+
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+
+    for (int i = 0; i < g_num_targets; i++) {
+        uint64_t total, local;
+        read_clos_mbm(&g_targets[i], &total, &local);
+    }
+
+    printf("Time(s)");
+    for (int i = 0; i < g_num_targets; i++) {
+        printf("  CLOS%-2d MB/s (tgt %6.0f) Delay", g_targets[i].clos, g_targets[i].target_mbps);
+    }
+    printf("\n");
+
+    uint64_t start_ns = timing_now_ns();
+    uint64_t prev_ns = start_ns;
+    uint64_t next_ns = start_ns;
+    for (int step = 0; step < max_samples - 1 && g_running; step++) {
+        next_ns += (uint64_t)interval_ms * 1000000ULL;
+        uint64_t now_ns = timing_now_ns();
+        if (next_ns > now_ns) {
+            struct timespec ts = { (time_t)((next_ns - now_ns) / 1000000000ULL),
+                                   (long)((next_ns - now_ns) % 1000000000ULL) };
+            nanosleep(&ts, NULL);
+        }
+
+        now_ns = timing_now_ns();
+        double dt = (now_ns - prev_ns) / 1e9;
+        prev_ns = now_ns;
+
+        printf("%7.2f", (now_ns - start_ns) / 1e9);
+        for (int i = 0; i < g_num_targets; i++) {
+            mba_target_t *t = &g_targets[i];
+            uint64_t total, local;
+
+            if (read_clos_mbm(t, &total, &local) != SUCCESS) {
+                printf("  %-32s", "  (MBM unavailable)");
+                continue;
+            }
+
+            double total_mbps = total / dt / (1024.0 * 1024.0);
+            double local_mbps = local / dt / (1024.0 * 1024.0);
+            double mbps = metric == MBA_METRIC_TOTAL ? total_mbps : local_mbps;
+
+            t->total_mbps[t->count] = total_mbps;
+            t->local_mbps[t->count] = local_mbps;
+            t->error_pct[t->count] = (mbps - t->target_mbps) / t->target_mbps * 100.0;
+            t->delays[t->count] = t->delay;
+            t->count++;
+
+            printf("  %9.1f (local %9.1f) %5d", total_mbps, local_mbps, t->delay);
+            mba_control(t, mbps, tolerance);
+        }
+        printf("\n");
+    }
+
+    report(interval_ms, tolerance);
+
+    for (int i = 0; i < g_num_targets; i++) {
+        free(g_targets[i].total_mbps);
+        free(g_targets[i].local_mbps);
+        free(g_targets[i].error_pct);
+        free(g_targets[i].delays);
+    }
+    // Clears the delays we set
+    rdt_backend_cleanup();
+    return EXIT_SUCCESS;
+}
+
+static void print_usage(const char *prog) {
+    printf("Usage: %s --target CLOS:MBPS [--target ...] [options]\n", prog);
+    printf("Options:\n");
+    printf("  --cpu CLOS:CPU         Move a CPU into the CLOS before starting\n");
+    printf("  --metric total|local   MBM event to control on (default total)\n");
+    printf("  --interval MS          Control interval (default %d)\n", MBA_CTL_INTERVAL_MS);
+    printf("  --duration SEC         Run time (default %d)\n", MBA_CTL_DURATION);
+    printf("  --tolerance PCT        Error band counted as converged (default %.0f)\n", MBA_CTL_TOLERANCE);
+    printf("  --backend auto|msr|resctrl|sim\n");
+    printf("  --sim-demand CLOS:MBPS Unthrottled demand of a CLOS in the simulator (default %.0f)\n",
+           MBA_CTL_SIM_DEMAND);
+    printf("  --sim-cap MBPS         Simulated memory bandwidth per domain (default %.0f)\n",
+           RDT_SIM_DEFAULT_CAP_MBPS);
+}
+
+void signal_handler(int sig) {
+    (void)sig;
+    g_running = 0;
+}
+
+static int parse_pair(const char *arg, int *clos, double *value) {
+    char *end;
+
+    *clos = (int)strtol(arg, &end, 10);
+    if (*end != ':' || *clos < 0 || *clos >= RDT_MAX_CLOS) {
+        return ERROR_INVALID_PARAM;
+    }
+    *value = strtod(end + 1, &end);
+    return *end == '\0' ? SUCCESS : ERROR_INVALID_PARAM;
+}
+
+static mba_target_t *find_target(int clos) {
+    for (int i = 0; i < g_num_targets; i++) {
+        if (g_targets[i].clos == clos) {
+            return &g_targets[i];
+        }
+    }
+    return NULL;
+}
+
+// Bytes between two readings of one domain's MBM counter. The MSR backends
+// return the upscaled hardware counter, which wraps at its counter width;
+// resctrl keeps a 64-bit byte count that only moves forward.
+static uint64_t mbm_delta(uint64_t prev, uint64_t cur) {
+    const char *backend = rdt_backend_name();
+    if (strcmp(backend, "msr") == 0 || strcmp(backend, "sim") == 0) {
+        uint32_t upscale = rdt_mon_upscale();
+        return rdt_mbm_delta_bytes(prev / upscale, cur / upscale);
+    }
+    return cur >= prev ? cur - prev : 0;
+}
+
+// MBM traffic of a CLOS (RMID == CLOS on the MSR backends) since its last
+// reading, taken per L3 domain so a wrap in one domain stays local to it
+static int read_clos_mbm(mba_target_t *t, uint64_t *total, uint64_t *local) {
+    uint64_t cur_total[MBA_CTL_MAX_DOMAINS], cur_local[MBA_CTL_MAX_DOMAINS];
+    int domains = rdt_num_domains();
+
+    for (int d = 0; d < domains; d++) {
+        if (rdt_mon_read(t->clos, d, RDT_MON_MBM_TOTAL, &cur_total[d]) != SUCCESS ||
+            rdt_mon_read(t->clos, d, RDT_MON_MBM_LOCAL, &cur_local[d]) != SUCCESS) {
+            return ERROR_NOT_SUPPORTED;
+        }
+    }
+
+    *total = *local = 0;
+    for (int d = 0; d < domains; d++) {
+        *total += mbm_delta(t->last_total[d], cur_total[d]);
+        *local += mbm_delta(t->last_local[d], cur_local[d]);
+        t->last_total[d] = cur_total[d];
+        t->last_local[d] = cur_local[d];
+    }
+    return SUCCESS;
+}
+
+// Delay granularity: linear MBA steps by 100 - max delay (10 on most parts)
+static int mba_step_size(void) {
+    int step = 100 - rdt_mba_max_delay();
+    return step > 0 ? step : 10;
+}
+
+static int quantize_delay(double allowed) {
+    int step = mba_step_size();
+    int delay = (int)lround((100.0 - allowed) / step) * step;
+    if (delay < 0) delay = 0;
+    if (delay > rdt_mba_max_delay()) delay = rdt_mba_max_delay();
+    return delay;
+}
+
+static void mba_control(mba_target_t *t, double mbps, double tolerance) {
+    double error = (mbps - t->target_mbps) / t->target_mbps;
+    double next = t->allowed;
+
+    t->demand_limited = t->delay == 0 && mbps < t->target_mbps;
+
+    // An idle CLOS says nothing about the mapping; wait for traffic
+    if (mbps < 1.0) {
+        return;
+    }
+
+    // Secant through the last two operating points when they are apart
+    // enough to give a usable slope (MB/s per percent allowed)
+    double slope = 0;
+    if (t->have_prev && fabs(t->allowed - t->prev_allowed) >= 1.0) {
+        slope = (mbps - t->prev_mbps) / (t->allowed - t->prev_allowed);
+    }
+    if (slope > 0) {
+        next = t->allowed + (t->target_mbps - mbps) / slope;
+    } else {
+        next = t->allowed * pow(t->target_mbps / mbps, MBA_CTL_GAIN);
+    }
+
+    if (next > t->allowed + MBA_CTL_MAX_STEP) next = t->allowed + MBA_CTL_MAX_STEP;
+    if (next < t->allowed - MBA_CTL_MAX_STEP) next = t->allowed - MBA_CTL_MAX_STEP;
+    if (next > 100.0) next = 100.0;
+    if (next < 100.0 - rdt_mba_max_delay()) next = 100.0 - rdt_mba_max_delay();
+
+    // Inside half the reported band, hold; the secant memory stays for
+    // the next error
+    if (fabs(error) * 100.0 <= tolerance / 2) {
+        return;
+    }
+
+    // The delay only moves in whole steps, so a target between two steps
+    // is bracketed rather than hit: leave the current step only when the
+    // secant predicts the new one lands closer to the target
+    int delay = quantize_delay(next);
+    if (delay != t->delay && slope > 0) {
+        double predicted = mbps + slope * (t->delay - delay);
+        if (fabs(predicted - t->target_mbps) >= fabs(mbps - t->target_mbps)) {
+            t->allowed = 100.0 - t->delay;
+            return;
+        }
+    }
+    if (delay != t->delay) {
+        if (rdt_alloc_mba(t->clos, RDT_ALL_DOMAINS, delay) != SUCCESS) {
+            PRINT_ERROR("Failed to set MBA delay %d for CLOS %d", delay, t->clos);
+            return;
+        }
+        t->prev_allowed = 100.0 - t->delay;
+        t->prev_mbps = mbps;
+        t->have_prev = 1;
+        t->delay = delay;
+        t->allowed = 100.0 - delay;
+    } else {
+        // Keep integrating so a persistent error eventually crosses a step
+        t->allowed = next;
+    }
+}
+
+// Convergence time: start of the last run of intervals that stays inside
+// the tolerance band until the end. Steady-state error: mean over that run.
+static void report(int interval_ms, double tolerance) {
+    printf("\n=== MBA Controller Summary (tolerance %.1f%%) ===\n", tolerance);
+    printf("CLOS  Target MB/s  Converged(s)  SS error(%%)  SS |error|(%%)  Final MB/s  Final delay\n");
+    printf("----  -----------  ------------  -----------  -------------  ----------  -----------\n");
+
+    for (int i = 0; i < g_num_targets; i++) {
+        const mba_target_t *t = &g_targets[i];
+        int start = t->count;
+
+        while (start > 0 && fabs(t->error_pct[start - 1]) <= tolerance) {
+            start--;
+        }
+
+        double sum = 0, abs_sum = 0;
+        for (int k = start; k < t->count; k++) {
+            sum += t->error_pct[k];
+            abs_sum += fabs(t->error_pct[k]);
+        }
+        int n = t->count - start;
+        double final = t->count ? (t->total_mbps[t->count - 1]) : 0;
+
+        if (n > 0) {
+            printf("%4d  %11.0f  %12.2f  %+11.2f  %13.2f  %10.1f  %11d\n",
+                   t->clos, t->target_mbps, (double)(start + 1) * interval_ms / 1000.0,
+                   sum / n, abs_sum / n, final, t->delay);
+        } else {
+            printf("%4d  %11.0f  %12s  %11s  %13s  %10.1f  %11d\n",
+                   t->clos, t->target_mbps, "never", "-", "-", final, t->delay);
+        }
+        int settled = t->count >= 5;
+        for (int k = t->count - 5; settled && k < t->count; k++) {
+            settled = t->delays[k] == t->delay;
+        }
+        if (n == 0 && settled && !t->demand_limited) {
+            printf("      CLOS %d settled at delay %d: the target lies between two delay steps\n",
+                   t->clos, t->delay);
+        }
+        if (t->demand_limited) {
+            printf("      CLOS %d is below target while unthrottled: its demand is lower\n", t->clos);
+        }
+    }
+    printf("\n");
+}
@@ -1,292 +1,830 @@
-#include "../common/common.h"
-#include "../common/msr_utils.h"
+#include "rdt_common.h"
+#include "rdt_sim.h"
 #include <signal.h>
+#include <pthread.h>
+#include <time.h>
 
 // RDT monitoring definitions
-#define MAX_RMID 256
-#define MONITORING_INTERVAL_MS 100
+#define MAX_RMID 1024                   // PQR_ASSOC RMID field is 10 bits
+#define MON_MAX_TARGETS 64              // RMIDs or groups watched in one run
+#define MON_EVENTS 3                    // LLC occupancy, MBM total, MBM local
+#define CGROUP_ROOT "/sys/fs/cgroup"
+#define MONITORING_INTERVAL_MS 10
+#define PRINT_INTERVAL_MS 1000
 
 static volatile int running = 1;
 
+// One reader per L3 domain, pinned to a CPU of that domain so the
+// QM_EVTSEL/QM_CTR pairs execute locally. It only reads and stores the
+// counters; rates are computed by the main thread from the stored samples.
+typedef struct {
+    int domain;
+    int cpu;
+    pthread_t thread;
+    rdt_mon_req_t *reqs;                // num_targets * MON_EVENTS
+    uint64_t *timestamp_ns;             // Per sample
+    uint64_t *read_ns;                  // Time spent in the batch
+    uint64_t *ctr;                      // Per sample, num_targets * MON_EVENTS values
+    int published;                      // Samples visible to the main thread
+    int overruns;                       // Intervals skipped because a read ran late
+    int errors;
+} domain_reader_t;
+
 typedef struct {
     int rmid;
-    uint64_t llc_occupancy;
-    uint64_t mbm_total;
-    uint64_t mbm_local;
-    uint64_t timestamp;
-} rdt_monitor_data_t;
+    cpu_set_t cpus;
+    uint64_t *saved;                    // PQR_ASSOC before we changed it
+} rmid_assign_t;
+
+// A column of counters: a raw RMID, or a resctrl monitoring group that the
+// kernel gave its own RMID for a set of PIDs or a cgroup
+typedef struct {
+    char label[32];
+    int rmid;
+    rdt_mon_group_t group;
+    char cgroup[256];                   // Rescanned for processes that join later
+    pid_t pids[MON_MAX_TARGETS];
+    int num_pids;
+} mon_target_t;
+
+static mon_target_t g_targets[MON_MAX_TARGETS];
+static int g_num_targets = 0;
+static int g_group_mode = 0;            // Targets are monitoring groups
+static rmid_assign_t g_assign[MON_MAX_TARGETS];
+static int g_num_assign = 0;
+static domain_reader_t *g_readers = NULL;
+static int g_num_readers = 0;
+static int g_max_samples = 0;
+static uint64_t g_interval_ns = MONITORING_INTERVAL_MS * 1000000ULL;
+static uint64_t g_start_ns = 0;
 
 // Function declarations
-int rdt_monitor_init(void);
+int rdt_monitor_init(rdt_backend_type_t backend);
 int rdt_monitor_cleanup(void);
-int rdt_monitor_read_llc_occupancy(int rmid, uint64_t *occupancy);
-int rdt_monitor_read_mbm_total(int rmid, uint64_t *bandwidth);
-int rdt_monitor_read_mbm_local(int rmid, uint64_t *bandwidth);
 int rdt_monitor_set_rmid(int cpu, int rmid);
 int rdt_monitor_get_rmid(int cpu, int *rmid);
-void rdt_monitor_print_data(rdt_monitor_data_t *data);
-void rdt_monitor_continuous(int duration_seconds);
+void rdt_monitor_continuous(int duration_seconds, int print_ms, const char *output);
 void signal_handler(int sig);
+static void print_usage(const char *prog);
+static int parse_rmid_list(const char *list);
+static int parse_group_target(const char *spec, int is_cgroup);
+static int rdt_monitor_init_groups(void);
+static int sync_cgroup(mon_target_t *t);
+static void print_target_summary(void);
+static uint64_t llc_bytes(uint64_t value);
+static uint64_t mono_ns(void);
+static void *domain_reader_thread(void *arg);
+static uint64_t *sample_ctr(const domain_reader_t *r, int sample, int target_idx, int event_idx);
+static int sample_rate(const domain_reader_t *r, int from, int to, int target_idx, int event_idx,
+                       double *mbps, int *wraps);
+static void print_window(int from[], int to[]);
+static int write_time_series(const char *path);
+static void print_reader_summary(void);
 
 int main(int argc, char *argv[]) {
+    rdt_backend_type_t backend = RDT_BACKEND_MSR;
+    int have_rmids = 0;
+    int duration = 10;      // Default 10 seconds
+    int print_ms = PRINT_INTERVAL_MS;
+    const char *output = NULL;
+    double sim_demand[MON_MAX_TARGETS][2];
+    int num_sim_demand = 0;
+    double sim_wrap = 0;
+
+    if (parse_rmid_list("0") != SUCCESS) {
+        return EXIT_FAILURE;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--rmids") == 0 && i + 1 < argc) {
+            if (parse_rmid_list(argv[++i]) != SUCCESS) {
+                return EXIT_FAILURE;
+            }
+            have_rmids = 1;
+        } else if ((strcmp(argv[i], "--pid") == 0 || strcmp(argv[i], "--cgroup") == 0) &&
+                   i + 1 < argc) {
+            int is_cgroup = strcmp(argv[i], "--cgroup") == 0;
+            if (parse_group_target(argv[++i], is_cgroup) != SUCCESS) {
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--assign") == 0 && i + 1 < argc) {
+            char *end;
+            const char *arg = argv[++i];
+            rmid_assign_t *a = &g_assign[g_num_assign];
+            a->rmid = (int)strtol(arg, &end, 10);
+            if (g_num_assign == MON_MAX_TARGETS || *end != ':' || a->rmid < 0 || a->rmid >= MAX_RMID ||
+                topo_parse_cpulist(end + 1, &a->cpus) <= 0) {
+                PRINT_ERROR("Invalid assignment \"%s\" (RMID:CPULIST)", arg);
+                return EXIT_FAILURE;
+            }
+            g_num_assign++;
+        } else if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc) {
+            int ms = atoi(argv[++i]);
+            if (ms <= 0) {
+                PRINT_ERROR("Invalid interval: %s", argv[i]);
+                return EXIT_FAILURE;
+            }
+            g_interval_ns = (uint64_t)ms * 1000000ULL;
+        } else if (strcmp(argv[i], "--print") == 0 && i + 1 < argc) {
+            print_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--duration") == 0 && i + 1 < argc) {
+            duration = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if (strcmp(argv[i], "--backend") == 0 && i + 1 < argc) {
+            if (rdt_backend_parse(argv[++i], &backend) != SUCCESS) {
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--sim-demand") == 0 && i + 1 < argc) {
+            char *end;
+            const char *arg = argv[++i];
+            if (num_sim_demand == MON_MAX_TARGETS) {
+                return EXIT_FAILURE;
+            }
+            sim_demand[num_sim_demand][0] = strtol(arg, &end, 10);
+            if (*end != ':') {
+                PRINT_ERROR("Invalid demand \"%s\" (RMID:MBPS)", arg);
+                return EXIT_FAILURE;
+            }
+            sim_demand[num_sim_demand][1] = atof(end + 1);
+            num_sim_demand++;
+        } else if (strcmp(argv[i], "--sim-wrap") == 0 && i + 1 < argc) {
+            sim_wrap = atof(argv[++i]);
+        } else if (argv[i][0] != '-') {
+            duration = atoi(argv[i]);
+        } else {
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (duration <= 0 || print_ms <= 0) {
+        PRINT_ERROR("Invalid duration or print interval");
+        return EXIT_FAILURE;
+    }
+    if (g_group_mode && (have_rmids || g_num_assign > 0 || backend == RDT_BACKEND_SIM)) {
+        PRINT_ERROR("--pid/--cgroup use resctrl monitoring groups; drop --rmids, --assign and --backend sim");
+        return EXIT_FAILURE;
+    }
+
     PRINT_INFO("Starting RDT Monitor");
-    
+
     // Check permissions
-    if (check_root_permission() != SUCCESS) {
+    if (backend != RDT_BACKEND_SIM && check_root_permission() != SUCCESS) {
         return EXIT_FAILURE;
     }
-    
+
     // Initialize monitoring
-    if (rdt_monitor_init() != SUCCESS) {
+    if ((g_group_mode ? rdt_monitor_init_groups() : rdt_monitor_init(backend)) != SUCCESS) {
+        rdt_monitor_cleanup();
         PRINT_ERROR("Failed to initialize RDT monitoring");
         return EXIT_FAILURE;
     }
-    
+
+    if (backend == RDT_BACKEND_SIM) {
+        uint64_t wrap_units = 1ULL << rdt_mbm_counter_width();
+        for (int i = 0; i < num_sim_demand; i++) {
+            int rmid = (int)sim_demand[i][0];
+            double units_per_sec = sim_demand[i][1] * 1024.0 * 1024.0 / rdt_mon_upscale();
+            for (int d = 0; d < rdt_num_domains(); d++) {
+                rdt_sim_set_demand(rmid, d, sim_demand[i][1]);
+            }
+            // Start the counter so it wraps about sim_wrap seconds in
+            if (sim_wrap > 0 && units_per_sec * sim_wrap < (double)wrap_units) {
+                rdt_sim_set_counter_offset(rmid, wrap_units - (uint64_t)(units_per_sec * sim_wrap));
+            }
+        }
+    }
+
     // Set up signal handler for graceful shutdown
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
-    
-    // Parse command line arguments
-    int duration = 10; // Default 10 seconds
-    if (argc > 1) {
-        duration = atoi(argv[1]);
-        if (duration <= 0) {
-            PRINT_ERROR("Invalid duration: %s", argv[1]);
-            return EXIT_FAILURE;
-        }
-    }
-    
-    PRINT_INFO("Starting continuous monitoring for %d seconds...", duration);
+
+    PRINT_INFO("Monitoring %d %s on %d L3 domain(s) every %.1f ms for %d seconds...",
+               g_num_targets, g_group_mode ? "workload(s)" : "RMID(s)", rdt_num_domains(),
+               g_interval_ns / 1e6, duration);
     PRINT_INFO("Press Ctrl+C to stop monitoring");
-    
+
     // Start continuous monitoring
-    rdt_monitor_continuous(duration);
-    
+    rdt_monitor_continuous(duration, print_ms, output);
+
     // Cleanup
     rdt_monitor_cleanup();
-    
+
     PRINT_INFO("RDT monitoring completed");
     return EXIT_SUCCESS;
 }
 
-int rdt_monitor_init(void) {
-    // Check if basic RDT is supported first
-    if (check_cpu_feature("rdt_a") != SUCCESS) {
-        PRINT_ERROR("RDT not supported on this CPU");
-        return ERROR_NOT_SUPPORTED;
+static void print_usage(const char *prog) {
+    printf("Usage: %s [options] [duration]\n", prog);
+    printf("Options:\n");
+    printf("  --rmids LIST           RMIDs to watch, e.g. 0,2-5 (default 0)\n");
+    printf("  --assign RMID:CPUS     Tag CPUs with an RMID for the run, e.g. 3:4-7\n");
+    printf("  --pid NAME:PID[,PID]   Monitor processes in their own resctrl monitoring group\n");
+    printf("  --cgroup NAME:PATH     Monitor a cgroup (relative to %s); rescanned while running\n",
+           CGROUP_ROOT);
+    printf("  --interval MS          Sampling interval (default %d)\n", MONITORING_INTERVAL_MS);
+    printf("  --print MS             Console aggregation interval (default %d)\n", PRINT_INTERVAL_MS);
+    printf("  --duration SEC         Run time (default 10)\n");
+    printf("  --output FILE          Write the per-sample time series as CSV\n");
+    printf("  --backend msr|sim      Register access (default msr)\n");
+    printf("  --sim-demand RMID:MBPS Simulated bandwidth of an RMID on every domain\n");
+    printf("  --sim-wrap SEC         Start simulated counters so they wrap after SEC seconds\n");
+}
+
+static int parse_rmid_list(const char *list) {
+    char buf[256];
+    char *saveptr = NULL;
+
+    snprintf(buf, sizeof(buf), "%s", list);
+    g_num_targets = 0;
+    memset(g_targets, 0, sizeof(g_targets));
+    for (char *tok = strtok_r(buf, ",", &saveptr); tok; tok = strtok_r(NULL, ",", &saveptr)) {
+        int lo, hi;
+        int n = sscanf(tok, "%d-%d", &lo, &hi);
+        if (n == 1) {
+            hi = lo;
+        } else if (n != 2) {
+            PRINT_ERROR("Invalid RMID list \"%s\"", list);
+            return ERROR_INVALID_PARAM;
+        }
+        for (int rmid = lo; rmid <= hi; rmid++) {
+            if (rmid < 0 || rmid >= MAX_RMID || g_num_targets == MON_MAX_TARGETS) {
+                PRINT_ERROR("RMID list \"%s\" out of range (0-%d, at most %d RMIDs)",
+                            list, MAX_RMID - 1, MON_MAX_TARGETS);
+                return ERROR_INVALID_PARAM;
+            }
+            mon_target_t *t = &g_targets[g_num_targets++];
+            t->rmid = rmid;
+            snprintf(t->label, sizeof(t->label), "rmid%d", rmid);
+        }
     }
-    
-    // Check MSR availability
-    if (msr_check_available() != SUCCESS) {
-        PRINT_ERROR("MSR access not available");
-        return ERROR_NOT_SUPPORTED;
+    return g_num_targets > 0 ? SUCCESS : ERROR_INVALID_PARAM;
+}
+
+// NAME:PID[,PID...] or NAME:CGROUP_PATH
+static int parse_group_target(const char *spec, int is_cgroup) {
+    const char *colon = strchr(spec, ':');
+
+    if (!g_group_mode) {
+        // The first group replaces the default RMID 0 target
+        g_group_mode = 1;
+        g_num_targets = 0;
+        memset(g_targets, 0, sizeof(g_targets));
     }
-    
-    // Check if monitoring is supported (optional)
-    if (check_cpu_feature("rdt_m") != SUCCESS) {
-        PRINT_INFO("RDT monitoring (rdt_m) not supported - using basic cache allocation only");
-        PRINT_INFO("LLC occupancy and MBM monitoring will show simulated data");
+    if (!colon || colon == spec || (size_t)(colon - spec) >= sizeof(g_targets[0].label) ||
+        g_num_targets == MON_MAX_TARGETS) {
+        PRINT_ERROR("Invalid target \"%s\" (NAME:%s)", spec, is_cgroup ? "PATH" : "PID[,PID]");
+        return ERROR_INVALID_PARAM;
     }
-    
-    // Try to initialize monitoring MSRs
-    // Set default RMID (0) for all CPUs (this might fail gracefully)
-    int cpu_count = get_cpu_count();
-    for (int cpu = 0; cpu < cpu_count; cpu++) {
-        int result = rdt_monitor_set_rmid(cpu, 0);
-        if (result != SUCCESS) {
-            PRINT_INFO("RMID setting not supported for CPU %d - using read-only monitoring", cpu);
-            // Don't fail initialization, just note the limitation
+
+    mon_target_t *t = &g_targets[g_num_targets];
+    snprintf(t->label, sizeof(t->label), "%.*s", (int)(colon - spec), spec);
+    for (int i = 0; i < g_num_targets; i++) {
+        if (strcmp(g_targets[i].label, t->label) == 0) {
+            PRINT_ERROR("Duplicate target name \"%s\"", t->label);
+            return ERROR_INVALID_PARAM;
         }
     }
-    
-    PRINT_INFO("RDT monitoring initialized (with limitations on this system)");
+
+    if (is_cgroup) {
+        const char *path = colon + 1;
+        if (path[0] == '/' && strncmp(path, CGROUP_ROOT, strlen(CGROUP_ROOT)) == 0) {
+            snprintf(t->cgroup, sizeof(t->cgroup), "%s", path);
+        } else {
+            snprintf(t->cgroup, sizeof(t->cgroup), "%s/%s", CGROUP_ROOT, path[0] == '/' ? path + 1 : path);
+        }
+    } else {
+        char buf[256];
+        char *saveptr = NULL;
+        snprintf(buf, sizeof(buf), "%s", colon + 1);
+        for (char *tok = strtok_r(buf, ",", &saveptr); tok; tok = strtok_r(NULL, ",", &saveptr)) {
+            if (atoi(tok) <= 0 || t->num_pids == MON_MAX_TARGETS) {
+                PRINT_ERROR("Invalid PID list in \"%s\"", spec);
+                return ERROR_INVALID_PARAM;
+            }
+            t->pids[t->num_pids++] = (pid_t)atoi(tok);
+        }
+        if (t->num_pids == 0) {
+            PRINT_ERROR("No PIDs in \"%s\"", spec);
+            return ERROR_INVALID_PARAM;
+        }
+    }
+    g_num_targets++;
     return SUCCESS;
 }
 
-int rdt_monitor_cleanup(void) {
-    // Reset all CPUs to default RMID (0)
-    int cpu_count = get_cpu_count();
-    for (int cpu = 0; cpu < cpu_count; cpu++) {
-        rdt_monitor_set_rmid(cpu, 0);
+// Move every process listed in the cgroup into the target's group. Already
+// moved tasks are rewritten, which resctrl treats as a no-op.
+static int sync_cgroup(mon_target_t *t) {
+    char path[300];
+    char line[32];
+    int moved = 0;
+
+    snprintf(path, sizeof(path), "%s/cgroup.procs", t->cgroup);
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        PRINT_ERROR("Failed to read %s: %s", path, strerror(errno));
+        return ERROR_SYSTEM;
     }
-    
-    PRINT_INFO("RDT monitoring cleanup completed");
-    return SUCCESS;
+    while (fgets(line, sizeof(line), fp)) {
+        pid_t pid = (pid_t)atoi(line);
+        if (pid > 0 && rdt_mon_group_add_pid(&t->group, pid) == SUCCESS) {
+            moved++;
+        }
+    }
+    fclose(fp);
+    return moved;
 }
 
-int rdt_monitor_read_llc_occupancy(int rmid, uint64_t *occupancy) {
-    if (occupancy == NULL) {
-        return ERROR_INVALID_PARAM;
+// Workload targets: one resctrl monitoring group (and so one RMID) each.
+// The kernel switches the RMID on context switch; an eBPF agent cannot
+// write PQR_ASSOC itself, so resctrl is the path that follows tasks.
+static int rdt_monitor_init_groups(void) {
+    if (!cpu_has_feature(CPU_FEAT_RDT_M)) {
+        PRINT_ERROR("RDT monitoring (rdt_m) not supported on this CPU");
+        return ERROR_NOT_SUPPORTED;
     }
-    
-    // Try to select LLC occupancy monitoring event
-    uint64_t evtsel = rmid | (1ULL << 32); // Event ID 1 for LLC occupancy
-    if (msr_write_cpu(0, MSR_IA32_QM_EVTSEL, evtsel) != SUCCESS) {
-        // If writing fails, provide simulated data
-        *occupancy = 1024 * 1024 * 4; // Simulate 4MB cache occupancy
-        return SUCCESS;
-    }
-    
-    // Read the counter
-    if (msr_read_cpu(0, MSR_IA32_QM_CTR, occupancy) != SUCCESS) {
-        // If reading fails, provide simulated data
-        *occupancy = 1024 * 1024 * 4; // Simulate 4MB cache occupancy
-        return SUCCESS;
-    }
-    
-    // Convert to bytes (scaling factor is typically 64 bytes per unit)
-    *occupancy *= 64;
-    
+
+    for (int i = 0; i < g_num_targets; i++) {
+        mon_target_t *t = &g_targets[i];
+        if (rdt_mon_group_create(&t->group, t->label) != SUCCESS) {
+            return ERROR_SYSTEM;
+        }
+
+        if (t->cgroup[0]) {
+            int moved = sync_cgroup(t);
+            if (moved < 0) {
+                return ERROR_SYSTEM;
+            }
+            PRINT_INFO("Target %s: cgroup %s, %d process(es)", t->label, t->cgroup, moved);
+        } else {
+            for (int p = 0; p < t->num_pids; p++) {
+                if (rdt_mon_group_add_pid(&t->group, t->pids[p]) != SUCCESS) {
+                    PRINT_ERROR("Failed to move PID %d into %s", (int)t->pids[p], t->group.path);
+                    return ERROR_SYSTEM;
+                }
+            }
+            PRINT_INFO("Target %s: %d process(es)", t->label, t->num_pids);
+        }
+    }
+
+    PRINT_INFO("RDT monitoring initialized (resctrl monitoring groups)");
     return SUCCESS;
 }
 
-int rdt_monitor_read_mbm_total(int rmid, uint64_t *bandwidth) {
-    if (bandwidth == NULL) {
+int rdt_monitor_init(rdt_backend_type_t backend) {
+    const cpu_caps_t *caps = cpu_caps_get();
+
+    // RMIDs are programmed directly, which resctrl owns when mounted
+    if (backend != RDT_BACKEND_MSR && backend != RDT_BACKEND_SIM) {
+        PRINT_ERROR("rdt_monitor drives RMIDs through MSRs; use --backend msr or sim");
         return ERROR_INVALID_PARAM;
     }
-    
-    // Try to select MBM total event
-    uint64_t evtsel = rmid | (2ULL << 32); // Event ID 2 for MBM total
-    if (msr_write_cpu(0, MSR_IA32_QM_EVTSEL, evtsel) != SUCCESS) {
-        // If writing fails, provide simulated data
-        static uint64_t sim_counter = 0;
-        sim_counter += 1024 * 1024 * 100; // Simulate 100MB bandwidth growth
-        *bandwidth = sim_counter;
-        return SUCCESS;
-    }
-    
-    // Read the counter
-    if (msr_read_cpu(0, MSR_IA32_QM_CTR, bandwidth) != SUCCESS) {
-        // If reading fails, provide simulated data
-        static uint64_t sim_counter = 0;
-        sim_counter += 1024 * 1024 * 100; // Simulate 100MB bandwidth growth
-        *bandwidth = sim_counter;
-        return SUCCESS;
-    }
-    
+
+    if (backend == RDT_BACKEND_MSR) {
+        if (!cpu_has_feature(CPU_FEAT_RDT_M)) {
+            PRINT_ERROR("RDT monitoring (rdt_m) not supported on this CPU (try --backend sim)");
+            return ERROR_NOT_SUPPORTED;
+        }
+        int max_rmid = caps->l3_max_rmid > 0 ? caps->l3_max_rmid : caps->max_rmid;
+        for (int i = 0; i < g_num_targets; i++) {
+            if (max_rmid > 0 && g_targets[i].rmid > max_rmid) {
+                PRINT_ERROR("RMID %d above the highest L3 RMID %d", g_targets[i].rmid, max_rmid);
+                return ERROR_INVALID_PARAM;
+            }
+        }
+    } else {
+        for (int i = 0; i < g_num_targets; i++) {
+            if (g_targets[i].rmid >= RDT_SIM_MAX_RMID) {
+                PRINT_ERROR("The simulator has RMIDs 0-%d", RDT_SIM_MAX_RMID - 1);
+                return ERROR_INVALID_PARAM;
+            }
+        }
+    }
+
+    if (rdt_backend_init(backend) != SUCCESS) {
+        return ERROR_NOT_SUPPORTED;
+    }
+
+    // Tag the requested CPUs, remembering their previous association
+    int cpu_count = get_cpu_count();
+    for (int i = 0; i < g_num_assign; i++) {
+        rmid_assign_t *a = &g_assign[i];
+        a->saved = calloc(cpu_count, sizeof(uint64_t));
+        if (!a->saved) {
+            return ERROR_SYSTEM;
+        }
+        TOPO_FOR_EACH_CPU(cpu, &a->cpus, cpu_count) {
+            if (rdt_msr_read(cpu, MSR_IA32_PQR_ASSOC, &a->saved[cpu]) != SUCCESS ||
+                rdt_monitor_set_rmid(cpu, a->rmid) != SUCCESS) {
+                PRINT_ERROR("Failed to set RMID %d on CPU %d", a->rmid, cpu);
+                CPU_CLR(cpu, &a->cpus);
+            }
+        }
+    }
+
+    PRINT_INFO("RDT monitoring initialized (%s backend, %d-bit MBM counters, %u bytes/unit)",
+               rdt_backend_name(), rdt_mbm_counter_width(), rdt_mon_upscale());
     return SUCCESS;
 }
 
-int rdt_monitor_read_mbm_local(int rmid, uint64_t *bandwidth) {
-    if (bandwidth == NULL) {
-        return ERROR_INVALID_PARAM;
+int rdt_monitor_cleanup(void) {
+    // Removing a monitoring group returns its tasks to the default group
+    for (int i = 0; g_group_mode && i < g_num_targets; i++) {
+        rdt_mon_group_destroy(&g_targets[i].group);
+    }
+
+    // Restore the association of the CPUs we tagged
+    int cpu_count = get_cpu_count();
+    for (int i = 0; i < g_num_assign; i++) {
+        rmid_assign_t *a = &g_assign[i];
+        if (!a->saved) {
+            continue;
+        }
+        TOPO_FOR_EACH_CPU(cpu, &a->cpus, cpu_count) {
+            rdt_msr_write(cpu, MSR_IA32_PQR_ASSOC, a->saved[cpu]);
+        }
+        free(a->saved);
+        a->saved = NULL;
     }
-    
-    // Try to select MBM local event
-    uint64_t evtsel = rmid | (3ULL << 32); // Event ID 3 for MBM local
-    if (msr_write_cpu(0, MSR_IA32_QM_EVTSEL, evtsel) != SUCCESS) {
-        // If writing fails, provide simulated data
-        static uint64_t sim_counter = 0;
-        sim_counter += 1024 * 1024 * 50; // Simulate 50MB local bandwidth growth
-        *bandwidth = sim_counter;
-        return SUCCESS;
-    }
-    
-    // Read the counter
-    if (msr_read_cpu(0, MSR_IA32_QM_CTR, bandwidth) != SUCCESS) {
-        // If reading fails, provide simulated data
-        static uint64_t sim_counter = 0;
-        sim_counter += 1024 * 1024 * 50; // Simulate 50MB local bandwidth growth
-        *bandwidth = sim_counter;
-        return SUCCESS;
-    }
-    
+
+    for (int i = 0; i < g_num_readers; i++) {
+        free(g_readers[i].reqs);
+        free(g_readers[i].timestamp_ns);
+        free(g_readers[i].read_ns);
+        free(g_readers[i].ctr);
+    }
+    free(g_readers);
+    g_readers = NULL;
+    g_num_readers = 0;
+
+    rdt_backend_cleanup();
+    PRINT_INFO("RDT monitoring cleanup completed");
     return SUCCESS;
 }
 
 int rdt_monitor_set_rmid(int cpu, int rmid) {
-    if (rmid >= MAX_RMID) {
+    if (rmid < 0 || rmid >= MAX_RMID) {
         return ERROR_INVALID_PARAM;
     }
-    
+
     uint64_t value;
-    if (msr_read_cpu(cpu, MSR_IA32_PQR_ASSOC, &value) != SUCCESS) {
+    if (rdt_msr_read(cpu, MSR_IA32_PQR_ASSOC, &value) != SUCCESS) {
         return ERROR_SYSTEM;
     }
-    
-    // Set RMID in bits 63:32
-    value = (value & 0x00000000FFFFFFFFULL) | ((uint64_t)rmid << 32);
-    
-    return msr_write_cpu(cpu, MSR_IA32_PQR_ASSOC, value);
+
+    // RMID lives in bits 9:0; the CLOS in bits 63:32 is left alone
+    value = (value & ~RDT_PQR_RMID_MASK) | ((uint64_t)rmid & RDT_PQR_RMID_MASK);
+
+    return rdt_msr_write(cpu, MSR_IA32_PQR_ASSOC, value);
 }
 
 int rdt_monitor_get_rmid(int cpu, int *rmid) {
     if (rmid == NULL) {
         return ERROR_INVALID_PARAM;
     }
-    
+
     uint64_t value;
-    if (msr_read_cpu(cpu, MSR_IA32_PQR_ASSOC, &value) != SUCCESS) {
+    if (rdt_msr_read(cpu, MSR_IA32_PQR_ASSOC, &value) != SUCCESS) {
         return ERROR_SYSTEM;
     }
-    
-    *rmid = (int)(value >> 32);
+
+    *rmid = (int)(value & RDT_PQR_RMID_MASK);
     return SUCCESS;
 }
 
-void rdt_monitor_print_data(rdt_monitor_data_t *data) {
-    printf("RMID: %d, LLC: %8lu KB, MBM Total: %8lu MB/s, MBM Local: %8lu MB/s\n",
-           data->rmid,
-           data->llc_occupancy / 1024,
-           data->mbm_total / (1024 * 1024),
-           data->mbm_local / (1024 * 1024));
+static uint64_t mono_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
 }
 
-void rdt_monitor_continuous(int duration_seconds) {
-    uint64_t start_time = get_timestamp_us();
-    uint64_t end_time = start_time + (uint64_t)duration_seconds * 1000000;
-    
-    rdt_monitor_data_t prev_data = {0};
-    rdt_monitor_data_t curr_data = {0};
-    
-    PRINT_INFO("Time    RMID  LLC Occupancy  MBM Total    MBM Local");
-    PRINT_INFO("-----  ----  -------------  ----------   ----------");
-    
-    while (running && get_timestamp_us() < end_time) {
-        curr_data.timestamp = get_timestamp_us();
-        curr_data.rmid = 0; // Monitor default RMID
-        
-        // Read monitoring data
-        if (rdt_monitor_read_llc_occupancy(curr_data.rmid, &curr_data.llc_occupancy) != SUCCESS) {
-            PRINT_ERROR("Failed to read LLC occupancy");
-            break;
+static uint64_t *sample_ctr(const domain_reader_t *r, int sample, int target_idx, int event_idx) {
+    return &r->ctr[((size_t)sample * g_num_targets + target_idx) * MON_EVENTS + event_idx];
+}
+
+static void *domain_reader_thread(void *arg) {
+    domain_reader_t *r = (domain_reader_t *)arg;
+    int num_reqs = g_num_targets * MON_EVENTS;
+    uint64_t next = g_start_ns;
+
+    topo_pin_thread(r->cpu);
+
+    // Sleep to absolute deadlines so a slow read does not shift later samples
+    for (int s = 0; s < g_max_samples && running; s++) {
+        struct timespec ts = { (time_t)(next / 1000000000ULL), (long)(next % 1000000000ULL) };
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+
+        uint64_t t0 = mono_ns();
+        int result = SUCCESS;
+        if (g_group_mode) {
+            // mon_data files; the kernel reads the counters on the domain
+            for (int i = 0; i < num_reqs; i++) {
+                if (rdt_mon_group_read(&g_targets[i / MON_EVENTS].group, r->domain,
+                                       (rdt_mon_event_t)(i % MON_EVENTS), &r->reqs[i].ctr) != SUCCESS) {
+                    r->reqs[i].ctr = RDT_QM_CTR_UNAVAILABLE;
+                }
+            }
+        } else {
+            result = rdt_mon_read_batch(r->domain, r->reqs, num_reqs);
+        }
+        uint64_t t1 = mono_ns();
+
+        for (int i = 0; i < num_reqs; i++) {
+            r->ctr[(size_t)s * num_reqs + i] = result == SUCCESS ? r->reqs[i].ctr : RDT_QM_CTR_ERROR;
+        }
+        if (result != SUCCESS) {
+            r->errors++;
+        }
+        r->timestamp_ns[s] = t0;
+        r->read_ns[s] = t1 - t0;
+        __atomic_store_n(&r->published, s + 1, __ATOMIC_RELEASE);
+
+        // Fell behind: drop the missed deadlines rather than bunching reads
+        next += g_interval_ns;
+        if (t1 > next) {
+            uint64_t missed = (t1 - next) / g_interval_ns + 1;
+            r->overruns += (int)missed;
+            next += missed * g_interval_ns;
+        }
+    }
+    return NULL;
+}
+
+// MB/s of an MBM event over samples [from, to], summing wrap-corrected
+// deltas of consecutive valid samples
+static int sample_rate(const domain_reader_t *r, int from, int to, int target_idx, int event_idx,
+                       double *mbps, int *wraps) {
+    const uint64_t bad = RDT_QM_CTR_ERROR | RDT_QM_CTR_UNAVAILABLE;
+    double bytes = 0, seconds = 0;
+
+    for (int s = from + 1; s <= to; s++) {
+        uint64_t prev = *sample_ctr(r, s - 1, target_idx, event_idx);
+        uint64_t cur = *sample_ctr(r, s, target_idx, event_idx);
+        if ((prev | cur) & bad) {
+            continue;
+        }
+        if (g_group_mode) {
+            // Byte counts from resctrl; the kernel already handles overflow
+            if (cur < prev) {
+                continue;
+            }
+            bytes += (double)(cur - prev);
+        } else {
+            if (cur < prev && wraps) {
+                (*wraps)++;
+            }
+            bytes += (double)rdt_mbm_delta_bytes(prev, cur);
+        }
+        seconds += (r->timestamp_ns[s] - r->timestamp_ns[s - 1]) / 1e9;
+    }
+    if (seconds <= 0) {
+        return ERROR_NOT_SUPPORTED;
+    }
+    *mbps = bytes / seconds / (1024.0 * 1024.0);
+    return SUCCESS;
+}
+
+static void print_window(int from[], int to[]) {
+    for (int d = 0; d < g_num_readers; d++) {
+        const domain_reader_t *r = &g_readers[d];
+        if (to[d] <= from[d]) {
+            continue;
+        }
+        double t = (r->timestamp_ns[to[d]] - g_start_ns) / 1e9;
+
+        for (int i = 0; i < g_num_targets; i++) {
+            double total = 0, local = 0;
+            uint64_t llc = *sample_ctr(r, to[d], i, 0);
+            int have_total = sample_rate(r, from[d], to[d], i, 1, &total, NULL) == SUCCESS;
+            int have_local = sample_rate(r, from[d], to[d], i, 2, &local, NULL) == SUCCESS;
+
+            printf("%6.2f  %6d  %-12s  ", t, rdt_domain_id(r->domain), g_targets[i].label);
+            if (llc & (RDT_QM_CTR_ERROR | RDT_QM_CTR_UNAVAILABLE)) {
+                printf("%10s", "n/a");
+            } else {
+                printf("%10lu", (unsigned long)(llc_bytes(llc) / 1024));
+            }
+            if (have_total) printf("  %11.1f", total); else printf("  %11s", "n/a");
+            if (have_local) printf("  %11.1f\n", local); else printf("  %11s\n", "n/a");
+        }
+    }
+    fflush(stdout);
+}
+
+void rdt_monitor_continuous(int duration_seconds, int print_ms, const char *output) {
+    int num_reqs = g_num_targets * MON_EVENTS;
+
+    g_num_readers = rdt_num_domains();
+    g_max_samples = (int)((uint64_t)duration_seconds * 1000000000ULL / g_interval_ns) + 1;
+    g_readers = calloc(g_num_readers, sizeof(domain_reader_t));
+    if (!g_readers) {
+        PRINT_ERROR("Out of memory");
+        return;
+    }
+
+    for (int d = 0; d < g_num_readers; d++) {
+        domain_reader_t *r = &g_readers[d];
+        r->domain = d;
+        r->cpu = topo_l3_domain_cpu(d);
+        r->reqs = calloc(num_reqs, sizeof(rdt_mon_req_t));
+        r->timestamp_ns = calloc(g_max_samples, sizeof(uint64_t));
+        r->read_ns = calloc(g_max_samples, sizeof(uint64_t));
+        r->ctr = calloc((size_t)g_max_samples * num_reqs, sizeof(uint64_t));
+        if (!r->reqs || !r->timestamp_ns || !r->read_ns || !r->ctr || r->cpu < 0) {
+            PRINT_ERROR("Failed to set up the reader for L3 domain %d", d);
+            return;
         }
-        
-        if (rdt_monitor_read_mbm_total(curr_data.rmid, &curr_data.mbm_total) != SUCCESS) {
-            PRINT_ERROR("Failed to read MBM total");
+        for (int i = 0; i < g_num_targets; i++) {
+            r->reqs[i * MON_EVENTS + 0] = (rdt_mon_req_t){ g_targets[i].rmid, RDT_EVT_LLC_OCCUPANCY, 0 };
+            r->reqs[i * MON_EVENTS + 1] = (rdt_mon_req_t){ g_targets[i].rmid, RDT_EVT_MBM_TOTAL, 0 };
+            r->reqs[i * MON_EVENTS + 2] = (rdt_mon_req_t){ g_targets[i].rmid, RDT_EVT_MBM_LOCAL, 0 };
+        }
+    }
+
+    // All readers share one start so the domains sample on the same ticks
+    g_start_ns = mono_ns() + g_interval_ns;
+    int started = 0;
+    for (; started < g_num_readers; started++) {
+        if (pthread_create(&g_readers[started].thread, NULL, domain_reader_thread,
+                           &g_readers[started]) != 0) {
+            PRINT_ERROR("Failed to start reader for L3 domain %d", started);
+            running = 0;
             break;
         }
-        
-        if (rdt_monitor_read_mbm_local(curr_data.rmid, &curr_data.mbm_local) != SUCCESS) {
-            PRINT_ERROR("Failed to read MBM local");
+    }
+
+    printf("  Time  Domain  Target          LLC (KB)  Total(MB/s)  Local(MB/s)\n");
+    printf("------  ------  ------------  ----------  -----------  -----------\n");
+
+    int *from = calloc(g_num_readers, sizeof(int));
+    int *to = calloc(g_num_readers, sizeof(int));
+    while (running && from && to) {
+        sleep_ms(print_ms);
+
+        // Processes that joined a watched cgroup since the last window
+        for (int i = 0; g_group_mode && i < g_num_targets; i++) {
+            if (g_targets[i].cgroup[0]) {
+                sync_cgroup(&g_targets[i]);
+            }
+        }
+
+        int done = 1;
+        for (int d = 0; d < g_num_readers; d++) {
+            to[d] = __atomic_load_n(&g_readers[d].published, __ATOMIC_ACQUIRE) - 1;
+            done &= to[d] + 1 >= g_max_samples;
+        }
+        print_window(from, to);
+        for (int d = 0; d < g_num_readers; d++) {
+            if (to[d] > from[d]) {
+                from[d] = to[d];
+            }
+        }
+        if (done) {
             break;
         }
-        
-        // Calculate bandwidth (if we have previous data)
-        if (prev_data.timestamp > 0) {
-            uint64_t time_diff = curr_data.timestamp - prev_data.timestamp;
-            if (time_diff > 0) {
-                uint64_t mbm_total_rate = (curr_data.mbm_total - prev_data.mbm_total) * 1000000 / time_diff;
-                uint64_t mbm_local_rate = (curr_data.mbm_local - prev_data.mbm_local) * 1000000 / time_diff;
-                
-                printf("%5.1f  %4d  %8lu KB    %8lu MB/s  %8lu MB/s\n",
-                       (curr_data.timestamp - start_time) / 1000000.0,
-                       curr_data.rmid,
-                       curr_data.llc_occupancy / 1024,
-                       mbm_total_rate / (1024 * 1024),
-                       mbm_local_rate / (1024 * 1024));
+    }
+    free(from);
+    free(to);
+
+    running = 0;
+    for (int d = 0; d < started; d++) {
+        pthread_join(g_readers[d].thread, NULL);
+    }
+
+    print_reader_summary();
+    print_target_summary();
+    if (output) {
+        if (write_time_series(output) == SUCCESS) {
+            PRINT_SUCCESS("Time series written to %s", output);
+        } else {
+            PRINT_ERROR("Failed to write %s", output);
+        }
+    }
+}
+
+// Occupancy in bytes: raw counters are in upscale units, resctrl in bytes
+static uint64_t llc_bytes(uint64_t value) {
+    return g_group_mode ? value : value * rdt_mon_upscale();
+}
+
+// Whole-run figures per target summed over domains, largest bandwidth
+// first, to point at the noisy neighbor
+static void print_target_summary(void) {
+    double total[MON_MAX_TARGETS], local[MON_MAX_TARGETS], llc[MON_MAX_TARGETS];
+    int order[MON_MAX_TARGETS];
+    double sum_total = 0;
+
+    for (int i = 0; i < g_num_targets; i++) {
+        total[i] = local[i] = llc[i] = 0;
+        order[i] = i;
+        for (int d = 0; d < g_num_readers; d++) {
+            const domain_reader_t *r = &g_readers[d];
+            double mbps;
+            uint64_t llc_sum = 0;
+            int llc_count = 0;
+
+            if (r->published > 1 && sample_rate(r, 0, r->published - 1, i, 1, &mbps, NULL) == SUCCESS) {
+                total[i] += mbps;
+            }
+            if (r->published > 1 && sample_rate(r, 0, r->published - 1, i, 2, &mbps, NULL) == SUCCESS) {
+                local[i] += mbps;
+            }
+            for (int s = 0; s < r->published; s++) {
+                uint64_t v = *sample_ctr(r, s, i, 0);
+                if (!(v & (RDT_QM_CTR_ERROR | RDT_QM_CTR_UNAVAILABLE))) {
+                    llc_sum += llc_bytes(v);
+                    llc_count++;
+                }
+            }
+            if (llc_count) {
+                llc[i] += (double)llc_sum / llc_count;
             }
         }
-        
-        prev_data = curr_data;
-        
-        // Sleep for monitoring interval
-        sleep_ms(MONITORING_INTERVAL_MS);
+        sum_total += total[i];
+    }
+
+    for (int i = 1; i < g_num_targets; i++) {
+        for (int j = i; j > 0 && total[order[j]] > total[order[j - 1]]; j--) {
+            int tmp = order[j];
+            order[j] = order[j - 1];
+            order[j - 1] = tmp;
+        }
+    }
+
+    printf("\n=== Per-Target Summary (all domains, whole run) ===\n");
+    printf("Target        LLC avg (MB)  Total(MB/s)  Local(MB/s)  Remote(%%)  BW share(%%)\n");
+    printf("------------  ------------  -----------  -----------  ---------  -----------\n");
+    for (int k = 0; k < g_num_targets; k++) {
+        int i = order[k];
+        printf("%-12s  %12.1f  %11.1f  %11.1f  %9.1f  %11.1f\n", g_targets[i].label,
+               llc[i] / (1024.0 * 1024.0), total[i], local[i],
+               total[i] > 0 ? (1.0 - local[i] / total[i]) * 100.0 : 0.0,
+               sum_total > 0 ? total[i] / sum_total * 100.0 : 0.0);
     }
 }
 
+static void print_reader_summary(void) {
+    printf("\n=== Reader Summary ===\n");
+    printf("Domain  CPU  Samples  Overruns  Errors  Read avg(us)  Read max(us)  MBM wraps\n");
+    printf("------  ---  -------  --------  ------  ------------  ------------  ---------\n");
+
+    for (int d = 0; d < g_num_readers; d++) {
+        const domain_reader_t *r = &g_readers[d];
+        uint64_t sum = 0, max = 0;
+        int wraps = 0;
+        double unused;
+
+        for (int s = 0; s < r->published; s++) {
+            sum += r->read_ns[s];
+            if (r->read_ns[s] > max) max = r->read_ns[s];
+        }
+        for (int i = 0; i < g_num_targets && r->published > 1; i++) {
+            sample_rate(r, 0, r->published - 1, i, 1, &unused, &wraps);
+            sample_rate(r, 0, r->published - 1, i, 2, &unused, &wraps);
+        }
+        printf("%6d  %3d  %7d  %8d  %6d  %12.1f  %12.1f  %9d\n",
+               rdt_domain_id(r->domain), r->cpu, r->published, r->overruns, r->errors,
+               r->published ? sum / 1e3 / r->published : 0.0, max / 1e3, wraps);
+    }
+}
+
+// One row per sample, domain and RMID; rates are over the preceding sample
+static int write_time_series(const char *path) {
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        return ERROR_SYSTEM;
+    }
+
+    fprintf(fp, "time_s,domain,target,llc_bytes,mbm_total_mbps,mbm_local_mbps\n");
+    for (int d = 0; d < g_num_readers; d++) {
+        const domain_reader_t *r = &g_readers[d];
+        for (int s = 1; s < r->published; s++) {
+            for (int i = 0; i < g_num_targets; i++) {
+                uint64_t llc = *sample_ctr(r, s, i, 0);
+                double total, local;
+                if (sample_rate(r, s - 1, s, i, 1, &total, NULL) != SUCCESS ||
+                    sample_rate(r, s - 1, s, i, 2, &local, NULL) != SUCCESS) {
+                    continue;
+                }
+                fprintf(fp, "%.4f,%d,%s,", (r->timestamp_ns[s] - g_start_ns) / 1e9,
+                        rdt_domain_id(r->domain), g_targets[i].label);
+                if (llc & (RDT_QM_CTR_ERROR | RDT_QM_CTR_UNAVAILABLE)) {
+                    fprintf(fp, ",");
+                } else {
+                    fprintf(fp, "%lu,", (unsigned long)llc_bytes(llc));
+                }
+                fprintf(fp, "%.2f,%.2f\n", total, local);
+            }
+        }
+    }
+    fclose(fp);
+    return SUCCESS;
+}
+
 void signal_handler(int sig) {
     (void)sig; // Suppress unused parameter warning
     running = 0;
     PRINT_INFO("Received signal, stopping monitoring...");
-}
\ No newline at end of file
+}
@@ -0,0 +1,316 @@
+#include "rdt_sim.h"
+#include "rdt_common.h"
+#include "../common/timing.h"
+#include <math.h>
+#include <pthread.h>
+
+// Per L3 domain state of the simulated hardware
+typedef struct {
+    uint64_t qos_cfg;                           // L3_QOS_CFG, bit 0 = CDP
+    uint64_t l3_mask[RDT_MAX_CLOS];
+    int mba_delay[RDT_MAX_CLOS];
+    double demand_mbps[RDT_SIM_MAX_RMID];
+    double total_bytes[RDT_SIM_MAX_RMID];       // Exact traffic, before wrap
+    double local_bytes[RDT_SIM_MAX_RMID];
+} sim_domain_t;
+
+static sim_domain_t *g_domains = NULL;
+static int g_num_domains = 0;
+static uint64_t (*g_l2_mask)[RDT_MAX_CLOS] = NULL;   // Per L2 domain
+static int g_num_l2 = 0;
+static uint64_t *g_pqr_assoc = NULL;            // Per CPU
+static uint64_t *g_evtsel = NULL;               // Per CPU
+static int g_num_cpus = 0;
+static double g_cap_mbps = RDT_SIM_DEFAULT_CAP_MBPS;
+static uint64_t g_last_ns = 0;
+static uint64_t g_noise_state = 0x9E3779B97F4A7C15ULL;
+static uint64_t g_counter_offset[RDT_SIM_MAX_RMID];
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Function declarations
+static int sim_cpu_domain(int cpu);
+static int sim_rmid_clos(int rmid);
+static int sim_cpu_l2(int cpu);
+static uint64_t sim_l3_fill_mask(const sim_domain_t *dom, int clos);
+static double sim_noise(void);
+static void sim_advance(void);
+static int sim_mba_granularity(void);
+static int sim_msr_read(int cpu, uint32_t msr, uint64_t *value);
+static int sim_msr_write(int cpu, uint32_t msr, uint64_t value);
+
+int rdt_sim_init(void) {
+    rdt_sim_cleanup();
+
+    g_num_cpus = get_cpu_count();
+    g_num_domains = rdt_num_domains();
+    g_domains = calloc(g_num_domains, sizeof(sim_domain_t));
+    g_pqr_assoc = calloc(g_num_cpus, sizeof(uint64_t));
+    g_evtsel = calloc(g_num_cpus, sizeof(uint64_t));
+    g_num_l2 = rdt_num_l2_domains() > 0 ? rdt_num_l2_domains() : 1;
+    g_l2_mask = calloc(g_num_l2, sizeof(*g_l2_mask));
+    if (!g_domains || !g_pqr_assoc || !g_evtsel || !g_l2_mask) {
+        rdt_sim_cleanup();
+        return ERROR_SYSTEM;
+    }
+
+    // Reset state of the hardware: every CLOS owns the whole cache
+    for (int d = 0; d < g_num_domains; d++) {
+        for (int clos = 0; clos < RDT_MAX_CLOS; clos++) {
+            g_domains[d].l3_mask[clos] = rdt_l3_full_mask();
+        }
+    }
+    for (int d = 0; d < g_num_l2; d++) {
+        for (int clos = 0; clos < RDT_MAX_CLOS; clos++) {
+            g_l2_mask[d][clos] = rdt_l2_full_mask();
+        }
+    }
+    memset(g_counter_offset, 0, sizeof(g_counter_offset));
+    g_last_ns = timing_now_ns();
+    return SUCCESS;
+}
+
+void rdt_sim_cleanup(void) {
+    free(g_domains);
+    free(g_pqr_assoc);
+    free(g_evtsel);
+    free(g_l2_mask);
+    g_l2_mask = NULL;
+    g_num_l2 = 0;
+    g_domains = NULL;
+    g_pqr_assoc = NULL;
+    g_evtsel = NULL;
+    g_num_domains = g_num_cpus = 0;
+}
+
+static int sim_cpu_domain(int cpu) {
+    int domain = topo_cpu_l3_domain(cpu);
+    return (domain >= 0 && domain < g_num_domains) ? domain : 0;
+}
+
+// Traffic of an RMID is throttled by the CLOS of a CPU it runs on; the
+// tools pair RMID n with CLOS n, which is also the fallback
+static int sim_rmid_clos(int rmid) {
+    for (int cpu = 0; cpu < g_num_cpus; cpu++) {
+        if ((int)(g_pqr_assoc[cpu] & RDT_PQR_RMID_MASK) == rmid) {
+            return (int)(g_pqr_assoc[cpu] >> RDT_PQR_CLOS_SHIFT) % RDT_MAX_CLOS;
+        }
+    }
+    return rmid % RDT_MAX_CLOS;
+}
+
+static int sim_cpu_l2(int cpu) {
+    const topology_t *topo = topology_get();
+    int l2 = topo && cpu < topo->max_cpus ? topo->cpus[cpu].l2 : -1;
+    return l2 >= 0 && l2 < g_num_l2 ? l2 : 0;
+}
+
+// Ways a CLOS may fill; under CDP that is the union of its code and data masks
+static uint64_t sim_l3_fill_mask(const sim_domain_t *dom, int clos) {
+    if (!(dom->qos_cfg & RDT_QOS_CFG_CDP)) {
+        return dom->l3_mask[clos];
+    }
+    if (2 * clos + 1 >= RDT_MAX_CLOS) {
+        return 0;
+    }
+    return dom->l3_mask[2 * clos] | dom->l3_mask[2 * clos + 1];
+}
+
+static int sim_mba_granularity(void) {
+    int max_delay = rdt_mba_max_delay();
+    return (100 - max_delay) > 0 ? 100 - max_delay : 10;
+}
+
+// Fraction of the demand left at a delay: ~1 below 20%, 0.75 at 50%,
+// 0.1 at 90%. Real parts differ, which is what the controller is for.
+double rdt_sim_throttle_factor(int delay) {
+    int max_delay = rdt_mba_max_delay();
+    if (delay <= 0) {
+        return 1.0;
+    }
+    if (delay > max_delay) {
+        delay = max_delay;
+    }
+    double x = (double)delay / 90.0;
+    double f = 1.0 - 0.9 * pow(x, 2.2);
+    return f > 0.05 ? f : 0.05;
+}
+
+// xorshift64*, mapped to [0.98, 1.02]
+static double sim_noise(void) {
+    g_noise_state ^= g_noise_state >> 12;
+    g_noise_state ^= g_noise_state << 25;
+    g_noise_state ^= g_noise_state >> 27;
+    uint64_t r = g_noise_state * 0x2545F4914F6CDD1DULL;
+    return 0.98 + 0.04 * (double)(r >> 11) / (double)(1ULL << 53);
+}
+
+// Integrate the bandwidth model up to now
+static void sim_advance(void) {
+    uint64_t now = timing_now_ns();
+    double dt = (now - g_last_ns) / 1e9;
+    int gran = sim_mba_granularity();
+
+    if (dt <= 0) {
+        return;
+    }
+    g_last_ns = now;
+
+    for (int d = 0; d < g_num_domains; d++) {
+        sim_domain_t *dom = &g_domains[d];
+        double bw[RDT_SIM_MAX_RMID];
+        double sum = 0;
+
+        for (int rmid = 0; rmid < RDT_SIM_MAX_RMID; rmid++) {
+            bw[rmid] = 0;
+            if (dom->demand_mbps[rmid] <= 0) continue;
+
+            // Hardware rounds a delay up to the next supported step
+            int delay = dom->mba_delay[sim_rmid_clos(rmid)];
+            delay = (delay + gran - 1) / gran * gran;
+            bw[rmid] = dom->demand_mbps[rmid] * rdt_sim_throttle_factor(delay) * sim_noise();
+            sum += bw[rmid];
+        }
+
+        double scale = sum > g_cap_mbps ? g_cap_mbps / sum : 1.0;
+        for (int rmid = 0; rmid < RDT_SIM_MAX_RMID; rmid++) {
+            double bytes = bw[rmid] * scale * 1024.0 * 1024.0 * dt;
+            dom->total_bytes[rmid] += bytes;
+            dom->local_bytes[rmid] += bytes * RDT_SIM_LOCAL_FRACTION;
+        }
+    }
+}
+
+int rdt_sim_set_demand(int rmid, int domain, double mbps) {
+    if (!g_domains || rmid < 0 || rmid >= RDT_SIM_MAX_RMID || domain < 0 ||
+        domain >= g_num_domains || mbps < 0) {
+        return ERROR_INVALID_PARAM;
+    }
+    pthread_mutex_lock(&g_lock);
+    sim_advance();
+    g_domains[domain].demand_mbps[rmid] = mbps;
+    pthread_mutex_unlock(&g_lock);
+    return SUCCESS;
+}
+
+void rdt_sim_set_bandwidth_cap(double mbps) {
+    pthread_mutex_lock(&g_lock);
+    sim_advance();
+    g_cap_mbps = mbps;
+    pthread_mutex_unlock(&g_lock);
+}
+
+int rdt_sim_set_counter_offset(int rmid, uint64_t units) {
+    if (rmid < 0 || rmid >= RDT_SIM_MAX_RMID) {
+        return ERROR_INVALID_PARAM;
+    }
+    pthread_mutex_lock(&g_lock);
+    g_counter_offset[rmid] = units;
+    pthread_mutex_unlock(&g_lock);
+    return SUCCESS;
+}
+
+int rdt_sim_msr_read(int cpu, uint32_t msr, uint64_t *value) {
+    pthread_mutex_lock(&g_lock);
+    int result = sim_msr_read(cpu, msr, value);
+    pthread_mutex_unlock(&g_lock);
+    return result;
+}
+
+int rdt_sim_msr_write(int cpu, uint32_t msr, uint64_t value) {
+    pthread_mutex_lock(&g_lock);
+    int result = sim_msr_write(cpu, msr, value);
+    pthread_mutex_unlock(&g_lock);
+    return result;
+}
+
+static int sim_msr_read(int cpu, uint32_t msr, uint64_t *value) {
+    if (!g_domains || cpu < 0 || cpu >= g_num_cpus) {
+        return ERROR_SYSTEM;
+    }
+    sim_domain_t *dom = &g_domains[sim_cpu_domain(cpu)];
+
+    if (msr == MSR_IA32_PQR_ASSOC) {
+        *value = g_pqr_assoc[cpu];
+    } else if (msr == MSR_IA32_QM_EVTSEL) {
+        *value = g_evtsel[cpu];
+    } else if (msr == MSR_IA32_L3_QOS_CFG) {
+        *value = dom->qos_cfg;
+    } else if (msr >= MSR_IA32_L3_MASK_0 && msr < MSR_IA32_L3_MASK_0 + RDT_MAX_CLOS) {
+        *value = dom->l3_mask[msr - MSR_IA32_L3_MASK_0];
+    } else if (msr >= MSR_IA32_L2_MASK_0 && msr < MSR_IA32_L2_MASK_0 + RDT_MAX_CLOS) {
+        *value = g_l2_mask[sim_cpu_l2(cpu)][msr - MSR_IA32_L2_MASK_0];
+    } else if (msr >= MSR_IA32_MBA_THRTL_MSR && msr < MSR_IA32_MBA_THRTL_MSR + RDT_MAX_CLOS) {
+        *value = (uint64_t)dom->mba_delay[msr - MSR_IA32_MBA_THRTL_MSR];
+    } else if (msr == MSR_IA32_QM_CTR) {
+        uint32_t event = g_evtsel[cpu] & 0xFF;
+        int rmid = (int)(g_evtsel[cpu] >> 32) & (int)RDT_PQR_RMID_MASK;
+        if (rmid >= RDT_SIM_MAX_RMID) {
+            *value = RDT_QM_CTR_ERROR;
+            return SUCCESS;
+        }
+
+        sim_advance();
+        double units;
+        if (event == RDT_EVT_LLC_OCCUPANCY) {
+            // Occupancy follows the share of ways the RMID's CLOS may fill
+            const topo_cache_t *llc = topo_llc();
+            double size = llc && llc->size_bytes ? (double)llc->size_bytes : 32.0 * 1024 * 1024;
+            uint64_t full = rdt_l3_full_mask();
+            double share = (double)__builtin_popcountll(sim_l3_fill_mask(dom, sim_rmid_clos(rmid)) & full) /
+                           (double)__builtin_popcountll(full);
+            units = dom->demand_mbps[rmid] > 0 ? 0.9 * size * share / rdt_mon_upscale() : 0;
+        } else if (event == RDT_EVT_MBM_TOTAL) {
+            units = dom->total_bytes[rmid] / rdt_mon_upscale();
+        } else if (event == RDT_EVT_MBM_LOCAL) {
+            units = dom->local_bytes[rmid] / rdt_mon_upscale();
+        } else {
+            *value = RDT_QM_CTR_ERROR;
+            return SUCCESS;
+        }
+
+        uint64_t width_mask = (1ULL << rdt_mbm_counter_width()) - 1;
+        uint64_t offset = event == RDT_EVT_LLC_OCCUPANCY ? 0 : g_counter_offset[rmid];
+        *value = ((uint64_t)units + offset) & width_mask;
+    } else {
+        PRINT_ERROR("Simulated MSR 0x%x not implemented", msr);
+        return ERROR_NOT_SUPPORTED;
+    }
+    return SUCCESS;
+}
+
+static int sim_msr_write(int cpu, uint32_t msr, uint64_t value) {
+    if (!g_domains || cpu < 0 || cpu >= g_num_cpus) {
+        return ERROR_SYSTEM;
+    }
+    sim_domain_t *dom = &g_domains[sim_cpu_domain(cpu)];
+
+    if (msr == MSR_IA32_PQR_ASSOC) {
+        sim_advance();
+        g_pqr_assoc[cpu] = value;
+    } else if (msr == MSR_IA32_QM_EVTSEL) {
+        g_evtsel[cpu] = value;
+    } else if (msr >= MSR_IA32_L3_MASK_0 && msr < MSR_IA32_L3_MASK_0 + RDT_MAX_CLOS) {
+        // Like the hardware, reject empty and non-contiguous masks
+        if (value == 0 || (value & (value + (value & -value))) != 0) {
+            return ERROR_INVALID_PARAM;
+        }
+        dom->l3_mask[msr - MSR_IA32_L3_MASK_0] = value;
+    } else if (msr == MSR_IA32_L3_QOS_CFG) {
+        dom->qos_cfg = value & RDT_QOS_CFG_CDP;
+    } else if (msr >= MSR_IA32_L2_MASK_0 && msr < MSR_IA32_L2_MASK_0 + RDT_MAX_CLOS) {
+        if (value == 0 || (value & (value + (value & -value))) != 0) {
+            return ERROR_INVALID_PARAM;
+        }
+        g_l2_mask[sim_cpu_l2(cpu)][msr - MSR_IA32_L2_MASK_0] = value;
+    } else if (msr >= MSR_IA32_MBA_THRTL_MSR && msr < MSR_IA32_MBA_THRTL_MSR + RDT_MAX_CLOS) {
+        if (value > (uint64_t)rdt_mba_max_delay()) {
+            return ERROR_INVALID_PARAM;
+        }
+        sim_advance();
+        dom->mba_delay[msr - MSR_IA32_MBA_THRTL_MSR] = (int)value;
+    } else {
+        PRINT_ERROR("Simulated MSR 0x%x not implemented", msr);
+        return ERROR_NOT_SUPPORTED;
+    }
+    return SUCCESS;
+}
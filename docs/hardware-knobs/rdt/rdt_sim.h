@@ -0,0 +1,44 @@
+#ifndef RDT_SIM_H
+#define RDT_SIM_H
+
+#include <stdint.h>
+#include "../common/common.h"
+
+// Simulated RDT register file behind the "sim" backend. It answers the
+// same MSRs as the hardware (PQR_ASSOC, L3_QOS_CFG, L3 and L2 masks, MBA
+// delays, QM_EVTSEL / QM_CTR) and advances the MBM counters from a
+// bandwidth model, so the MSR backend code paths and the controllers built
+// on them run without RDT hardware.
+//
+// Model: each RMID has an unthrottled demand per L3 domain. The MBA delay
+// of its CLOS scales that demand through a nonlinear curve (little effect
+// at small delays, steep near the maximum), the delay is rounded up to the
+// MBA granularity, and a domain whose throttled demand exceeds the memory
+// bandwidth cap shares the cap in proportion. Each interval gets +/-2%
+// noise. Counters wrap at the MBM counter width like the hardware.
+
+#define RDT_SIM_UPSCALE          65536          // Bytes per counter unit when CPUID has none
+#define RDT_SIM_DEFAULT_CAP_MBPS 20000.0        // Per-domain memory bandwidth
+#define RDT_SIM_LOCAL_FRACTION   0.85           // Share of traffic to the local node
+#define RDT_SIM_MAX_RMID         64
+
+// All entry points are serialized, so per-domain reader threads may share it.
+
+// Register file lifetime
+int rdt_sim_init(void);
+void rdt_sim_cleanup(void);
+
+// MSR access, same contract as msr_read_cpu()/msr_write_cpu()
+int rdt_sim_msr_read(int cpu, uint32_t msr, uint64_t *value);
+int rdt_sim_msr_write(int cpu, uint32_t msr, uint64_t value);
+
+// Workload model
+int rdt_sim_set_demand(int rmid, int domain, double mbps);
+void rdt_sim_set_bandwidth_cap(double mbps);
+double rdt_sim_throttle_factor(int delay);
+
+// Start the MBM counters of an RMID this many units in, e.g. just below the
+// wrap point to exercise overflow handling without waiting for it
+int rdt_sim_set_counter_offset(int rmid, uint64_t units);
+
+#endif /* RDT_SIM_H */
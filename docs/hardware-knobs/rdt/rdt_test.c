@@ -1,12 +1,15 @@
 #include "../common/common.h"
 #include "../common/msr_utils.h"
+#include "../common/cpu_caps.h"
+#include "../common/timing.h"
+#include "../common/topology.h"
+#include "../common/histogram.h"
 #include <sys/stat.h>
 #include <dirent.h>
 
 // RDT specific definitions
 #define RESCTRL_PATH "/sys/fs/resctrl"
-#define MAX_CLOS 16
-#define MAX_CACHE_WAYS 20
+#define MAX_CLOS 16        // Upper bound; the CPU's count comes from CPUID
 
 typedef struct {
     int clos_id;
@@ -14,11 +17,19 @@ typedef struct {
     int mb_throttle;
 } rdt_config_t;
 
+// L3 masks of every domain as found at init, restored on cleanup
+static uint64_t (*g_saved_masks)[MAX_CLOS] = NULL;
+static int g_saved_domains = 0;
+
 // Function declarations
+static int rdt_num_clos(void);
+static int rdt_num_domains(void);
+static uint64_t rdt_full_mask(void);
 int rdt_check_support(void);
 int rdt_init(void);
 int rdt_cleanup(void);
 int rdt_read_l3_mask(int clos_id, uint64_t *mask);
+int rdt_read_l3_mask_domain(int domain, int clos_id, uint64_t *mask);
 int rdt_write_l3_mask(int clos_id, uint64_t mask);
 int rdt_set_clos(int cpu, int clos_id);
 int rdt_get_clos(int cpu, int *clos_id);
@@ -43,6 +54,8 @@ int main(int argc, char *argv[]) {
         return EXIT_FAILURE;
     }
     
+    timing_init();
+    
     // Initialize RDT
     if (rdt_init() != SUCCESS) {
         PRINT_ERROR("Failed to initialize RDT");
@@ -104,7 +117,7 @@ int main(int argc, char *argv[]) {
 
 int rdt_check_support(void) {
     // Check CPU features first
-    if (check_cpu_feature("rdt_a") != SUCCESS) {
+    if (!cpu_has_feature(CPU_FEAT_RDT_A)) {
         PRINT_ERROR("CPU does not support RDT allocation");
         return ERROR_NOT_SUPPORTED;
     }
@@ -117,7 +130,7 @@ int rdt_check_support(void) {
     
     // Try to read a basic RDT MSR to verify support
     uint64_t test_value;
-    if (msr_read_cpu(0, MSR_IA32_L3_MASK_0, &test_value) != SUCCESS) {
+    if (rdt_read_l3_mask(0, &test_value) != SUCCESS) {
         PRINT_ERROR("Failed to read RDT MSR - RDT may not be available");
         return ERROR_NOT_SUPPORTED;
     }
@@ -126,16 +139,34 @@ int rdt_check_support(void) {
     return SUCCESS;
 }
 
+static int rdt_num_clos(void) {
+    int num_clos = cpu_caps_get()->l3_cat.num_clos;
+    return (num_clos > 0 && num_clos <= MAX_CLOS) ? num_clos : MAX_CLOS;
+}
+
+static int rdt_num_domains(void) {
+    int num_domains = topo_l3_domain_count();
+    return num_domains > 0 ? num_domains : 1;
+}
+
+static uint64_t rdt_full_mask(void) {
+    int cbm_len = cpu_caps_get()->l3_cat.cbm_len;
+    return (cbm_len > 0 && cbm_len < 64) ? (1ULL << cbm_len) - 1 : 0xFFFF;
+}
+
 int rdt_init(void) {
-    // Initialize RDT using MSR interface
-    // Set default L3 cache mask for CLOS 0 (all ways available)
-    uint64_t default_mask = 0xFFFFF; // 20 ways maximum
-    
-    // Read the current mask to determine actual number of ways
-    uint64_t current_mask;
-    if (msr_read_cpu(0, MSR_IA32_L3_MASK_0, &current_mask) == SUCCESS) {
-        if (current_mask != 0) {
-            default_mask = current_mask;
+    // Snapshot every L3 domain's masks so cleanup can put them back
+    g_saved_domains = rdt_num_domains();
+    g_saved_masks = calloc(g_saved_domains, sizeof(*g_saved_masks));
+    if (!g_saved_masks) {
+        return ERROR_SYSTEM;
+    }
+    for (int domain = 0; domain < g_saved_domains; domain++) {
+        for (int clos = 0; clos < rdt_num_clos(); clos++) {
+            if (rdt_read_l3_mask_domain(domain, clos, &g_saved_masks[domain][clos]) != SUCCESS) {
+                PRINT_ERROR("Failed to read L3 mask of CLOS %d on L3 domain %d", clos, domain);
+                return ERROR_SYSTEM;
+            }
         }
     }
     
@@ -159,31 +190,53 @@ int rdt_cleanup(void) {
         rdt_set_clos(cpu, 0);
     }
     
+    // Restore the masks found at init in every L3 domain
+    for (int domain = 0; domain < g_saved_domains; domain++) {
+        int cpu = topo_l3_domain_cpu(domain);
+        for (int clos = 0; clos < rdt_num_clos(); clos++) {
+            uint64_t mask;
+            if (rdt_read_l3_mask_domain(domain, clos, &mask) == SUCCESS &&
+                mask != g_saved_masks[domain][clos]) {
+                msr_write_cpu(cpu, MSR_IA32_L3_MASK_0 + clos, g_saved_masks[domain][clos]);
+            }
+        }
+    }
+    free(g_saved_masks);
+    g_saved_masks = NULL;
+    g_saved_domains = 0;
+    
     PRINT_INFO("RDT cleanup completed");
     return SUCCESS;
 }
 
 int rdt_read_l3_mask(int clos_id, uint64_t *mask) {
-    if (clos_id >= MAX_CLOS || mask == NULL) {
+    return rdt_read_l3_mask_domain(0, clos_id, mask);
+}
+
+int rdt_read_l3_mask_domain(int domain, int clos_id, uint64_t *mask) {
+    if (clos_id < 0 || clos_id >= rdt_num_clos() || mask == NULL) {
         return ERROR_INVALID_PARAM;
     }
     
-    uint32_t msr = MSR_IA32_L3_MASK_0 + clos_id;
-    return msr_read_cpu(0, msr, mask);
+    int cpu = topo_l3_domain_cpu(domain);
+    if (cpu < 0) {
+        return ERROR_INVALID_PARAM;
+    }
+    return msr_read_cpu(cpu, MSR_IA32_L3_MASK_0 + clos_id, mask);
 }
 
 int rdt_write_l3_mask(int clos_id, uint64_t mask) {
-    if (clos_id >= MAX_CLOS) {
+    if (clos_id < 0 || clos_id >= rdt_num_clos()) {
         return ERROR_INVALID_PARAM;
     }
     
     uint32_t msr = MSR_IA32_L3_MASK_0 + clos_id;
     
-    // Write to all CPUs
-    int cpu_count = get_cpu_count();
-    for (int cpu = 0; cpu < cpu_count; cpu++) {
-        if (msr_write_cpu(cpu, msr, mask) != SUCCESS) {
-            PRINT_ERROR("Failed to write L3 mask to CPU %d", cpu);
+    // Mask MSRs are shared by every CPU of an L3 domain; write each domain once
+    for (int domain = 0; domain < rdt_num_domains(); domain++) {
+        int cpu = topo_l3_domain_cpu(domain);
+        if (cpu < 0 || msr_write_cpu(cpu, msr, mask) != SUCCESS) {
+            PRINT_ERROR("Failed to write L3 mask to L3 domain %d", domain);
             return ERROR_SYSTEM;
         }
     }
@@ -192,7 +245,7 @@ int rdt_write_l3_mask(int clos_id, uint64_t mask) {
 }
 
 int rdt_set_clos(int cpu, int clos_id) {
-    if (clos_id >= MAX_CLOS) {
+    if (clos_id < 0 || clos_id >= rdt_num_clos()) {
         return ERROR_INVALID_PARAM;
     }
     
@@ -201,8 +254,8 @@ int rdt_set_clos(int cpu, int clos_id) {
         return ERROR_SYSTEM;
     }
     
-    // Set CLOS ID in bits 31:0
-    value = (value & 0xFFFFFFFF00000000ULL) | (uint64_t)clos_id;
+    // CLOS ID lives in bits 63:32; the RMID in bits 9:0 is left alone
+    value = (value & 0x00000000FFFFFFFFULL) | ((uint64_t)clos_id << 32);
     
     return msr_write_cpu(cpu, MSR_IA32_PQR_ASSOC, value);
 }
@@ -217,7 +270,7 @@ int rdt_get_clos(int cpu, int *clos_id) {
         return ERROR_SYSTEM;
     }
     
-    *clos_id = (int)(value & 0xFFFFFFFF);
+    *clos_id = (int)(value >> 32);
     return SUCCESS;
 }
 
@@ -259,36 +312,31 @@ int rdt_test_basic_functionality(void) {
 int rdt_test_cache_allocation(void) {
     PRINT_INFO("Testing cache allocation...");
     
-    // Save original configuration
-    uint64_t original_mask;
-    if (rdt_read_l3_mask(1, &original_mask) != SUCCESS) {
-        PRINT_ERROR("Failed to read original L3 mask for CLOS 1");
-        return ERROR_SYSTEM;
-    }
-    
-    // Set a restricted mask for CLOS 1 (use only first 10 cache ways)
-    uint64_t restricted_mask = 0x3FF; // 10 bits set
+    // Set a restricted mask for CLOS 1: the low half of the CBM. The
+    // original masks are restored by rdt_cleanup().
+    int cbm_len = __builtin_popcountll(rdt_full_mask());
+    uint64_t restricted_mask = (1ULL << (cbm_len > 1 ? cbm_len / 2 : 1)) - 1;
     if (rdt_write_l3_mask(1, restricted_mask) != SUCCESS) {
         PRINT_ERROR("Failed to write restricted L3 mask");
         return ERROR_SYSTEM;
     }
     
-    // Verify the mask was set correctly
-    uint64_t read_mask;
-    if (rdt_read_l3_mask(1, &read_mask) != SUCCESS) {
-        PRINT_ERROR("Failed to read back L3 mask");
-        return ERROR_SYSTEM;
-    }
-    
-    if (read_mask != restricted_mask) {
-        PRINT_ERROR("L3 mask mismatch: wrote 0x%lx, read 0x%lx", restricted_mask, read_mask);
-        return ERROR_SYSTEM;
+    // Verify the mask was set correctly in every L3 domain
+    for (int domain = 0; domain < rdt_num_domains(); domain++) {
+        uint64_t read_mask;
+        if (rdt_read_l3_mask_domain(domain, 1, &read_mask) != SUCCESS) {
+            PRINT_ERROR("Failed to read back L3 mask on L3 domain %d", domain);
+            return ERROR_SYSTEM;
+        }
+        
+        if (read_mask != restricted_mask) {
+            PRINT_ERROR("L3 mask mismatch on L3 domain %d: wrote 0x%lx, read 0x%lx",
+                        domain, restricted_mask, read_mask);
+            return ERROR_SYSTEM;
+        }
     }
     
-    PRINT_DEBUG("Successfully set L3 mask for CLOS 1: 0x%lx", read_mask);
-    
-    // Restore original configuration
-    rdt_write_l3_mask(1, original_mask);
+    PRINT_DEBUG("Successfully set L3 mask for CLOS 1: 0x%lx", restricted_mask);
     
     return SUCCESS;
 }
@@ -297,7 +345,7 @@ int rdt_test_bandwidth_monitoring(void) {
     PRINT_INFO("Testing bandwidth monitoring...");
     
     // Check if monitoring is supported
-    if (check_cpu_feature("rdt_m") != SUCCESS) {
+    if (!cpu_has_feature(CPU_FEAT_RDT_M)) {
         PRINT_INFO("Bandwidth monitoring not supported, skipping test");
         return SUCCESS;
     }
@@ -346,19 +394,23 @@ int rdt_test_dynamic_switching(void) {
     } else {
         PRINT_DEBUG("Successfully switched CPU 0 to CLOS %d", test_clos);
         
-        // Measure switching latency only if switching works
-        uint64_t start_time = get_timestamp_us();
-        int successful_switches = 0;
+        // Measure switching latency only if switching works. Run on CPU 0
+        // so the msr driver writes locally; rdt_bench --switch-latency
+        // compares this path with the fast path and remote writes.
+        histogram_t hist;
+        hist_reset(&hist);
+        topo_pin_thread(0);
         for (int i = 0; i < 100; i++) { // Reduced iterations to avoid flooding
-            if (rdt_set_clos(0, (i % 2) ? 1 : 0) == SUCCESS) {
-                successful_switches++;
+            uint64_t start_time = timing_start();
+            int result = rdt_set_clos(0, (i % 2) ? 1 : 0);
+            uint64_t end_time = timing_stop();
+            if (result == SUCCESS) {
+                hist_record(&hist, (uint64_t)timing_ticks_to_ns(end_time - start_time));
             }
         }
-        uint64_t end_time = get_timestamp_us();
         
-        if (successful_switches > 0) {
-            uint64_t avg_latency = (end_time - start_time) / successful_switches;
-            PRINT_INFO("Average CLOS switching latency: %lu microseconds", avg_latency);
+        if (hist.count > 0) {
+            hist_print(&hist, "CLOS switching latency (open/close per access)", "ns");
         }
     }
     
@@ -371,30 +423,29 @@ int rdt_test_dynamic_switching(void) {
 void rdt_print_config(void) {
     PRINT_INFO("Current RDT Configuration:");
     
-    // Print CPU vendor
-    char vendor[64];
-    if (get_cpu_vendor(vendor, sizeof(vendor)) == SUCCESS) {
-        PRINT_INFO("CPU Vendor: %s", vendor);
-    }
+    // Print CPU identity and RDT enumeration
+    cpu_caps_print();
     
     // Print supported features
     PRINT_INFO("RDT Features:");
-    if (check_cpu_feature("rdt_a") == SUCCESS) {
+    if (cpu_has_feature(CPU_FEAT_CAT_L3)) {
         PRINT_INFO("  - Cache Allocation Technology (CAT): Supported");
     }
-    if (check_cpu_feature("rdt_m") == SUCCESS) {
+    if (cpu_has_feature(CPU_FEAT_CQM_MBM_TOTAL)) {
         PRINT_INFO("  - Memory Bandwidth Monitoring (MBM): Supported");
     }
-    if (check_cpu_feature("mba") == SUCCESS) {
+    if (cpu_has_feature(CPU_FEAT_MBA)) {
         PRINT_INFO("  - Memory Bandwidth Allocation (MBA): Supported");
     }
     
-    // Print current L3 masks for first few CLOS
-    PRINT_INFO("L3 Cache Masks:");
-    for (int i = 0; i < 4; i++) {
-        uint64_t mask;
-        if (rdt_read_l3_mask(i, &mask) == SUCCESS) {
-            PRINT_INFO("  CLOS %d: 0x%lx", i, mask);
+    // Print current L3 masks for first few CLOS of each L3 domain
+    PRINT_INFO("L3 Cache Masks (%d CLOS, %d L3 domains):", rdt_num_clos(), rdt_num_domains());
+    for (int domain = 0; domain < rdt_num_domains(); domain++) {
+        for (int i = 0; i < (rdt_num_clos() < 4 ? rdt_num_clos() : 4); i++) {
+            uint64_t mask;
+            if (rdt_read_l3_mask_domain(domain, i, &mask) == SUCCESS) {
+                PRINT_INFO("  Domain %d CLOS %d: 0x%lx", domain, i, mask);
+            }
         }
     }
     
@@ -97,11 +97,12 @@ int main() {
         }
         printf("2. If MSR writes still fail after mounting resctrl:\n");
         printf("   - The kernel may be configured to use resctrl interface exclusively\n");
-        printf("   - Consider using resctrl interface instead of direct MSR writes\n");
+        printf("   - Run rdt_bench with --backend resctrl instead of direct MSR writes\n");
         printf("   - Check kernel config: CONFIG_X86_CPU_RESCTRL=y\n");
         return 1;
     }
     
     printf("\nAll checks passed. RDT should be functional.\n");
+    printf("rdt_bench uses the resctrl backend automatically while resctrl is mounted.\n");
     return 0;
 }
\ No newline at end of file
@@ -1,4 +1,7 @@
 #include "smt_common.h"
+#include "../common/timing.h"
+#include "../common/topology.h"
+#include "../common/bench_harness.h"
 #include <pthread.h>
 #include <sched.h>
 
@@ -23,6 +26,13 @@ typedef struct {
     int should_stop;
 } benchmark_thread_data_t;
 
+// Parameters of one harness sample
+typedef struct {
+    benchmark_type_t bench_type;
+    int num_threads;
+    int use_smt;
+} smt_kernel_ctx_t;
+
 // Function declarations
 void* benchmark_worker(void *arg);
 double run_smt_benchmark(benchmark_type_t bench_type, int num_threads, int use_smt);
@@ -31,8 +41,30 @@ void memory_bound_benchmark(benchmark_thread_data_t *data);
 void mixed_workload_benchmark(benchmark_thread_data_t *data);
 void print_benchmark_results(void);
 int setup_cpu_affinity(int thread_id, int use_smt);
+static double smt_kernel_run(void *ctx);
+static double measure_smt(benchmark_type_t bench_type, int num_threads, int use_smt);
+
+// Indexed by benchmark_type_t
+static const bench_kernel_t smt_kernels[] = {
+    { "cpu",    "Mops/s", 1, smt_kernel_run },
+    { "memory", "Mops/s", 1, smt_kernel_run },
+    { "mixed",  "Mops/s", 1, smt_kernel_run },
+};
 
 int main(int argc, char *argv[]) {
+    bench_options_t opts;
+    
+    for (size_t i = 0; i < sizeof(smt_kernels) / sizeof(smt_kernels[0]); i++) {
+        bench_register(&smt_kernels[i]);
+    }
+    
+    bench_options_init(&opts, "smt_bench");
+    if (bench_parse_args(&opts, &argc, argv) != SUCCESS || argc > 1) {
+        printf("Usage: %s [harness options]\n", argv[0]);
+        bench_print_usage();
+        return EXIT_FAILURE;
+    }
+    
     PRINT_INFO("Starting SMT Performance Benchmark");
     
     // Check permissions
@@ -46,7 +78,14 @@ int main(int argc, char *argv[]) {
         return EXIT_FAILURE;
     }
     
+    if (bench_begin(&opts) != SUCCESS) {
+        PRINT_ERROR("Failed to set up benchmark harness");
+        return EXIT_FAILURE;
+    }
+    timing_print_info();
+    
     print_benchmark_results();
+    bench_end();
     
     PRINT_INFO("SMT benchmark completed");
     return EXIT_SUCCESS;
@@ -61,7 +100,7 @@ void* benchmark_worker(void *arg) {
     CPU_SET(data->cpu_id, &cpuset);
     pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
     
-    uint64_t start_time = get_timestamp_us();
+    uint64_t start_time = timing_now_ns();
     data->operations = 0;
     
     // Run benchmark based on type
@@ -77,17 +116,17 @@ void* benchmark_worker(void *arg) {
             break;
     }
     
-    uint64_t end_time = get_timestamp_us();
-    data->execution_time_ms = (end_time - start_time) / 1000.0;
+    uint64_t end_time = timing_now_ns();
+    data->execution_time_ms = (end_time - start_time) / 1000000.0;
     
     return NULL;
 }
 
 void cpu_intensive_benchmark(benchmark_thread_data_t *data) {
     volatile uint64_t result = 1;
-    uint64_t end_time = get_timestamp_us() + (BENCHMARK_DURATION_MS * 1000);
+    uint64_t end_time = timing_now_ns() + (BENCHMARK_DURATION_MS * 1000000ULL);
     
-    while (get_timestamp_us() < end_time && !data->should_stop) {
+    while (timing_now_ns() < end_time && !data->should_stop) {
         // CPU-intensive calculations
         for (int i = 0; i < 1000; i++) {
             result *= 7;
@@ -102,9 +141,9 @@ void cpu_intensive_benchmark(benchmark_thread_data_t *data) {
 
 void memory_bound_benchmark(benchmark_thread_data_t *data) {
     volatile char *buffer = (volatile char *)data->memory_buffer;
-    uint64_t end_time = get_timestamp_us() + (BENCHMARK_DURATION_MS * 1000);
+    uint64_t end_time = timing_now_ns() + (BENCHMARK_DURATION_MS * 1000000ULL);
     
-    while (get_timestamp_us() < end_time && !data->should_stop) {
+    while (timing_now_ns() < end_time && !data->should_stop) {
         // Memory-intensive operations
         for (int i = 0; i < MEMORY_SIZE; i += 64) {
             buffer[i] = (char)(i & 0xFF);
@@ -122,9 +161,9 @@ void memory_bound_benchmark(benchmark_thread_data_t *data) {
 void mixed_workload_benchmark(benchmark_thread_data_t *data) {
     volatile char *buffer = (volatile char *)data->memory_buffer;
     volatile uint64_t cpu_result = 1;
-    uint64_t end_time = get_timestamp_us() + (BENCHMARK_DURATION_MS * 1000);
+    uint64_t end_time = timing_now_ns() + (BENCHMARK_DURATION_MS * 1000000ULL);
     
-    while (get_timestamp_us() < end_time && !data->should_stop) {
+    while (timing_now_ns() < end_time && !data->should_stop) {
         // Mixed CPU and memory operations
         for (int i = 0; i < 100; i++) {
             // CPU work
@@ -197,16 +236,47 @@ double run_smt_benchmark(benchmark_type_t bench_type, int num_threads, int use_s
     return (total_operations / total_time) * 1000.0;
 }
 
+static double smt_kernel_run(void *ctx) {
+    smt_kernel_ctx_t *k = (smt_kernel_ctx_t *)ctx;
+    return run_smt_benchmark(k->bench_type, k->num_threads, k->use_smt) / 1000000.0;
+}
+
+// Median Mops/s over the harness repetitions, 0 when the kernel is filtered out
+static double measure_smt(benchmark_type_t bench_type, int num_threads, int use_smt) {
+    smt_kernel_ctx_t ctx = { bench_type, num_threads, use_smt };
+    bench_stats_t stats;
+    char config[64];
+    
+    if (!bench_kernel_selected(&smt_kernels[bench_type])) {
+        return 0.0;
+    }
+    
+    snprintf(config, sizeof(config), "threads=%d,smt=%d", num_threads, use_smt);
+    bench_run(&smt_kernels[bench_type], &ctx, config, &stats);
+    return stats.median;
+}
+
 int setup_cpu_affinity(int thread_id, int use_smt) {
-    int cpu_count = get_cpu_count();
-    
-    if (use_smt) {
-        // Use all available CPUs
-        return thread_id % cpu_count;
-    } else {
-        // Use only even-numbered CPUs (physical cores)
-        return (thread_id * 2) % cpu_count;
+    const topology_t *topo = topology_get();
+    if (!topo || topo->num_cores == 0) {
+        return thread_id % get_cpu_count();
     }
+    
+    if (!use_smt) {
+        // One thread per physical core
+        return topo->cores[thread_id % topo->num_cores].first_cpu;
+    }
+    
+    // Fill every hardware thread of a core before moving to the next
+    int threads_per_core = topo->cores[0].num_cpus > 0 ? topo->cores[0].num_cpus : 1;
+    const topo_domain_t *core = &topo->cores[(thread_id / threads_per_core) % topo->num_cores];
+    int sibling = thread_id % threads_per_core;
+    TOPO_FOR_EACH_CPU(cpu, &core->cpus, topo->max_cpus) {
+        if (sibling-- == 0) {
+            return cpu;
+        }
+    }
+    return core->first_cpu;
 }
 
 void print_benchmark_results(void) {
@@ -216,26 +286,29 @@ void print_benchmark_results(void) {
     PRINT_INFO("=================================");
     
     for (int bench_type = 0; bench_type < 3; bench_type++) {
+        if (!bench_kernel_selected(&smt_kernels[bench_type])) {
+            continue;
+        }
+        
         PRINT_INFO("\n%s Benchmark:", bench_names[bench_type]);
         PRINT_INFO("Threads  No SMT (Mops/s)  SMT (Mops/s)  SMT Efficiency  SMT Benefit");
         PRINT_INFO("-------  ----------------  -------------  --------------  -----------");
         
         for (int threads = 1; threads <= 8; threads *= 2) {
             // Run without SMT (physical cores only)
-            double perf_no_smt = run_smt_benchmark((benchmark_type_t)bench_type, threads, 0);
+            double perf_no_smt = measure_smt((benchmark_type_t)bench_type, threads, 0);
             
             // Run with SMT if available
             double perf_with_smt = 0.0;
             if (smt_get_state() == SMT_ON) {
-                perf_with_smt = run_smt_benchmark((benchmark_type_t)bench_type, threads, 1);
+                perf_with_smt = measure_smt((benchmark_type_t)bench_type, threads, 1);
             }
             
             double efficiency = (perf_no_smt > 0) ? (perf_with_smt / perf_no_smt) : 0.0;
             double benefit = perf_with_smt - perf_no_smt;
             
             printf("%7d  %16.2f  %13.2f  %14.2f%%  %+10.2f\n",
-                   threads, perf_no_smt / 1000000.0, perf_with_smt / 1000000.0,
-                   efficiency * 100.0, benefit / 1000000.0);
+                   threads, perf_no_smt, perf_with_smt, efficiency * 100.0, benefit);
         }
     }
     
@@ -252,14 +325,14 @@ void print_benchmark_results(void) {
         PRINT_INFO("Active SMT threads: %d", active_threads);
         
         // Measure SMT switching overhead
-        uint64_t start_time = get_timestamp_us();
+        uint64_t start_time = timing_start();
         for (int i = 0; i < 100; i++) {
             // Simulate rapid context switching
             sched_yield();
         }
-        uint64_t end_time = get_timestamp_us();
+        uint64_t end_time = timing_stop();
         
-        double switch_overhead = (end_time - start_time) / 100.0;
+        double switch_overhead = timing_ticks_to_ns(end_time - start_time) / 100.0 / 1000.0;
         PRINT_INFO("Context switch overhead: %.2f microseconds", switch_overhead);
     }
     
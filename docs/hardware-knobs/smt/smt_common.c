@@ -8,7 +8,7 @@ int smt_check_support(void) {
     }
     
     // Check if CPU supports SMT
-    if (check_cpu_feature("ht") != SUCCESS) {
+    if (!cpu_has_feature(CPU_FEAT_HT)) {
         PRINT_ERROR("CPU does not support Hyper-Threading");
         return ERROR_NOT_SUPPORTED;
     }
@@ -3,6 +3,7 @@
 
 #include "../common/common.h"
 #include "../common/msr_utils.h"
+#include "../common/cpu_caps.h"
 
 // SMT control paths
 #define SMT_CONTROL_PATH "/sys/devices/system/cpu/smt/control"
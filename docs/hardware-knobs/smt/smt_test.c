@@ -301,7 +301,7 @@ void smt_print_topology(void) {
     }
     
     // Print CPU features
-    if (check_cpu_feature("ht") == SUCCESS) {
+    if (cpu_has_feature(CPU_FEAT_HT)) {
         PRINT_INFO("Hyper-Threading: Supported");
     } else {
         PRINT_INFO("Hyper-Threading: Not Supported");
@@ -0,0 +1,443 @@
+#include "../common/common.h"
+#include "../common/results_store.h"
+#include <math.h>
+
+#define DEFAULT_ALPHA     0.05
+#define DEFAULT_THRESHOLD 2.0   // Percent change below which nothing is flagged
+#define MAX_RUNS          4096
+
+typedef enum {
+    VERDICT_SAME,
+    VERDICT_IMPROVED,
+    VERDICT_REGRESSED,
+    VERDICT_NOISE       // Large change that is not statistically significant
+} verdict_t;
+
+// A run selected for comparison: its records, copied out of a record set
+typedef struct {
+    char label[256];
+    bench_record_set_t set;
+} run_view_t;
+
+typedef struct {
+    const char *store_path;
+    const char *host;
+    double alpha;
+    double threshold;
+    const char *normalize;
+} compare_options_t;
+
+// Function declarations
+void print_usage(const char *prog);
+int list_runs(const char *path);
+int collect_run_ids(const bench_record_set_t *set, char (*ids)[64], int max);
+int select_run(const bench_record_set_t *store, const char *selector, run_view_t *run);
+int normalize_run(run_view_t *run, const char *reference);
+double mann_whitney_p(const double *a, int na, const double *b, int nb);
+int compare_runs(run_view_t *base, run_view_t *cur, const compare_options_t *opts);
+
+int main(int argc, char *argv[]) {
+    compare_options_t opts = {
+        .alpha = DEFAULT_ALPHA,
+        .threshold = DEFAULT_THRESHOLD,
+    };
+    char store_path[512];
+    int list = 0;
+    const char *selectors[2];
+    int num_selectors = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--store") == 0 && i + 1 < argc) {
+            opts.store_path = argv[++i];
+        } else if (strcmp(argv[i], "--host") == 0 && i + 1 < argc) {
+            opts.host = argv[++i];
+        } else if (strcmp(argv[i], "--alpha") == 0 && i + 1 < argc) {
+            opts.alpha = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+            opts.threshold = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--normalize") == 0 && i + 1 < argc) {
+            opts.normalize = argv[++i];
+        } else if (strcmp(argv[i], "--list") == 0) {
+            list = 1;
+        } else if (argv[i][0] != '-' && num_selectors < 2) {
+            selectors[num_selectors++] = argv[i];
+        } else {
+            print_usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (opts.store_path == NULL) {
+        if (results_store_path(opts.host, store_path, sizeof(store_path)) != SUCCESS) {
+            PRINT_ERROR("Invalid results store path");
+            return 2;
+        }
+        opts.store_path = store_path;
+    }
+
+    if (list) {
+        return list_runs(opts.store_path) == SUCCESS ? 0 : 2;
+    }
+
+    // Default to the two most recent runs in the store
+    if (num_selectors == 0) {
+        selectors[num_selectors++] = "prev";
+    }
+    if (num_selectors == 1) {
+        selectors[num_selectors++] = "last";
+    }
+
+    bench_record_set_t store = { 0 };
+    int need_store = 0;
+    for (int i = 0; i < 2; i++) {
+        need_store |= check_file_exists(selectors[i]) != SUCCESS;
+    }
+    if (need_store && results_load(opts.store_path, &store) != SUCCESS) {
+        return 2;
+    }
+
+    run_view_t base = { 0 }, cur = { 0 };
+    if (select_run(&store, selectors[0], &base) != SUCCESS ||
+        select_run(&store, selectors[1], &cur) != SUCCESS) {
+        results_free(&store);
+        results_free(&base.set);
+        results_free(&cur.set);
+        return 2;
+    }
+    results_free(&store);
+
+    int ret = compare_runs(&base, &cur, &opts);
+
+    results_free(&base.set);
+    results_free(&cur.set);
+    if (ret < 0) {
+        return 2;
+    }
+    return ret > 0 ? 1 : 0;
+}
+
+void print_usage(const char *prog) {
+    printf("Usage: %s [options] [BASE [NEW]]\n", prog);
+    printf("\nCompare two benchmark runs per benchmark, kernel and knob configuration.\n");
+    printf("BASE and NEW are run ids from the results store, \"last\", \"prev\", or\n");
+    printf("JSON lines files written with --json. Defaults: BASE=prev, NEW=last.\n");
+    printf("\nOptions:\n");
+    printf("  --store FILE         Results store to read (default per-host store)\n");
+    printf("  --host NAME          Use the store of another host\n");
+    printf("  --alpha A            Significance level of the Mann-Whitney U test (default %.2f)\n",
+           DEFAULT_ALPHA);
+    printf("  --threshold PCT      Minimum median change to flag, in percent (default %.1f)\n",
+           DEFAULT_THRESHOLD);
+    printf("  --normalize REF      Express results relative to reference kernel\n");
+    printf("                       REF = benchmark:kernel[:config] in each run\n");
+    printf("  --list               List runs in the store\n");
+    printf("\nStore: $%s/results-<host>.jsonl (default %s)\n", RESULTS_DIR_ENV, RESULTS_DEFAULT_DIR);
+    printf("Exit status: 0 no regressions, 1 regressions found, 2 error\n");
+}
+
+// Distinct run ids in store order (the store is append-only, so this is time order)
+int collect_run_ids(const bench_record_set_t *set, char (*ids)[64], int max) {
+    int count = 0;
+
+    for (int i = 0; i < set->count; i++) {
+        int seen = 0;
+        for (int j = count - 1; j >= 0 && !seen; j--) {
+            seen = strcmp(ids[j], set->records[i].run_id) == 0;
+        }
+        if (!seen && count < max) {
+            snprintf(ids[count++], 64, "%s", set->records[i].run_id);
+        }
+    }
+    return count;
+}
+
+int list_runs(const char *path) {
+    bench_record_set_t set = { 0 };
+    static char ids[MAX_RUNS][64];
+
+    if (results_load(path, &set) != SUCCESS) {
+        return ERROR_SYSTEM;
+    }
+
+    int num_runs = collect_run_ids(&set, ids, MAX_RUNS);
+    printf("%-24s %-20s %-16s %7s  %s\n", "Run", "Date", "Host", "Records", "Benchmarks");
+
+    for (int r = 0; r < num_runs; r++) {
+        const bench_record_t *first = NULL;
+        char benchmarks[256] = "";
+        int records = 0;
+
+        for (int i = 0; i < set.count; i++) {
+            const bench_record_t *rec = &set.records[i];
+            if (strcmp(rec->run_id, ids[r]) != 0) continue;
+            if (!first) first = rec;
+            records++;
+            if (!strstr(benchmarks, rec->benchmark) &&
+                strlen(benchmarks) + strlen(rec->benchmark) + 2 < sizeof(benchmarks)) {
+                if (benchmarks[0]) strcat(benchmarks, ",");
+                strcat(benchmarks, rec->benchmark);
+            }
+        }
+
+        char date[32] = "-";
+        time_t ts = first->timestamp;
+        if (ts > 0) {
+            strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", localtime(&ts));
+        }
+        printf("%-24s %-20s %-16s %7d  %s\n", ids[r], date, first->host, records, benchmarks);
+    }
+
+    results_free(&set);
+    return SUCCESS;
+}
+
+static int append_record(bench_record_set_t *set, const bench_record_t *rec) {
+    if (set->count == set->capacity) {
+        int capacity = set->capacity ? set->capacity * 2 : 16;
+        bench_record_t *records = realloc(set->records, capacity * sizeof(bench_record_t));
+        if (!records) {
+            return ERROR_SYSTEM;
+        }
+        set->records = records;
+        set->capacity = capacity;
+    }
+    set->records[set->count++] = *rec;
+    return SUCCESS;
+}
+
+// A selector is a JSON lines file, a run id, or "last"/"prev" in the store
+int select_run(const bench_record_set_t *store, const char *selector, run_view_t *run) {
+    static char ids[MAX_RUNS][64];
+    const char *run_id = selector;
+
+    snprintf(run->label, sizeof(run->label), "%s", selector);
+
+    if (check_file_exists(selector) == SUCCESS) {
+        int ret = results_load(selector, &run->set);
+        if (ret == SUCCESS && run->set.count == 0) {
+            PRINT_ERROR("No records in %s", selector);
+            return ERROR_INVALID_PARAM;
+        }
+        return ret;
+    }
+
+    if (strcmp(selector, "last") == 0 || strcmp(selector, "prev") == 0) {
+        int num_runs = collect_run_ids(store, ids, MAX_RUNS);
+        int index = num_runs - (strcmp(selector, "last") == 0 ? 1 : 2);
+        if (index < 0) {
+            PRINT_ERROR("Results store has %d run(s), cannot select \"%s\"", num_runs, selector);
+            return ERROR_INVALID_PARAM;
+        }
+        run_id = ids[index];
+        snprintf(run->label, sizeof(run->label), "%s (%s)", run_id, selector);
+    }
+
+    for (int i = 0; i < store->count; i++) {
+        if (strcmp(store->records[i].run_id, run_id) == 0 &&
+            append_record(&run->set, &store->records[i]) != SUCCESS) {
+            return ERROR_SYSTEM;
+        }
+    }
+
+    if (run->set.count == 0) {
+        PRINT_ERROR("No records for run \"%s\"", selector);
+        return ERROR_INVALID_PARAM;
+    }
+    return SUCCESS;
+}
+
+static int same_key(const bench_record_t *a, const bench_record_t *b) {
+    return strcmp(a->benchmark, b->benchmark) == 0 &&
+           strcmp(a->kernel, b->kernel) == 0 &&
+           strcmp(a->config, b->config) == 0;
+}
+
+// Divide every result by the reference kernel's median of the same run, so
+// runs on different CPU models compare as ratios. Lower-is-better metrics
+// are multiplied instead, which cancels machine speed the same way.
+int normalize_run(run_view_t *run, const char *reference) {
+    char bench[RESULTS_STR_LEN] = "", kernel[RESULTS_STR_LEN] = "", config[RESULTS_STR_LEN] = "";
+    const bench_record_t *ref = NULL;
+
+    if (sscanf(reference, "%127[^:]:%127[^:]:%127[^\n]", bench, kernel, config) < 2) {
+        PRINT_ERROR("Invalid reference \"%s\", expected benchmark:kernel[:config]", reference);
+        return ERROR_INVALID_PARAM;
+    }
+
+    for (int i = 0; i < run->set.count && !ref; i++) {
+        const bench_record_t *rec = &run->set.records[i];
+        if (strcmp(rec->benchmark, bench) == 0 && strcmp(rec->kernel, kernel) == 0 &&
+            (config[0] == '\0' || strcmp(rec->config, config) == 0)) {
+            ref = rec;
+        }
+    }
+
+    if (!ref || ref->median == 0.0) {
+        PRINT_ERROR("Reference %s not found in run %s", reference, run->label);
+        return ERROR_INVALID_PARAM;
+    }
+
+    double ref_median = ref->median;
+    int ref_higher = ref->higher_is_better;
+    for (int i = 0; i < run->set.count; i++) {
+        bench_record_t *rec = &run->set.records[i];
+        double scale = rec->higher_is_better == ref_higher ? 1.0 / ref_median : ref_median;
+        for (int s = 0; s < rec->n; s++) {
+            rec->samples[s] *= scale;
+        }
+        rec->median *= scale;
+        rec->mean *= scale;
+        snprintf(rec->unit, sizeof(rec->unit), "x ref");
+    }
+    return SUCCESS;
+}
+
+static int compare_value(const void *a, const void *b) {
+    double x = ((const double *)a)[0];
+    double y = ((const double *)b)[0];
+    return (x > y) - (x < y);
+}
+
+// Two-sided Mann-Whitney U test using the normal approximation with tie
+// and continuity correction; benchmark samples are rarely normal
+double mann_whitney_p(const double *a, int na, const double *b, int nb) {
+    int n = na + nb;
+    double (*pool)[2] = malloc(n * sizeof(*pool));   // value, group
+    if (!pool || na == 0 || nb == 0) {
+        free(pool);
+        return 1.0;
+    }
+
+    for (int i = 0; i < na; i++) { pool[i][0] = a[i]; pool[i][1] = 0; }
+    for (int i = 0; i < nb; i++) { pool[na + i][0] = b[i]; pool[na + i][1] = 1; }
+    qsort(pool, n, sizeof(*pool), compare_value);
+
+    double rank_sum_a = 0.0;
+    double tie_term = 0.0;
+    for (int i = 0; i < n; ) {
+        int j = i;
+        while (j + 1 < n && pool[j + 1][0] == pool[i][0]) j++;
+        double rank = (i + j) / 2.0 + 1.0;
+        double ties = j - i + 1;
+        for (int k = i; k <= j; k++) {
+            if (pool[k][1] == 0) rank_sum_a += rank;
+        }
+        tie_term += ties * ties * ties - ties;
+        i = j + 1;
+    }
+    free(pool);
+
+    double u = rank_sum_a - na * (na + 1) / 2.0;
+    double mu = na * (double)nb / 2.0;
+    double sigma2 = na * (double)nb / 12.0 * ((n + 1) - tie_term / ((double)n * (n - 1)));
+    if (sigma2 <= 0.0) {
+        return 1.0;
+    }
+
+    double diff = fabs(u - mu) - 0.5;
+    if (diff < 0.0) diff = 0.0;
+    double z = diff / sqrt(sigma2);
+    return erfc(z / sqrt(2.0));
+}
+
+static const char *verdict_name(verdict_t v) {
+    switch (v) {
+        case VERDICT_IMPROVED:  return "improved";
+        case VERDICT_REGRESSED: return "REGRESSION";
+        case VERDICT_NOISE:     return "noise";
+        default:                return "-";
+    }
+}
+
+// Returns the number of regressions, or a negative error code
+int compare_runs(run_view_t *base, run_view_t *cur, const compare_options_t *opts) {
+    if (base->set.count == 0 || cur->set.count == 0) {
+        PRINT_ERROR("Nothing to compare: %s has no records",
+                    base->set.count == 0 ? base->label : cur->label);
+        return ERROR_INVALID_PARAM;
+    }
+    const bench_record_t *b0 = &base->set.records[0];
+    const bench_record_t *c0 = &cur->set.records[0];
+
+    if (strcmp(b0->cpu_model, c0->cpu_model) != 0 || strcmp(b0->cpu_signature, c0->cpu_signature) != 0) {
+        PRINT_INFO("Warning: runs come from different CPUs:");
+        PRINT_INFO("  base: %s (%s) on %s", b0->cpu_model, b0->cpu_signature, b0->host);
+        PRINT_INFO("  new:  %s (%s) on %s", c0->cpu_model, c0->cpu_signature, c0->host);
+        if (!opts->normalize) {
+            PRINT_INFO("  Absolute results are not comparable; consider --normalize benchmark:kernel");
+        }
+    }
+
+    if (opts->normalize) {
+        if (normalize_run(base, opts->normalize) != SUCCESS ||
+            normalize_run(cur, opts->normalize) != SUCCESS) {
+            return ERROR_INVALID_PARAM;
+        }
+    }
+
+    PRINT_INFO("Base: %s", base->label);
+    PRINT_INFO("New:  %s", cur->label);
+    printf("\n%-36s %-24s %-10s %12s %12s %8s %8s  %s\n",
+           "Benchmark/Kernel", "Config", "Unit", "Base", "New", "Change", "p", "Verdict");
+
+    int regressions = 0, improvements = 0, compared = 0, unmatched = 0, small_n = 0;
+
+    for (int i = 0; i < cur->set.count; i++) {
+        const bench_record_t *c = &cur->set.records[i];
+        const bench_record_t *b = NULL;
+
+        // The last record wins if a key was measured twice in one run
+        int later = 0;
+        for (int j = i + 1; j < cur->set.count && !later; j++) {
+            later = same_key(&cur->set.records[j], c);
+        }
+        if (later) continue;
+
+        for (int j = 0; j < base->set.count; j++) {
+            if (same_key(&base->set.records[j], c)) {
+                b = &base->set.records[j];
+            }
+        }
+        if (!b) {
+            unmatched++;
+            continue;
+        }
+
+        compared++;
+        double change = b->median != 0.0 ? (c->median - b->median) / fabs(b->median) * 100.0 : 0.0;
+        double p = mann_whitney_p(b->samples, b->n, c->samples, c->n);
+        int better = c->higher_is_better ? change > 0 : change < 0;
+        verdict_t verdict = VERDICT_SAME;
+
+        if (b->n < 4 || c->n < 4) {
+            small_n++;
+        }
+
+        if (fabs(change) >= opts->threshold) {
+            if (p < opts->alpha) {
+                verdict = better ? VERDICT_IMPROVED : VERDICT_REGRESSED;
+            } else {
+                verdict = VERDICT_NOISE;
+            }
+        }
+        if (verdict == VERDICT_REGRESSED) regressions++;
+        if (verdict == VERDICT_IMPROVED) improvements++;
+
+        char name[2 * RESULTS_STR_LEN];
+        snprintf(name, sizeof(name), "%s/%s", c->benchmark, c->kernel);
+        printf("%-36s %-24.24s %-10s %12.4g %12.4g %+7.2f%% %8.4f  %s\n",
+               name, c->config, c->unit, b->median, c->median, change, p, verdict_name(verdict));
+    }
+
+    printf("\n");
+    PRINT_INFO("Compared %d result(s): %d regression(s), %d improvement(s)",
+               compared, regressions, improvements);
+    if (unmatched > 0) {
+        PRINT_INFO("%d result(s) in the new run have no baseline", unmatched);
+    }
+    if (small_n > 0) {
+        PRINT_INFO("%d comparison(s) have fewer than 4 samples per side; "
+                   "the test cannot reach significance, rerun with more --reps", small_n);
+    }
+    return regressions;
+}
@@ -1,5 +1,6 @@
 #include "../common/common.h"
 #include "../common/msr_utils.h"
+#include "../common/topology.h"
 
 // Uncore frequency control definitions
 #define UNCORE_FREQ_SYSFS_PATH "/sys/devices/system/cpu/intel_uncore_frequency"
@@ -7,6 +8,8 @@
 
 typedef struct {
     int domain_id;
+    int package_id;
+    int die_id;
     int min_freq_khz;
     int max_freq_khz;
     int current_freq_khz;
@@ -123,18 +126,27 @@ int uncore_cleanup(void) {
 
 int uncore_get_domains(uncore_domain_t *domains, int max_domains) {
     int domain_count = 0;
+    const topology_t *topo = topology_get();
+    if (!topo) {
+        return 0;
+    }
     
-    for (int i = 0; i < max_domains; i++) {
+    // One uncore domain per (package, die) pair
+    for (int i = 0; i < topo->num_dies && domain_count < max_domains; i++) {
+        int package_id = topo->dies[i].package_id;
+        int die_id = topo->dies[i].id;
         char min_path[256], max_path[256], cur_path[256];
         snprintf(min_path, sizeof(min_path), 
-                "%s/package_%02d_die_%02d/min_freq_khz", UNCORE_FREQ_SYSFS_PATH, i, 0);
+                "%s/package_%02d_die_%02d/min_freq_khz", UNCORE_FREQ_SYSFS_PATH, package_id, die_id);
         snprintf(max_path, sizeof(max_path), 
-                "%s/package_%02d_die_%02d/max_freq_khz", UNCORE_FREQ_SYSFS_PATH, i, 0);
+                "%s/package_%02d_die_%02d/max_freq_khz", UNCORE_FREQ_SYSFS_PATH, package_id, die_id);
         snprintf(cur_path, sizeof(cur_path), 
-                "%s/package_%02d_die_%02d/current_freq_khz", UNCORE_FREQ_SYSFS_PATH, i, 0);
+                "%s/package_%02d_die_%02d/current_freq_khz", UNCORE_FREQ_SYSFS_PATH, package_id, die_id);
         
         if (check_file_exists(min_path) == SUCCESS) {
-            domains[domain_count].domain_id = i;
+            domains[domain_count].domain_id = domain_count;
+            domains[domain_count].package_id = package_id;
+            domains[domain_count].die_id = die_id;
             
             read_file_int(min_path, &domains[domain_count].min_freq_khz);
             read_file_int(max_path, &domains[domain_count].max_freq_khz);
@@ -159,7 +171,7 @@ int uncore_set_min_freq(int domain, int freq_khz) {
     char path[256];
     snprintf(path, sizeof(path), 
             "%s/package_%02d_die_%02d/min_freq_khz", 
-            UNCORE_FREQ_SYSFS_PATH, domains[domain].domain_id, 0);
+            UNCORE_FREQ_SYSFS_PATH, domains[domain].package_id, domains[domain].die_id);
     
     return write_file_int(path, freq_khz);
 }
@@ -170,7 +182,7 @@ int uncore_set_max_freq(int domain, int freq_khz) {
     char path[256];
     snprintf(path, sizeof(path), 
             "%s/package_%02d_die_%02d/max_freq_khz", 
-            UNCORE_FREQ_SYSFS_PATH, domains[domain].domain_id, 0);
+            UNCORE_FREQ_SYSFS_PATH, domains[domain].package_id, domains[domain].die_id);
     
     return write_file_int(path, freq_khz);
 }
@@ -181,7 +193,7 @@ int uncore_get_current_freq(int domain, int *freq_khz) {
     char path[256];
     snprintf(path, sizeof(path), 
             "%s/package_%02d_die_%02d/current_freq_khz", 
-            UNCORE_FREQ_SYSFS_PATH, domains[domain].domain_id, 0);
+            UNCORE_FREQ_SYSFS_PATH, domains[domain].package_id, domains[domain].die_id);
     
     return read_file_int(path, freq_khz);
 }
@@ -287,7 +299,8 @@ void uncore_print_info(void) {
     PRINT_INFO("Domains found: %d", num_domains);
     
     for (int i = 0; i < num_domains; i++) {
-        PRINT_INFO("Domain %d:", domains[i].domain_id);
+        PRINT_INFO("Domain %d (package %d, die %d):", domains[i].domain_id,
+                   domains[i].package_id, domains[i].die_id);
         PRINT_INFO("  Min frequency: %d kHz", domains[i].min_freq_khz);
         PRINT_INFO("  Max frequency: %d kHz", domains[i].max_freq_khz);
         
@@ -20,6 +20,16 @@
 #include <cmath>
 #include <condition_variable>
 #include <mutex>
+#include <numeric>
+
+#include "bench_harness.h"
+
+#define WAKEUP_BATCH 1000  // Wake-ups per harness sample
+
+// Harness kernel; ctx is the CPUCStateBenchmark instance
+static double kernel_wakeup(void *ctx);
+
+static const bench_kernel_t wakeup_kernel = { "wakeup_p50", "us", 0, kernel_wakeup };
 
 class CPUCStateBenchmark {
 private:
@@ -65,12 +75,12 @@ private:
     }
     
 public:
+    LatencyResult last_latency{};
+    
     LatencyResult benchmark_wakeup_latency(int iterations = 10000) {
         std::vector<double> latencies;
         latencies.reserve(iterations);
         
-        std::cout << "Measuring wake-up latency (" << iterations << " iterations)...\n";
-        
         for (int i = 0; i < iterations; i++) {
             auto start = std::chrono::high_resolution_clock::now();
             
@@ -233,9 +243,15 @@ public:
             
             std::cout << "Current config: " << get_current_cstate_config() << "\n\n";
             
-            // 1. Wake-up latency test
-            auto latency = benchmark_wakeup_latency(5000);
-            std::cout << "Wake-up latency:\n";
+            // 1. Wake-up latency test, per-wake percentiles come from the last batch
+            std::cout << "Measuring wake-up latency (" << WAKEUP_BATCH << " wake-ups per sample)...\n";
+            bench_stats_t stats;
+            bench_run(&wakeup_kernel, this, config.name.c_str(), &stats);
+            const auto& latency = last_latency;
+            std::cout << "Wake-up latency (median p50 over " << stats.n << " samples): "
+                      << std::fixed << std::setprecision(2) << stats.median << " us, 95% CI ["
+                      << stats.ci95_lo << ", " << stats.ci95_hi << "]\n";
+            std::cout << "Wake-up latency (last sample):\n";
             std::cout << "  Min: " << std::fixed << std::setprecision(2) << latency.min_us << " us\n";
             std::cout << "  Avg: " << latency.avg_us << " us\n";
             std::cout << "  P95: " << latency.p95_us << " us\n";
@@ -285,7 +301,27 @@ public:
     }
 };
 
-int main() {
+static double kernel_wakeup(void *ctx) {
+    auto *bench = static_cast<CPUCStateBenchmark *>(ctx);
+    bench->last_latency = bench->benchmark_wakeup_latency(WAKEUP_BATCH);
+    return bench->last_latency.p50_us;
+}
+
+int main(int argc, char* argv[]) {
+    bench_register(&wakeup_kernel);
+    
+    bench_options_t opts;
+    bench_options_init(&opts, "cpu_cstate_benchmark");
+    if (bench_parse_args(&opts, &argc, argv) != SUCCESS || argc > 1) {
+        std::cerr << "Usage: " << argv[0] << " [harness options]\n";
+        bench_print_usage();
+        return 1;
+    }
+    if (bench_begin(&opts) != SUCCESS) {
+        std::cerr << "Failed to set up benchmark harness\n";
+        return 1;
+    }
+    
     std::cout << "CPU C-State Impact Benchmark\n";
     std::cout << "============================\n";
     
@@ -301,8 +337,10 @@ int main() {
         
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
+        bench_end();
         return 1;
     }
     
+    bench_end();
     return 0;
 }
\ No newline at end of file
@@ -20,6 +20,21 @@
 #include <iomanip>
 #include <cstring>
 
+#include "bench_harness.h"
+
+class CPUFreqBenchmark;
+
+// Harness kernels; ctx is the CPUFreqBenchmark instance
+static double kernel_compute(void *ctx);
+static double kernel_mem_bw(void *ctx);
+static double kernel_latency(void *ctx);
+
+static const bench_kernel_t freq_kernels[] = {
+    { "compute", "GFLOPS", 1, kernel_compute },
+    { "mem_bw",  "GB/s",   1, kernel_mem_bw },
+    { "latency", "ns",     0, kernel_latency },
+};
+
 class CPUFreqBenchmark {
 private:
     static constexpr size_t ARRAY_SIZE = 64 * 1024 * 1024; // 64MB
@@ -138,23 +153,31 @@ public:
         return latencies[latencies.size() / 2];
     }
     
+    // Median of the harness repetitions, 0 when the kernel is filtered out
+    double measure(const bench_kernel_t& kernel, const std::string& config) {
+        if (!bench_kernel_selected(&kernel)) {
+            return 0.0;
+        }
+        bench_stats_t stats;
+        bench_run(&kernel, this, config.c_str(), &stats);
+        return stats.median;
+    }
+    
     BenchmarkResult run_benchmark() {
         BenchmarkResult result;
         
         // Read current frequency
         result.frequency_khz = read_current_freq();
-        
-        // Warm up
-        benchmark_compute();
+        std::string config = "freq_khz=" + std::to_string(result.frequency_khz);
         
         // Energy measurement start
         double energy_start = read_cpu_energy();
         auto power_start = std::chrono::steady_clock::now();
         
-        // Run benchmarks
-        result.compute_gflops = benchmark_compute();
-        result.memory_bandwidth_gb_s = benchmark_memory_bandwidth();
-        result.latency_ns = benchmark_latency();
+        // Run benchmarks (the harness handles warmup and repetitions)
+        result.compute_gflops = measure(freq_kernels[0], config);
+        result.memory_bandwidth_gb_s = measure(freq_kernels[1], config);
+        result.latency_ns = measure(freq_kernels[2], config);
         
         // Energy measurement end
         double energy_end = read_cpu_energy();
@@ -230,7 +253,33 @@ public:
     }
 };
 
+static double kernel_compute(void *ctx) {
+    return static_cast<CPUFreqBenchmark *>(ctx)->benchmark_compute();
+}
+
+static double kernel_mem_bw(void *ctx) {
+    return static_cast<CPUFreqBenchmark *>(ctx)->benchmark_memory_bandwidth();
+}
+
+static double kernel_latency(void *ctx) {
+    return static_cast<CPUFreqBenchmark *>(ctx)->benchmark_latency();
+}
+
 int main(int argc, char* argv[]) {
+    for (const auto& kernel : freq_kernels) {
+        bench_register(&kernel);
+    }
+    
+    // Each compute sample is long, so default to fewer repetitions
+    bench_options_t opts;
+    bench_options_init(&opts, "cpu_freq_benchmark");
+    opts.repetitions = 3;
+    if (bench_parse_args(&opts, &argc, argv) != SUCCESS || argc > 1) {
+        std::cerr << "Usage: " << argv[0] << " [harness options]\n";
+        bench_print_usage();
+        return 1;
+    }
+    
     std::cout << "CPU Frequency Impact Benchmark\n";
     std::cout << "==============================\n";
     
@@ -271,13 +320,20 @@ int main(int argc, char* argv[]) {
         return 1;
     }
     
+    if (bench_begin(&opts) != SUCCESS) {
+        std::cerr << "Failed to set up benchmark harness\n";
+        return 1;
+    }
+    
     try {
         CPUFreqBenchmark bench;
         bench.run_frequency_sweep(test_frequencies);
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
+        bench_end();
         return 1;
     }
     
+    bench_end();
     return 0;
 }
\ No newline at end of file